@@ -1,5 +1,6 @@
 #include "AbstractModel.h"
 #include "EventBucket.h"
+#include "SNAPTrace.h"
 
 #include <IRISException.h>
 #include <vtkObject.h>
@@ -29,6 +30,7 @@ void AbstractModel::Update()
 {
   if(!m_EventBucket->IsEmpty())
     {
+    SNAP_TRACE_SCOPE("model", this->GetNameOfClass());
 #ifdef SNAP_DEBUG_EVENTS
     if(flag_snap_debug_events)
       {
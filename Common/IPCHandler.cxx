@@ -5,6 +5,7 @@
 #include <cerrno>
 #include <functional>
 #include <sstream>
+#include <climits>
 
 #if defined(WIN32)
   #ifdef _WIN32_WINNT
@@ -29,8 +30,87 @@
   #include <unistd.h>
   #include <signal.h>
   #include <sys/time.h>
+  #include <time.h>
+  #if defined(__linux__)
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #define SNAP_IPC_USE_FUTEX
+  #endif
 #endif
 
+namespace {
+
+// Atomic access to the sequence counter in shared memory
+inline int ipc_load_seq(volatile int *seq)
+{
+#if defined(WIN32)
+  return InterlockedCompareExchange((volatile long *) seq, 0, 0);
+#else
+  return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+#endif
+}
+
+inline void ipc_increment_seq(volatile int *seq)
+{
+#if defined(WIN32)
+  InterlockedIncrement((volatile long *) seq);
+#else
+  __atomic_add_fetch(seq, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+// Replace the sequence counter if it still has the expected value
+inline bool ipc_cas_seq(volatile int *seq, int expected, int desired)
+{
+#if defined(WIN32)
+  return InterlockedCompareExchange((volatile long *) seq, desired, expected) == expected;
+#else
+  return __atomic_compare_exchange_n(seq, &expected, desired, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Yield the processor to other threads
+inline void ipc_yield()
+{
+#if defined(WIN32)
+  Sleep(0);
+#else
+  usleep(0);
+#endif
+}
+
+// Sleep the calling thread for a number of milliseconds
+inline void ipc_sleep_ms(int ms)
+{
+#if defined(WIN32)
+  Sleep(ms);
+#else
+  usleep(ms * 1000);
+#endif
+}
+
+#if defined(SNAP_IPC_USE_FUTEX)
+
+// Wait on a shared (non-private) futex while its value equals 'value'
+inline void ipc_futex_wait(volatile int *addr, int value, int timeout_ms)
+{
+  struct timespec ts;
+  ts.tv_sec = timeout_ms / 1000;
+  ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+  syscall(SYS_futex, (int *) addr, FUTEX_WAIT, value, &ts, nullptr, 0);
+}
+
+// Wake all processes sleeping on the futex
+inline void ipc_futex_wake_all(volatile int *addr)
+{
+  syscall(SYS_futex, (int *) addr, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+#endif
+
+}
+
 using namespace std;
 
 void IPCHandler::Attach(const char *path, short version, size_t message_size)
@@ -70,7 +150,11 @@ void IPCHandler::Attach(const char *path, short version, size_t message_size)
   // Generate a complete key
   // std::ostringstream oss_key;
   // oss_key << "5A636Q488D.itksnap." << str_hash;
-  m_SharedMemoryObjectName = "5A636Q488D.itksnap";
+  // The object name includes the protocol version, since the size of the
+  // shared memory object can not be changed once it has been created
+  std::ostringstream oss_name;
+  oss_name << "5A636Q488D.itksnap." << std::hex << version;
+  m_SharedMemoryObjectName = oss_name.str();
 
   // Try to connect to an existing memory space
   m_Handle = shm_open(m_SharedMemoryObjectName.c_str(), O_RDWR, 0644);
@@ -140,26 +224,105 @@ void IPCHandler::Attach(const char *path, short version, size_t message_size)
     }
 }
 
+bool IPCHandler::ReadHeader(Header &snapshot) const
+{
+  // Copy the header under the sequence lock, like the message in Read()
+  const Header *header = static_cast<const Header *>(m_SharedData);
+  for(int attempt = 0; attempt < 100; attempt++)
+    {
+    int seq_start = ipc_load_seq(const_cast<volatile int *>(&header->sequence));
+    if(seq_start & 1)
+      {
+      ipc_yield();
+      continue;
+      }
+
+    snapshot.version = header->version;
+    snapshot.sender_pid = header->sender_pid;
+    snapshot.message_id = header->message_id;
+    snapshot.message_size = header->message_size;
+
+    if(ipc_load_seq(const_cast<volatile int *>(&header->sequence)) == seq_start)
+      return true;
+    }
+
+  return false;
+}
+
+bool IPCHandler::IsNewMessage() const
+{
+  Header header;
+  if(!ReadHeader(header))
+    return false;
+
+  // Ignore messages from different versions
+  if(header.version != m_ProtocolVersion)
+    return false;
+
+  // Ignore our own messages or messages from dead processes
+  if(header.sender_pid == m_ProcessID || header.sender_pid == -1)
+    return false;
+
+  // If we have already seen this message from this sender, also ignore it
+  if(m_LastSender == header.sender_pid && m_LastReceivedMessageID == header.message_id)
+    return false;
+
+  return true;
+}
+
+bool IPCHandler::HasMessage() const
+{
+  Header header;
+  return m_SharedData && ReadHeader(header) && header.version == m_ProtocolVersion;
+}
+
 bool IPCHandler::Read(void *target_ptr)
 {
   // Must have some shared memory
   if(!m_SharedData)
     return false;
 
-  // Read the header, make sure it's the right version number
   Header *header = static_cast<Header *>(m_SharedData);
-  if(header->version != m_ProtocolVersion)
-    return false;
 
-  // Store the last sender / id
-  m_LastSender = header->sender_pid;
-  m_LastReceivedMessageID = header->message_id;
+  // Copy the message under the sequence lock: if the sender was writing while
+  // we copied, the sequence number will have changed and we try again
+  for(int attempt = 0; attempt < 100; attempt++)
+    {
+    int seq_start = ipc_load_seq(&header->sequence);
+    if(seq_start & 1)
+      {
+      ipc_yield();
+      continue;
+      }
+
+    // Make sure it's the right version number
+    if(header->version != m_ProtocolVersion)
+      return false;
 
-  // Copy the message to the target pointer
-  memcpy(target_ptr, m_UserData, m_MessageSize);
+    long sender = header->sender_pid, id = header->message_id;
+    size_t size = header->message_size;
+    if(size > m_MessageSize)
+      size = m_MessageSize;
 
-  // Success!
-  return true;
+    memcpy(target_ptr, m_UserData, size);
+
+    if(ipc_load_seq(&header->sequence) == seq_start)
+      {
+      // Zero out the part of the message not sent by the sender
+      if(size < m_MessageSize)
+        memset(static_cast<char *>(target_ptr) + size, 0, m_MessageSize - size);
+
+      // Store the last sender / id
+      m_LastSender = sender;
+      m_LastReceivedMessageID = id;
+      m_LastMessageSize = size;
+
+      // Success!
+      return true;
+      }
+    }
+
+  return false;
 }
 
 bool IPCHandler::ReadIfNew(void *target_ptr)
@@ -168,50 +331,119 @@ bool IPCHandler::ReadIfNew(void *target_ptr)
   if(!m_SharedData)
     return false;
 
-  // Read the header, make sure it's the right version number
-  Header *header = static_cast<Header *>(m_SharedData);
-  if(header->version != m_ProtocolVersion)
+  // Check that there is a message we have not seen before
+  if(!IsNewMessage())
     return false;
 
-  // Ignore our own messages or messages from dead processes
-  if(header->sender_pid == m_ProcessID || header->sender_pid == -1)
-    return false;
+  // Read the message
+  return Read(target_ptr);
+}
 
-  // If we have already seen this message from this sender, also ignore it
-  if(m_LastSender == header->sender_pid && m_LastReceivedMessageID == header->message_id)
+bool IPCHandler::WaitForMessage(int timeout_ms)
+{
+  // Must have some shared memory
+  if(!m_SharedData)
+    {
+    ipc_sleep_ms(timeout_ms);
     return false;
+    }
+
+  Header *header = static_cast<Header *>(m_SharedData);
 
-  // Store the last sender / id
-  m_LastSender = header->sender_pid;
-  m_LastReceivedMessageID = header->message_id;
+#if defined(SNAP_IPC_USE_FUTEX)
 
-  // Copy the message to the target pointer
-  memcpy(target_ptr, m_UserData, m_MessageSize);
+  // Read the sequence before checking for a new message. If a broadcast happens
+  // after the check, the futex value will differ and the wait returns at once
+  int seq = ipc_load_seq(&header->sequence);
+  if(IsNewMessage())
+    return true;
+
+  ipc_futex_wait(&header->sequence, seq, timeout_ms);
+  return IsNewMessage();
+
+#else
+
+  // Poll the header at a short interval
+  const int poll_interval = 5;
+  for(int t = 0; t < timeout_ms; t += poll_interval)
+    {
+    if(IsNewMessage())
+      return true;
+    ipc_sleep_ms(poll_interval);
+    }
+  return IsNewMessage();
+
+#endif
+}
 
-  // Success!
+bool IPCHandler::IsNotificationSupported()
+{
+#if defined(SNAP_IPC_USE_FUTEX)
   return true;
+#else
+  return false;
+#endif
+}
+
+void IPCHandler::LockForWriting(Header *header)
+{
+  // Take the writer lock by making the sequence odd. Several sessions may
+  // broadcast at once, so this must be a compare-and-swap. A session that
+  // crashed while writing leaves the sequence odd; after a while we take
+  // over the lock from it
+  const int max_attempts = 1000;
+  for(int attempt = 0; ; attempt++)
+    {
+    int seq = ipc_load_seq(&header->sequence);
+    if(!(seq & 1) && ipc_cas_seq(&header->sequence, seq, seq + 1))
+      return;
+    if((seq & 1) && attempt >= max_attempts && ipc_cas_seq(&header->sequence, seq, seq + 2))
+      return;
+    ipc_yield();
+    }
 }
 
+void IPCHandler::UnlockAfterWriting(Header *header)
+{
+  ipc_increment_seq(&header->sequence);
+#if defined(SNAP_IPC_USE_FUTEX)
+  ipc_futex_wake_all(&header->sequence);
+#endif
+}
 
 bool
 IPCHandler
 ::Broadcast(const void *message_ptr)
+{
+  return Broadcast(message_ptr, m_MessageSize);
+}
+
+bool
+IPCHandler
+::Broadcast(const void *message_ptr, size_t message_size)
 {
   // Write to the shared memory
-  if(m_SharedData)
+  if(m_SharedData && message_size <= m_MessageSize)
     {
     // Access the message header
     Header *header = static_cast<Header *>(m_SharedData);
 
+    // Take the writer lock
+    LockForWriting(header);
+
     // Write version number
     header->version = m_ProtocolVersion;
 
     // Write the process ID
     header->sender_pid = m_ProcessID;
     header->message_id = ++m_MessageID;
+    header->message_size = (unsigned int) message_size;
 
     // Copy the message contents into the shared memory
-    memcpy(m_UserData, message_ptr, m_MessageSize);
+    memcpy(m_UserData, message_ptr, message_size);
+
+    // Mark the message as complete and wake up the listeners
+    UnlockAfterWriting(header);
 
     // Done
     return true;
@@ -230,8 +462,10 @@ void IPCHandler::Close()
     Header *header = static_cast<Header *>(m_SharedData);
 
     // Is the current shared memory created by us? If so, we need to clear it
+    LockForWriting(header);
     if(header->version == m_ProtocolVersion && header->sender_pid == m_ProcessID)
       header->sender_pid = -1;
+    UnlockAfterWriting(header);
     }
 
 #if defined(WIN32)
@@ -264,6 +498,8 @@ IPCHandler::IPCHandler()
   m_LastReceivedMessageID = -1;
   m_LastSender = -1;
   m_MessageID = 0;
+  m_MessageSize = 0;
+  m_LastMessageSize = 0;
 
   // Reset the shared memory
   m_SharedData = NULL;
@@ -1,6 +1,7 @@
 #ifndef IPCHANDLER_H
 #define IPCHANDLER_H
 
+#include <atomic>
 #include <cstddef>
 #include <set>
 #include <string>
@@ -22,7 +23,8 @@ public:
    * number is used to prevent problems when the format of the shared data structure
    * has changed between versions of the program. The version number should be
    * incremented whenever the data structure being shared changes. The last parameter
-   * is the size of the message in bytes (obtained using size_of)
+   * is the maximum size of the message in bytes (e.g., obtained using size_of).
+   * Messages of any size up to this capacity can be broadcast.
    */
   void Attach(const char *path, short version, size_t message_size);
 
@@ -32,7 +34,11 @@ public:
   /** Whether the shared memory is attached */
   bool IsAttached() { return m_SharedData != NULL; }
 
-  /** Read a 'message', i.e., the contents of shared memory */
+  /**
+   * Read a 'message', i.e., the contents of shared memory. The target must be
+   * able to hold the full message capacity passed to Attach. If the message
+   * in shared memory is shorter, the remaining bytes of the target are zeroed.
+   */
   bool Read(void *target_ptr);
 
   /** Read a 'message' but only if it has not been seen before */
@@ -41,6 +47,30 @@ public:
   /** Broadcast a 'message' (i.e. replace shared memory contents */
   bool Broadcast(const void *message_ptr);
 
+  /** Broadcast a message of given size (must not exceed capacity) */
+  bool Broadcast(const void *message_ptr, size_t message_size);
+
+  /** Size of the payload in the last message read */
+  size_t GetLastMessageSize() const { return m_LastMessageSize; }
+
+  /**
+   * Block until another process broadcasts a message that this process has
+   * not read yet, or until the timeout expires. Returns true if a new message
+   * is available. On Linux this sleeps on a futex in shared memory and is woken
+   * by Broadcast(), elsewhere it falls back to short sleeps. The method does not
+   * modify the state of the handler and may be called from a listener thread
+   * while Read/ReadIfNew are called on the main thread. A message seen while
+   * the main thread is reading it may be reported as new, and is then ignored
+   * by ReadIfNew.
+   */
+  bool WaitForMessage(int timeout_ms);
+
+  /** Whether WaitForMessage uses a real notification mechanism */
+  static bool IsNotificationSupported();
+
+  /** Whether shared memory holds a message with the current protocol version */
+  bool HasMessage() const;
+
 protected:
 
   struct Header
@@ -48,8 +78,25 @@ protected:
     short version;
     long sender_pid;
     long message_id;
+
+    // Size of the message payload that follows the header
+    unsigned int message_size;
+
+    // Sequence counter, odd while a message is being written. Doubles as the
+    // futex word on which listeners sleep
+    volatile int sequence;
   };
 
+  // Copy the header from shared memory, returns false if it kept changing
+  bool ReadHeader(Header &snapshot) const;
+
+  // Check whether shared memory holds a message we have not seen yet
+  bool IsNewMessage() const;
+
+  // Take and release the lock held while a message is written
+  static void LockForWriting(Header *header);
+  static void UnlockAfterWriting(Header *header);
+
 
   // Shared data pointer
   void *m_SharedData, *m_UserData;
@@ -57,6 +104,9 @@ protected:
   // Size of the shared data message
   size_t m_MessageSize;
 
+  // Size of the last message read
+  size_t m_LastMessageSize;
+
   // Version of the protocol (to avoid problems with older code)
   short m_ProtocolVersion;
 
@@ -76,7 +126,11 @@ protected:
   static const short IPC_VERSION;
 
   // Process ID and other values used by IPC
-  long m_ProcessID, m_MessageID, m_LastSender, m_LastReceivedMessageID;
+  long m_ProcessID, m_MessageID;
+
+  // The last message read. These are also checked by WaitForMessage, which
+  // may be called on a listener thread
+  std::atomic<long> m_LastSender, m_LastReceivedMessageID;
 
   bool IsProcessRunning(int pid);
 
@@ -39,8 +39,11 @@
 #include <stdio.h>
 #include <cstdlib>
 #include <cstdarg>
+#include <cstring>
+#include <cctype>
 #include <fstream>
 #include <iomanip>
+#include <iterator>
 #include <regex>
 #include "itksys/SystemTools.hxx"
 #include "IRISException.h"
@@ -161,6 +164,431 @@ void RegistryXMLFileReader::CharacterDataHandler(const char *inData, int inLengt
 }
 
 
+/**
+ * A fast, zero-copy tokenizer for Registry XML files. ITK-SNAP workspace and
+ * preference files only use the <registry>, <folder> and <entry> elements, so
+ * rather than handing them to a general-purpose XML parser (which allocates an
+ * attribute map for every element), the tokenizer scans the file buffer in
+ * place and emits tokens that point into the buffer. Keys and values are only
+ * copied (and entity-decoded) when they are inserted into the Registry.
+ *
+ * The tokenizer is deliberately strict: on anything it does not understand
+ * (CDATA, custom entities, non-UTF-8 encodings, malformed markup) it reports
+ * failure and the caller falls back to the general XML reader, which then
+ * produces the same result or error as before.
+ */
+class RegistryXMLTokenizer
+{
+public:
+
+  enum TokenType { FOLDER_START, FOLDER_END, ENTRY, REGISTRY_START, REGISTRY_END };
+
+  struct Token
+  {
+    TokenType type;
+    const char *key, *value;
+    size_t key_len, value_len;
+    bool key_raw, value_raw;
+  };
+
+  typedef std::vector<Token> TokenList;
+
+  RegistryXMLTokenizer(const char *begin, const char *end)
+    : m_Pos(begin), m_End(end) {}
+
+  /** Tokenize the buffer, returns false if the fast path can not be used */
+  bool Tokenize(TokenList &tokens)
+  {
+    // Skip the UTF-8 byte order mark
+    if(m_End - m_Pos >= 3 && !memcmp(m_Pos, "\xEF\xBB\xBF", 3))
+      m_Pos += 3;
+
+    int depth = 0;
+    bool seen_root = false;
+    while(m_Pos < m_End)
+      {
+      // Character data between elements is ignored, as in the XML reader
+      const char *lt = (const char *) memchr(m_Pos, '<', m_End - m_Pos);
+      if(!lt)
+        break;
+      m_Pos = lt + 1;
+      if(m_Pos >= m_End)
+        return false;
+
+      if(*m_Pos == '?')
+        {
+        // Processing instruction / XML declaration
+        const char *pi_end = Find("?>");
+        if(!pi_end || !CheckDeclarationEncoding(m_Pos, pi_end))
+          return false;
+        m_Pos = pi_end + 2;
+        }
+      else if(StartsWith("!--"))
+        {
+        const char *c_end = Find("-->");
+        if(!c_end)
+          return false;
+        m_Pos = c_end + 3;
+        }
+      else if(StartsWith("!DOCTYPE"))
+        {
+        if(!SkipDoctype())
+          return false;
+        }
+      else if(*m_Pos == '!')
+        {
+        // CDATA and other constructs are left to the full parser
+        return false;
+        }
+      else if(*m_Pos == '/')
+        {
+        // End tag
+        ++m_Pos;
+        const char *name = m_Pos;
+        size_t name_len = ScanName();
+        SkipSpace();
+        if(m_Pos >= m_End || *m_Pos != '>')
+          return false;
+        ++m_Pos;
+
+        if(NameIs(name, name_len, "folder"))
+          {
+          if(--depth < 0)
+            return false;
+          tokens.push_back(MakeToken(FOLDER_END));
+          }
+        else if(NameIs(name, name_len, "registry"))
+          {
+          tokens.push_back(MakeToken(REGISTRY_END));
+          }
+        else if(!NameIs(name, name_len, "entry"))
+          return false;
+        }
+      else
+        {
+        // Start tag
+        const char *name = m_Pos;
+        size_t name_len = ScanName();
+        if(!name_len)
+          return false;
+
+        Token tok = MakeToken(ENTRY);
+        bool has_key = false, has_value = false, empty_element = false;
+
+        // Read the attributes
+        while(true)
+          {
+          SkipSpace();
+          if(m_Pos >= m_End)
+            return false;
+          if(*m_Pos == '>')
+            {
+            ++m_Pos;
+            break;
+            }
+          if(*m_Pos == '/')
+            {
+            if(m_Pos + 1 >= m_End || m_Pos[1] != '>')
+              return false;
+            m_Pos += 2;
+            empty_element = true;
+            break;
+            }
+
+          const char *attr = m_Pos;
+          size_t attr_len = ScanName();
+          if(!attr_len)
+            return false;
+          SkipSpace();
+          if(m_Pos >= m_End || *m_Pos != '=')
+            return false;
+          ++m_Pos;
+          SkipSpace();
+          if(m_Pos >= m_End || (*m_Pos != '"' && *m_Pos != '\''))
+            return false;
+          char quote = *m_Pos++;
+          const char *val = m_Pos;
+          const char *val_end = (const char *) memchr(m_Pos, quote, m_End - m_Pos);
+          if(!val_end)
+            return false;
+          m_Pos = val_end + 1;
+
+          // Values that contain markup or entities need decoding
+          bool raw = true;
+          for(const char *p = val; p < val_end; ++p)
+            {
+            if(*p == '<')
+              return false;
+            if(*p == '&' || *p == '\t' || *p == '\n' || *p == '\r')
+              raw = false;
+            }
+
+          if(NameIs(attr, attr_len, "key"))
+            {
+            tok.key = val; tok.key_len = val_end - val; tok.key_raw = raw;
+            has_key = true;
+            }
+          else if(NameIs(attr, attr_len, "value"))
+            {
+            tok.value = val; tok.value_len = val_end - val; tok.value_raw = raw;
+            has_value = true;
+            }
+          }
+
+        if(NameIs(name, name_len, "registry"))
+          {
+          seen_root = true;
+          tokens.push_back(MakeToken(REGISTRY_START));
+          if(empty_element)
+            tokens.push_back(MakeToken(REGISTRY_END));
+          }
+        else if(!seen_root)
+          {
+          return false;
+          }
+        else if(NameIs(name, name_len, "folder"))
+          {
+          if(!has_key)
+            return false;
+          tok.type = FOLDER_START;
+          tokens.push_back(tok);
+          if(empty_element)
+            tokens.push_back(MakeToken(FOLDER_END));
+          else
+            ++depth;
+          }
+        else if(NameIs(name, name_len, "entry"))
+          {
+          if(!has_key || !has_value)
+            return false;
+          tokens.push_back(tok);
+          }
+        else
+          return false;
+        }
+      }
+
+    return seen_root && depth == 0;
+  }
+
+  /**
+   * Convert an attribute value to a string, expanding the predefined and
+   * numeric entities and normalizing whitespace the way XML parsers do
+   */
+  static bool Decode(const char *p, size_t len, bool raw, std::string &out)
+  {
+    if(raw)
+      {
+      out.assign(p, len);
+      return true;
+      }
+
+    out.clear();
+    out.reserve(len);
+    const char *end = p + len;
+    while(p < end)
+      {
+      char c = *p;
+      if(c == '&')
+        {
+        const char *semi = (const char *) memchr(p, ';', end - p);
+        if(!semi)
+          return false;
+        const char *ent = p + 1;
+        size_t ent_len = semi - ent;
+        if(ent_len == 2 && !strncmp(ent, "lt", 2))
+          out.push_back('<');
+        else if(ent_len == 2 && !strncmp(ent, "gt", 2))
+          out.push_back('>');
+        else if(ent_len == 3 && !strncmp(ent, "amp", 3))
+          out.push_back('&');
+        else if(ent_len == 4 && !strncmp(ent, "apos", 4))
+          out.push_back('\'');
+        else if(ent_len == 4 && !strncmp(ent, "quot", 4))
+          out.push_back('"');
+        else if(ent_len > 1 && ent[0] == '#')
+          {
+          unsigned long code = 0;
+          bool hex = (ent[1] == 'x');
+          const char *d = ent + (hex ? 2 : 1);
+          if(d == semi)
+            return false;
+          for(; d < semi; ++d)
+            {
+            int digit;
+            if(*d >= '0' && *d <= '9')
+              digit = *d - '0';
+            else if(hex && *d >= 'a' && *d <= 'f')
+              digit = *d - 'a' + 10;
+            else if(hex && *d >= 'A' && *d <= 'F')
+              digit = *d - 'A' + 10;
+            else
+              return false;
+            code = code * (hex ? 16 : 10) + digit;
+            if(code > 0x10FFFF)
+              return false;
+            }
+          if(code == 0)
+            return false;
+          AppendUTF8(code, out);
+          }
+        else
+          return false;
+        p = semi + 1;
+        }
+      else if(c == '\r')
+        {
+        // Line ends (CR, LF, CRLF) are normalized to a single space
+        out.push_back(' ');
+        p += (p + 1 < end && p[1] == '\n') ? 2 : 1;
+        }
+      else if(c == '\n' || c == '\t')
+        {
+        out.push_back(' ');
+        ++p;
+        }
+      else
+        {
+        out.push_back(c);
+        ++p;
+        }
+      }
+    return true;
+  }
+
+protected:
+
+  const char *m_Pos, *m_End;
+
+  Token MakeToken(TokenType type)
+  {
+    Token tok = { type, NULL, NULL, 0, 0, true, true };
+    return tok;
+  }
+
+  bool StartsWith(const char *s)
+  {
+    size_t n = strlen(s);
+    return (size_t)(m_End - m_Pos) >= n && !memcmp(m_Pos, s, n);
+  }
+
+  const char *Find(const char *s)
+  {
+    size_t n = strlen(s);
+    for(const char *p = m_Pos; p + n <= m_End; ++p)
+      {
+      p = (const char *) memchr(p, s[0], m_End - p);
+      if(!p || p + n > m_End)
+        return NULL;
+      if(!memcmp(p, s, n))
+        return p;
+      }
+    return NULL;
+  }
+
+  static bool IsSpace(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  }
+
+  void SkipSpace()
+  {
+    while(m_Pos < m_End && IsSpace(*m_Pos))
+      ++m_Pos;
+  }
+
+  size_t ScanName()
+  {
+    const char *start = m_Pos;
+    while(m_Pos < m_End && !IsSpace(*m_Pos) && *m_Pos != '>' && *m_Pos != '/'
+          && *m_Pos != '=' && *m_Pos != '<')
+      ++m_Pos;
+    return m_Pos - start;
+  }
+
+  static bool NameIs(const char *name, size_t len, const char *target)
+  {
+    if(strlen(target) != len)
+      return false;
+    for(size_t i = 0; i < len; i++)
+      if(tolower((unsigned char) name[i]) != target[i])
+        return false;
+    return true;
+  }
+
+  // Only UTF-8 (and its ASCII subset) can be read in place
+  static bool CheckDeclarationEncoding(const char *begin, const char *end)
+  {
+    std::string decl(begin, end);
+    std::string::size_type pos = decl.find("encoding");
+    if(pos == std::string::npos)
+      return true;
+    std::string::size_type q = decl.find_first_of("\"'", pos);
+    if(q == std::string::npos)
+      return false;
+    std::string::size_type q_end = decl.find(decl[q], q + 1);
+    if(q_end == std::string::npos)
+      return false;
+    std::string enc = itksys::SystemTools::LowerCase(decl.substr(q + 1, q_end - q - 1));
+    return enc == "utf-8" || enc == "utf8" || enc == "us-ascii";
+  }
+
+  // Skip the DOCTYPE, including the internal subset written by WriteToXMLFile
+  bool SkipDoctype()
+  {
+    const char *gt = Find(">");
+    const char *br = Find("[");
+    if(!gt)
+      return false;
+    if(br && br < gt)
+      {
+      m_Pos = br + 1;
+      const char *br_end = Find("]");
+      if(!br_end)
+        return false;
+
+      // Entity declarations would change how the document is parsed
+      std::string subset(br + 1, br_end);
+      if(subset.find("<!ENTITY") != std::string::npos)
+        return false;
+
+      m_Pos = br_end + 1;
+      gt = Find(">");
+      if(!gt)
+        return false;
+      }
+    m_Pos = gt + 1;
+    return true;
+  }
+
+  static void AppendUTF8(unsigned long code, std::string &out)
+  {
+    if(code < 0x80)
+      {
+      out.push_back((char) code);
+      }
+    else if(code < 0x800)
+      {
+      out.push_back((char) (0xC0 | (code >> 6)));
+      out.push_back((char) (0x80 | (code & 0x3F)));
+      }
+    else if(code < 0x10000)
+      {
+      out.push_back((char) (0xE0 | (code >> 12)));
+      out.push_back((char) (0x80 | ((code >> 6) & 0x3F)));
+      out.push_back((char) (0x80 | (code & 0x3F)));
+      }
+    else
+      {
+      out.push_back((char) (0xF0 | (code >> 18)));
+      out.push_back((char) (0x80 | ((code >> 12) & 0x3F)));
+      out.push_back((char) (0x80 | ((code >> 6) & 0x3F)));
+      out.push_back((char) (0x80 | (code & 0x3F)));
+      }
+  }
+};
+
+
 RegistryValue
 ::RegistryValue()
 {
@@ -309,15 +737,17 @@ Registry
       sout << prefix << Encode(ite->first) << " = ";
 
       // Write the encoded value
-      sout << Encode(ite->second.GetInternalString()) << endl;
+      sout << Encode(ite->second.GetInternalString()) << '\n';
       }
     }
 
   // Write the folders
+  StringType childPrefix;
   for(FolderIterator itf = m_FolderMap.begin(); itf != m_FolderMap.end(); ++itf)
     {
     // Write the folder contents (recursive, contents prefixed with full path name)
-    itf->second->Write(sout, prefix + itf->first + "." );
+    childPrefix.assign(prefix).append(itf->first).append(1, '.');
+    itf->second->Write(sout, childPrefix);
     }  
 }
 
@@ -354,6 +784,10 @@ void
 Registry
 ::WriteXML(ostream &sout, const StringType &prefix)
 {
+  // Lines are terminated with '\n' rather than endl, since flushing the stream
+  // after every entry dominates the cost of writing large workspaces
+  StringType buffer;
+
   // Write the entries in this folder
   for(EntryIterator ite = m_EntryMap.begin();ite != m_EntryMap.end(); ++ite)
     {
@@ -361,24 +795,33 @@ Registry
     if(!ite->second.IsNull())
       {
       // Write the key
-      sout << prefix << "<entry key=\"" << EncodeXML(ite->first) << "\"";
+      buffer.assign(prefix).append("<entry key=\"");
+      AppendEncodedXML(ite->first, buffer);
+      buffer.append("\"");
 
       // Write the encoded value
-      sout << " value=\"" << EncodeXML(ite->second.GetInternalString()) << "\" />" << endl;
+      buffer.append(" value=\"");
+      AppendEncodedXML(ite->second.GetInternalString(), buffer);
+      buffer.append("\" />\n");
+      sout.write(buffer.data(), buffer.size());
       }
     }
 
   // Write the folders
+  StringType childPrefix = prefix + "  ";
   for(FolderIterator itf = m_FolderMap.begin(); itf != m_FolderMap.end(); ++itf)
     {
     // Write the folder tag
-    sout << prefix << "<folder key=\"" << EncodeXML(itf->first) << "\" >" << endl;
+    buffer.assign(prefix).append("<folder key=\"");
+    AppendEncodedXML(itf->first, buffer);
+    buffer.append("\" >\n");
+    sout.write(buffer.data(), buffer.size());
 
     // Write the folder contents (recursive, contents prefixed with full path name)
-    itf->second->WriteXML(sout, prefix + "  ");
+    itf->second->WriteXML(sout, childPrefix);
 
     // Close the folder
-    sout << prefix << "</folder>" << endl;
+    sout << prefix << "</folder>\n";
     }
 }
 
@@ -540,36 +983,41 @@ bool Registry::IsEmpty() const
   return m_EntryMap.size() == 0 && m_FolderMap.size() == 0;
 }
 
-Registry::StringType
+void
 Registry
-::EncodeXML(const StringType &input)
+::AppendEncodedXML(const StringType &input, StringType &out)
 {
-  IRISOStringStream oss;
-  for(unsigned int i=0; i < input.length() ; i++)
+  for(StringType::size_type i = 0; i < input.length(); i++)
     {
-    // Map the character to positive integer (0..255)
     char c = input[i];
 
     // There are special characters not allowed in XML
     switch(c)
       {
       case '<' :
-        oss << "&lt;"; break;
+        out.append("&lt;"); break;
       case '>' :
-        oss << "&gt;"; break;
+        out.append("&gt;"); break;
       case '&' :
-        oss << "&amp;"; break;
+        out.append("&amp;"); break;
       case '\'' :
-        oss << "&apos;"; break;
+        out.append("&apos;"); break;
       case '\"' :
-        oss << "&quot;"; break;
+        out.append("&quot;"); break;
       default:
-        oss << c; break;
+        out.push_back(c); break;
       }
-   }
+    }
+}
 
-  // Return the resulting string
-  return oss.str();
+Registry::StringType
+Registry
+::EncodeXML(const StringType &input)
+{
+  StringType out;
+  out.reserve(input.length());
+  AppendEncodedXML(input, out);
+  return out;
 }
 
 Registry::StringType Registry::DecodeXML(const Registry::StringType &input)
@@ -581,8 +1029,11 @@ Registry::StringType
 Registry
 ::Encode(const StringType &input) 
 {
-  IRISOStringStream oss;
-  for(unsigned int i=0; i < input.length() ; i++)
+  static const char *hexdigits = "0123456789abcdef";
+
+  StringType out;
+  out.reserve(input.length());
+  for(StringType::size_type i = 0; i < input.length(); i++)
     {
     // Map the character to positive integer (0..255)
     char c = input[i];
@@ -592,67 +1043,70 @@ Registry
     if(v <= 0x20 || v >= 0x7f || c == '%')
       {
       // Replace character by a escape string
-      oss << '%';
-      oss << setw(2) << setfill('0') << hex << v;
+      out.push_back('%');
+      out.push_back(hexdigits[v >> 4]);
+      out.push_back(hexdigits[v & 0x0f]);
       }
     else
       {
       // Just copy the character
-      oss << c;
+      out.push_back(c);
       }
     }
 
   // Return the resulting string
-  return oss.str();
+  return out;
 }   
 
 Registry::StringType
 Registry::Decode(const StringType &input) 
 {
-  // Create an input stream
-  IRISIStringStream iss(input);
-  IRISOStringStream oss;
+  StringType out;
+  out.reserve(input.length());
 
-  // Read until we run out or crash
-  while(iss.good())
-    {  
+  StringType::size_type n = input.length(), i = 0;
+  while(i < n)
+    {
     // Read the next character
-    char c = (char) iss.get();
+    char c = input[i++];
 
     // Check if the character needs to be translated
-    if(!isprint(c))
+    if(!isprint(static_cast<unsigned char>(c)))
       {
       continue;
       }
     else if(c != '%')
       {
       // Just copy the character
-      oss.put(c);
+      out.push_back(c);
       }
     else 
       {
-      // A pair of chars
-      char c1,c2;
-      
-      // Read the hex digit
-      iss >> c1;
-      iss >> c2;
-      
+      // Read the pair of hex digits, skipping whitespace like operator >>
+      char cd[2];
+      int k = 0;
+      while(k < 2 && i < n)
+        {
+        char ci = input[i++];
+        if(!isspace(static_cast<unsigned char>(ci)))
+          cd[k++] = ci;
+        }
+
+      // Incomplete escape sequence at the end of the string
+      if(k < 2)
+        break;
+
       // Reconstruct the hex
-      int d1 = (c1 < 'a') ? c1 - '0' : c1 - 'a' + 10;
-      int d2 = (c2 < 'a') ? c2 - '0' : c2 - 'a' + 10;
-      int digit = d1 * 16 + d2;
-
-      // See if the read succeeded, only then use the digit
-      if(iss.good())
-        oss << (char)digit;      
-      
+      int d1 = (cd[0] < 'a') ? cd[0] - '0' : cd[0] - 'a' + 10;
+      int d2 = (cd[1] < 'a') ? cd[1] - '0' : cd[1] - 'a' + 10;
+      out.push_back((char)(d1 * 16 + d2));
+
       // A good place to throw an exception (for strict interpretation)
       }        
     }
   
   // Return the result
-  return oss.str();
+  return out;
 }
 
 
@@ -661,14 +1115,13 @@ Registry
 ::Read(istream &sin, ostream &oss) 
 {
   unsigned int lineNumber = 1;
+  StringType line;
   while(sin.good())
     {
     // Read a line from the file
-    char buffer[1024];
-    sin.getline(buffer,1024);
+    std::getline(sin, line);
 
     // Find the first character in the string
-    StringType line = buffer;
     StringType::size_type iToken = line.find_first_not_of(" \t\v\r\n");
 
     // Skip blank lines
@@ -834,10 +1287,11 @@ Registry
 
   // Write the header
   if(header)
-    sout << header << endl;
+    sout << header << '\n';
  
   // Write to the stream
   Write(sout,"");
+  sout.flush();
 }
 
 void Registry::WriteToXMLFile(const char *pathname, const char *header)
@@ -849,24 +1303,24 @@ void Registry::WriteToXMLFile(const char *pathname, const char *header)
   sout.exceptions(std::ios::failbit);
 
   // Write the XML string
-  sout << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>" << endl;
+  sout << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>" << '\n';
 
   // Write the header
   if(header)
-    sout << "<!--" << header << "-->" << endl;
+    sout << "<!--" << header << "-->" << '\n';
 
   // Write the DOCTYPE content
-  sout << "<!DOCTYPE registry [" << endl
-       << "<!ELEMENT registry (entry*,folder*)>" << endl
-       << "<!ELEMENT folder (entry*,folder*)>" << endl
-       << "<!ELEMENT entry EMPTY>" << endl
-       << "<!ATTLIST folder key CDATA #REQUIRED>" << endl
-       << "<!ATTLIST entry key CDATA #REQUIRED>" << endl
-       << "<!ATTLIST entry value CDATA #REQUIRED>" << endl
-       << "]>" << endl;
+  sout << "<!DOCTYPE registry [" << '\n'
+       << "<!ELEMENT registry (entry*,folder*)>" << '\n'
+       << "<!ELEMENT folder (entry*,folder*)>" << '\n'
+       << "<!ELEMENT entry EMPTY>" << '\n'
+       << "<!ATTLIST folder key CDATA #REQUIRED>" << '\n'
+       << "<!ATTLIST entry key CDATA #REQUIRED>" << '\n'
+       << "<!ATTLIST entry value CDATA #REQUIRED>" << '\n'
+       << "]>" << '\n';
 
   // Write to the stream
-  sout << "<registry>" << endl;
+  sout << "<registry>" << '\n';
   WriteXML(sout, "  ");
   sout << "</registry>" << endl;
 }
@@ -911,8 +1365,71 @@ void Registry
     throw SyntaxException(serr.str().c_str());
 }
 
+bool Registry::ReadXMLBuffer(const char *buffer, size_t length)
+{
+  // Tokenize the whole buffer before touching the registry, so that if the
+  // fast path fails, the registry is left unchanged
+  RegistryXMLTokenizer::TokenList tokens;
+  tokens.reserve(length / 48);
+  RegistryXMLTokenizer tokenizer(buffer, buffer + length);
+  if(!tokenizer.Tokenize(tokens))
+    return false;
+
+  // Decode all keys and values before making changes as well
+  std::vector<StringType> keys(tokens.size()), values(tokens.size());
+  for(size_t i = 0; i < tokens.size(); i++)
+    {
+    const RegistryXMLTokenizer::Token &tok = tokens[i];
+    if(tok.key && !RegistryXMLTokenizer::Decode(tok.key, tok.key_len, tok.key_raw, keys[i]))
+      return false;
+    if(tok.value && !RegistryXMLTokenizer::Decode(tok.value, tok.value_len, tok.value_raw, values[i]))
+      return false;
+    }
+
+  // Build the registry tree
+  std::vector<Registry *> stack;
+  for(size_t i = 0; i < tokens.size(); i++)
+    {
+    switch(tokens[i].type)
+      {
+      case RegistryXMLTokenizer::REGISTRY_START:
+        stack.push_back(this);
+        break;
+      case RegistryXMLTokenizer::REGISTRY_END:
+        stack.clear();
+        break;
+      case RegistryXMLTokenizer::FOLDER_START:
+        if(stack.empty())
+          throw IRISException("Problem parsing Registry XML file. The file might not be valid.");
+        stack.push_back(&stack.back()->Folder(keys[i]));
+        break;
+      case RegistryXMLTokenizer::FOLDER_END:
+        if(!stack.empty())
+          stack.pop_back();
+        break;
+      case RegistryXMLTokenizer::ENTRY:
+        if(stack.empty())
+          throw IRISException("Problem parsing Registry XML file. The file might not be valid.");
+        stack.back()->Entry(keys[i]) = RegistryValue(values[i]);
+        break;
+      }
+    }
+
+  return true;
+}
+
 void Registry::ReadFromXMLFile(const char *pathname)
 {
+  // Read the whole file into memory and try the fast tokenizer first
+  std::ifstream fin(pathname, std::ios::in | std::ios::binary);
+  if(fin.good())
+    {
+    std::string buffer((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+    if(!fin.bad() && ReadXMLBuffer(buffer.data(), buffer.size()))
+      return;
+    }
+
+  // Fall back to the general XML reader, which also reports errors
   SmartPtr<RegistryXMLFileReader> reader = RegistryXMLFileReader::New();
   reader->SetOutputObject(this);
   reader->SetFilename(pathname);
@@ -612,6 +612,13 @@ private:
   /** Read this folder recursively from a stream, recording syntax errors */
   void Read(std::istream &sin, std::ostream &serr);
 
+  /** Read from an in-memory XML buffer using the fast tokenizer. Returns false,
+   * leaving the registry unchanged, if the buffer requires the full XML parser */
+  bool ReadXMLBuffer(const char *buffer, size_t length);
+
+  /** Append the XML-encoded string to the output */
+  static void AppendEncodedXML(const StringType &input, StringType &out);
+
   /** Encode a string for writing to file */
   static StringType Encode(const StringType &input);
 
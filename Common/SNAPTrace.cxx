@@ -0,0 +1,164 @@
+#include "SNAPTrace.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> SNAPTrace::m_Enabled(false);
+
+namespace
+{
+
+struct TraceEvent
+{
+  const char *Category, *Name;
+  long long Start, Duration;
+};
+
+// Number of events kept per thread (about 2MB of memory per thread)
+const size_t TRACE_BUFFER_SIZE = 1 << 16;
+
+// A ring buffer written by a single thread. The head is the total number of
+// events written, and is published after each event is complete
+struct TraceBuffer
+{
+  TraceEvent Events[TRACE_BUFFER_SIZE];
+  std::atomic<size_t> Head;
+  std::atomic<bool> InUse;
+  unsigned int ThreadId;
+};
+
+// All the buffers ever allocated. Buffers are never freed, but the buffer of
+// a thread that has exited is reused by the next new thread
+struct TraceRegistry
+{
+  std::mutex Mutex;
+  std::vector<std::unique_ptr<TraceBuffer> > Buffers;
+};
+
+TraceRegistry &GetTraceRegistry()
+{
+  static TraceRegistry registry;
+  return registry;
+}
+
+// Releases the buffer of the thread when the thread exits
+struct TraceBufferHolder
+{
+  TraceBuffer *Buffer = nullptr;
+  ~TraceBufferHolder() { if(Buffer) Buffer->InUse = false; }
+};
+
+thread_local TraceBufferHolder tls_TraceBuffer;
+
+TraceBuffer *GetThreadTraceBuffer()
+{
+  if(!tls_TraceBuffer.Buffer)
+    {
+    TraceRegistry &reg = GetTraceRegistry();
+    std::lock_guard<std::mutex> lock(reg.Mutex);
+    for(auto &buffer : reg.Buffers)
+      {
+      if(!buffer->InUse)
+        {
+        buffer->InUse = true;
+        tls_TraceBuffer.Buffer = buffer.get();
+        return tls_TraceBuffer.Buffer;
+        }
+      }
+
+    TraceBuffer *buffer = new TraceBuffer();
+    buffer->Head = 0;
+    buffer->InUse = true;
+    buffer->ThreadId = reg.Buffers.size() + 1;
+    reg.Buffers.emplace_back(buffer);
+    tls_TraceBuffer.Buffer = buffer;
+    }
+
+  return tls_TraceBuffer.Buffer;
+}
+
+void WriteJSONString(FILE *f, const char *s)
+{
+  fputc('"', f);
+  for(; s && *s; s++)
+    {
+    if(*s == '"' || *s == '\\')
+      fputc('\\', f);
+    if((unsigned char) *s >= 0x20)
+      fputc(*s, f);
+    }
+  fputc('"', f);
+}
+
+} // namespace
+
+void SNAPTrace::SetEnabled(bool flag)
+{
+  m_Enabled.store(flag, std::memory_order_relaxed);
+}
+
+long long SNAPTrace::Now()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SNAPTrace::Record(const char *category, const char *name,
+                       long long t_start, long long t_end)
+{
+  TraceBuffer *buffer = GetThreadTraceBuffer();
+  size_t head = buffer->Head.load(std::memory_order_relaxed);
+  TraceEvent &event = buffer->Events[head % TRACE_BUFFER_SIZE];
+  event.Category = category;
+  event.Name = name;
+  event.Start = t_start;
+  event.Duration = t_end - t_start;
+  buffer->Head.store(head + 1, std::memory_order_release);
+}
+
+bool SNAPTrace::WriteChromeTrace(const std::string &filename)
+{
+  FILE *f = fopen(filename.c_str(), "wt");
+  if(!f)
+    return false;
+
+  // Events being written while we dump are not guaranteed to be consistent,
+  // so the oldest slots, which may be overwritten, are skipped
+  const size_t margin = 64;
+
+  TraceRegistry &reg = GetTraceRegistry();
+  std::lock_guard<std::mutex> lock(reg.Mutex);
+
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  for(auto &buffer : reg.Buffers)
+    {
+    size_t head = buffer->Head.load(std::memory_order_acquire);
+    size_t n = head < TRACE_BUFFER_SIZE ? head : TRACE_BUFFER_SIZE - margin;
+    for(size_t i = head - n; i < head; i++)
+      {
+      const TraceEvent &event = buffer->Events[i % TRACE_BUFFER_SIZE];
+      fprintf(f, first ? "{\"name\":" : ",\n{\"name\":");
+      WriteJSONString(f, event.Name);
+      fprintf(f, ",\"cat\":");
+      WriteJSONString(f, event.Category);
+      fprintf(f, ",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%u}",
+              event.Start, event.Duration, buffer->ThreadId);
+      first = false;
+      }
+    }
+  fprintf(f, "\n]}\n");
+
+  bool ok = !ferror(f);
+  return fclose(f) == 0 && ok;
+}
+
+void SNAPTrace::Clear()
+{
+  TraceRegistry &reg = GetTraceRegistry();
+  std::lock_guard<std::mutex> lock(reg.Mutex);
+  for(auto &buffer : reg.Buffers)
+    buffer->Head = 0;
+}
@@ -0,0 +1,90 @@
+#ifndef SNAPTRACE_H
+#define SNAPTRACE_H
+
+#include <atomic>
+#include <string>
+
+/**
+ * Lightweight tracing of the hot paths of ITK-SNAP. Trace points are placed in
+ * the code with the SNAP_TRACE_SCOPE macro, which records the time spent in
+ * the enclosing scope. Each thread records its events into its own fixed-size
+ * ring buffer, so that no locks are taken while tracing, and only the most
+ * recent events are kept. The events of all threads can be written out in
+ * the Chrome trace event format, which can be viewed in chrome://tracing or
+ * in the Perfetto UI.
+ *
+ * Tracing is off by default (see the --trace command line option). When it is
+ * off, a trace point costs a relaxed atomic load and a branch. The events can
+ * be written while they are being recorded, which the GUI does on exit and
+ * on demand (Ctrl+Alt+T).
+ */
+class SNAPTrace
+{
+public:
+
+  /** Turn the recording of events on or off */
+  static void SetEnabled(bool flag);
+
+  /** Whether events are being recorded */
+  static bool IsEnabled() { return m_Enabled.load(std::memory_order_relaxed); }
+
+  /** Current time in microseconds, relative to an arbitrary fixed origin */
+  static long long Now();
+
+  /**
+   * Record an event that started and ended at the given times. The category
+   * and name are not copied and must remain valid (e.g., string literals or
+   * the names returned by GetNameOfClass())
+   */
+  static void Record(const char *category, const char *name,
+                     long long t_start, long long t_end);
+
+  /**
+   * Write the events recorded so far to a JSON file in the Chrome trace event
+   * format. Returns false if the file could not be written.
+   */
+  static bool WriteChromeTrace(const std::string &filename);
+
+  /** Discard all recorded events */
+  static void Clear();
+
+private:
+
+  static std::atomic<bool> m_Enabled;
+};
+
+/**
+ * Records the time between its construction and destruction as a trace event,
+ * if tracing was enabled at construction. Use through SNAP_TRACE_SCOPE.
+ */
+class SNAPTraceScope
+{
+public:
+
+  SNAPTraceScope(const char *category, const char *name)
+    : m_Category(category), m_Name(name),
+      m_Start(SNAPTrace::IsEnabled() ? SNAPTrace::Now() : -1) {}
+
+  ~SNAPTraceScope()
+    {
+    if(m_Start >= 0)
+      SNAPTrace::Record(m_Category, m_Name, m_Start, SNAPTrace::Now());
+    }
+
+private:
+
+  SNAPTraceScope(const SNAPTraceScope &);
+  void operator = (const SNAPTraceScope &);
+
+  const char *m_Category, *m_Name;
+  long long m_Start;
+};
+
+#define SNAP_TRACE_CONCAT_IMPL(a, b) a##b
+#define SNAP_TRACE_CONCAT(a, b) SNAP_TRACE_CONCAT_IMPL(a, b)
+
+/** Trace the time spent in the enclosing scope */
+#define SNAP_TRACE_SCOPE(category, name) \
+  SNAPTraceScope SNAP_TRACE_CONCAT(snap_trace_scope_, __LINE__)(category, name)
+
+#endif // SNAPTRACE_H
@@ -540,6 +540,18 @@ SystemInterface
   folder.WriteToXMLFile(fname.c_str());
 }
 
+std::string
+SystemInterface
+::GetUserCacheDirectory(const char *category)
+{
+  std::string cachedir =
+      GetApplicationDataDirectory() + std::string("/Cache/") + std::string(category);
+  if(!itksys::SystemTools::MakeDirectory(cachedir.c_str()))
+    return std::string();
+
+  return cachedir;
+}
+
 void 
 SystemInterface
 ::DeleteSavedObject(const char *category, const char *name)
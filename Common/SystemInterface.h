@@ -123,6 +123,10 @@ public:
   /** Write a thumbnail */
   void WriteThumbnail(const char *associated_file, ThumbnailImageType *thumbnail);
 
+  /** Get (and create if needed) a per-user directory for cached data of a
+   * given category, e.g., meshes. Returns an empty string on failure */
+  std::string GetUserCacheDirectory(const char *category);
+
   /** A higher level method: associates current settings with the current image
    * so that the next time the image is loaded, it can be saved */
   bool AssociateCurrentSettingsWithCurrentImageFile(
@@ -0,0 +1,273 @@
+#ifndef BRUSHWATERSHEDPIPELINE_H
+#define BRUSHWATERSHEDPIPELINE_H
+
+#include "itkImage.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkGradientAnisotropicDiffusionImageFilter.h"
+#include "itkGradientMagnitudeImageFilter.h"
+#include "itkWatershedImageFilter.h"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Watershed segmentation used by the adaptive paintbrush. The anisotropic
+ * diffusion, the gradient magnitude and the watershed hierarchy are computed
+ * over a window around the brush, which is kept from one brush application to
+ * the next, and grown as needed to cover the brush as long as it stays under
+ * a maximum size. Applying the brush at a given level only requires the basic
+ * segments of the hierarchy to be merged up to that level, which does not
+ * involve the image, and the result is cached until the level changes.
+ */
+class BrushWatershedPipeline
+{
+public:
+  typedef itk::Image<float, 3> FloatImageType;
+  typedef itk::Image<itk::IdentifierType, 3> WatershedImageType;
+  typedef WatershedImageType::IndexType IndexType;
+  typedef itk::ImageRegion<3> RegionType;
+
+  BrushWatershedPipeline()
+    {
+    roi = ROIType::New();
+    adf = ADFType::New();
+    adf->SetInput(roi->GetOutput());
+    adf->SetConductanceParameter(0.5);
+    gmf = GMFType::New();
+    gmf->SetInput(adf->GetOutput());
+    wf = WFType::New();
+    wf->SetInput(gmf->GetOutput());
+
+    source = NULL;
+    source_mtime = 0;
+    smoothing_iter = 0;
+    max_saliency = 0.0;
+    level = -1.0;
+    center_segment = -1;
+    }
+
+  /**
+   * Check whether the window computed for the given source image (identified
+   * by the image and its modification time) covers the brush region. If not,
+   * PrecomputeWatersheds must be called before the brush is applied.
+   */
+  bool IsWindowValid(const itk::Object *source, const RegionType &region, size_t smoothing_iter)
+    {
+    if(this->source != source || this->source_mtime != source->GetMTime()
+       || this->smoothing_iter != smoothing_iter || !window.IsInside(region))
+      return false;
+
+    // A flat region (2D brush) is only covered by a window that is flat in
+    // the same slice, as computed by PrecomputeWatersheds
+    for(unsigned int d = 0; d < 3; d++)
+      if(region.GetSize(d) == 1 && window.GetSize(d) != 1)
+        return false;
+    return true;
+    }
+
+  /**
+   * Compute the watershed hierarchy over a window that covers the brush
+   * region, reusing the previous window when the source has not changed
+   */
+  void PrecomputeWatersheds(
+    const FloatImageType *grey,
+    const itk::Object *source,
+    const RegionType &region,
+    size_t smoothing_iter)
+    {
+    // Pad the brush region along the axes where it is not flat. Flat regions
+    // (2D brushes) are only combined with windows in the same slice.
+    RegionType padded = region;
+    for(unsigned int d = 0; d < 3; d++)
+      if(region.GetSize(d) > 1)
+        {
+        long pad = std::max((long) region.GetSize(d), (long) MIN_MARGIN);
+        padded.SetIndex(d, region.GetIndex(d) - pad);
+        padded.SetSize(d, region.GetSize(d) + 2 * pad);
+        }
+
+    bool reuse = this->source == source && this->source_mtime == source->GetMTime()
+        && this->smoothing_iter == smoothing_iter && window.GetNumberOfPixels() > 0;
+
+    RegionType grown = padded;
+    for(unsigned int d = 0; d < 3 && reuse; d++)
+      {
+      if(region.GetSize(d) == 1 || window.GetSize(d) == 1)
+        {
+        reuse = window.GetIndex(d) == padded.GetIndex(d)
+            && window.GetSize(d) == padded.GetSize(d);
+        }
+      else
+        {
+        long lo = std::min(window.GetIndex(d), padded.GetIndex(d));
+        long hi = std::max(window.GetUpperIndex()[d], padded.GetUpperIndex()[d]);
+        grown.SetIndex(d, lo);
+        grown.SetSize(d, hi - lo + 1);
+        }
+      }
+
+    // Grow the previous window, unless that makes it too large
+    if(reuse && grown.GetNumberOfPixels() <= MAX_WINDOW_VOXELS)
+      padded = grown;
+
+    padded.Crop(grey->GetLargestPossibleRegion());
+    window = padded;
+    this->source = source;
+    this->source_mtime = source->GetMTime();
+    this->smoothing_iter = smoothing_iter;
+
+    // Initialize the watershed pipeline
+    roi->SetInput(grey);
+    roi->SetRegionOfInterest(window);
+    adf->SetNumberOfIterations(smoothing_iter);
+
+    // Set the level to the highest possible, to get the complete hierarchy
+    wf->SetLevel(1.0);
+    wf->Update();
+
+    // Keep the basic segmentation and the merges of the hierarchy, the
+    // latter as indices into a table of the segment labels
+    const WatershedImageType *basic = wf->GetBasicSegmentation();
+    basic_labels = basic;
+    segments.clear();
+    merges.clear();
+    max_saliency = 0.0;
+
+    auto *tree = wf->GetSegmentTree();
+    for(auto it = tree->Begin(); it != tree->End(); ++it)
+      {
+      merges.push_back(Merge(GetSegment(it->from), GetSegment(it->to), it->saliency));
+      max_saliency = it->saliency;
+      }
+
+    level = -1.0;
+
+    // The pipeline does not need to hold on to the input image
+    roi->SetInput(NULL);
+    }
+
+  /**
+   * Merge the basic segments up to the given fraction of the maximum depth
+   * of the hierarchy, as done by itk::WatershedImageFilter
+   */
+  void RecomputeWatersheds(double level)
+    {
+    if(level == this->level)
+      return;
+    this->level = level;
+
+    // Union-find over the segments, for the merges below the limit
+    root.resize(segments.size());
+    for(size_t i = 0; i < root.size(); i++)
+      root[i] = i;
+
+    double limit = level * max_saliency;
+    for(const Merge &m : merges)
+      {
+      if(m.saliency > limit)
+        break;
+      size_t a = FindRoot(m.from), b = FindRoot(m.to);
+      if(a != b)
+        root[a] = b;
+      }
+
+    for(size_t i = 0; i < root.size(); i++)
+      root[i] = FindRoot(i);
+    }
+
+  /** Set the brush center, in image coordinates */
+  void SetCenter(const IndexType &vcenter, const RegionType &region)
+    {
+    // Use the center of the region if the center is outside of it
+    IndexType c = vcenter;
+    if(!region.IsInside(c))
+      for(size_t d = 0; d < 3; d++)
+        c[d] = region.GetIndex(d) + region.GetSize(d) / 2;
+    center_segment = GetSegmentAt(c);
+    }
+
+  /** Check if a pixel, in image coordinates, is in the segment of the center */
+  bool IsPixelInSegmentation(const IndexType &idx)
+    {
+    return GetSegmentAt(idx) == center_segment;
+    }
+
+  /**
+   * The merged segment of a voxel inside the window, in image coordinates.
+   * Basic segments that take no part in the hierarchy are segments of their
+   * own, and are given distinct negative values.
+   */
+  long GetSegmentAt(const IndexType &idx)
+    {
+    IndexType local;
+    for(unsigned int d = 0; d < 3; d++)
+      local[d] = idx[d] - window.GetIndex(d);
+    itk::IdentifierType label = basic_labels->GetPixel(local);
+    auto it = segments.find(label);
+    return it == segments.end() ? -1 - (long) label : (long) root[it->second];
+    }
+
+  /** The window over which the hierarchy was last computed */
+  const RegionType &GetWindow() const
+    { return window; }
+
+private:
+  typedef itk::RegionOfInterestImageFilter<FloatImageType, FloatImageType> ROIType;
+  typedef itk::GradientAnisotropicDiffusionImageFilter<FloatImageType,FloatImageType> ADFType;
+  typedef itk::GradientMagnitudeImageFilter<FloatImageType, FloatImageType> GMFType;
+  typedef itk::WatershedImageFilter<FloatImageType> WFType;
+
+  // Margin added around the brush when a new window is created
+  static const long MIN_MARGIN = 8;
+
+  // Maximum size of a window grown to cover several brush positions
+  static const unsigned long MAX_WINDOW_VOXELS = 128 * 128 * 128;
+
+  struct Merge
+  {
+    size_t from, to;
+    double saliency;
+    Merge(size_t f, size_t t, double s) : from(f), to(t), saliency(s) {}
+  };
+
+  size_t GetSegment(itk::IdentifierType label)
+    {
+    auto it = segments.find(label);
+    if(it != segments.end())
+      return it->second;
+    size_t k = segments.size();
+    segments[label] = k;
+    return k;
+    }
+
+  size_t FindRoot(size_t i)
+    {
+    while(root[i] != i)
+      i = root[i] = root[root[i]];
+    return i;
+    }
+
+  ROIType::Pointer roi;
+  ADFType::Pointer adf;
+  GMFType::Pointer gmf;
+  WFType::Pointer wf;
+
+  // The window and the source for which the hierarchy was computed
+  RegionType window;
+  const itk::Object *source;
+  itk::ModifiedTimeType source_mtime;
+  size_t smoothing_iter;
+
+  // The basic segmentation and the hierarchy of merges, in order of saliency
+  WatershedImageType::ConstPointer basic_labels;
+  std::unordered_map<itk::IdentifierType, size_t> segments;
+  std::vector<Merge> merges;
+  double max_saliency;
+
+  // The merged segment of each basic segment at the current level
+  double level;
+  std::vector<size_t> root;
+  long center_segment;
+};
+
+#endif // BRUSHWATERSHEDPIPELINE_H
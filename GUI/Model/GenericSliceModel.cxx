@@ -34,6 +34,7 @@
 #include <vtkContourTriangulator.h>
 #include "DeformationGridModel.h"
 #include "DrawTriangles.h"
+#include "PolygonScanConvert.h"
 
 #include <itkImage.h>
 #include <itkImageRegionIteratorWithIndex.h>
@@ -574,8 +575,23 @@ unsigned int GenericSliceModel::GetSliceIndex()
 void GenericSliceModel::UpdateSliceIndex(unsigned int newIndex)
 {
   Vector3ui cursorImageSpace = m_Driver->GetCursorPosition();
+  unsigned int oldIndex = cursorImageSpace[m_ImageAxes[2]];
   cursorImageSpace[m_ImageAxes[2]] = newIndex;
   m_Driver->SetCursorPosition(cursorImageSpace);
+
+  // Assume the user keeps scrolling in the same direction, and have the
+  // next few slices of the anatomical layers generated in the background.
+  // Segmentation and SNAP layers are edited in place, so they are skipped
+  if(newIndex != oldIndex)
+    {
+    int direction = newIndex > oldIndex ? 1 : -1;
+    for(LayerIterator it = this->GetImageData()->GetLayers(MAIN_ROLE | OVERLAY_ROLE);
+        !it.IsAtEnd(); ++it)
+      {
+      if(it.GetLayer()->IsDrawable())
+        it.GetLayer()->PrefetchSlices(m_Id, direction, 4);
+      }
+    }
 }
 
 void GenericSliceModel::ComputeThumbnailProperties()
@@ -675,12 +691,25 @@ GenericSliceWindow::OnDragAndDrop(const FLTKEvent &event)
 
 unsigned int
 GenericSliceModel
-::MergeSliceSegmentation(itk::Image<unsigned char, 2> *drawing)
+::MergeSlicePolygon(const std::vector<Vector2d> &vertices)
 {
+  // Scan convert along the slice axis that maps to the x axis of the image,
+  // so that each span of the polygon is a single span in the segmentation
+  Vector3d x_dir = m_DisplayToImageTransform->TransformVector(Vector3d(1.0, 0.0, 0.0));
+  unsigned int axis = std::fabs(x_dir[0]) > 0.5 ? 0 : 1;
+
+  typedef std::vector<Vector2d>::const_iterator VertexIterator;
+  typedef PolygonScanConvert<itk::Image<unsigned char, 2>, double, VertexIterator> ScanConvertType;
+
+  Vector2ui slice_size(m_SliceSize[0], m_SliceSize[1]);
+  unsigned int size[] = { slice_size[0], slice_size[1] };
+  IRISApplication::SpanList spans;
+  ScanConvertType::RasterizeFilledSpans(vertices.begin(), vertices.size(), size, axis, spans);
+
   // Z position of slice
   double zpos = this->GetCursorPositionInSliceCoordinates()[2];
-  return m_Driver->UpdateSegmentationWithSliceDrawing(
-        drawing, m_DisplayToImageTransform, zpos, "Polygon Drawing");
+  return m_Driver->UpdateSegmentationWithSliceSpans(
+        spans, axis, slice_size, m_DisplayToImageTransform, zpos, "Polygon Drawing");
 }
 
 Vector2ui GenericSliceModel::GetSize()
@@ -1225,16 +1254,10 @@ GenericSliceModel
   fltContTri->Update();
   auto tri_pd = fltContTri->GetOutput();
 
-  // Create a temporary RLE image for rasterization
+  // The region of the segmentation covered by the polygon
   itk::ImageRegion<3> seg_region(to_itkIndex(ext_min), to_itkSize(1 + ext_max - ext_min));
   seg_region.Crop(seg->GetBufferedRegion());
 
-  LabelImageWrapper::ImagePointer seg_temp = LabelImageWrapper::ImageType::New();
-  auto *iseg = seg->GetModifiableImage();
-  seg_temp->CopyInformation(iseg);
-  seg_temp->SetRegions(seg_region);
-  seg_temp->Allocate();
-
   // Convert the triangles into the data structure expected by scan converter and subtract
   // the lower corner since the rasterization code expects the image to start at the
   // coordinate zero
@@ -1252,24 +1275,43 @@ GenericSliceModel
 
   // Image dimensions
   int seg_dim[3] = { (int) seg_region.GetSize()[0], (int) seg_region.GetSize()[1], (int) seg_region.GetSize()[2] };
-  int w_line = seg_dim[2];
 
-  // Get the segmentation image and create an iterator for it
-  using RLEIter = itk::ImageRegionIterator<LabelImageWrapper::ImageType>;
-  RLEIter it_temp(seg_temp, seg_region);
+  // The scan conversion code only needs the offset table of the region, so
+  // there is no need to allocate a temporary image
+  itk::ImageBase<3>::Pointer grid = itk::ImageBase<3>::New();
+  grid->SetRegions(seg_region);
 
-  // Create a lambda that can update pixels in an RLE image via the iterator
-  auto functor = [&it_temp](auto *img, int offset)
+  // Collect the offsets of the voxels inside the polygon
+  std::vector<itk::OffsetValueType> offsets;
+  auto functor = [&offsets](auto *, int offset)
     {
-    // Go to the indexed vertex and set value to 1
-    it_temp.SetIndex(img->ComputeIndex(offset));
-    it_temp.Set(1);
+    offsets.push_back(offset);
     };
 
   // Actual call to the scan conversion code
-  // DrawBinaryTrianglesSheetFilled(seg->GetModifiableImage(), seg_dim, varr, tri_pd->GetNumberOfCells(), functor);
-  cpu_voxelizer::DrawBinaryTrianglesSheetFilled(seg_temp.GetPointer(), seg_dim, varr, tri_pd->GetNumberOfCells(), functor);
+  cpu_voxelizer::DrawBinaryTrianglesSheetFilled(grid.GetPointer(), seg_dim, varr, tri_pd->GetNumberOfCells(), functor);
+
+  // Convert the offsets, which are in image order, into spans of voxels
+  std::sort(offsets.begin(), offsets.end());
+  offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+  typedef SegmentationSpanPainter::Span Span;
+  IRISApplication::SpanList spans;
+  for(itk::OffsetValueType offset : offsets)
+    {
+    long x = seg_region.GetIndex(0) + offset % seg_dim[0];
+    long y = seg_region.GetIndex(1) + (offset / seg_dim[0]) % seg_dim[1];
+    long z = seg_region.GetIndex(2) + offset / (seg_dim[0] * seg_dim[1]);
+    if(spans.size() && spans.back().x1 == x && spans.back().y == y && spans.back().z == z)
+      spans.back().x1++;
+    else
+      spans.push_back(Span(x, x + 1, y, z));
+    }
+
+  // When drawing is inverted, the rest of the region is painted
+  if(invert)
+    spans = SegmentationSpanPainter::Complement(spans, seg_region);
 
   // Update the segmentation via IRIS
-  m_Driver->UpdateSegmentationWithBinarySegmentation(seg_temp, undoTitle, invert, reverse);
+  m_Driver->UpdateSegmentationWithSpans(spans, undoTitle, reverse && !invert);
 }
@@ -388,13 +388,12 @@ public:
   const SliceViewportLayout::SubViewport *GetHoveredViewport();
 
   /**
-    Merges a binary segmentation drawn on a slice into the main
-    segmentation in SNAP. Returns the number of voxels changed.
-
-    This method might be better placed in IRISApplication
+    Merges a polygon drawn on a slice into the main segmentation in SNAP.
+    The vertices are in slice pixel units. The polygon is scan converted
+    into spans of pixels, which are painted directly into the runs of the
+    segmentation. Returns the number of voxels changed.
    */
-  unsigned int MergeSliceSegmentation(
-        itk::Image<unsigned char, 2> *drawing);
+  unsigned int MergeSlicePolygon(const std::vector<Vector2d> &vertices);
 
   Vector3d ComputeGridPosition(const Vector3d &disp_pix,
                                const itk::Index<2> &slice_index,
@@ -11,6 +11,18 @@
 #include "itkBWAandRFinterpolation.h"
 #include "itkImageRegionConstIterator.h"
 #include "itkImageRegionIterator.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMultiThreaderBase.h"
+#include "RLERegionOfInterestImageFilter.h"
+#include <array>
+#include <atomic>
+#include <climits>
+#include <exception>
+#include <functional>
+#include <map>
+#include <thread>
+#include <vector>
 
 void InterpolateLabelModel::SetParentModel(GlobalUIModel *parent)
 {
@@ -41,10 +53,148 @@ private:
   TLabel m_Label;
 };
 
+typedef GenericImageData::LabelImageType LabelImageType;
+typedef LabelImageType::RegionType LabelRegionType;
+typedef itk::Image<LabelType, 3> LabelCropType;
+
+/**
+ * The interpolation of a single label, which is carried out within the padded
+ * bounding box of the label, using crops of the segmentation and of the
+ * anatomical images
+ */
+struct LabelInterpolationJob
+{
+  LabelType Label;
+
+  // Padded bounding box of the label, in image coordinates
+  LabelRegionType Region;
+
+  // Whether the label may only be painted over clear voxels. This is the
+  // case when all labels are interpolated, so that the interpolation of one
+  // label does not overwrite the others.
+  bool ClearOnly;
+
+  // Crops of the segmentation and of the anatomical images to the region
+  LabelImageType::Pointer Segmentation;
+  std::vector<ImageWrapperBase::FloatImageType::Pointer> ScalarImages;
+  std::vector<ImageWrapperBase::FloatVectorImageType::Pointer> VectorImages;
+
+  // The interpolation result, with the index of the crops (zero)
+  LabelCropType::Pointer Result;
+
+  // The part of the region where the interpolation may change the
+  // segmentation, in image coordinates
+  LabelRegionType ChangedRegion;
+};
+
+// Padding added around the bounding box of each label
+static const long LABEL_BOX_PADDING = 2;
+
+/**
+ * Find the bounding box of every label in the segmentation from the runs of
+ * the RLE image, without decoding it
+ */
+static std::map<LabelType, LabelRegionType> ComputeLabelBoundingBoxes(LabelImageType *seg)
+{
+  typedef LabelImageType::BufferType LineImageType;
+  typedef LabelImageType::RLLine RLLine;
+
+  // Extents of each label: minimum and maximum index along each axis
+  std::map<LabelType, std::array<long, 6> > ext;
+  const LabelRegionType &region = seg->GetBufferedRegion();
+  LineImageType *lines = seg->GetBuffer();
+  for(itk::ImageRegionConstIteratorWithIndex<LineImageType> it(lines, lines->GetBufferedRegion());
+      !it.IsAtEnd(); ++it)
+    {
+    const RLLine &line = it.Value();
+    long y = it.GetIndex()[0], z = it.GetIndex()[1];
+    long x = region.GetIndex(0);
+    for(const auto &seg_run : line)
+      {
+      if(seg_run.second != 0)
+        {
+        long x1 = x + seg_run.first - 1;
+        auto found = ext.find(seg_run.second);
+        if(found == ext.end())
+          {
+          ext[seg_run.second] = {{ x, y, z, x1, y, z }};
+          }
+        else
+          {
+          std::array<long, 6> &e = found->second;
+          e[0] = std::min(e[0], x); e[1] = std::min(e[1], y); e[2] = std::min(e[2], z);
+          e[3] = std::max(e[3], x1); e[4] = std::max(e[4], y); e[5] = std::max(e[5], z);
+          }
+        }
+      x += seg_run.first;
+      }
+    }
+
+  std::map<LabelType, LabelRegionType> boxes;
+  for(const auto &e : ext)
+    {
+    LabelRegionType box;
+    for(unsigned int d = 0; d < 3; d++)
+      {
+      box.SetIndex(d, e.second[d]);
+      box.SetSize(d, e.second[d+3] - e.second[d] + 1);
+      }
+    boxes[e.first] = box;
+    }
+
+  return boxes;
+}
+
+/**
+ * Store the result of interpolating a label and find the part of the region
+ * where painting it would change the segmentation, i.e., the voxels that are
+ * assigned the label by the interpolation but do not have it already (or, if
+ * the label may only be painted over clear voxels, that are clear)
+ */
+template <class TImage>
+static void StoreInterpolationResult(LabelInterpolationJob &job, TImage *result)
+{
+  job.Result = LabelCropType::New();
+  job.Result->CopyInformation(job.Segmentation);
+  job.Result->SetRegions(job.Segmentation->GetBufferedRegion());
+  job.Result->Allocate();
+
+  itk::ImageRegionConstIterator<TImage> it_res(result, result->GetBufferedRegion());
+  itk::ImageRegionConstIterator<LabelImageType> it_seg(job.Segmentation, job.Segmentation->GetBufferedRegion());
+  itk::ImageRegionIteratorWithIndex<LabelCropType> it_out(job.Result, job.Result->GetBufferedRegion());
+
+  long bmin[3] = { LONG_MAX, LONG_MAX, LONG_MAX }, bmax[3] = { -1, -1, -1 };
+  for(; !it_out.IsAtEnd(); ++it_out, ++it_res, ++it_seg)
+    {
+    LabelType l = static_cast<LabelType>(it_res.Get());
+    it_out.Set(l);
+    LabelType l_seg = it_seg.Get();
+    if(l == job.Label && (job.ClearOnly ? l_seg == 0 : l_seg != job.Label))
+      {
+      for(unsigned int d = 0; d < 3; d++)
+        {
+        bmin[d] = std::min(bmin[d], (long) it_out.GetIndex()[d]);
+        bmax[d] = std::max(bmax[d], (long) it_out.GetIndex()[d]);
+        }
+      }
+    }
+
+  job.ChangedRegion = LabelRegionType();
+  if(bmax[0] >= 0)
+    {
+    for(unsigned int d = 0; d < 3; d++)
+      {
+      job.ChangedRegion.SetIndex(d, job.Region.GetIndex(d) + bmin[d]);
+      job.ChangedRegion.SetSize(d, bmax[d] - bmin[d] + 1);
+      }
+    }
+}
+
 void InterpolateLabelModel::Interpolate()
 {
   // Get the segmentation wrapper
   LabelImageWrapper *liw = m_Parent->GetDriver()->GetSelectedSegmentationLayer();
+  LabelImageType *seg = liw->GetImage();
 
   // Get the anatomical images - SR added this
   m_CurrentImageData = m_Parent->GetDriver()->GetCurrentImageData();
@@ -55,192 +205,279 @@ void InterpolateLabelModel::Interpolate()
   // Which method is being used
   auto method = this->GetInterpolationMethod();
 
+  // The label painted in place of the interpolated label
+  LabelType l_replace = this->GetDrawingLabel();
+
+  // Find the labels to interpolate and their bounding boxes
+  std::map<LabelType, LabelRegionType> boxes = ComputeLabelBoundingBoxes(seg);
+  std::vector<LabelInterpolationJob> jobs;
+  for(const auto &box : boxes)
+    {
+    if(interp_all || box.first == this->GetInterpolateLabel())
+      {
+      LabelInterpolationJob job;
+      job.Label = box.first;
+      job.ClearOnly = interp_all;
+      job.Region = box.second;
+      job.Region.PadByRadius(LABEL_BOX_PADDING);
+      job.Region.Crop(seg->GetBufferedRegion());
+      jobs.push_back(job);
+      }
+    }
+
+  // The anatomical images, cast to float, for the methods that use them
+  typedef ImageWrapperBase::FloatImageType ImageType;
+  typedef ImageWrapperBase::FloatVectorImageType VectorImageType;
+  std::vector<ImageType *> scalar_sources;
+  std::vector<VectorImageType *> vector_sources;
+
+  // The function that interpolates one label, which may be called concurrently
+  std::function<void(LabelInterpolationJob &)> interpolate;
+
   //Morphological Interpolation
   if(method == MORPHOLOGY)
     {
+    // Get the settings of the filter
+    int axis = -1;
+    if (this->GetMorphologyInterpolateOneAxis())
+      axis = this->m_Parent->GetDriver()->GetImageDirectionForAnatomicalDirection(this->GetMorphologyInterpolationAxis());
+    bool use_distance = this->GetMorphologyUseDistance();
+    bool heuristic = !this->GetMorphologyUseOptimalAlignment();
 
-    // Create the morphological interpolation filter
-    typedef itk::MorphologicalContourInterpolator<GenericImageData::LabelImageType> MCIType;
-    SmartPtr<MCIType> mci = MCIType::New();
-
-    // Should we be interpolating a specific label or all labels?
-    if(interp_all)
-      {
-      mci->SetInput(liw->GetImage());
-      }
-    else
+    interpolate = [=](LabelInterpolationJob &job)
       {
+      // Create the morphological interpolation filter
+      typedef itk::MorphologicalContourInterpolator<LabelImageType> MCIType;
+      SmartPtr<MCIType> mci = MCIType::New();
+
       // We need to extract a single component from the segmentation image to interpolate
-      typedef GenericImageData::LabelImageType LabelImageType;
       typedef BinarizeFunctor<LabelType> FunctorType;
       typedef itk::UnaryFunctorImageFilter<LabelImageType, LabelImageType, FunctorType> BinarizeFilterType;
       BinarizeFilterType::Pointer flt = BinarizeFilterType::New();
 
       FunctorType fn;
-      fn.SetLabel(this->GetInterpolateLabel());
-      flt->SetInput(liw->GetImage());
+      fn.SetLabel(job.Label);
+      flt->SetInput(job.Segmentation);
       flt->SetFunctor(fn);
       flt->Update();
 
       mci->SetInput(flt->GetOutput());
-      mci->SetLabel(this->GetInterpolateLabel());
-      }
+      mci->SetLabel(job.Label);
 
-    // Should we interpolate only one axis?
-    if (this->GetMorphologyInterpolateOneAxis())
-      {
-      int axis = this->m_Parent->GetDriver()->GetImageDirectionForAnatomicalDirection(this->GetMorphologyInterpolationAxis());
-      mci->SetAxis(axis);
-      }
-
-    // Should we use the distance transform?
-    mci->SetUseDistanceTransform(this->GetMorphologyUseDistance());
-
-    // Should heuristic or optimal alignment be used?
-    mci->SetHeuristicAlignment(!this->GetMorphologyUseOptimalAlignment());
+      // Should we interpolate only one axis?
+      if(axis >= 0)
+        mci->SetAxis(axis);
 
-    // Update the filter
-    mci->Update();
+      // Should we use the distance transform?
+      mci->SetUseDistanceTransform(use_distance);
 
-    // Apply the labels back to the segmentation
-    SegmentationUpdateIterator it_trg(liw, liw->GetBufferedRegion(),
-                                      this->GetDrawingLabel(), this->GetDrawOverFilter());
+      // Should heuristic or optimal alignment be used?
+      mci->SetHeuristicAlignment(heuristic);
 
-    itk::ImageRegionConstIterator<GenericImageData::LabelImageType>
-        it_src(mci->GetOutput(), mci->GetOutput()->GetBufferedRegion());
-
-    // The way we paint back into the segmentation depends on whether all labels
-    // or a specific label are being interpolated
-    if(interp_all)
-      {
-      // Just replace the segmentation by the interpolation, respecting draw-over
-      for(; !it_trg.IsAtEnd(); ++it_trg, ++it_src)
-        it_trg.PaintLabel(it_src.Get());
-      }
-    else
-      {
-      LabelType l_interp = this->GetInterpolateLabel();
-      LabelType l_replace = this->GetDrawingLabel();
-      for(; !it_trg.IsAtEnd(); ++it_trg, ++it_src)
-        if(it_src.Get() == l_interp)
-          it_trg.PaintLabelWithExtraProtection(l_interp, l_replace);
-      }
+      // Update the filter
+      mci->Update();
 
-    // Finish the segmentation editing and create an undo point
-    it_trg.Finalize("Interpolate label");
-  }
+      StoreInterpolationResult(job, mci->GetOutput());
+      };
+    }
 
   // If Binary Weighted Averaging ...
-  // TODO: this can become a memory hog - should crop around the region of interest
-  // TODO: label mapping code should be parallelized
   else if(method == BINARY_WEIGHTED_AVERAGE)
     {
-    // Inputs to the filter will be floating point images
-    typedef ImageWrapperBase::FloatImageType ImageType;
-    typedef ImageWrapperBase::FloatVectorImageType VectorImageType;
-
-    // Copy label image to short type from RLE
-    ShortType::Pointer SegmentationImageShortType = ShortType::New();
-
-    ShortType::RegionType ShortRegion = liw->GetImage()->GetBufferedRegion();
-    SegmentationImageShortType->CopyInformation(liw->GetImage());
-    SegmentationImageShortType->SetRegions( ShortRegion );
-    SegmentationImageShortType->Allocate();
-
-    itk::ImageRegionIterator< ShortType > itO( SegmentationImageShortType, SegmentationImageShortType->GetBufferedRegion() );
-    itk::ImageRegionConstIterator< GenericImageData::LabelImageType > itI( liw->GetImage(), liw->GetImage()->GetBufferedRegion() );
-
-    while ( !itI.IsAtEnd() )
-      {
-      typename GenericImageData::LabelImageType::PixelType val = itI.Get();
-      itO.Set( val );
-      ++itI;
-      ++itO;
-      }
-
-    using BinaryWeightedAverageType = itk::CombineBWAandRFFilter<ImageType,VectorImageType,ShortType>;
-    typename BinaryWeightedAverageType::Pointer bwa =  BinaryWeightedAverageType::New();
-
-    // Iterate through all of the relevant layers to get the main image
+    // Iterate through all of the relevant layers to get the anatomical images
     for(LayerIterator it = m_CurrentImageData->GetLayers(MAIN_ROLE | OVERLAY_ROLE);
         !it.IsAtEnd(); ++it)
       {
+      // Critical that these pipelines be released later
       if(it.GetLayerAsScalar())
-        {
-        // Critical that these pipelines be released later
-        auto src = it.GetLayer()->CreateCastToFloatPipeline("BinaryWeightedAverage");
-        bwa->AddScalarImage(src);
-        }
+        scalar_sources.push_back(it.GetLayer()->CreateCastToFloatPipeline("BinaryWeightedAverage"));
       else if (it.GetLayerAsVector())
-        {
-        // Critical that these pipelines be released later
-        auto src = it.GetLayer()->CreateCastToFloatVectorPipeline("BinaryWeightedAverage");
-        bwa->AddVectorImage(src);
-        }
+        vector_sources.push_back(it.GetLayer()->CreateCastToFloatVectorPipeline("BinaryWeightedAverage"));
       }
 
+    // Get the settings of the filter
+    bool contour_only = this->GetBWAUseContourOnly();
+    bool intermediate_only = this->GetBWAInterpolateIntermediateOnly();
+    int axis = -1;
+    if (this->GetSliceDirection())
+      axis = this->m_Parent->GetDriver()->GetImageDirectionForAnatomicalDirection(this->GetSliceDirectionAxis());
 
-    // Should we be interpolating a specific label or all labels?
-    if(interp_all)
+    interpolate = [=](LabelInterpolationJob &job)
       {
-      bwa->SetSegmentationImage(SegmentationImageShortType);
-      }
-    else
+      // Copy the label, binarized, to short type from RLE
+      ShortType::Pointer binary = ShortType::New();
+      binary->CopyInformation(job.Segmentation);
+      binary->SetRegions(job.Segmentation->GetBufferedRegion());
+      binary->Allocate();
+
+      itk::ImageRegionIterator<ShortType> itO(binary, binary->GetBufferedRegion());
+      itk::ImageRegionConstIterator<LabelImageType> itI(job.Segmentation, job.Segmentation->GetBufferedRegion());
+      for(; !itI.IsAtEnd(); ++itI, ++itO)
+        itO.Set(itI.Get() == job.Label ? job.Label : 0);
+
+      using BinaryWeightedAverageType = itk::CombineBWAandRFFilter<ImageType,VectorImageType,ShortType>;
+      typename BinaryWeightedAverageType::Pointer bwa =  BinaryWeightedAverageType::New();
+
+      for(auto &img : job.ScalarImages)
+        bwa->AddScalarImage(img);
+      for(auto &img : job.VectorImages)
+        bwa->AddVectorImage(img);
+
+      bwa->SetSegmentationImage(binary);
+      bwa->SetLabel(job.Label);
+      bwa->SetContourInformationOnly(contour_only);
+      bwa->SetIntermediateSlicesOnly(intermediate_only);
+
+      // Did the user manually specify the slicing direction
+      if(axis >= 0)
+        bwa->SetUserAxis(axis);
+
+      bwa->Update();
+
+      StoreInterpolationResult(job, bwa->GetInterpolation());
+      };
+    }
+
+  // Crop the segmentation and the anatomical images to the region of a job.
+  // This updates shared pipelines, and is done on this thread.
+  typedef itk::RegionOfInterestImageFilter<LabelImageType, LabelImageType> LabelROIType;
+  typedef itk::RegionOfInterestImageFilter<ImageType, ImageType> ScalarROIType;
+  typedef itk::RegionOfInterestImageFilter<VectorImageType, VectorImageType> VectorROIType;
+  auto crop = [&](LabelInterpolationJob &job)
+    {
+    SmartPtr<LabelROIType> roi = LabelROIType::New();
+    roi->SetInput(seg);
+    roi->SetRegionOfInterest(job.Region);
+    roi->Update();
+    job.Segmentation = roi->GetOutput();
+    job.Segmentation->DisconnectPipeline();
+
+    for(ImageType *src : scalar_sources)
       {
-      // We need to extract a single component from the segmentation image to interpolate
-        typename BinarizerType::Pointer Binarizer = BinarizerType::New();
-        Binarizer->SetInput(SegmentationImageShortType);
-        Binarizer->SetLowerThreshold(this->GetInterpolateLabel());
-        Binarizer->SetUpperThreshold(this->GetInterpolateLabel());
-        Binarizer->SetInsideValue(this->GetInterpolateLabel());
-        Binarizer->SetOutsideValue(0);
-        Binarizer->Update();
-        bwa->SetSegmentationImage(Binarizer->GetOutput());
-        bwa->SetLabel(this->GetInterpolateLabel());
+      SmartPtr<ScalarROIType> roi = ScalarROIType::New();
+      roi->SetInput(src);
+      roi->SetRegionOfInterest(job.Region);
+      roi->Update();
+      job.ScalarImages.push_back(roi->GetOutput());
+      job.ScalarImages.back()->DisconnectPipeline();
       }
 
-    // Should we be interpolating a specific label?
-//    if (!interp_all){
-//      bwa->SetLabel(this->GetInterpolateLabel());
-//    }
-
-    //    bwa->SetSegmentationImage(SegmentationImageShortType);
-    bwa->SetContourInformationOnly(this->GetBWAUseContourOnly());
-    bwa->SetIntermediateSlicesOnly(this->GetBWAInterpolateIntermediateOnly());
-
-    // Did the user manually specify the slicing direction
-    if (this->GetSliceDirection())
+    for(VectorImageType *src : vector_sources)
       {
-      int axis = this->m_Parent->GetDriver()->GetImageDirectionForAnatomicalDirection(this->GetSliceDirectionAxis());
-      bwa->SetUserAxis(axis);
+      SmartPtr<VectorROIType> roi = VectorROIType::New();
+      roi->SetInput(src);
+      roi->SetRegionOfInterest(job.Region);
+      roi->Update();
+      job.VectorImages.push_back(roi->GetOutput());
+      job.VectorImages.back()->DisconnectPipeline();
       }
+    };
+
+  // Interpolate the labels, concurrently when there are several. The labels
+  // are processed in batches of one label per thread: the crops of a batch
+  // are made, the batch is interpolated and painted back, and its images are
+  // released before the next batch, so that only one batch is held in memory.
+  // The ITK filters of each job get an even share of the threads ITK would
+  // otherwise use for a single filter.
+  if(interpolate && jobs.size())
+    {
+    unsigned int itk_threads = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+    size_t n_threads = std::min((size_t) std::max(1u, itk_threads), jobs.size());
+    unsigned int job_threads = std::max(1u, (unsigned int) (itk_threads / n_threads));
 
-    bwa->Update();
-
-    // Apply the labels back to the segmentation - same as Morphological
-    SegmentationUpdateIterator it_trg(liw, liw->GetBufferedRegion(),
-                                      this->GetDrawingLabel(), this->GetDrawOverFilter());
+    std::vector<std::exception_ptr> errors(jobs.size());
+    bool changed = false;
+    for(size_t first = 0; first < jobs.size(); first += n_threads)
+      {
+      size_t last = std::min(first + n_threads, jobs.size());
+      for(size_t i = first; i < last; i++)
+        {
+        try { crop(jobs[i]); }
+        catch(...) { errors[i] = std::current_exception(); }
+        }
 
-    itk::ImageRegionConstIterator<ShortType>
-        it_src(bwa->GetInterpolation(), bwa->GetInterpolation()->GetBufferedRegion());
+      std::atomic<size_t> next_job(first);
+      auto worker = [&]()
+        {
+        for(size_t i = next_job++; i < last; i = next_job++)
+          {
+          if(errors[i])
+            continue;
+          try { interpolate(jobs[i]); }
+          catch(...) { errors[i] = std::current_exception(); }
+          }
+        };
+
+      // Filters created by the jobs use the reduced number of threads
+      itk::MultiThreaderBase::SetGlobalDefaultNumberOfThreads(job_threads);
+      std::vector<std::thread> threads;
+      for(size_t t = first + 1; t < last; t++)
+        threads.push_back(std::thread(worker));
+      worker();
+      for(std::thread &t : threads)
+        t.join();
+      itk::MultiThreaderBase::SetGlobalDefaultNumberOfThreads(itk_threads);
+
+      // Release the cropped images
+      for(size_t i = first; i < last; i++)
+        {
+        jobs[i].Segmentation = NULL;
+        jobs[i].ScalarImages.clear();
+        jobs[i].VectorImages.clear();
+        }
 
-    if(interp_all)
-      {
-      // Just replace the segmentation by the interpolation, respecting draw-over
-      for(; !it_trg.IsAtEnd(); ++it_trg, ++it_src)
-        it_trg.PaintLabel(it_src.Get());
-      }
-    else
-      {
-      LabelType l_interp = this->GetInterpolateLabel();
-      LabelType l_replace = this->GetDrawingLabel();
-      for(; !it_trg.IsAtEnd(); ++it_trg, ++it_src)
-        if(it_src.Get() == l_interp)
-          it_trg.PaintLabelWithExtraProtection(l_interp, l_replace);
+      // Apply the labels back to the segmentation, only in the regions that
+      // change, and combine the changes into a single undo point. The labels
+      // that are painted do not affect the interpolation of the next batches.
+      for(size_t i = first; i < last; i++)
+        {
+        LabelInterpolationJob &job = jobs[i];
+        if(errors[i] || job.ChangedRegion.GetNumberOfPixels() == 0)
+          continue;
+
+        SegmentationUpdateIterator it_trg(liw, job.ChangedRegion,
+                                          this->GetDrawingLabel(), this->GetDrawOverFilter());
+
+        LabelRegionType src_region = job.ChangedRegion;
+        for(unsigned int d = 0; d < 3; d++)
+          src_region.SetIndex(d, job.ChangedRegion.GetIndex(d) - job.Region.GetIndex(d));
+        itk::ImageRegionConstIterator<LabelCropType> it_src(job.Result, src_region);
+
+        // The way we paint back into the segmentation depends on whether all labels
+        // or a specific label are being interpolated
+        for(; !it_trg.IsAtEnd(); ++it_trg, ++it_src)
+          {
+          if(it_src.Get() == job.Label)
+            {
+            // When interpolating all labels, paint each label over clear voxels
+            // only, respecting draw-over. A voxel claimed by more than one label
+            // goes to the first one.
+            if(job.ClearOnly)
+              it_trg.PaintLabelOverClear(job.Label);
+            else
+              it_trg.PaintLabelWithExtraProtection(job.Label, l_replace);
+            }
+          }
+
+        if(it_trg.Finalize())
+          {
+          liw->StoreIntermediateUndoDelta(it_trg.RelinquishDelta());
+          changed = true;
+          }
+
+        // Release the result
+        job.Result = NULL;
+        }
       }
 
-    // Finish the segmentation editing and create an undo point
-    it_trg.Finalize("Interpolate label");
+    // Finish the segmentation editing and create an undo point. If some of
+    // the labels failed, the others have been applied and can be undone.
+    if(changed)
+      liw->StoreUndoPoint("Interpolate label");
+
+    for(std::exception_ptr &e : errors)
+      if(e)
+        std::rethrow_exception(e);
     }
 
   // Iterate through all of the relevant layers and release the pipelines we created
@@ -8,98 +8,7 @@
 #include "SegmentationUpdateIterator.h"
 
 #include "RLERegionOfInterestImageFilter.h"
-#include "itkGradientAnisotropicDiffusionImageFilter.h"
-#include "itkGradientMagnitudeImageFilter.h"
-#include "itkWatershedImageFilter.h"
-
-
-// TODO: move this into a separate file!!!!
-class BrushWatershedPipeline
-{
-public:
-  typedef LabelImageWrapperTraits::ImageType LabelImageType;
-  typedef itk::Image<float, 3> FloatImageType;
-  typedef itk::Image<itk::IdentifierType, 3> WatershedImageType;
-  typedef WatershedImageType::IndexType IndexType;
-
-  BrushWatershedPipeline()
-    {
-    roi = ROIType::New();
-    adf = ADFType::New();
-    adf->SetInput(roi->GetOutput());
-    adf->SetConductanceParameter(0.5);
-    gmf = GMFType::New();
-    gmf->SetInput(adf->GetOutput());
-    wf = WFType::New();
-    wf->SetInput(gmf->GetOutput());
-    }
-
-  void PrecomputeWatersheds(
-    const FloatImageType *grey,
-    const LabelImageType *label,
-    itk::ImageRegion<3> region,
-    itk::Index<3> vcenter,
-    size_t smoothing_iter)
-    {
-    this->region = region;
-
-    // Get the offset of vcenter in the region
-    if(region.IsInside(vcenter))
-      for(size_t d = 0; d < 3; d++)
-        this->vcenter[d] = vcenter[d] - region.GetIndex()[d];
-    else
-      for(size_t d = 0; d < 3; d++)
-        this->vcenter[d] = region.GetSize()[d] / 2;
-
-    // Create a backup of the label image
-    LROIType::Pointer lroi = LROIType::New();
-    lroi->SetInput(label);
-    lroi->SetRegionOfInterest(region);
-    lroi->Update();
-    lsrc = lroi->GetOutput();
-    lsrc->DisconnectPipeline();
-
-    // Initialize the watershed pipeline
-    roi->SetInput(grey);
-    roi->SetRegionOfInterest(region);
-    adf->SetNumberOfIterations(smoothing_iter);
-
-    // Set the initial level to lowest possible - to get all watersheds
-    wf->SetLevel(1.0);
-    wf->Update();
-    }
-
-  void RecomputeWatersheds(double level)
-    {
-    // Reupdate the filter with new level
-    wf->SetLevel(level);
-    wf->Update();
-    }
-
-  bool IsPixelInSegmentation(IndexType idx)
-    {
-    // Get the watershed ID at the center voxel
-    unsigned long wctr = wf->GetOutput()->GetPixel(vcenter);
-    unsigned long widx = wf->GetOutput()->GetPixel(idx);
-    return wctr == widx;
-    }
-
-private:
-  typedef itk::RegionOfInterestImageFilter<FloatImageType, FloatImageType> ROIType;
-  typedef itk::RegionOfInterestImageFilter<LabelImageType, LabelImageType> LROIType;
-  typedef itk::GradientAnisotropicDiffusionImageFilter<FloatImageType,FloatImageType> ADFType;
-  typedef itk::GradientMagnitudeImageFilter<FloatImageType, FloatImageType> GMFType;
-  typedef itk::WatershedImageFilter<FloatImageType> WFType;
-
-  ROIType::Pointer roi;
-  ADFType::Pointer adf;
-  GMFType::Pointer gmf;
-  WFType::Pointer wf;
-
-  itk::ImageRegion<3> region;
-  LabelImageType::Pointer lsrc;
-  itk::Index<3> vcenter;
-};
+#include "BrushWatershedPipeline.h"
 
 
 
@@ -394,21 +303,22 @@ PaintbrushModel::ApplyBrush(bool reverse_mode, bool dragging)
     if(!context_layer)
       context_layer = gid->GetMain();
 
-    // Obtain a cast to float pipeline from the layer
-    // TODO: this causes repeated memory allocation - should probably create when entering mode
-    auto *img_source = context_layer->CreateCastToFloatPipeline("WatershedBrush", this->m_Parent->GetId());
-
-    // Precompute the watersheds
-    m_Watershed->PrecomputeWatersheds(
-          img_source,
-          driver->GetSelectedSegmentationLayer()->GetImage(),
-          xTestRegion, to_itkIndex(m_MousePosition), pbs.watershed.smooth_iterations);
+    // Recompute the watersheds only if the brush leaves the cached window
+    itk::Object *source = context_layer->GetImageBase();
+    if(!m_Watershed->IsWindowValid(source, xTestRegion, pbs.watershed.smooth_iterations))
+      {
+      // Obtain a cast to float pipeline from the layer
+      auto *img_source = context_layer->CreateCastToFloatPipeline("WatershedBrush", this->m_Parent->GetId());
 
-    m_Watershed->RecomputeWatersheds(pbs.watershed.level);
+      m_Watershed->PrecomputeWatersheds(
+            img_source, source, xTestRegion, pbs.watershed.smooth_iterations);
 
-    // Release the casting pipeline
-    context_layer->ReleaseInternalPipeline("WatershedBrush", this->m_Parent->GetId());
+      // Release the casting pipeline
+      context_layer->ReleaseInternalPipeline("WatershedBrush", this->m_Parent->GetId());
+      }
 
+    m_Watershed->RecomputeWatersheds(pbs.watershed.level);
+    m_Watershed->SetCenter(to_itkIndex(m_MousePosition), xTestRegion);
     }
 
   // Shift vector (different depending on whether the brush has odd/even diameter
@@ -433,11 +343,7 @@ PaintbrushModel::ApplyBrush(bool reverse_mode, bool dragging)
     // Check if the pixel is in the watershed
     if(flagWatershed)
       {
-      LabelImageWrapper::ImageType::IndexType idxoff;
-      for(unsigned int i = 0; i < 3; i++)
-        idxoff[i] = idx.GetIndex()[i] - xTestRegion.GetIndex().GetIndex()[i];
-
-      if(!m_Watershed->IsPixelInSegmentation(idxoff))
+      if(!m_Watershed->IsPixelInSegmentation(idx))
         continue;
       }
 
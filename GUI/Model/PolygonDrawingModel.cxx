@@ -1,5 +1,4 @@
 #include "PolygonDrawingModel.h"
-#include "PolygonScanConvert.h"
 #include <iostream>
 #include <cstdlib>
 #include <algorithm>
@@ -31,7 +30,6 @@ PolygonDrawingModel
   m_SelectedVertices = false;
   m_DraggingPickBox = false;
   m_StartX = 0; m_StartY = 0;
-  m_PolygonSlice = PolygonSliceType::New();
   m_HoverOverFirstVertex = false;
 
   m_FreehandFittingRateModel = NewRangedConcreteProperty(DefaultFreehandFittingRate, 0.0, 100.0, 1.0);
@@ -633,13 +631,6 @@ PolygonDrawingModel
 {
   assert(m_State == EDITING_STATE);
 
-  // Allocate the polygon to match current image size. This will only
-  // allocate new memory if the slice size changed
-  itk::Size<2> sz = {{ (itk::SizeValueType) m_Parent->GetSliceSize()[0],
-                       (itk::SizeValueType) m_Parent->GetSliceSize()[1] }};
-  m_PolygonSlice->SetRegions(sz);
-  m_PolygonSlice->Allocate();
-
   // Remove duplicates from the vertex array
   VertexIterator itEnd = std::unique(m_Vertices.begin(), m_Vertices.end(), PolygonVertexTest);
   m_Vertices.erase(itEnd, m_Vertices.end());
@@ -672,14 +663,12 @@ PolygonDrawingModel
       xVertexSet.insert(make_pair(it->x, it->y));
       }
 
-    // Scan convert the points into the slice
-    typedef PolygonScanConvert<PolygonSliceType, float, VertexIterator> ScanConvertType;
-
-    ScanConvertType::RasterizeFilled(
-      m_Vertices.begin(), m_Vertices.size(), m_PolygonSlice);
+    // Scan convert the polygon and apply it to the main segmentation
+    std::vector<Vector2d> vts2d;
+    for (auto &v : m_Vertices)
+      vts2d.push_back(Vector2d(v.x, v.y));
 
-    // Apply the segmentation to the main segmentation
-    int nUpdates = m_Parent->MergeSliceSegmentation(m_PolygonSlice);
+    int nUpdates = m_Parent->MergeSlicePolygon(vts2d);
     if(nUpdates == 0)
       {
       warnings.push_back(
@@ -188,13 +188,6 @@ protected:
 
   // Freehand fitting rate
   SmartPtr<ConcreteRangedDoubleProperty> m_FreehandFittingRateModel;
-
-  // Type definition for the slice used for polygon rendering
-  typedef itk::Image<unsigned char,2> PolygonSliceType;
-  typedef SmartPtr<PolygonSliceType> PolygonSlicePointer;
-
-  /** Slice used for polygon drawing and merging */
-  PolygonSlicePointer m_PolygonSlice;
 };
 
 #endif // POLYGONDRAWINGMODEL_H
@@ -15,6 +15,105 @@
 #include "vnl/algo/vnl_svd.h"
 
 #include "OptimizationProgressRenderer.h"
+#include "itkBinShrinkImageFilter.h"
+
+/**
+ * Downsampled copies of an image used by automatic registration, one for each
+ * resolution level coarser than the full resolution. Level k is obtained by
+ * averaging bins of two voxels along each axis of level k-1. The copies are
+ * kept between registration runs until the image they were computed from,
+ * identified by its ITK image and its modification time, changes.
+ */
+template <class TImage>
+class RegistrationImagePyramid
+{
+public:
+  typedef ImageWrapperBase::FloatImageType FloatImageType;
+  typedef ImageWrapperBase::FloatVectorImageType FloatVectorImageType;
+
+  RegistrationImagePyramid() : m_Source(NULL), m_SourceMTime(0) {}
+
+  /**
+   * Get the image at a given resolution level. Level zero is the output of the
+   * casting pipeline of the layer's default scalar representation, which must
+   * be released with the given key when no longer needed.
+   */
+  TImage *GetLevel(ImageWrapperBase *layer, int level, const char *key)
+  {
+    // The levels are computed from the default scalar representation, which
+    // may be derived from the layer's image by a pipeline (e.g., magnitude of
+    // a multi-component image), so its pipeline decides whether they are
+    // still valid. The cast output itself is created anew on each call.
+    ScalarImageWrapperBase *scalar = layer->GetDefaultScalarRepresentation();
+    itk::ModifiedTimeType mtime = GetScalarMTime(scalar);
+    if(scalar != m_Source || mtime != m_SourceMTime)
+      {
+      m_Levels.clear();
+      m_Source = scalar;
+      m_SourceMTime = mtime;
+      }
+
+    if(level == 0 || m_Levels.size() < (size_t) level)
+      {
+      // The full resolution image is needed
+      TImage *image = CreateCast(scalar, key, (TImage *) NULL);
+      if(image->GetSource())
+        image->GetSource()->UpdateLargestPossibleRegion();
+      if(level == 0)
+        return image;
+
+      // Downsample it one level at a time
+      while(m_Levels.size() < (size_t) level)
+        {
+        TImage *finer = m_Levels.size() ? m_Levels.back().GetPointer() : image;
+        typename ShrinkFilter::ShrinkFactorsType factors;
+        for(unsigned int d = 0; d < 3; d++)
+          factors[d] = finer->GetBufferedRegion().GetSize(d) > 1 ? 2 : 1;
+
+        typename ShrinkFilter::Pointer shrink = ShrinkFilter::New();
+        shrink->SetInput(finer);
+        shrink->SetShrinkFactors(factors);
+        shrink->Update();
+
+        SmartPtr<TImage> coarser = shrink->GetOutput();
+        coarser->DisconnectPipeline();
+        m_Levels.push_back(coarser);
+        }
+      }
+
+    return m_Levels[level - 1];
+  }
+
+  /** Discard the cached levels */
+  void Clear()
+  {
+    m_Levels.clear();
+    m_Source = NULL;
+    m_SourceMTime = 0;
+  }
+
+protected:
+  typedef itk::BinShrinkImageFilter<TImage, TImage> ShrinkFilter;
+
+  // The time of the last change to the image that the cast pipeline reads,
+  // or to any filter upstream of it
+  static itk::ModifiedTimeType GetScalarMTime(ScalarImageWrapperBase *w)
+  {
+    itk::ImageBase<3> *image = w->GetImageBase();
+    image->UpdateOutputInformation();
+    return std::max(image->GetMTime(), image->GetPipelineMTime());
+  }
+
+  static FloatVectorImageType *CreateCast(ScalarImageWrapperBase *w, const char *key, FloatVectorImageType *)
+    { return w->CreateCastToFloatVectorPipeline(key); }
+
+  static FloatImageType *CreateCast(ScalarImageWrapperBase *w, const char *key, FloatImageType *)
+    { return w->CreateCastToFloatPipeline(key); }
+
+  const ScalarImageWrapperBase *m_Source;
+  itk::ModifiedTimeType m_SourceMTime;
+  std::vector<SmartPtr<TImage> > m_Levels;
+};
 
 
 const unsigned long RegistrationModel::NOID = (unsigned long)(-1);
@@ -105,11 +204,21 @@ RegistrationModel::RegistrationModel()
   m_Driver = NULL;
   m_Parent = NULL;
   m_GreedyAPI = NULL;
+
+  // Downsampled images are kept between registration runs
+  m_FixedPyramid = new FloatVectorImagePyramid();
+  m_MovingPyramid = new FloatVectorImagePyramid();
+  m_MaskPyramid = new FloatImagePyramid();
+  m_AutoRegistrationRunning = false;
+  m_CancelRequested = false;
+  m_CurrentLevelIndex = 0;
 }
 
 RegistrationModel::~RegistrationModel()
 {
-
+  delete m_FixedPyramid;
+  delete m_MovingPyramid;
+  delete m_MaskPyramid;
 }
 
 
@@ -666,32 +775,12 @@ void RegistrationModel::RunAutoRegistration()
   // Obtain the fixed and moving images.
   ImageWrapperBase *fixed = this->GetParent()->GetDriver()->GetCurrentImageData()->GetMain();
   ImageWrapperBase *moving = this->GetMovingLayerWrapper();
-
-  // TODO: for now, we are not supporting vector image registration, only registration between
-  // scalar components; and we use the default scalar component.
-  ImageWrapperBase::FloatVectorImageType *fixed_cast =
-      fixed->GetDefaultScalarRepresentation()->CreateCastToFloatVectorPipeline("RegistrationModel");
-
-  ImageWrapperBase::FloatVectorImageType *moving_cast =
-      moving->GetDefaultScalarRepresentation()->CreateCastToFloatVectorPipeline("RegistrationModel");
-
-
-  // Update the cast filters so the buffers are loaded
-  //   Greedy is using BufferredRegion to create cost functions.
-  //   Without updating, the bufferred region will be [0,0,0],
-  //   and it will cause divide-by-zero error on the greedy side
-  if(fixed_cast->GetSource()) fixed_cast->GetSource()->Update();
-  if(moving_cast->GetSource()) moving_cast->GetSource()->Update();
-
-  // Caster for the mask image - declared here so that SmartPtr does not go out of scope
-  ImageWrapperBase::FloatImageType *mask_cast;
+  ImageWrapperBase *seg = this->GetUseSegmentationAsMask()
+                          ? this->GetParent()->GetDriver()->GetSelectedSegmentationLayer() : NULL;
 
   // Set up the parameters for greedy registration
   GreedyParameters param;
 
-  // Create an API object
-  m_GreedyAPI = new GreedyAPI();
-
   // Create an imput group and configure the fixed and moving images
   GreedyInputGroup ig;
   ImagePairSpec ip;
@@ -700,20 +789,9 @@ void RegistrationModel::RunAutoRegistration()
   ip.moving = "MOVING_IMAGE";
   ig.inputs.push_back(ip);
 
-  // Pass the actual images to the cache
-  m_GreedyAPI->AddCachedInputObject(ip.fixed, fixed_cast);
-  m_GreedyAPI->AddCachedInputObject(ip.moving, moving_cast);
-
   // Mask image
-  if(this->GetUseSegmentationAsMask())
-    {
+  if(seg)
     ig.fixed_mask = "GRADIENT_MASK";
-    ImageWrapperBase *seg = this->GetParent()->GetDriver()->GetSelectedSegmentationLayer();
-    mask_cast = seg->GetDefaultScalarRepresentation()->CreateCastToFloatPipeline("RegistrationModel");
-    if(mask_cast->GetSource())
-      mask_cast->GetSource()->UpdateLargestPossibleRegion();
-    m_GreedyAPI->AddCachedInputObject(ig.fixed_mask, mask_cast);
-    }
 
   // Set up the metric
   switch(m_SimilarityMetricModel->GetValue())
@@ -736,15 +814,11 @@ void RegistrationModel::RunAutoRegistration()
   else
     param.affine_dof = GreedyParameters::DOF_AFFINE;
 
-  // Set up the pyramid
+  // Each resolution level is a separate single-level run of greedy on the
+  // downsampled images, so that the transform can be published and the
+  // registration cancelled between the levels
   param.iter_per_level.clear();
-  for(int k = m_CoarsestResolutionLevel; k >= 0; k--)
-    {
-    if(k >= m_FinestResolutionLevel)
-      param.iter_per_level.push_back(100);
-    else
-      param.iter_per_level.push_back(0);
-    }
+  param.iter_per_level.push_back(100);
 
   // Create a transform spec
   param.affine_init_mode = RAS_FILENAME;
@@ -769,36 +843,92 @@ void RegistrationModel::RunAutoRegistration()
   tran->SetMatrix(matrix);
   tran->SetOffset(offset);
 
-  // Finally pass the float transform to the API
-  m_GreedyAPI->AddCachedInputObject(param.affine_init_transform.filename, tran);
-
   // Pass the output string - same as the input transform
   param.output = param.affine_init_transform.filename;
+  param.output_intermediate = param.affine_init_transform.filename;
 
-  // Handle intermediate data
-  if(m_IterationCommand)
+  // Publish the intermediate transforms to the reslicing overlay
+  typedef itk::MemberCommand<Self> CommandType;
+  CommandType::Pointer cmd = CommandType::New();
+  cmd->SetCallbackFunction(this, &RegistrationModel::IterationCallback);
+  unsigned long tag = tran->AddObserver(itk::ModifiedEvent(), cmd);
+
+  // The metric log has an entry for each level, from coarsest to finest
+  m_MetricLog.clear();
+  m_MetricLog.resize(1 + m_CoarsestResolutionLevel - m_FinestResolutionLevel);
+
+  m_AutoRegistrationRunning = true;
+  m_CancelRequested = false;
+  try
     {
-    typedef itk::MemberCommand<Self> CommandType;
-    CommandType::Pointer cmd = CommandType::New();
-    cmd->SetCallbackFunction(this, &RegistrationModel::IterationCallback);
-    param.output_intermediate = param.affine_init_transform.filename;
-    tran->AddObserver(itk::ModifiedEvent(), cmd);
+    for(int k = m_CoarsestResolutionLevel; k >= m_FinestResolutionLevel && !m_CancelRequested; k--)
+      {
+      m_CurrentLevelIndex = m_CoarsestResolutionLevel - k;
+
+      // Create an API object and pass the images at this level to the cache
+      m_GreedyAPI = new GreedyAPI();
+      m_GreedyAPI->AddCachedInputObject(ip.fixed, m_FixedPyramid->GetLevel(fixed, k, "RegistrationModel"));
+      m_GreedyAPI->AddCachedInputObject(ip.moving, m_MovingPyramid->GetLevel(moving, k, "RegistrationModel"));
+      if(seg)
+        m_GreedyAPI->AddCachedInputObject(ig.fixed_mask, m_MaskPyramid->GetLevel(seg, k, "RegistrationModel"));
+
+      // Finally pass the float transform to the API, starting from the result
+      // of the previous level
+      m_GreedyAPI->AddCachedInputObject(param.affine_init_transform.filename, tran);
+
+      // Run the registration
+      m_GreedyAPI->RunAffine(param);
+
+      // Now, the transform tran should hold our matrix and offset
+      matrix = tran->GetMatrix();
+      offset = tran->GetOffset();
+      this->SetMovingTransform(matrix, offset);
+      if(m_GreedyAPI->GetMetricLog().size())
+        m_MetricLog[m_CurrentLevelIndex] = m_GreedyAPI->GetMetricLog().back();
+
+      // Delete the API
+      delete(m_GreedyAPI); m_GreedyAPI = NULL;
+      }
+    }
+  catch(itk::ProcessAborted &)
+    {
+    // Cancelled during a level, keep the transform from the last level
+    delete(m_GreedyAPI); m_GreedyAPI = NULL;
+    this->SetMovingTransform(matrix, offset);
+    }
+  catch(...)
+    {
+    delete(m_GreedyAPI); m_GreedyAPI = NULL;
+    tran->RemoveObserver(tag);
+    m_AutoRegistrationRunning = false;
+    this->ReleaseRegistrationPipelines();
+    throw;
     }
 
-  // Run the registration
-  m_GreedyAPI->RunAffine(param);
-
-  // Now, the transform tran should hold our matrix and offset
-  this->SetMovingTransform(tran->GetMatrix(), tran->GetOffset());
+  tran->RemoveObserver(tag);
+  m_AutoRegistrationRunning = false;
+  this->ReleaseRegistrationPipelines();
+}
 
-  // Delete the API
-  delete(m_GreedyAPI); m_GreedyAPI = NULL;
+void RegistrationModel::CancelAutoRegistration()
+{
+  if(m_AutoRegistrationRunning)
+    m_CancelRequested = true;
+}
 
-  // Release the pipelines
-  fixed->GetDefaultScalarRepresentation()->ReleaseInternalPipeline("RegistrationModel");
-  moving->GetDefaultScalarRepresentation()->ReleaseInternalPipeline("RegistrationModel");
-  if(mask_cast)
-    this->GetParent()->GetDriver()->GetSelectedSegmentationLayer()->ReleaseInternalPipeline("RegistrationModel");
+void RegistrationModel::ReleaseRegistrationPipelines()
+{
+  // Release the casting pipelines used for the full resolution images, the
+  // downsampled images are kept
+  ImageWrapperBase *fixed = this->GetParent()->GetDriver()->GetCurrentImageData()->GetMain();
+  ImageWrapperBase *moving = this->GetMovingLayerWrapper();
+  ImageWrapperBase *seg = this->GetParent()->GetDriver()->GetSelectedSegmentationLayer();
+  if(fixed)
+    fixed->GetDefaultScalarRepresentation()->ReleaseInternalPipeline("RegistrationModel");
+  if(moving)
+    moving->GetDefaultScalarRepresentation()->ReleaseInternalPipeline("RegistrationModel");
+  if(seg)
+    seg->GetDefaultScalarRepresentation()->ReleaseInternalPipeline("RegistrationModel");
 }
 
 void RegistrationModel::MatchByMoments(int order)
@@ -959,8 +1089,8 @@ void RegistrationModel::SaveTransform(const char *filename, TransformFormat form
 const RegistrationModel::MetricLog &
 RegistrationModel::GetRegistrationMetricLog() const
 {
-  // Get the complete metric report
-  return m_GreedyAPI->GetMetricLog();
+  // Get the complete metric report, collected over the levels
+  return m_MetricLog;
 }
 
 void RegistrationModel::OnDialogClosed()
@@ -968,6 +1098,16 @@ void RegistrationModel::OnDialogClosed()
   // Don't leave the interactive mode on
   if(m_InteractiveToolModel->GetValue())
     m_InteractiveToolModel->SetValue(false);
+
+  // Don't hold on to the downsampled images
+  this->ClearPyramids();
+}
+
+void RegistrationModel::ClearPyramids()
+{
+  m_FixedPyramid->Clear();
+  m_MovingPyramid->Clear();
+  m_MaskPyramid->Clear();
 }
 
 void RegistrationModel
@@ -1042,6 +1182,7 @@ void RegistrationModel::OnUpdate()
       // Set the moving layer ID to the first available overlay
       LayerIterator it = m_Driver->GetCurrentImageData()->GetLayers(role);
       m_MovingLayerId = it.IsAtEnd() ? NOID : it.GetLayer()->GetUniqueId();
+      m_MovingPyramid->Clear();
       }
     }
 
@@ -1152,7 +1293,9 @@ bool RegistrationModel::GetMovingLayerValueAndRange(unsigned long &value, Regist
 
 void RegistrationModel::SetMovingLayerValue(unsigned long value)
 {
-  // Set the layer id
+  // Set the layer id, the downsampled moving image is no longer needed
+  if(value != m_MovingLayerId)
+    m_MovingPyramid->Clear();
   m_MovingLayerId = value;
 
   // Update the cache
@@ -1363,11 +1506,12 @@ void RegistrationModel::IterationCallback(const itk::Object *object, const itk::
   // Apply the transform
   this->SetMovingTransform(tran->GetMatrix(), tran->GetOffset());
 
-  // Update the last metric value
+  // Update the metric log of the current level and the last metric value
   const GreedyAPI::MetricLogType &metric_log = m_GreedyAPI->GetMetricLog();
   if(metric_log.size())
     {
     const std::vector<MultiComponentMetricReport> &last_log = metric_log.back();
+    m_MetricLog[m_CurrentLevelIndex] = last_log;
     if(last_log.size())
       m_LastMetricValueModel->SetValue(last_log.back().TotalPerPixelMetric);
     }
@@ -1376,6 +1520,12 @@ void RegistrationModel::IterationCallback(const itk::Object *object, const itk::
   // just putting the above ModelUpdateEvent() into a bucket
   if(m_IterationCommand)
     m_IterationCommand->Execute(object, event);
+
+  // Cancellation may have been requested while processing events. Greedy has
+  // no way to stop an optimization, so we abort it the same way that ITK
+  // filters are aborted, by throwing from the progress callback
+  if(m_CancelRequested)
+    throw itk::ProcessAborted(__FILE__, __LINE__);
 }
 
 
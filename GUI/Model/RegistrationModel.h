@@ -13,10 +13,13 @@ class ImageWrapperBase;
 class OptimizationProgressRenderer;
 
 template <unsigned int VDim, class TReal> class GreedyApproach;
+template <class TImage> class RegistrationImagePyramid;
 
 namespace itk
 {
   class Command;
+  template <typename TPixel, unsigned int VImageDimension> class Image;
+  template <typename TPixel, unsigned int VImageDimension> class VectorImage;
   template <typename TParametersValueType, unsigned int N1, unsigned int N2> class MatrixOffsetTransformBase;
 }
 
@@ -123,8 +126,24 @@ public:
 
   void SetIterationCommand(itk::Command *command);
 
+  /**
+    Run automatic registration, from the coarsest to the finest resolution
+    level. The coarse levels use downsampled copies of the images, which are
+    kept between runs as long as the images do not change. The transform of
+    the moving layer is updated after every iteration and every level.
+    */
   void RunAutoRegistration();
 
+  /**
+    Request that the running automatic registration stop. The request is
+    honored at the next iteration, and the transform computed at the last
+    completed level is kept.
+    */
+  void CancelAutoRegistration();
+
+  /** Whether automatic registration is currently running */
+  irisIsMacro(AutoRegistrationRunning)
+
   void LoadTransform(const char *filename, TransformFormat format,
                      bool compose = false, bool inverse = false);
 
@@ -172,6 +191,27 @@ protected:
   // Pointer to the GreedyAPI. This is only non-null during RunAutoRegistration();
   GreedyAPI *m_GreedyAPI;
 
+  // Downsampled fixed, moving and mask images, kept between registration runs
+  typedef RegistrationImagePyramid<itk::VectorImage<float, 3> > FloatVectorImagePyramid;
+  typedef RegistrationImagePyramid<itk::Image<float, 3> > FloatImagePyramid;
+  FloatVectorImagePyramid *m_FixedPyramid, *m_MovingPyramid;
+  FloatImagePyramid *m_MaskPyramid;
+
+  // State of the running registration
+  bool m_AutoRegistrationRunning, m_CancelRequested;
+
+  // Index of the level being registered, zero for the coarsest level
+  unsigned int m_CurrentLevelIndex;
+
+  // The metric log collected over the levels of the last registration
+  MetricLog m_MetricLog;
+
+  // Discard the downsampled images
+  void ClearPyramids();
+
+  // Release the pipelines used to cast the images for registration
+  void ReleaseRegistrationPipelines();
+
   // Shorthand to generate an ITK affine transform from a matrix and a vector
   SmartPtr<AffineTransform> MakeTransform(const ITKMatrixType &matrix, const ITKVectorType &offset) const;
   SmartPtr<AffineTransform> MakeIdentityTransform() const;
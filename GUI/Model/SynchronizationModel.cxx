@@ -11,6 +11,10 @@
 #include "vtkCamera.h"
 #include "vtkCommand.h"
 #include "IPCHandler.h"
+#include "GlobalState.h"
+#include "ColorLabelTable.h"
+#include <cmath>
+#include <cstring>
 
 /** Structure passed on to IPC */
 struct IPCMessage
@@ -28,8 +32,17 @@ struct IPCMessage
   // 3D camera state
   CameraState camera;
 
+  // Current time point (zero-based)
+  unsigned int time_point;
+
+  // The active drawing label
+  LabelType active_label;
+
+  // The segmentation ROI, as the NIFTI coordinates of its corner voxels
+  Vector3d roi_corner[2];
+
   // Version of the data structure
-  enum VersionEnum { VERSION = 0x1005 };
+  enum VersionEnum { VERSION = 0x1007 };
 };
 
 
@@ -41,6 +54,7 @@ SynchronizationModel::SynchronizationModel()
   m_SyncZoomModel = NewSimpleConcreteProperty(true);
   m_SyncPanModel = NewSimpleConcreteProperty(true);
   m_SyncCameraModel = NewSimpleConcreteProperty(true);
+  m_SyncSegmentationModel = NewSimpleConcreteProperty(true);
 
   m_SyncChannelModel = NewRangedConcreteProperty(1, 1, 99, 1);
 
@@ -85,6 +99,7 @@ void SynchronizationModel::SetParentModel(GlobalUIModel *parent)
 
   // Cursor changes
   Rebroadcast(m_Parent->GetDriver(), CursorUpdateEvent(), ModelUpdateEvent());
+  Rebroadcast(m_Parent->GetDriver(), CursorTimePointUpdateEvent(), ModelUpdateEvent());
 
   // Viewpoint geometry changes
   for(int i = 0; i < 3; i++)
@@ -99,6 +114,11 @@ void SynchronizationModel::SetParentModel(GlobalUIModel *parent)
 
   // Changes to the loaded layers
   Rebroadcast(m_Parent->GetDriver(), LayerChangeEvent(), ModelUpdateEvent());
+
+  // Changes to the active label and to the segmentation ROI
+  GlobalState *gs = m_Parent->GetDriver()->GetGlobalState();
+  Rebroadcast(gs->GetDrawingColorLabelModel(), ValueChangedEvent(), ModelUpdateEvent());
+  Rebroadcast(gs->GetSegmentationROISettingsModel(), ValueChangedEvent(), ModelUpdateEvent());
 }
 
 
@@ -116,6 +136,10 @@ void SynchronizationModel::OnUpdate()
       m_EventBucket->HasEvent(CursorUpdateEvent())
       && m_SyncCursorModel->GetValue();
 
+  bool bc_time_point =
+      m_EventBucket->HasEvent(CursorTimePointUpdateEvent())
+      && m_SyncCursorModel->GetValue();
+
   bool bc_zoom =
       m_EventBucket->HasEvent(SliceModelGeometryChangeEvent())
       && m_SyncZoomModel->GetValue();
@@ -129,9 +153,28 @@ void SynchronizationModel::OnUpdate()
       m_EventBucket->HasEvent(Generic3DRenderer::CameraUpdateEvent())
       && m_SyncCameraModel->GetValue();
 
+  GlobalState *gs = app->GetGlobalState();
+  bool bc_label =
+      m_EventBucket->HasEvent(ValueChangedEvent(), gs->GetDrawingColorLabelModel())
+      && m_SyncSegmentationModel->GetValue();
+
+  bool bc_roi =
+      m_EventBucket->HasEvent(ValueChangedEvent(), gs->GetSegmentationROISettingsModel())
+      && m_SyncSegmentationModel->GetValue();
+
   // Read the contents of shared memory into the local message object
   IPCMessage message;
-  m_IPCHandler->Read(static_cast<void *>(&message));
+  if(!m_IPCHandler->Read(static_cast<void *>(&message)))
+    {
+    // If there is a message that we could not read, skip this update rather
+    // than broadcast garbage
+    if(m_IPCHandler->HasMessage())
+      return;
+
+    // Otherwise this is the first message, so broadcast the complete state
+    memset(&message, 0, sizeof(message));
+    bc_cursor = bc_time_point = bc_zoom = bc_pan = bc_camera = bc_label = bc_roi = true;
+    }
 
   // Cursor change
   if(bc_cursor)
@@ -157,6 +200,10 @@ void SynchronizationModel::OnUpdate()
       }
     }
 
+  // Time point change (also sent with the cursor, since the cursor is 4D)
+  if(bc_time_point || bc_cursor)
+    message.time_point = app->GetCursorTimePoint();
+
   // Zoom/Pan change
   for(int i = 0; i < 3; i++)
     {
@@ -177,6 +224,25 @@ void SynchronizationModel::OnUpdate()
     message.camera = cs;
     }
 
+  // Active label
+  if(bc_label)
+    message.active_label = gs->GetDrawingColorLabel();
+
+  // Segmentation ROI
+  if(bc_roi)
+    {
+    ImageWrapperBase *iw = app->GetCurrentImageData()->GetMain();
+    GlobalState::RegionType roi = gs->GetSegmentationROI();
+    Vector3d lower, upper;
+    for(unsigned int d = 0; d < 3; d++)
+      {
+      lower[d] = roi.GetIndex()[d];
+      upper[d] = roi.GetUpperIndex()[d];
+      }
+    message.roi_corner[0] = iw->TransformVoxelCIndexToNIFTICoordinates(lower);
+    message.roi_corner[1] = iw->TransformVoxelCIndexToNIFTICoordinates(upper);
+    }
+
   // Broadcast the new message
   m_IPCHandler->Broadcast(static_cast<void *>(&message));
 }
@@ -232,6 +298,11 @@ void SynchronizationModel::SetWarpLayerValue(unsigned long value)
 }
 
 
+bool SynchronizationModel::WaitForIPCMessage(int timeout_ms)
+{
+  return m_IPCHandler->WaitForMessage(timeout_ms);
+}
+
 void SynchronizationModel::ReadIPCState()
 {
   IRISApplication *app = m_Parent->GetDriver();
@@ -260,6 +331,13 @@ void SynchronizationModel::ReadIPCState()
         {
         app->SetCursorPosition(vpos);
         }
+
+      // Follow the time point of the sender if we have that many time points
+      if(message.time_point != app->GetCursorTimePoint()
+         && message.time_point < app->GetNumberOfTimePoints())
+        {
+        app->SetCursorTimePoint(message.time_point);
+        }
       }
 
     // Set the zoom/pan levels
@@ -291,6 +369,33 @@ void SynchronizationModel::ReadIPCState()
       CameraState cs = message.camera;
       m_Parent->GetModel3D()->GetRenderer()->SetCameraState(message.camera);
       }
+
+    if(m_SyncSegmentationModel->GetValue())
+      {
+      // Follow the active label if it is defined in our label table
+      GlobalState *gs = app->GetGlobalState();
+      if(message.active_label != gs->GetDrawingColorLabel()
+         && app->GetColorLabelTable()->IsColorLabelValid(message.active_label))
+        {
+        gs->SetDrawingColorLabel(message.active_label);
+        }
+
+      // Map the ROI corners into our image and crop to the image region
+      GenericImageData *id = app->GetCurrentImageData();
+      Vector3d c0 = id->GetMain()->TransformNIFTICoordinatesToVoxelCIndex(message.roi_corner[0]);
+      Vector3d c1 = id->GetMain()->TransformNIFTICoordinatesToVoxelCIndex(message.roi_corner[1]);
+      GlobalState::RegionType roi;
+      for(unsigned int d = 0; d < 3; d++)
+        {
+        long i0 = (long) std::floor(std::min(c0[d], c1[d]) + 0.5);
+        long i1 = (long) std::floor(std::max(c0[d], c1[d]) + 0.5);
+        roi.SetIndex(d, i0);
+        roi.SetSize(d, i1 - i0 + 1);
+        }
+
+      if(roi.Crop(id->GetImageRegion()) && roi != gs->GetSegmentationROI())
+        gs->SetSegmentationROI(roi);
+      }
     }
 }
 
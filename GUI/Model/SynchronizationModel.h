@@ -25,6 +25,7 @@ public:
   irisSimplePropertyAccessMacro(SyncZoom, bool)
   irisSimplePropertyAccessMacro(SyncPan, bool)
   irisSimplePropertyAccessMacro(SyncCamera, bool)
+  irisSimplePropertyAccessMacro(SyncSegmentation, bool)
 
   typedef SimpleItemSetDomain<unsigned long, std::string> LayerSelectionDomain;
   typedef AbstractPropertyModel<unsigned long, LayerSelectionDomain> AbstractLayerSelectionModel;
@@ -40,6 +41,13 @@ public:
   /** This method should be called by UI at regular intervals to read IPC state */
   void ReadIPCState();
 
+  /**
+   * Block until another ITK-SNAP session broadcasts a new state or the timeout
+   * expires. This method is safe to call from a listener thread, which should
+   * then ask the UI thread to call ReadIPCState()
+   */
+  bool WaitForIPCMessage(int timeout_ms);
+
 protected:
 
   SynchronizationModel();
@@ -52,6 +60,7 @@ protected:
   SmartPtr<ConcreteSimpleBooleanProperty> m_SyncZoomModel;
   SmartPtr<ConcreteSimpleBooleanProperty> m_SyncPanModel;
   SmartPtr<ConcreteSimpleBooleanProperty> m_SyncCameraModel;
+  SmartPtr<ConcreteSimpleBooleanProperty> m_SyncSegmentationModel;
 
   SmartPtr<ConcreteRangedIntProperty> m_SyncChannelModel;
 
@@ -1,13 +1,58 @@
 #include "QtIPCManager.h"
 #include "SNAPEvents.h"
 #include "SynchronizationModel.h"
+#include "IPCHandler.h"
 
 
+QtIPCListenerThread::QtIPCListenerThread(QObject *parent, SynchronizationModel *model)
+  : QThread(parent), m_Model(model), m_StopRequested(0), m_Pending(0)
+{
+}
+
+void QtIPCListenerThread::requestStop()
+{
+  m_StopRequested.storeRelease(1);
+}
+
+void QtIPCListenerThread::acknowledge()
+{
+  m_Pending.storeRelease(0);
+}
+
+void QtIPCListenerThread::run()
+{
+  while(!m_StopRequested.loadAcquire())
+    {
+    // Do not queue up notifications while the GUI thread is busy: the GUI
+    // reads the latest state anyway, so one pending notification is enough
+    if(m_Pending.loadAcquire())
+      {
+      QThread::msleep(1);
+      continue;
+      }
+
+    if(m_Model->WaitForIPCMessage(200))
+      {
+      m_Pending.storeRelease(1);
+      emit messageAvailable();
+      }
+    }
+}
+
 QtIPCManager::QtIPCManager(QWidget *parent) :
   SNAPComponent(parent)
 {
-  // Start the IPC timer at 30ms intervals
-  startTimer(30);
+  m_Model = nullptr;
+  m_Listener = nullptr;
+}
+
+QtIPCManager::~QtIPCManager()
+{
+  if(m_Listener)
+    {
+    m_Listener->requestStop();
+    m_Listener->wait();
+    }
 }
 
 void QtIPCManager::SetModel(SynchronizationModel *model)
@@ -16,6 +61,20 @@ void QtIPCManager::SetModel(SynchronizationModel *model)
 
   // Listen to update events from the model
   connectITK(m_Model, ModelUpdateEvent());
+
+  if(IPCHandler::IsNotificationSupported())
+    {
+    // Wait for messages from other sessions on a listener thread
+    m_Listener = new QtIPCListenerThread(this, m_Model);
+    connect(m_Listener, SIGNAL(messageAvailable()), this,
+            SLOT(onMessageAvailable()), Qt::QueuedConnection);
+    m_Listener->start(QThread::LowPriority);
+    }
+  else
+    {
+    // Start the IPC timer at 30ms intervals
+    startTimer(30);
+    }
 }
 
 void QtIPCManager::onModelUpdate(const EventBucket &bucket)
@@ -24,10 +83,16 @@ void QtIPCManager::onModelUpdate(const EventBucket &bucket)
   m_Model->Update();
 }
 
+void QtIPCManager::onMessageAvailable()
+{
+  if(m_Listener)
+    m_Listener->acknowledge();
+  if(m_Model)
+    m_Model->ReadIPCState();
+}
+
 void QtIPCManager::timerEvent(QTimerEvent *)
 {
   if(!m_Model) return;
   m_Model->ReadIPCState();
 }
-
-
@@ -2,13 +2,46 @@
 #define QTIPCMANAGER_H
 
 #include <QObject>
+#include <QThread>
+#include <QAtomicInt>
 #include <SNAPComponent.h>
 
 class SynchronizationModel;
 
+/**
+ * @brief A thread that sleeps until another SNAP session broadcasts an IPC
+ * message and then notifies the GUI thread. This replaces polling the shared
+ * memory on a timer on platforms where IPC notification is available.
+ */
+class QtIPCListenerThread : public QThread
+{
+  Q_OBJECT
+
+public:
+  QtIPCListenerThread(QObject *parent, SynchronizationModel *model);
+
+  /** Ask the thread to finish (it exits within one wait interval) */
+  void requestStop();
+
+  /** Called by the GUI thread once it has handled a notification */
+  void acknowledge();
+
+signals:
+
+  /** Emitted (across threads) when a new IPC message is available */
+  void messageAvailable();
+
+protected:
+  virtual void run();
+
+  SynchronizationModel *m_Model;
+  QAtomicInt m_StopRequested, m_Pending;
+};
+
 /**
  * @brief This class manages IPC communications between SNAP sessions on the
- * GUI level. It uses Qt's timers to schedule checks for IPC updates, and it
+ * GUI level. It uses a listener thread (or Qt's timers, when notification is
+ * not supported by the platform) to schedule checks for IPC updates, and it
  * listens to the events from the model layer in order to send IPC messages
  * out.
  */
@@ -17,6 +50,7 @@ class QtIPCManager : public SNAPComponent
   Q_OBJECT
 public:
   explicit QtIPCManager(QWidget *parent = 0);
+  virtual ~QtIPCManager();
 
   void SetModel(SynchronizationModel *model);
   
@@ -26,6 +60,8 @@ public slots:
 
   virtual void onModelUpdate(const EventBucket &bucket);
 
+  void onMessageAvailable();
+
 protected:
 
   virtual void timerEvent(QTimerEvent *);
@@ -33,6 +69,8 @@ protected:
 private:
 
   SynchronizationModel *m_Model;
+
+  QtIPCListenerThread *m_Listener;
 };
 
 #endif // QTIPCMANAGER_H
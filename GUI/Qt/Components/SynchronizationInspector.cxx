@@ -30,6 +30,7 @@ void SynchronizationInspector::SetModel(SynchronizationModel *model)
   makeCoupling(ui->chkZoom, model->GetSyncZoomModel());
   makeCoupling(ui->chkPan, model->GetSyncPanModel());
   makeCoupling(ui->chkCamera, model->GetSyncCameraModel());
+  makeCoupling(ui->chkSegmentation, model->GetSyncSegmentationModel());
 
   // Hook up a warp model
   makeCoupling(ui->inWarpLayer, m_Model->GetWarpLayerModel());
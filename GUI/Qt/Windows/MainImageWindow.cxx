@@ -339,6 +339,13 @@ MainImageWindow::MainImageWindow(QWidget *parent) :
   // Start the timer (it doesn't cost much...)
   m_AnimateTimer->start();
 
+  // Set up the autosave timer. The interval is read from the preferences
+  // each time the timer fires
+  m_AutosaveTimer = new QTimer(this);
+  m_AutosaveTimer->setInterval(60000);
+  connect(m_AutosaveTimer, SIGNAL(timeout()), SLOT(onAutosaveTimeout()));
+  m_AutosaveTimer->start();
+
   // Set up the 4D replay timer
   m_4DReplayTimer = new QTimer(this);
   m_4DReplayTimer->setInterval(m_Crnt4DReplayInteval);
@@ -1622,6 +1629,25 @@ void MainImageWindow::on4DReplayTimeout()
     }
 }
 
+void MainImageWindow::onAutosaveTimeout()
+{
+  if(m_Model)
+    {
+    IRISApplication *driver = m_Model->GetDriver();
+    try
+      {
+      driver->UpdateAutosaveJournal();
+      }
+    catch(std::exception &exc)
+      {
+      std::cerr << "Autosave failed: " << exc.what() << std::endl;
+      }
+
+    DefaultBehaviorSettings *dbs = m_Model->GetGlobalState()->GetDefaultBehaviorSettings();
+    m_AutosaveTimer->setInterval(1000 * dbs->GetAutosaveInterval());
+    }
+}
+
 void MainImageWindow::LoadRecentProjectActionTriggered()
 {
   // Check for unsaved changes before loading new data
@@ -264,6 +264,8 @@ private slots:
 
   void on4DReplayTimeout();
 
+  void onAutosaveTimeout();
+
   void on_actionExportAxial_triggered();
 
   void on_actionExportCoronal_triggered();
@@ -457,6 +459,9 @@ private:
 
   // A timer used to animate components
   QTimer *m_AnimateTimer;
+
+  // A timer used to update the autosave journal
+  QTimer *m_AutosaveTimer;
 };
 
 
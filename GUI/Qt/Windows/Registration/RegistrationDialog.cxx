@@ -123,6 +123,13 @@ void RegistrationDialog::on_pushButton_2_clicked()
 
 void RegistrationDialog::on_btnRunRegistration_clicked()
 {
+  // While registration is running, the button cancels it
+  if(m_Model->IsAutoRegistrationRunning())
+    {
+    m_Model->CancelAutoRegistration();
+    return;
+    }
+
   // Create the render panels based on the number of iterations
   int coarsest = m_Model->GetCoarsestResolutionLevel();
   int finest = m_Model->GetFinestResolutionLevel();
@@ -173,7 +180,21 @@ void RegistrationDialog::on_btnRunRegistration_clicked()
 
   ui->scrollPlots->setVisible(true);
 
-  m_Model->RunAutoRegistration();
+  // Events are processed during registration, so the button can be used to cancel
+  QString runText = ui->btnRunRegistration->text();
+  ui->btnRunRegistration->setText("Cancel");
+
+  try
+    {
+    m_Model->RunAutoRegistration();
+    }
+  catch(...)
+    {
+    ui->btnRunRegistration->setText(runText);
+    throw;
+    }
+
+  ui->btnRunRegistration->setText(runText);
 }
 
 int RegistrationDialog::GetTransformFormat(QString &format)
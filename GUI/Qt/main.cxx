@@ -13,6 +13,7 @@
 #include "QtCursorOverride.h"
 #include "SNAPQtCommon.h"
 #include "SNAPTestQt.h"
+#include "SNAPTrace.h"
 
 #include "GenericSliceView.h"
 #include "GenericSliceModel.h"
@@ -159,6 +160,9 @@ void usage(const char *progname)
 #ifdef SNAP_DEBUG_EVENTS
   cout << "   --debug-events       : Dump information regarding UI events" << endl;
 #endif // SNAP_DEBUG_EVENTS
+  cout << "   --trace FILE         : Record timing of internal operations, written to FILE on exit" << endl;
+  cout << "                        :   and when Ctrl+Alt+T is pressed in the main window" << endl;
+  cout << "                        :   (Chrome trace format, view in chrome://tracing or Perfetto)" << endl;
   cout << "   --test list          : List available tests. " << endl;
   cout << "   --test TESTID        : Execute a test. " << endl;
   cout << "   --testdir DIR        : Set the root directory for tests. " << endl;
@@ -192,6 +196,9 @@ public:
   double xZoomFactor;
   bool flagDebugEvents;
 
+  // File to which trace events are written on exit
+  std::string fnTrace;
+
   // Whether the console-based application should not fork
   bool flagNoFork;
 
@@ -331,6 +338,8 @@ int parse(int argc, char *argv[], CommandLineRequest &argdata)
 
   parser.AddOption("--debug-events", 0);
 
+  parser.AddOption("--trace", 1);
+
   parser.AddOption("--no-fork", 0);
   parser.AddOption("--console", 0);
 
@@ -398,6 +407,10 @@ int parse(int argc, char *argv[], CommandLineRequest &argdata)
 #endif
     }
 
+  // Tracing of hot paths
+  if(parseResult.IsOptionPresent("--trace"))
+    argdata.fnTrace = DecodeFilename(parseResult.GetOptionParameter("--trace"));
+
   // Initial directory
   if(parseResult.IsOptionPresent("--cwd"))
     argdata.cwd = parseResult.GetOptionParameter("--cwd");
@@ -678,6 +691,10 @@ int main(int argc, char *argv[])
   flag_snap_debug_events = argdata.flagDebugEvents;
 #endif
 
+  // Start recording trace events if requested
+  if(argdata.fnTrace.size())
+    SNAPTrace::SetEnabled(true);
+
   // Setup crash signal handlers
   SetupSignalHandlers();
 
@@ -1012,6 +1029,25 @@ int main(int argc, char *argv[])
     if (!argdata.xTestId.size())
       mainwin->RemindLayoutPreference();
 
+    // When tracing, the events recorded so far can be written at any time,
+    // e.g., before reproducing a problem that ends in a crash or a hang
+    if(argdata.fnTrace.size())
+      {
+      QAction *actTrace = new QAction("Write Trace Events", mainwin);
+      actTrace->setShortcut(QKeySequence("Ctrl+Alt+T"));
+      actTrace->setShortcutContext(Qt::ApplicationShortcut);
+      mainwin->addAction(actTrace);
+
+      std::string fnTrace = argdata.fnTrace;
+      QObject::connect(actTrace, &QAction::triggered, [fnTrace]()
+        {
+        if(SNAPTrace::WriteChromeTrace(fnTrace))
+          std::cout << "Trace events written to " << fnTrace << std::endl;
+        else
+          std::cerr << "Failed to write trace file " << fnTrace << std::endl;
+        });
+      }
+
     // Assign the main window to the application. We do this right before
     // starting the event loop.
     app.setMainWindow(mainwin);
@@ -1050,6 +1086,14 @@ int main(int argc, char *argv[])
     // Run application
     int rc = app.exec();
 
+    // Write the trace events
+    if(argdata.fnTrace.size())
+      {
+      SNAPTrace::SetEnabled(false);
+      if(!SNAPTrace::WriteChromeTrace(argdata.fnTrace))
+        std::cerr << "Failed to write trace file " << argdata.fnTrace << std::endl;
+      }
+
     // If everything cool, save the preferences
     if(!rc)
       gui->SaveUserPreferences();
@@ -29,6 +29,7 @@
 #include "GenericSliceModel.h"
 #include "GlobalUIModel.h"
 #include "SNAPAppearanceSettings.h"
+#include "SNAPTrace.h"
 #include "GenericImageData.h"
 #include "ImageWrapper.h"
 #include "IRISApplication.h"
@@ -303,6 +304,8 @@ void GenericSliceRenderer::UpdateSceneAppearanceSettings()
 
 void GenericSliceRenderer::OnUpdate()
 {
+  SNAP_TRACE_SCOPE("render", "GenericSliceRenderer::OnUpdate");
+
   // Make sure the model has been updated first
   m_Model->Update();
 
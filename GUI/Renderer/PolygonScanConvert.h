@@ -41,6 +41,9 @@
 #include <vtkPoints.h>
 #include <vtkSmartPointer.h>
 #include <vtkContourTriangulator.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 template<class TImage, class TVertex, class TVertexIterator>
 class PolygonScanConvert
@@ -91,6 +94,68 @@ public:
         it.Set(0);
       }
   }
+
+  /**
+   * Scan convert the polygon into spans of pixels whose centers are inside
+   * the polygon, without visiting the pixels outside of it. The spans run
+   * along the given axis of a slice with the given size: each span covers the
+   * pixels x0 <= i < x1 along the axis, at position y along the other axis.
+   * Points are inside the polygon by the even-odd rule, as in
+   * vtkPolygon::PointInPolygon, so self-intersecting polygons are filled as
+   * by RasterizeFilled(). The spans are appended to the list, with z set to
+   * zero.
+   */
+  template <class TSpanList>
+  static void RasterizeFilledSpans(TVertexIterator first, unsigned int n,
+                                   const unsigned int size[2], unsigned int axis,
+                                   TSpanList &spans)
+  {
+    typedef typename TSpanList::value_type SpanType;
+    if(n < 3)
+      return;
+
+    // Coordinates of the vertices along and across the scan axis
+    std::vector<double> u(n), w(n);
+    for (unsigned int i = 0; i < n; ++i, ++first)
+      {
+      u[i] = (*first)[axis];
+      w[i] = (*first)[1 - axis];
+      }
+
+    // The range of scan lines whose centers may be inside the polygon
+    double w_min = *std::min_element(w.begin(), w.end());
+    double w_max = *std::max_element(w.begin(), w.end());
+    long j0 = std::max(0l, (long) std::ceil(w_min - 0.5));
+    long j1 = std::min((long) size[1 - axis] - 1, (long) std::floor(w_max - 0.5));
+    long nu = size[axis];
+
+    // Crossings of the edges with the current scan line
+    std::vector<double> xings;
+    for(long j = j0; j <= j1; j++)
+      {
+      double wc = j + 0.5;
+      xings.clear();
+      for(unsigned int a = 0, b = n - 1; a < n; b = a++)
+        {
+        if((w[a] <= wc) != (w[b] <= wc))
+          {
+          double t = (wc - w[a]) / (w[b] - w[a]);
+          xings.push_back(u[a] + t * (u[b] - u[a]));
+          }
+        }
+      std::sort(xings.begin(), xings.end());
+
+      // Each crossing toggles between outside and inside, so the pixels
+      // between the crossings 2k and 2k+1 are filled
+      for(size_t k = 0; k + 1 < xings.size(); k += 2)
+        {
+        long i0 = std::max(0l, (long) std::ceil(xings[k] - 0.5));
+        long i1 = std::min(nu, (long) std::ceil(xings[k+1] - 0.5));
+        if(i0 < i1)
+          spans.push_back(SpanType(i0, i1, j, 0));
+        }
+      }
+  }
 };
 
 
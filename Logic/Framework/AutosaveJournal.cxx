@@ -0,0 +1,490 @@
+#include "AutosaveJournal.h"
+#include "GenericImageData.h"
+#include "LayerIterator.h"
+#include "IRISException.h"
+#include "itk_zlib.h"
+#include <itksys/SystemTools.hxx>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#if defined(WIN32)
+  #ifndef NOMINMAX
+  #define NOMINMAX
+  #endif
+  #include <windows.h>
+#elif defined(__APPLE__)
+  #include <pthread.h>
+#elif defined(__linux__)
+  #include <sys/resource.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+using itksys::SystemTools;
+
+// The journal file starts with a signature and a version number
+static const char JOURNAL_SIGNATURE[8] = { 'S', 'N', 'A', 'P', 'J', 'R', 'N', 'L' };
+static const uint32_t JOURNAL_VERSION = 2;
+
+// Each record consists of this header, followed by the filename of the layer
+// and the zlib-compressed line data. The checksum covers both. The time and
+// size of the segmentation file identify the version of the file that the
+// lines apply to.
+struct JournalRecordHeader
+{
+  char Magic[4];
+  uint32_t Type;
+  uint32_t NameLength;
+  uint32_t Dimensions[4];
+  uint32_t TimePoint;
+  uint32_t LineIndex[2];
+  uint32_t LineSize[2];
+  uint64_t RawSize;
+  uint64_t PackedSize;
+  int64_t FileTime;
+  uint64_t FileSize;
+  uint32_t Checksum;
+};
+
+static const char JOURNAL_RECORD_MAGIC[4] = { 'J', 'R', 'E', 'C' };
+
+typedef LabelImageWrapper::ImageType::RLSegment RLSegment;
+
+
+AutosaveJournal::AutosaveJournal()
+{
+  m_StopWorker = false;
+}
+
+AutosaveJournal::~AutosaveJournal()
+{
+  if(this->IsOpen())
+    this->Close(false);
+}
+
+std::string AutosaveJournal::GetJournalFileName(const std::string &project_file)
+{
+  return project_file + ".journal";
+}
+
+void AutosaveJournal::Open(const std::string &filename)
+{
+  if(this->IsOpen())
+    {
+    if(m_FileName == filename)
+      return;
+    this->Close(true);
+    }
+
+  m_FileName = filename;
+  m_Layers.clear();
+  m_StopWorker = false;
+  m_Worker = std::thread(&AutosaveJournal::WorkerThread, this);
+}
+
+void AutosaveJournal::Close(bool remove)
+{
+  if(!this->IsOpen())
+    return;
+
+    {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    // Records that will be deleted anyway need not be written
+    if(remove)
+      {
+      for(Record *rec : m_Queue)
+        delete rec;
+      m_Queue.clear();
+      }
+
+    m_StopWorker = true;
+    m_Condition.notify_all();
+    }
+
+  m_Worker.join();
+
+  if(remove)
+    SystemTools::RemoveFile(m_FileName);
+
+  m_FileName.clear();
+  m_Layers.clear();
+}
+
+void AutosaveJournal::Clear()
+{
+  if(!this->IsOpen())
+    return;
+
+  for(auto &it : m_Layers)
+    it.second.HasRecords = false;
+
+  Record *rec = new Record();
+  rec->Type = RECORD_TRUNCATE;
+  this->Enqueue(rec);
+}
+
+void AutosaveJournal::Enqueue(Record *rec)
+{
+  std::lock_guard<std::mutex> guard(m_Mutex);
+  m_Queue.push_back(rec);
+  m_Condition.notify_all();
+}
+
+void AutosaveJournal::Update(GenericImageData *data)
+{
+  if(!this->IsOpen())
+    return;
+
+  for(LayerIterator it = data->GetLayers(LABEL_ROLE); !it.IsAtEnd(); ++it)
+    {
+    LabelImageWrapper *seg = dynamic_cast<LabelImageWrapper *>(it.GetLayer());
+    if(!seg)
+      continue;
+
+    std::string fn = seg->GetFileName() ? seg->GetFileName() : "";
+    if(fn.size())
+      fn = SystemTools::CollapseFullPath(fn);
+    long ftime = fn.size() ? SystemTools::ModifiedTime(fn) : 0;
+    unsigned long long fsize = fn.size() ? SystemTools::FileLength(fn) : 0;
+    bool unsaved = seg->HasUnsavedChanges();
+
+    // A layer seen for the first time may have changes that are already
+    // in the journal (e.g., after a replay)
+    auto lit = m_Layers.find(seg->GetUniqueId());
+    if(lit == m_Layers.end())
+      {
+      LayerState ls_new = { fn, ftime, fsize, unsaved };
+      lit = m_Layers.insert(std::make_pair(seg->GetUniqueId(), ls_new)).first;
+      }
+    LayerState &ls = lit->second;
+
+    // If the layer has been saved since the last update, the earlier records
+    // must not be applied on top of the saved file
+    bool saved = (fn != ls.FileName || ftime != ls.FileTime
+                  || fsize != ls.FileSize || !unsaved);
+    if(saved && ls.HasRecords)
+      {
+      Record *rec = new Record();
+      rec->Type = RECORD_RESET;
+      rec->LayerFile = ls.FileName;
+      this->Enqueue(rec);
+      ls.HasRecords = false;
+      }
+    ls.FileName = fn;
+    ls.FileTime = ftime;
+    ls.FileSize = fsize;
+
+    // Snapshot the modified lines of each time point. Layers that have never
+    // been saved can not be matched to a file when replaying.
+    LineRegionType all_lines = LabelImageWrapper::ImageType::truncateRegion(
+          seg->GetImage()->GetLargestPossibleRegion());
+    for(unsigned int tp = 0; tp < seg->GetNumberOfTimePoints(); tp++)
+      {
+      LabelImageWrapper::RegionType region;
+      bool complete = seg->PopModifiedRegion(tp, region);
+      if(fn.empty() || !unsaved || (complete && region.GetNumberOfPixels() == 0))
+        continue;
+
+      LineRegionType lines = all_lines;
+      if(complete)
+        {
+        LineRegionType changed = LabelImageWrapper::ImageType::truncateRegion(region);
+        if(!changed.Crop(all_lines))
+          continue;
+        lines = changed;
+        }
+
+      Record *rec = new Record();
+      rec->Type = RECORD_LINES;
+      rec->LayerFile = fn;
+      rec->FileTime = ftime;
+      rec->FileSize = fsize;
+      for(unsigned int d = 0; d < 3; d++)
+        rec->Dimensions[d] = seg->GetSize()[d];
+      rec->Dimensions[3] = seg->GetNumberOfTimePoints();
+      rec->TimePoint = tp;
+      rec->Lines = lines;
+      seg->CopyRLELines(tp, lines, rec->Data);
+      this->Enqueue(rec);
+      ls.HasRecords = true;
+      }
+    }
+}
+
+void AutosaveJournal::SerializeLines(const Record *rec, std::vector<char> &out)
+{
+  size_t n_bytes = 0;
+  for(const RLLine &line : rec->Data)
+    n_bytes += sizeof(uint32_t) + line.size() * (sizeof(RLSegment::first_type) + sizeof(LabelType));
+
+  out.resize(n_bytes);
+  char *p = out.data();
+  for(const RLLine &line : rec->Data)
+    {
+    uint32_t n_runs = line.size();
+    memcpy(p, &n_runs, sizeof(n_runs)); p += sizeof(n_runs);
+    for(const RLSegment &seg : line)
+      {
+      memcpy(p, &seg.first, sizeof(seg.first)); p += sizeof(seg.first);
+      memcpy(p, &seg.second, sizeof(seg.second)); p += sizeof(seg.second);
+      }
+    }
+}
+
+void AutosaveJournal::WriteRecord(FILE *f, const Record *rec)
+{
+  JournalRecordHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.Magic, JOURNAL_RECORD_MAGIC, 4);
+  hdr.Type = rec->Type;
+  hdr.NameLength = rec->LayerFile.size();
+
+  std::vector<char> raw, packed;
+  if(rec->Type == RECORD_LINES)
+    {
+    for(unsigned int d = 0; d < 4; d++)
+      hdr.Dimensions[d] = rec->Dimensions[d];
+    hdr.TimePoint = rec->TimePoint;
+    hdr.FileTime = rec->FileTime;
+    hdr.FileSize = rec->FileSize;
+    for(unsigned int d = 0; d < 2; d++)
+      {
+      hdr.LineIndex[d] = rec->Lines.GetIndex(d);
+      hdr.LineSize[d] = rec->Lines.GetSize(d);
+      }
+
+    // Favor speed over size, the journal is short-lived
+    SerializeLines(rec, raw);
+    uLongf n_packed = compressBound(raw.size());
+    packed.resize(n_packed);
+    if(compress2((Bytef *) packed.data(), &n_packed,
+                 (const Bytef *) raw.data(), raw.size(), Z_BEST_SPEED) != Z_OK)
+      return;
+    packed.resize(n_packed);
+    hdr.RawSize = raw.size();
+    hdr.PackedSize = packed.size();
+    }
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, (const Bytef *) rec->LayerFile.data(), rec->LayerFile.size());
+  crc = crc32(crc, (const Bytef *) packed.data(), packed.size());
+  hdr.Checksum = (uint32_t) crc;
+
+  fwrite(&hdr, sizeof(hdr), 1, f);
+  fwrite(rec->LayerFile.data(), 1, rec->LayerFile.size(), f);
+  fwrite(packed.data(), 1, packed.size(), f);
+  fflush(f);
+}
+
+void AutosaveJournal::WorkerThread()
+{
+  // Writing the journal should not compete with the user interface
+#if defined(WIN32)
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__APPLE__)
+  pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#elif defined(__linux__)
+  setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), 10);
+#endif
+
+  // Append to an existing journal, or start a new one
+  FILE *f = fopen(m_FileName.c_str(), "ab");
+  if(f && ftell(f) == 0)
+    {
+    fwrite(JOURNAL_SIGNATURE, 1, sizeof(JOURNAL_SIGNATURE), f);
+    fwrite(&JOURNAL_VERSION, sizeof(JOURNAL_VERSION), 1, f);
+    fflush(f);
+    }
+
+  while(true)
+    {
+    Record *rec;
+      {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_Condition.wait(lock, [this]() { return m_StopWorker || m_Queue.size(); });
+      if(m_Queue.empty())
+        break;
+      rec = m_Queue.front();
+      m_Queue.pop_front();
+      }
+
+    if(rec->Type == RECORD_TRUNCATE)
+      {
+      if(f)
+        fclose(f);
+      f = fopen(m_FileName.c_str(), "wb");
+      if(f)
+        {
+        fwrite(JOURNAL_SIGNATURE, 1, sizeof(JOURNAL_SIGNATURE), f);
+        fwrite(&JOURNAL_VERSION, sizeof(JOURNAL_VERSION), 1, f);
+        fflush(f);
+        }
+      }
+    else if(f)
+      {
+      this->WriteRecord(f, rec);
+      }
+
+    delete rec;
+    }
+
+  if(f)
+    fclose(f);
+}
+
+unsigned int AutosaveJournal::Replay(const std::string &filename, GenericImageData *data)
+{
+  FILE *f = fopen(filename.c_str(), "rb");
+  if(!f)
+    return 0;
+
+  char signature[sizeof(JOURNAL_SIGNATURE)];
+  uint32_t version = 0;
+  if(fread(signature, 1, sizeof(signature), f) != sizeof(signature)
+     || fread(&version, sizeof(version), 1, f) != 1
+     || memcmp(signature, JOURNAL_SIGNATURE, sizeof(signature)) != 0
+     || version != JOURNAL_VERSION)
+    {
+    fclose(f);
+    throw IRISException("File %s is not a valid ITK-SNAP journal", filename.c_str());
+    }
+
+  // Read the records, stopping at the first incomplete one. Only the records
+  // after the last reset of each layer are kept.
+  struct PendingRecord
+  {
+    JournalRecordHeader Header;
+    std::vector<char> Packed;
+  };
+  std::map<std::string, std::vector<PendingRecord> > pending;
+
+  PendingRecord pr;
+  while(fread(&pr.Header, sizeof(pr.Header), 1, f) == 1)
+    {
+    const JournalRecordHeader &hdr = pr.Header;
+    if(memcmp(hdr.Magic, JOURNAL_RECORD_MAGIC, 4) != 0)
+      break;
+
+    std::string name(hdr.NameLength, '\0');
+    pr.Packed.resize(hdr.PackedSize);
+    if(fread(&name[0], 1, hdr.NameLength, f) != hdr.NameLength
+       || fread(pr.Packed.data(), 1, hdr.PackedSize, f) != hdr.PackedSize)
+      break;
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef *) name.data(), name.size());
+    crc = crc32(crc, (const Bytef *) pr.Packed.data(), pr.Packed.size());
+    if((uint32_t) crc != hdr.Checksum)
+      break;
+
+    if(hdr.Type == RECORD_RESET)
+      pending[name].clear();
+    else if(hdr.Type == RECORD_LINES)
+      pending[name].push_back(pr);
+    }
+  fclose(f);
+
+  // Apply the records to the matching layers
+  unsigned int n_updated = 0;
+  for(LayerIterator it = data->GetLayers(LABEL_ROLE); !it.IsAtEnd(); ++it)
+    {
+    LabelImageWrapper *seg = dynamic_cast<LabelImageWrapper *>(it.GetLayer());
+    if(!seg || !seg->GetFileName() || !strlen(seg->GetFileName()))
+      continue;
+
+    auto pit = pending.find(SystemTools::CollapseFullPath(seg->GetFileName()));
+    if(pit == pending.end() || pit->second.empty())
+      continue;
+
+    LineRegionType all_lines = LabelImageWrapper::ImageType::truncateRegion(
+          seg->GetImage()->GetLargestPossibleRegion());
+    unsigned int nx = seg->GetSize()[0];
+
+    // The records only apply to the version of the file they were made for.
+    // If the file has been written since (e.g., by another program), they
+    // would be applied on top of the wrong data.
+    std::string fn = pit->first;
+    int64_t ftime = SystemTools::ModifiedTime(fn);
+    uint64_t fsize = SystemTools::FileLength(fn);
+
+    bool updated = false;
+    for(const PendingRecord &rec : pit->second)
+      {
+      const JournalRecordHeader &hdr = rec.Header;
+
+      // The records must match the file and the layer
+      if(hdr.FileTime != ftime || hdr.FileSize != fsize)
+        continue;
+
+      if(hdr.Dimensions[0] != nx
+         || hdr.Dimensions[1] != seg->GetSize()[1]
+         || hdr.Dimensions[2] != seg->GetSize()[2]
+         || hdr.Dimensions[3] != seg->GetNumberOfTimePoints()
+         || hdr.TimePoint >= seg->GetNumberOfTimePoints())
+        continue;
+
+      LineRegionType lines;
+      for(unsigned int d = 0; d < 2; d++)
+        {
+        lines.SetIndex(d, hdr.LineIndex[d]);
+        lines.SetSize(d, hdr.LineSize[d]);
+        }
+      if(!all_lines.IsInside(lines))
+        continue;
+
+      std::vector<char> raw(hdr.RawSize);
+      uLongf n_raw = raw.size();
+      if(uncompress((Bytef *) raw.data(), &n_raw,
+                    (const Bytef *) rec.Packed.data(), rec.Packed.size()) != Z_OK
+         || n_raw != raw.size())
+        continue;
+
+      // Decode the lines, checking that each line has the right length
+      std::vector<RLLine> line_data(lines.GetNumberOfPixels());
+      const char *p = raw.data(), *p_end = raw.data() + raw.size();
+      bool valid = true;
+      for(RLLine &line : line_data)
+        {
+        uint32_t n_runs;
+        if((size_t) (p_end - p) < sizeof(n_runs))
+          { valid = false; break; }
+        memcpy(&n_runs, p, sizeof(n_runs)); p += sizeof(n_runs);
+
+        size_t run_bytes = sizeof(RLSegment::first_type) + sizeof(LabelType);
+        if((size_t) (p_end - p) < n_runs * run_bytes)
+          { valid = false; break; }
+
+        line.resize(n_runs);
+        size_t length = 0;
+        for(RLSegment &run : line)
+          {
+          memcpy(&run.first, p, sizeof(run.first)); p += sizeof(run.first);
+          memcpy(&run.second, p, sizeof(run.second)); p += sizeof(run.second);
+          length += run.first;
+          }
+
+        if(length != nx)
+          { valid = false; break; }
+        }
+
+      if(valid && p == p_end)
+        {
+        seg->ReplaceRLELines(hdr.TimePoint, lines, line_data);
+        updated = true;
+        }
+      }
+
+    if(updated)
+      {
+      // The replayed changes are already in the journal
+      LabelImageWrapper::RegionType dummy;
+      for(unsigned int tp = 0; tp < seg->GetNumberOfTimePoints(); tp++)
+        seg->PopModifiedRegion(tp, dummy);
+      n_updated++;
+      }
+    }
+
+  return n_updated;
+}
@@ -0,0 +1,132 @@
+#ifndef AUTOSAVEJOURNAL_H
+#define AUTOSAVEJOURNAL_H
+
+#include "SNAPCommon.h"
+#include "LabelImageWrapper.h"
+#include <itkObject.h>
+#include <itkObjectFactory.h>
+#include <string>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class GenericImageData;
+
+/**
+ * A crash-recovery journal for the segmentation layers of a project. The
+ * journal is a file next to the project file to which the run-length encoded
+ * lines of the segmentation that have changed are appended periodically.
+ *
+ * Update() is called on the main thread. It uses the modification tracking in
+ * LabelImageWrapper to find out which lines of which time points have changed
+ * since the last update, and copies just these lines. Compressing them and
+ * writing them to disk happens on a low-priority background thread, so that
+ * the cost to the interactive thread is proportional to the size of the edits
+ * rather than to the size of the segmentation.
+ *
+ * The records contain complete lines, not differences, keyed by the file name
+ * of the segmentation layer. When a layer is saved, a reset record is written
+ * so that the older records for that layer are ignored. Replay() applies the
+ * records that follow the last reset for each layer to the matching layers of
+ * a freshly opened project. Records truncated by a crash are ignored, and so
+ * are records made for a different version of the segmentation file, as
+ * identified by its modification time and size.
+ */
+class AutosaveJournal : public itk::Object
+{
+public:
+
+  irisITKObjectMacro(AutosaveJournal, itk::Object)
+
+  typedef LabelImageWrapper::RLLine RLLine;
+  typedef LabelImageWrapper::LineRegionType LineRegionType;
+
+  /**
+   * Start journaling to a file. If the file exists, new records are appended
+   * to it. If the journal is already open with another file, it is closed and
+   * the old file is removed.
+   */
+  void Open(const std::string &filename);
+
+  /** Whether the journal is open */
+  bool IsOpen() const { return m_FileName.size() > 0; }
+
+  /** The file to which the journal is written */
+  irisGetMacro(FileName, const std::string &)
+
+  /**
+   * Record the changes to the segmentation layers in the image data since the
+   * previous call. Only layers that have been saved to a file are journaled.
+   */
+  void Update(GenericImageData *data);
+
+  /** Discard all records, e.g., after all the layers have been saved */
+  void Clear();
+
+  /**
+   * Stop journaling. Waits for the pending records to be written and, if
+   * remove is true, deletes the journal file.
+   */
+  void Close(bool remove);
+
+  /**
+   * Apply the records in a journal file to the segmentation layers of the
+   * image data. Returns the number of layers that were updated.
+   */
+  static unsigned int Replay(const std::string &filename, GenericImageData *data);
+
+  /** Default file name of the journal for a project file */
+  static std::string GetJournalFileName(const std::string &project_file);
+
+protected:
+
+  AutosaveJournal();
+  virtual ~AutosaveJournal();
+
+  enum RecordType { RECORD_LINES = 0, RECORD_RESET, RECORD_TRUNCATE };
+
+  // A snapshot of some lines of one time point of a segmentation layer
+  struct Record
+  {
+    RecordType Type;
+    std::string LayerFile;
+    unsigned int Dimensions[4];
+    unsigned int TimePoint;
+    long FileTime;
+    unsigned long long FileSize;
+    LineRegionType Lines;
+    std::vector<RLLine> Data;
+  };
+
+  // What we know about each journaled layer, keyed by unique id
+  struct LayerState
+  {
+    std::string FileName;
+    long FileTime;
+    unsigned long long FileSize;
+    bool HasRecords;
+  };
+
+  void Enqueue(Record *rec);
+
+  void WorkerThread();
+
+  void WriteRecord(FILE *f, const Record *rec);
+
+  static void SerializeLines(const Record *rec, std::vector<char> &out);
+
+  std::string m_FileName;
+
+  std::map<unsigned long, LayerState> m_Layers;
+
+  // Queue of records for the writer thread, guarded by the mutex
+  std::thread m_Worker;
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::deque<Record *> m_Queue;
+  bool m_StopWorker;
+};
+
+#endif // AUTOSAVEJOURNAL_H
@@ -14,6 +14,13 @@ DefaultBehaviorSettings::DefaultBehaviorSettings()
 
   m_AutoContrastModel = NewSimpleProperty("AutoContrast", false);
 
+  // Keep computed meshes on disk so reopening a workspace does not recompute them
+  m_PersistentMeshCacheModel = NewSimpleProperty("PersistentMeshCache", false);
+
+  // Journal segmentation edits in the background so they survive a crash
+  m_AutosaveModel = NewSimpleProperty("Autosave", false);
+  m_AutosaveIntervalModel = NewRangedProperty("AutosaveInterval", 60, 5, 3600, 5);
+
   // Permissions
   RegistryEnumMap<UpdateCheckingPermission> remUpdate;
   remUpdate.AddPair(UPDATE_NO, "No");
@@ -21,6 +21,12 @@ public:
   irisSimplePropertyAccessMacro(SyncZoom, bool)
   irisSimplePropertyAccessMacro(SyncPan, bool)
   irisSimplePropertyAccessMacro(AutoContrast, bool)
+  irisSimplePropertyAccessMacro(PersistentMeshCache, bool)
+
+  // Periodic journaling of segmentation changes for crash recovery, and the
+  // interval between journal updates in seconds
+  irisSimplePropertyAccessMacro(Autosave, bool)
+  irisRangedPropertyAccessMacro(AutosaveInterval, int)
 
   // Permissions
   enum UpdateCheckingPermission {
@@ -53,6 +59,9 @@ protected:
   SmartPtr<ConcreteSimpleBooleanProperty> m_SyncZoomModel;
   SmartPtr<ConcreteSimpleBooleanProperty> m_SyncPanModel;
   SmartPtr<ConcreteSimpleBooleanProperty> m_AutoContrastModel;
+  SmartPtr<ConcreteSimpleBooleanProperty> m_PersistentMeshCacheModel;
+  SmartPtr<ConcreteSimpleBooleanProperty> m_AutosaveModel;
+  SmartPtr<ConcreteRangedIntProperty> m_AutosaveIntervalModel;
 
   // Permissions
   SmartPtr<ConcretePropertyModel<UpdateCheckingPermission> > m_CheckForUpdatesModel;
@@ -240,6 +240,40 @@ GenericImageData::CreateAnatomicWrapper(GuidedNativeImageIO *io, ITKTransformTyp
   return out_wrapper;
 }
 
+template<typename TComponent>
+static void CastAnatomicImageToComponent(GuidedNativeImageIO *io)
+{
+  // Use the same image types as GenericImageDataWrapperCreator::Create()
+  if(io->GetNumberOfComponentsInNativeImage() > 1)
+    {
+    typedef typename AnatomicImageWrapperTraits<TComponent, false>::WrapperType::Image4DType Image4DType;
+    RescaleNativeImageToIntegralType<Image4DType> rescaler;
+    SmartPtr<Image4DType> image = rescaler(io);
+    io->SetCastImage(image, rescaler.GetNativeScale(), rescaler.GetNativeShift());
+    }
+  else
+    {
+    typedef typename AnatomicScalarImageWrapperTraits<TComponent, false>::WrapperType::Image4DType Image4DType;
+    RescaleNativeImageToIntegralType<Image4DType> rescaler;
+    SmartPtr<Image4DType> image = rescaler(io);
+    io->SetCastImage(image, rescaler.GetNativeScale(), rescaler.GetNativeShift());
+    }
+}
+
+void GenericImageData::CastAnatomicImage(GuidedNativeImageIO *io)
+{
+  // Same component types as in CreateAnatomicWrapper()
+  switch(io->GetComponentTypeInNativeImage())
+    {
+    case itk::IOComponentEnum::UCHAR:  CastAnatomicImageToComponent<unsigned char>(io);   break;
+    case itk::IOComponentEnum::CHAR:   CastAnatomicImageToComponent<char>(io);            break;
+    case itk::IOComponentEnum::USHORT: CastAnatomicImageToComponent<unsigned short>(io);  break;
+    case itk::IOComponentEnum::SHORT:  CastAnatomicImageToComponent<short>(io);           break;
+    case itk::IOComponentEnum::DOUBLE: CastAnatomicImageToComponent<double>(io);          break;
+    default: CastAnatomicImageToComponent<float>(io);                                     break;
+    }
+}
+
 void GenericImageData::SetMainImage(GuidedNativeImageIO *io)
 {
   // Create the wrapper from the Native IO (the wrapper will either be a scalar
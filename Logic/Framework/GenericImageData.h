@@ -222,6 +222,14 @@ public:
    */
   virtual void SetMainImage(GuidedNativeImageIO *io);
 
+  /**
+   * Cast the native image in the IO to the internal type that is used for
+   * main and overlay images, and store the result in the IO. This does not
+   * touch any state, so it can be called on another thread before the image
+   * is passed to SetMainImage() or AddCoregOverlay().
+   */
+  static void CastAnatomicImage(GuidedNativeImageIO *io);
+
   /** Unload the main image (and everything else) */
   virtual void UnloadMainImage();
 
@@ -46,6 +46,7 @@
 #include "IRISVectorTypesToITKConversion.h"
 #include "SNAPImageData.h"
 #include "MeshManager.h"
+#include "AutosaveJournal.h"
 #include "MeshExportSettings.h"
 #include "SegmentationStatistics.h"
 #include "RLEImageRegionIterator.h"
@@ -89,10 +90,19 @@
 #include "ImageMeshLayers.h"
 #include "StandaloneMeshWrapper.h"
 #include "AllPurposeProgressAccumulator.h"
+#include "SNAPTrace.h"
+#include "LevelSetSegmentationMerger.h"
+#include "itkTimeProbe.h"
 
 #include <stdio.h>
 #include <sstream>
 #include <iomanip>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cmath>
 
 IRISApplication
 ::IRISApplication() 
@@ -101,6 +111,11 @@ IRISApplication
   m_SystemInterface = new SystemInterface();
   m_HistoryManager = m_SystemInterface->GetHistoryManager();
 
+  // Keep an index of DICOM headers, so that directories are parsed quickly
+  // when they are browsed again
+  GuidedNativeImageIO::SetDicomIndexDirectory(
+        m_SystemInterface->GetUserCacheDirectory("DicomIndex"));
+
   // Create a color map preset manager
   m_ColorMapPresetManager = ColorMapPresetManager::New();
   m_ColorMapPresetManager->Initialize(m_SystemInterface);
@@ -166,6 +181,9 @@ IRISApplication
   m_MeshManager = MeshManager::New();
   m_MeshManager->Initialize(this);
 
+  // Autosave journal
+  m_AutosaveJournal = AutosaveJournal::New();
+
   // Data saved for restoring IRIS state while in SNAP state
   m_SavedIRISSelectedSegmentationLayerId = 0;
 }
@@ -557,132 +575,88 @@ IRISApplication
 
 unsigned int
 IRISApplication
-::UpdateSegmentationWithSliceDrawing(
-    IRISApplication::SliceBinaryImageType *drawing,
+::UpdateSegmentationWithSliceSpans(
+    const SpanList &spans, unsigned int axis, const Vector2ui &sliceSize,
     const ImageCoordinateTransform *xfmSliceToImage,
     double zSlice,
     const std::string &undoTitle)
 {
-  // Turn the 2D region of the drawing into a 3D region in the segmentation
-  IRISApplication::SliceBinaryImageType::RegionType r_draw = drawing->GetBufferedRegion();
-
-  // Array of corners of the drawing region
-  Vector2ui corners[4];
-  corners[0][0] = r_draw.GetIndex()[0];
-  corners[0][1] = r_draw.GetIndex()[1];
-  corners[1][0] = r_draw.GetUpperIndex()[0];
-  corners[1][1] = r_draw.GetIndex()[1];
-  corners[2][0] = r_draw.GetIndex()[0];
-  corners[2][1] = r_draw.GetUpperIndex()[1];
-  corners[3][0] = r_draw.GetUpperIndex()[0];
-  corners[3][1] = r_draw.GetUpperIndex()[1];
-
-  // Compute 3D extents of the region
-  Vector3ui pos_min, pos_max;
-  for(int i = 0; i < 4; i++)
-    {
-    // Get the 3D coordinate of the corner
-    Vector3ui idxVol = to_unsigned_int(
-                         xfmSliceToImage->TransformPoint(
-                           Vector3d(corners[i][0] + 0.5, corners[i][1] + 0.5, zSlice)));
-
-    if(i == 0)
+  typedef SegmentationSpanPainter::Span Span;
+
+  // When drawing is inverted, the rest of the slice is painted
+  SpanList slice_spans;
+  if(m_GlobalState->GetPolygonInvert())
+    {
+    LabelImageType::RegionType r_slice;
+    r_slice.SetSize(0, sliceSize[axis]);
+    r_slice.SetSize(1, sliceSize[1 - axis]);
+    r_slice.SetSize(2, 1);
+    slice_spans = SegmentationSpanPainter::Complement(spans, r_slice);
+    }
+  else
+    {
+    slice_spans = spans;
+    }
+
+  // Map the center of a pixel in the slice to a voxel in the image
+  auto map_pixel = [&](long i, long j)
+    {
+    Vector3d x_slice(0.0, 0.0, zSlice);
+    x_slice[axis] = i + 0.5;
+    x_slice[1 - axis] = j + 0.5;
+    Vector3d x_vol = xfmSliceToImage->TransformPoint(x_slice);
+    return Vector3i((int) std::floor(x_vol[0]), (int) std::floor(x_vol[1]), (int) std::floor(x_vol[2]));
+    };
+
+  // A span along the slice axis that maps to the x axis of the image is a
+  // span in the image, otherwise its pixels map to different image lines
+  SpanList vol_spans;
+  for(const Span &s : slice_spans)
+    {
+    Vector3i v0 = map_pixel(s.x0, s.y), v1 = map_pixel(s.x1 - 1, s.y);
+    if(v0[1] == v1[1] && v0[2] == v1[2])
       {
-      pos_min = idxVol;
-      pos_max = idxVol;
+      vol_spans.push_back(Span(std::min(v0[0], v1[0]), std::max(v0[0], v1[0]) + 1, v0[1], v0[2]));
       }
     else
       {
-      for(int j = 0; j < 3; j++)
+      for(long i = s.x0; i < s.x1; i++)
         {
-        if(pos_min[j] > idxVol[j]) pos_min[j] = idxVol[j];
-        if(pos_max[j] < idxVol[j]) pos_max[j] = idxVol[j];
+        Vector3i v = map_pixel(i, s.y);
+        vol_spans.push_back(Span(v[0], v[0] + 1, v[1], v[2]));
         }
       }
     }
 
-  // Define the volumetric region
-  LabelImageType::RegionType r_vol;
-  r_vol.SetIndex(to_itkIndex(pos_min));
-  r_vol.SetUpperIndex(to_itkIndex(pos_max));
-  r_vol.Crop(this->GetSelectedSegmentationLayer()->GetBufferedRegion());
-
-  // Create an iterator for painting
-  SegmentationUpdateIterator itVol(this->GetSelectedSegmentationLayer(), r_vol,
-                                   m_GlobalState->GetDrawingColorLabel(),
-                                   m_GlobalState->GetDrawOverFilter());
-
-  // Drawing parameters
-  bool invert = m_GlobalState->GetPolygonInvert();
-
-  // Inverse transform
-  ImageCoordinateTransform::Pointer xfmImageToSlice = ImageCoordinateTransform::New();
-  xfmSliceToImage->ComputeInverse(xfmImageToSlice);
-
-  // Iterate over the volume region
-  for(; !itVol.IsAtEnd(); ++itVol)
-    {
-    // Find the coordinate of the voxel in the slice
-    itk::Index<3> idx_vol = itVol.GetIndex();
-    Vector3d x_slice = xfmImageToSlice->TransformPoint(
-                         Vector3d(idx_vol[0] + 0.5, idx_vol[1] + 0.5, idx_vol[2] + 0.5));
-    itk::Index<2> idx_slice;
-    idx_slice[0] = (int) x_slice[0];
-    idx_slice[1] = (int) x_slice[1];
-
-    // Check value
-    SliceBinaryImageType::PixelType px = drawing->GetPixel(idx_slice);
-    if((px != 0) ^ invert)
-      itVol.PaintAsForeground();
-
-
-    }
-
-  // Finalize
-  if(itVol.Finalize(undoTitle.c_str()))
-    {
-    // Voxels were updated
-    this->RecordCurrentLabelUse();
-    InvokeEvent(SegmentationChangeEvent());
-    }
-
-  return itVol.GetNumberOfChangedVoxels();
+  return this->UpdateSegmentationWithSpans(vol_spans, undoTitle);
 }
 
 unsigned int
 IRISApplication
-::UpdateSegmentationWithBinarySegmentation(
-    const LabelImageType *binseg, const std::string &undoTitle, bool invert, bool reverse)
+::UpdateSegmentationWithSpans(
+    const SpanList &spans, const std::string &undoTitle, bool reverse)
 {
-  // Work out the 3D region to merge
-  RegionType r_vol = binseg->GetBufferedRegion();
-  r_vol.Crop(this->GetSelectedSegmentationLayer()->GetBufferedRegion());
-
-  // Create an iterator for painting
-  SegmentationUpdateIterator it_trg(this->GetSelectedSegmentationLayer(), r_vol,
-                                    m_GlobalState->GetDrawingColorLabel(),
-                                    m_GlobalState->GetDrawOverFilter());
+  LabelImageWrapper *seg = this->GetSelectedSegmentationLayer();
 
-  // Iterate over the volume region
-  for(LabelImageWrapper::ConstIterator it_src(binseg, r_vol); !it_src.IsAtEnd(); ++it_src, ++it_trg)
-    if((it_src.Get() != 0) ^ invert)
-      {
-      if (it_src.Get() != 0 && reverse)
-        it_trg.PaintAsBackground();
-      else
-        it_trg.PaintAsForeground();
-      }
+  // Paint the spans directly into the runs of the segmentation
+  SegmentationSpanPainter painter(
+        m_GlobalState->GetDrawingColorLabel(),
+        m_GlobalState->GetDrawOverFilter(), reverse);
 
+  SegmentationSpanPainter::DeltaType *delta =
+      painter.Paint(seg->GetModifiableImage(), spans);
 
   // Finalize
-  if(it_trg.Finalize(undoTitle.c_str()))
+  if(delta)
     {
     // Voxels were updated
+    seg->PixelsModifiedInRegion(painter.GetChangedRegion());
+    seg->StoreUndoPoint(undoTitle.c_str(), delta);
     this->RecordCurrentLabelUse();
     InvokeEvent(SegmentationChangeEvent());
     }
 
-  return it_trg.GetNumberOfChangedVoxels();
+  return painter.GetNumberOfChangedVoxels();
 }
 
 void 
@@ -776,36 +750,21 @@ IRISApplication
     source = fltSample->GetOutput();
     }  
 
-  // Creat the source iterator
-  typedef itk::ImageRegionConstIterator<SourceImageType> SourceIteratorType;
-  SourceIteratorType itSource(source,source->GetLargestPossibleRegion());
-
-  // Create the smart target iterator
-  SegmentationUpdateIterator itTarget(
-        iris_seg, roi.GetROI(),
-        m_GlobalState->GetDrawingColorLabel(), m_GlobalState->GetDrawOverFilter());
-
-  // Inversion state
-  bool invert = m_GlobalState->GetPolygonInvert();
+  // Paste the level set into the segmentation. Only the lines that change are
+  // rewritten, and the undo delta spans just the bounding box of the changes
+  LevelSetSegmentationMerger merger(
+        m_GlobalState->GetDrawingColorLabel(),
+        m_GlobalState->GetDrawOverFilter(),
+        m_GlobalState->GetPolygonInvert());
 
-  // Go through both iterators, copy the new over the old
-  while(!itSource.IsAtEnd())
-    {
-    // Get the level set value
-    float voxSNAP = itSource.Value();
-    if((!invert && voxSNAP <= 0) || (invert && voxSNAP >= 0))
-      itTarget.PaintAsForeground();
-    else
-      itTarget.PaintAsBackground();
-
-    // Iterate
-    ++itSource;
-    ++itTarget;
-    }
+  LevelSetSegmentationMerger::DeltaType *delta =
+      merger.Merge(iris_seg->GetModifiableImage(), roi.GetROI(), source);
 
   // Finalize the segmentation and store undo point
-  if(itTarget.Finalize("Automatic Segmentation"))
+  if(delta)
     {
+    iris_seg->PixelsModifiedInRegion(merger.GetChangedRegion());
+    iris_seg->StoreUndoPoint("Automatic Segmentation", delta);
     RecordCurrentLabelUse();
     InvokeEvent(SegmentationChangeEvent());
     }
@@ -1827,6 +1786,9 @@ IRISApplication
   // Unload the main image
   m_CurrentImageData->UnloadMainImage();
 
+  // The project was closed normally, so the journal is no longer needed
+  m_AutosaveJournal->Close(true);
+
   // After unloading the main image, we reset the workspace filename
   m_GlobalState->SetProjectFilename("");
 
@@ -1846,7 +1808,8 @@ IRISApplication
                        AbstractOpenImageDelegate *del,
                        IRISWarningList &wl,
 											 Registry *ioHints,
-											 ImageReadingProgressAccumulator *irAccum)
+											 ImageReadingProgressAccumulator *irAccum,
+                       GuidedNativeImageIO *preloadedIO)
 {
   Registry regAssoc;
 
@@ -1875,14 +1838,18 @@ IRISApplication
     ioHints = &regAssoc.Folder("Files.Grey");
     }
 
-  // Create a native image IO object
-  SmartPtr<GuidedNativeImageIO> io = GuidedNativeImageIO::New();
+  // Create a native image IO object, unless the image has been read already
+  SmartPtr<GuidedNativeImageIO> io = preloadedIO;
+  if(!io)
+    {
+    io = GuidedNativeImageIO::New();
 
-  // Configure io using delegate
-  del->ConfigureImageIO(io);
+    // Configure io using delegate
+    del->ConfigureImageIO(io);
 
-  // Load the header of the image
-	io->ReadNativeImageHeader(fname, *ioHints, headerProgCmd);
+    // Load the header of the image
+    io->ReadNativeImageHeader(fname, *ioHints, headerProgCmd);
+    }
 
   // Validate the header
   del->ValidateHeader(io, wl);
@@ -1891,7 +1858,8 @@ IRISApplication
   del->UnloadCurrentImage();
 
   // Read the image body
-	io->ReadNativeImageData(dataProgCmd);
+  if(!preloadedIO)
+    io->ReadNativeImageData(dataProgCmd);
 
   // Validate the image data
   del->ValidateImage(io, wl);
@@ -2023,9 +1991,9 @@ void IRISApplication
     }
 }
 
-void IRISApplication
-::OpenImage(const char *fname, LayerRole role, IRISWarningList &wl,
-            Registry *meta_data_reg, Registry *io_hints_reg, bool additive)
+SmartPtr<AbstractOpenImageDelegate>
+IRISApplication
+::CreateOpenDelegateForRole(LayerRole role, bool additive)
 {
   // Pointer to the delegate
   SmartPtr<AbstractOpenImageDelegate> delegate;
@@ -2050,6 +2018,15 @@ void IRISApplication
     }
 
   delegate->Initialize(this);
+  return delegate;
+}
+
+void IRISApplication
+::OpenImage(const char *fname, LayerRole role, IRISWarningList &wl,
+            Registry *meta_data_reg, Registry *io_hints_reg, bool additive)
+{
+  // Create the delegate
+  SmartPtr<AbstractOpenImageDelegate> delegate = CreateOpenDelegateForRole(role, additive);
   if(meta_data_reg)
     delegate->SetMetaDataRegistry(meta_data_reg);
 
@@ -2215,6 +2192,9 @@ void IRISApplication::SaveProject(const std::string &proj_file)
 
   // Store the project registry
   m_LastSavedProjectState = preg;
+
+  // All layers have been saved, so earlier journal records are obsolete
+  m_AutosaveJournal->Clear();
 }
 
 std::string
@@ -2254,6 +2234,133 @@ IRISApplication
   return ret;
 }
 
+/**
+ * Reads the image files of the layers of a project on a pool of threads. The
+ * layers are read in order, and at most as many layers as there are threads
+ * are held in memory before the calling thread has added them to the project.
+ */
+class ProjectLayerReader
+{
+public:
+
+  struct Layer
+  {
+    std::string FileName;
+    Registry *IOHints;
+    SmartPtr<AbstractOpenImageDelegate> Delegate;
+    SmartPtr<GuidedNativeImageIO> IO;
+    std::exception_ptr Error;
+    double ReadTime, CastTime;
+    bool CastOnLoad;
+    bool Done;
+  };
+
+  ProjectLayerReader(std::vector<Layer> &layers, unsigned int n_threads)
+    : m_Layers(layers), m_NextLayer(0), m_Released(0), m_Stop(false)
+    {
+    m_MaxReadAhead = n_threads;
+    for(unsigned int k = 0; k < n_threads; k++)
+      m_Threads.push_back(std::thread(&ProjectLayerReader::ThreadMain, this));
+    }
+
+  ~ProjectLayerReader()
+    {
+      {
+      std::lock_guard<std::mutex> guard(m_Mutex);
+      m_Stop = true;
+      }
+    m_Condition.notify_all();
+    for(auto &t : m_Threads)
+      t.join();
+    }
+
+  /** Wait for a layer to be read, rethrowing any exception from reading it */
+  GuidedNativeImageIO *WaitForLayer(unsigned int i)
+    {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this, i]() { return m_Layers[i].Done; });
+    if(m_Layers[i].Error)
+      std::rethrow_exception(m_Layers[i].Error);
+    return m_Layers[i].IO;
+    }
+
+  /** Free the memory of a layer that has been added, and read the next one */
+  void ReleaseLayer(unsigned int i)
+    {
+      {
+      std::lock_guard<std::mutex> guard(m_Mutex);
+      m_Layers[i].IO = nullptr;
+      m_Released++;
+      }
+    m_Condition.notify_all();
+    }
+
+protected:
+
+  void ThreadMain()
+    {
+    while(true)
+      {
+      unsigned int i;
+        {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Condition.wait(lock, [this]()
+          {
+          return m_Stop || m_NextLayer >= m_Layers.size()
+              || m_NextLayer < m_Released + m_MaxReadAhead;
+          });
+        if(m_Stop || m_NextLayer >= m_Layers.size())
+          return;
+        i = m_NextLayer++;
+        }
+
+      Layer &layer = m_Layers[i];
+      itk::TimeProbe probe_read, probe_cast;
+      try
+        {
+        SNAP_TRACE_SCOPE("io", "ProjectLayerReader::ReadLayer");
+        probe_read.Start();
+        SmartPtr<GuidedNativeImageIO> io = GuidedNativeImageIO::New();
+        layer.Delegate->ConfigureImageIO(io);
+        io->ReadNativeImageHeader(layer.FileName.c_str(), *layer.IOHints);
+        io->ReadNativeImageData();
+        probe_read.Stop();
+
+        // Cast anatomic images to the internal type here, so that the cast
+        // and its range statistics overlap with the other layers
+        if(layer.CastOnLoad)
+          {
+          SNAP_TRACE_SCOPE("io", "ProjectLayerReader::CastLayer");
+          probe_cast.Start();
+          GenericImageData::CastAnatomicImage(io);
+          probe_cast.Stop();
+          }
+
+        layer.IO = io;
+        }
+      catch(...)
+        {
+        layer.Error = std::current_exception();
+        }
+
+        {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        layer.ReadTime = probe_read.GetTotal();
+        layer.CastTime = probe_cast.GetTotal();
+        layer.Done = true;
+        }
+      m_Condition.notify_all();
+      }
+    }
+
+  std::vector<Layer> &m_Layers;
+  std::vector<std::thread> m_Threads;
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  unsigned int m_NextLayer, m_Released, m_MaxReadAhead;
+  bool m_Stop;
+};
+
 void IRISApplication::OpenProject(
     const std::string &proj_file, IRISWarningList &warn)
 {
@@ -2273,7 +2380,9 @@ void IRISApplication::OpenProject(
   // If the locations are different, we will attempt to find relative paths first
   bool moved = (project_save_dir != project_dir);
 
-  // Read all the layers
+  // Collect all the layers, so that their files can be read concurrently
+  std::vector<ProjectLayerReader::Layer> layers;
+  std::list<Registry> assoc_hints;
   std::string key;
   bool main_loaded = false;
   int n_segs_loaded = 0;
@@ -2301,8 +2410,6 @@ void IRISApplication::OpenProject(
     // Get the filenames for the layer
     std::string layer_file_full = folder["AbsolutePath"][""];
 
-    std::string generated_file_full;
-
     // If the project has moved, try finding a relative location
     if(moved)
       {
@@ -2314,23 +2421,39 @@ void IRISApplication::OpenProject(
 
     // Load the IO hints for the image from the project - but only if this
     // folder is actually present (otherwise some projects from before 2016
-    // will not load hints)
+    // will not load hints). In the latter case, use the association files.
     Registry *io_hints = NULL;
     if(folder.HasFolder("IOHints"))
+      {
       io_hints = &folder.Folder("IOHints");
+      }
+    else
+      {
+      assoc_hints.push_back(Registry());
+      m_SystemInterface->FindRegistryAssociatedWithFile(layer_file_full.c_str(), assoc_hints.back());
+      io_hints = &assoc_hints.back().Folder("Files.Grey");
+      }
 
     // TODO: this is spaggetti code
     bool load_additive = false;
     if(role == LABEL_ROLE && n_segs_loaded > 0)
       load_additive = true;
 
-    // Load the image and its metadata
-    OpenImage(layer_file_full.c_str(), role, warn, &folder, io_hints, load_additive);
+    // Create the delegate that will read the image and its metadata
+    ProjectLayerReader::Layer layer;
+    layer.FileName = layer_file_full;
+    layer.IOHints = io_hints;
+    layer.Delegate = CreateOpenDelegateForRole(role, load_additive);
+    layer.Delegate->SetMetaDataRegistry(&folder);
+    layer.ReadTime = layer.CastTime = 0.0;
+    layer.CastOnLoad = (role == MAIN_ROLE || role == OVERLAY_ROLE);
+    layer.Done = false;
+    layers.push_back(layer);
 
     // Check if the main has been loaded
     if(role == MAIN_ROLE)
       {
-      main_loaded = true;      
+      main_loaded = true;
       }
     else if(role == LABEL_ROLE)
       {
@@ -2342,6 +2465,49 @@ void IRISApplication::OpenProject(
   if(!main_loaded)
     throw IRISException("Empty or invalid project (main image not found in the project file).");
 
+  // Decoding a file is single-threaded, so a few loader threads keep several
+  // cores busy. The number is kept small because every layer that is read
+  // ahead is held in memory
+  unsigned int n_threads = std::min(
+        (unsigned int) layers.size(),
+        std::max(1u, std::min(4u, std::thread::hardware_concurrency())));
+
+  // Add the layers to the project in the original order, as they become available
+  m_ProjectLoadTimings.clear();
+    {
+    ProjectLayerReader reader(layers, n_threads);
+    for(unsigned int i = 0; i < layers.size(); i++)
+      {
+      LayerLoadTiming timing;
+      timing.FileName = layers[i].FileName;
+
+      itk::TimeProbe probe_wait, probe_attach;
+      GuidedNativeImageIO *io;
+        {
+        SNAP_TRACE_SCOPE("io", "IRISApplication::OpenProject::WaitForLayer");
+        probe_wait.Start();
+        io = reader.WaitForLayer(i);
+        probe_wait.Stop();
+        }
+
+        {
+        SNAP_TRACE_SCOPE("io", "IRISApplication::OpenProject::AttachLayer");
+        probe_attach.Start();
+        OpenImageViaDelegate(layers[i].FileName.c_str(), layers[i].Delegate, warn,
+                             layers[i].IOHints, nullptr, io);
+        probe_attach.Stop();
+        }
+
+      reader.ReleaseLayer(i);
+
+      timing.ReadTime = layers[i].ReadTime;
+      timing.CastTime = layers[i].CastTime;
+      timing.WaitTime = probe_wait.GetTotal();
+      timing.AttachTime = probe_attach.GetTotal();
+      m_ProjectLoadTimings.push_back(timing);
+      }
+    }
+
   // Load Mesh Layers
   GetCurrentImageData()->GetMeshLayers()->
       LoadFromRegistry(preg, project_save_dir, project_dir);
@@ -2374,6 +2540,49 @@ void IRISApplication::OpenProject(
   // Simulate saving the project into a registy that will be cached. This
   // allows us to check later whether the project state has changed.
   SaveProjectToRegistry(m_LastSavedProjectState, proj_file_full);
+
+  // If the previous session with this project did not end normally, recover
+  // the segmentation changes that were recorded in the autosave journal
+  std::string fn_journal = AutosaveJournal::GetJournalFileName(proj_file_full);
+  if(itksys::SystemTools::FileExists(fn_journal.c_str(), true))
+    {
+    try
+      {
+      unsigned int n_recovered = AutosaveJournal::Replay(fn_journal, m_IRISImageData);
+      if(n_recovered > 0)
+        {
+        warn.push_back(IRISWarning(
+                         "Warning: Unsaved changes recovered. "
+                         "Unsaved changes to %d segmentation layer(s) were recovered from the "
+                         "autosave journal %s. Save the segmentation to keep these changes.",
+                         n_recovered, fn_journal.c_str()));
+        }
+
+      // Keep the journal, so that it is removed when the project is closed
+      m_AutosaveJournal->Open(fn_journal);
+      }
+    catch(IRISException &exc)
+      {
+      warn.push_back(IRISWarning("Warning: Autosave journal not recovered. "
+                                 "Failed to read autosave journal %s: %s",
+                                 fn_journal.c_str(), exc.what()));
+      }
+    }
+}
+
+void IRISApplication::UpdateAutosaveJournal()
+{
+  std::string proj_file = m_GlobalState->GetProjectFilename();
+  if(!m_GlobalState->GetDefaultBehaviorSettings()->GetAutosave()
+     || !IsMainImageLoaded() || proj_file.empty())
+    {
+    m_AutosaveJournal->Close(true);
+    return;
+    }
+
+  // If the project was saved under a new name, the journal follows it
+  m_AutosaveJournal->Open(AutosaveJournal::GetJournalFileName(proj_file));
+  m_AutosaveJournal->Update(m_IRISImageData);
 }
 
 bool IRISApplication::IsProjectUnsaved()
@@ -46,6 +46,7 @@
 #include "itkCommand.h"
 #include "SystemInterface.h"
 #include "UndoDataManager.h"
+#include "SegmentationSpanPainter.h"
 #include "SNAPEvents.h"
 
 // #include "itkImage.h"
@@ -72,6 +73,7 @@ class LabelUseHistory;
 class ImageAnnotationData;
 class LabelImageWrapper;
 class ImageReadingProgressAccumulator;
+class AutosaveJournal;
 
 template <class TPixel, class TLabel, int VDim> class RandomForestClassifier;
 template <class TPixel, class TLabel, int VDim> class RFClassificationEngine;
@@ -131,9 +133,6 @@ public:
   typedef itk::Image<short ,3> SpeedImageType;
   typedef itk::Command CommandType;
 
-  // A drawing performed on a slice
-  typedef itk::Image<unsigned char, 2> SliceBinaryImageType;
-
   // Bubble array
   typedef std::vector<Bubble> BubbleArray;
 
@@ -209,12 +208,16 @@ public:
    * looking up the hints associated with fname in the user's application data
    * directory. But it is also possible to provide a pointer to the ioHints, i.e.,
    * if the image is being as part of loading a workspace.
+   *
+   * If preloadedIO is provided, it must already hold the image data read from
+   * fname (after configuration by the delegate), and the file is not read again.
    */
   ImageWrapperBase* OpenImageViaDelegate(const char *fname,
                                          AbstractOpenImageDelegate *del,
                                          IRISWarningList &wl,
 																				 Registry *ioHints = NULL,
-																				 ImageReadingProgressAccumulator *irAccum = nullptr);
+																				 ImageReadingProgressAccumulator *irAccum = nullptr,
+                                         GuidedNativeImageIO *preloadedIO = nullptr);
 
   /**
    * List available additional DICOM series that can be loaded given the currently
@@ -257,6 +260,13 @@ public:
                  Registry *io_hints_reg = NULL,
                  bool additive = false);
 
+  /**
+   * Create a delegate for opening an image non-interactively in a given role.
+   * The additive flag applies to segmentation images only.
+   */
+  SmartPtr<AbstractOpenImageDelegate> CreateOpenDelegateForRole(
+      LayerRole role, bool additive = false);
+
   /**
    * Create a delegate for saving an image interactively or non-interactively
    * via a wizard.
@@ -591,24 +601,26 @@ public:
    */
   void ReorientImage(vnl_matrix_fixed<double, 3, 3> inDirection);
 
+  /** Spans of voxels or pixels used to apply drawings to the segmentation */
+  typedef SegmentationSpanPainter::SpanList SpanList;
+
   /**
-    Apply a binary drawing performed on an orthogonal slice to the
-    main segmentation.
+    Apply a drawing performed on an orthogonal slice to the main
+    segmentation. The drawing is given as spans of pixels along one of
+    the axes of the slice, with z set to zero.
     */
-  unsigned int UpdateSegmentationWithSliceDrawing(
-      SliceBinaryImageType *drawing,
+  unsigned int UpdateSegmentationWithSliceSpans(
+      const SpanList &spans, unsigned int axis, const Vector2ui &sliceSize,
       const ImageCoordinateTransform *xfmSliceToImage,
       double zSlice,
       const std::string &undoTitle);
 
   /**
-   * Apply a binary drawing represented as an RLE image
-   * if invert == true, draw foreground with value 1 and background with 0
-   * if reverse = true, draw background with value 1
+   * Apply a drawing given as spans of voxels in the segmentation image
+   * if reverse = true, draw background over the active label instead of foreground
    */
-  unsigned int UpdateSegmentationWithBinarySegmentation(
-      const LabelImageType *binseg, const std::string &undoTitle,
-      bool invert = false, bool reverse = false);
+  unsigned int UpdateSegmentationWithSpans(
+      const SpanList &spans, const std::string &undoTitle, bool reverse = false);
 
   /** Get the pointer to the settings used for threshold-based preprocessing */
   // irisGetMacro(ThresholdSettings, ThresholdSettings *)
@@ -649,10 +661,36 @@ public:
   void SaveProject(const std::string &proj_file);
 
   /**
-   * Open an existing project.
+   * Open an existing project. The image files of the layers are read and
+   * decoded on a pool of threads, which also cast main and overlay images to
+   * the internal type, while the layers are added to the project in their
+   * original order on the calling thread. The stages are recorded as trace
+   * events (see SNAPTrace) and in GetProjectLoadTimings().
    */
   void OpenProject(const std::string &proj_file, IRISWarningList &warn);
 
+  /** Time spent in each stage of loading a project layer, in seconds */
+  struct LayerLoadTiming
+  {
+    std::string FileName;
+
+    // Reading and decoding the file (on a loader thread)
+    double ReadTime;
+
+    // Casting main and overlay images to the internal type (on a loader thread)
+    double CastTime;
+
+    // Time the layer was waited on by the calling thread
+    double WaitTime;
+
+    // Computing statistics and adding the layer to the project
+    double AttachTime;
+  };
+
+  /** Get the per-layer timing of the last call to OpenProject */
+  const std::vector<LayerLoadTiming> &GetProjectLoadTimings() const
+    { return m_ProjectLoadTimings; }
+
   /**
    * Get Moved File Path from the absolute file path in the original project file
    */
@@ -673,6 +711,15 @@ public:
    */
   bool IsProjectFile(const char *filename);
 
+  /**
+   * Record the changes made to the segmentation layers since the last call
+   * in the autosave journal of the current project. This does nothing unless
+   * autosave is enabled in the default behavior settings and the project has
+   * been saved. Called periodically by the GUI. The journal is replayed the
+   * next time the project is opened, unless the project is closed normally.
+   */
+  void UpdateAutosaveJournal();
+
   // --------------------- End project support ----------------------------
 
   // --------------------- Annotation support ----------------------------
@@ -790,6 +837,9 @@ protected:
   // Mesh object (used to manage meshes)
   SmartPtr<MeshManager> m_MeshManager;
 
+  // Crash recovery journal for the segmentation layers of the project
+  SmartPtr<AutosaveJournal> m_AutosaveJournal;
+
   // Color map preset manager
   SmartPtr<ColorMapPresetManager> m_ColorMapPresetManager;
 
@@ -825,6 +875,9 @@ protected:
   // if the project has been modified.
   Registry m_LastSavedProjectState;
 
+  // Timing of the stages of the last project load
+  std::vector<LayerLoadTiming> m_ProjectLoadTimings;
+
   // Internal method used by the project IO code
   void SaveProjectToRegistry(Registry &preg, const std::string proj_file_full);
 
@@ -0,0 +1,173 @@
+#include "LevelSetSegmentationMerger.h"
+#include "IRISException.h"
+#include "SNAPTrace.h"
+#include <itkMultiThreaderBase.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+LevelSetSegmentationMerger
+::LevelSetSegmentationMerger(LabelType active_label, DrawOverFilter draw_over, bool invert)
+  : m_ActiveLabel(active_label), m_DrawOver(draw_over), m_Invert(invert),
+    m_NumberOfChangedVoxels(0)
+{
+}
+
+LevelSetSegmentationMerger::DeltaType *
+LevelSetSegmentationMerger
+::Merge(LabelImageType *target, const RegionType &region,
+        const LevelSetImageType *source)
+{
+  SNAP_TRACE_SCOPE("snake", "LevelSetSegmentationMerger::Merge");
+
+  typedef LabelImageType::RLLine RLLine;
+  typedef LabelImageType::RLSegment RLSegment;
+  typedef RLSegment::first_type CounterType;
+  typedef LabelImageType::BufferType LineImageType;
+
+  m_ChangedRegion = RegionType();
+  m_NumberOfChangedVoxels = 0;
+
+  const RegionType &target_region = target->GetBufferedRegion();
+  if(source->GetBufferedRegion().GetSize() != region.GetSize()
+     || !target_region.IsInside(region))
+    throw IRISException("Level set does not match the segmentation region in "
+                        "LevelSetSegmentationMerger::Merge");
+
+  // Dimensions of the region and of the lines of the target image
+  const size_t nx = region.GetSize(0), ny = region.GetSize(1), nz = region.GetSize(2);
+  const size_t nx_line = target_region.GetSize(0);
+  const size_t x0 = region.GetIndex(0) - target_region.GetIndex(0);
+  const size_t max_count = std::numeric_limits<CounterType>::max();
+  if(nx * ny * nz == 0)
+    return NULL;
+
+  // The changes to a line of the region: the range of changed voxels and the
+  // run-length encoded differences over that range
+  struct LineChange
+  {
+    long First, Last;
+    std::vector<std::pair<size_t, LabelType> > Delta;
+    LineChange() : First(-1), Last(-1) {}
+  };
+
+  std::vector<LineChange> changes(ny * nz);
+  std::vector<unsigned long> changed_voxels(nz, 0);
+  LineImageType *lines = target->GetBuffer();
+  const float *ls_buffer = source->GetBufferPointer();
+
+  // Each slice of the region is updated by a single thread, one line at a time
+  itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
+  mt->ParallelizeArray(0, nz, [&](itk::SizeValueType iz)
+    {
+    std::vector<LabelType> row(nx_line), old_row(nx);
+    for(size_t iy = 0; iy < ny; iy++)
+      {
+      LineImageType::IndexType idx;
+      idx[0] = region.GetIndex(1) + iy;
+      idx[1] = region.GetIndex(2) + iz;
+      RLLine &line = lines->GetPixel(idx);
+
+      // Decode the line
+      LabelType *p = row.data();
+      for(const RLSegment &seg : line)
+        p = std::fill_n(p, seg.first, seg.second);
+
+      // Paint the part of the line inside the region
+      LabelType *r = row.data() + x0;
+      const float *ls = ls_buffer + (iz * ny + iy) * nx;
+      long first = -1, last = -1;
+      for(size_t x = 0; x < nx; x++)
+        {
+        old_row[x] = r[x];
+        r[x] = Paint(r[x], ls[x]);
+        if(r[x] != old_row[x])
+          {
+          if(first < 0)
+            first = x;
+          last = x;
+          changed_voxels[iz]++;
+          }
+        }
+
+      if(first < 0)
+        continue;
+
+      // Encode the differences over the range of changed voxels
+      LineChange &lc = changes[iz * ny + iy];
+      lc.First = first; lc.Last = last;
+      for(long x = first; x <= last; x++)
+        {
+        LabelType d = r[x] - old_row[x];
+        if(lc.Delta.size() && lc.Delta.back().second == d)
+          lc.Delta.back().first++;
+        else
+          lc.Delta.push_back(std::make_pair((size_t) 1, d));
+        }
+
+      // Re-encode the line
+      line.clear();
+      for(size_t i = 0; i < nx_line; )
+        {
+        size_t j = i + 1;
+        while(j < nx_line && row[j] == row[i] && j - i < max_count)
+          j++;
+        line.push_back(RLSegment((CounterType) (j - i), row[i]));
+        i = j;
+        }
+      }
+    }, nullptr);
+
+  for(unsigned long n : changed_voxels)
+    m_NumberOfChangedVoxels += n;
+  if(m_NumberOfChangedVoxels == 0)
+    return NULL;
+
+  // Find the bounding box of the changes
+  long bmin[3] = { (long) nx, (long) ny, (long) nz }, bmax[3] = { -1, -1, -1 };
+  for(size_t iz = 0; iz < nz; iz++)
+    {
+    for(size_t iy = 0; iy < ny; iy++)
+      {
+      const LineChange &lc = changes[iz * ny + iy];
+      if(lc.First >= 0)
+        {
+        bmin[0] = std::min(bmin[0], lc.First);     bmax[0] = std::max(bmax[0], lc.Last);
+        bmin[1] = std::min(bmin[1], (long) iy);    bmax[1] = std::max(bmax[1], (long) iy);
+        bmin[2] = std::min(bmin[2], (long) iz);    bmax[2] = std::max(bmax[2], (long) iz);
+        }
+      }
+    }
+
+  for(unsigned int d = 0; d < 3; d++)
+    {
+    m_ChangedRegion.SetIndex(d, region.GetIndex(d) + bmin[d]);
+    m_ChangedRegion.SetSize(d, bmax[d] - bmin[d] + 1);
+    }
+
+  // Encode the undo delta over the bounding box, in image order
+  DeltaType *delta = new DeltaType();
+  delta->SetRegion(m_ChangedRegion);
+  size_t bnx = m_ChangedRegion.GetSize(0);
+  for(long iz = bmin[2]; iz <= bmax[2]; iz++)
+    {
+    for(long iy = bmin[1]; iy <= bmax[1]; iy++)
+      {
+      const LineChange &lc = changes[iz * ny + iy];
+      if(lc.First < 0)
+        {
+        delta->EncodeRun(0, bnx);
+        continue;
+        }
+
+      delta->EncodeRun(0, lc.First - bmin[0]);
+      for(const auto &run : lc.Delta)
+        delta->EncodeRun(run.second, run.first);
+      delta->EncodeRun(0, bmax[0] - lc.Last);
+      }
+    }
+  delta->FinishEncoding();
+
+  target->Modified();
+  return delta;
+}
@@ -0,0 +1,78 @@
+#ifndef LEVELSETSEGMENTATIONMERGER_H
+#define LEVELSETSEGMENTATIONMERGER_H
+
+#include "SNAPCommon.h"
+#include "UndoDataManager.h"
+#include "RLEImage.h"
+#include <itkImage.h>
+#include <itkImageRegion.h>
+
+/**
+ * Pastes the interior of a level set (the result of active contour
+ * segmentation) into a region of a run-length encoded segmentation image.
+ * The painting rules are those of SegmentationUpdateIterator: voxels inside
+ * the contour are painted with the active label, subject to the draw-over
+ * filter, and voxels outside of it that have the active label are cleared.
+ *
+ * Rather than visiting every voxel of the region through RLE iterators, each
+ * line of the region is decoded once, updated and re-encoded, on multiple
+ * threads. Lines that do not change are left alone. The undo delta only
+ * spans the bounding box of the voxels that actually changed, which is
+ * typically a thin shell when the contour was seeded from the existing
+ * segmentation.
+ */
+class LevelSetSegmentationMerger
+{
+public:
+  typedef RLEImage<LabelType> LabelImageType;
+  typedef itk::Image<float, 3> LevelSetImageType;
+  typedef UndoDelta<LabelType> DeltaType;
+  typedef itk::ImageRegion<3> RegionType;
+
+  LevelSetSegmentationMerger(LabelType active_label, DrawOverFilter draw_over, bool invert);
+
+  /**
+   * Merge the level set into the given region of the target. The level set
+   * image must have the size of the region. Returns the undo delta for the
+   * changes, which the caller is responsible for deleting, or NULL if no
+   * voxels were changed.
+   */
+  DeltaType *Merge(LabelImageType *target, const RegionType &region,
+                   const LevelSetImageType *source);
+
+  /** The bounding box of the voxels changed by the last merge */
+  irisGetMacro(ChangedRegion, const RegionType &)
+
+  /** The number of voxels changed by the last merge */
+  irisGetMacro(NumberOfChangedVoxels, unsigned long)
+
+protected:
+
+  // Compute the new label of a voxel
+  LabelType Paint(LabelType old_label, float level_set) const
+  {
+    bool inside = m_Invert ? (level_set >= 0) : (level_set <= 0);
+    if(inside)
+      {
+      if(old_label != m_ActiveLabel &&
+         (m_DrawOver.CoverageMode == PAINT_OVER_ALL ||
+          (m_DrawOver.CoverageMode == PAINT_OVER_ONE && old_label == m_DrawOver.DrawOverLabel) ||
+          (m_DrawOver.CoverageMode == PAINT_OVER_VISIBLE && old_label != 0)))
+        return m_ActiveLabel;
+      }
+    else if(m_ActiveLabel != 0 && old_label == m_ActiveLabel)
+      {
+      return 0;
+      }
+    return old_label;
+  }
+
+  LabelType m_ActiveLabel;
+  DrawOverFilter m_DrawOver;
+  bool m_Invert;
+
+  RegionType m_ChangedRegion;
+  unsigned long m_NumberOfChangedVoxels;
+};
+
+#endif // LEVELSETSEGMENTATIONMERGER_H
@@ -61,6 +61,11 @@
 
 #include "SlicePreviewFilterWrapper.h"
 #include "PreprocessingFilterConfigTraits.h"
+#include "SNAPTrace.h"
+#include "itkPlatformMultiThreader.h"
+#include <algorithm>
+#include <thread>
+#include <exception>
 
 
 SNAPImageData
@@ -577,31 +582,56 @@ SNAPImageData
                   const SNAPSegmentationROISettings &roi,
                   itk::Command *progressCommand)
 {
-  // Get the source main wrapper
-  ImageWrapperBase *srcMain = source->GetMain();
-
-  // Extract the ROI into a generic type
-  SmartPtr<ImageWrapperBase> roiMain = srcMain->ExtractROI(roi, progressCommand);
+  SNAP_TRACE_SCOPE("snake", "SNAPImageData::InitializeToROI");
+
+  // Collect the main image and the overlays, in order
+  std::vector<ImageWrapperBase *> srcLayers;
+  srcLayers.push_back(source->GetMain());
+  for(LayerIterator lit = source->GetLayers(OVERLAY_ROLE); !lit.IsAtEnd(); ++lit)
+    srcLayers.push_back(lit.GetLayer());
+
+  // Extract the ROI from each layer. The layers are independent, so they are
+  // extracted in parallel, with at most as many threads as ITK would use.
+  // The platform multithreader is used rather than the default pool, since
+  // ExtractROI runs multithreaded ITK filters of its own, and it runs the
+  // first work unit, which includes the main image, on the calling thread.
+  // Only that thread reports progress, since the progress command may update
+  // the user interface.
+  size_t nLayers = srcLayers.size();
+  std::vector<SmartPtr<ImageWrapperBase> > roiLayers(nLayers);
+  std::vector<std::exception_ptr> errors(nLayers);
+  std::thread::id caller = std::this_thread::get_id();
+
+  itk::PlatformMultiThreader::Pointer mt = itk::PlatformMultiThreader::New();
+  mt->SetNumberOfWorkUnits(std::min(
+    (unsigned int) nLayers, itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads()));
+  mt->ParallelizeArray(0, nLayers, [&](itk::SizeValueType i)
+    {
+    try
+      {
+      itk::Command *progress =
+          std::this_thread::get_id() == caller ? progressCommand : NULL;
+      roiLayers[i] = srcLayers[i]->ExtractROI(roi, progress);
+      }
+    catch(...)
+      {
+      errors[i] = std::current_exception();
+      }
+    }, nullptr);
 
-  // Assign the new wrapper to the target
-  this->SetMainImageInternal(roiMain);
+  for(auto &err : errors)
+    if(err)
+      std::rethrow_exception(err);
 
-  // Copy metadata
-  this->CopyLayerMetadata(this->GetMain(), source->GetMain());
+  // Assign the new main wrapper to the target and copy metadata
+  this->SetMainImageInternal(roiLayers[0]);
+  this->CopyLayerMetadata(this->GetMain(), srcLayers[0]);
 
-  // Repeat all of this for the overlays
-  for(LayerIterator lit = source->GetLayers(OVERLAY_ROLE);
-      !lit.IsAtEnd(); ++lit)
+  // Add the overlays in their original order
+  for(unsigned int i = 1; i < srcLayers.size(); i++)
     {
-    // Do the same for all the anatomic wrappers
-    SmartPtr<ImageWrapperBase> roiOvl =
-        lit.GetLayer()->ExtractROI(roi, progressCommand);
-
-    // Add the overlay
-    this->AddOverlayInternal(roiOvl);
-
-    // Copy metadata
-    this->CopyLayerMetadata(this->GetLastOverlay(), lit.GetLayer());
+    this->AddOverlayInternal(roiLayers[i]);
+    this->CopyLayerMetadata(this->GetLastOverlay(), srcLayers[i]);
     }
 
   // Destroy the alternate image if there is none or if the ROI settings have changed
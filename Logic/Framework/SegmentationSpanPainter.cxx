@@ -0,0 +1,263 @@
+#include "SegmentationSpanPainter.h"
+#include "SNAPTrace.h"
+#include <itkMultiThreaderBase.h>
+#include <algorithm>
+#include <limits>
+
+SegmentationSpanPainter
+::SegmentationSpanPainter(LabelType active_label, DrawOverFilter draw_over, bool background)
+  : m_ActiveLabel(active_label), m_DrawOver(draw_over), m_Background(background),
+    m_NumberOfChangedVoxels(0)
+{
+}
+
+void
+SegmentationSpanPainter
+::Normalize(SpanList &spans)
+{
+  std::sort(spans.begin(), spans.end(), [](const Span &a, const Span &b)
+    {
+    return a.z != b.z ? a.z < b.z : (a.y != b.y ? a.y < b.y : a.x0 < b.x0);
+    });
+
+  size_t n = 0;
+  for(const Span &s : spans)
+    {
+    if(s.x1 <= s.x0)
+      continue;
+
+    Span &last = spans[n > 0 ? n - 1 : 0];
+    if(n > 0 && last.z == s.z && last.y == s.y && s.x0 <= last.x1)
+      last.x1 = std::max(last.x1, s.x1);
+    else
+      spans[n++] = s;
+    }
+  spans.resize(n);
+}
+
+SegmentationSpanPainter::SpanList
+SegmentationSpanPainter
+::Complement(const SpanList &spans, const RegionType &region)
+{
+  SpanList sorted = spans;
+  Normalize(sorted);
+
+  long rx0 = region.GetIndex(0), rx1 = rx0 + (long) region.GetSize(0);
+  SpanList result;
+  auto it = sorted.begin();
+  for(long z = region.GetIndex(2); z <= region.GetUpperIndex()[2]; z++)
+    {
+    for(long y = region.GetIndex(1); y <= region.GetUpperIndex()[1]; y++)
+      {
+      // Skip the spans on lines that precede this one
+      while(it != sorted.end() && (it->z < z || (it->z == z && it->y < y)))
+        ++it;
+
+      long x = rx0;
+      for(; it != sorted.end() && it->z == z && it->y == y; ++it)
+        {
+        if(it->x0 > x)
+          result.push_back(Span(x, std::min(it->x0, rx1), y, z));
+        x = std::max(x, it->x1);
+        }
+      if(x < rx1)
+        result.push_back(Span(x, rx1, y, z));
+      }
+    }
+
+  return result;
+}
+
+SegmentationSpanPainter::DeltaType *
+SegmentationSpanPainter
+::Paint(LabelImageType *target, SpanList spans)
+{
+  SNAP_TRACE_SCOPE("paint", "SegmentationSpanPainter::Paint");
+
+  typedef LabelImageType::RLLine RLLine;
+  typedef LabelImageType::RLSegment RLSegment;
+  typedef RLSegment::first_type CounterType;
+  typedef LabelImageType::BufferType LineImageType;
+
+  m_ChangedRegion = RegionType();
+  m_NumberOfChangedVoxels = 0;
+
+  // Clip the spans to the image
+  const RegionType &region = target->GetBufferedRegion();
+  long rx0 = region.GetIndex(0), rx1 = rx0 + (long) region.GetSize(0);
+  size_t n = 0;
+  for(const Span &s : spans)
+    {
+    if(s.y < region.GetIndex(1) || s.y > region.GetUpperIndex()[1]
+       || s.z < region.GetIndex(2) || s.z > region.GetUpperIndex()[2])
+      continue;
+    spans[n] = s;
+    spans[n].x0 = std::max(s.x0, rx0);
+    spans[n].x1 = std::min(s.x1, rx1);
+    n++;
+    }
+  spans.resize(n);
+  Normalize(spans);
+  if(spans.empty())
+    return NULL;
+
+  // Find the first span on each line
+  std::vector<size_t> line_start;
+  for(size_t i = 0; i < spans.size(); i++)
+    if(i == 0 || spans[i].y != spans[i-1].y || spans[i].z != spans[i-1].z)
+      line_start.push_back(i);
+  line_start.push_back(spans.size());
+  size_t n_lines = line_start.size() - 1;
+
+  // The changes to a line: the range of changed voxels and the runs of
+  // differences within it, each given by its first voxel, length and value
+  struct DeltaRun
+  {
+    long x, n;
+    LabelType value;
+  };
+
+  struct LineChange
+  {
+    long First, Last;
+    unsigned long Count;
+    std::vector<DeltaRun> Delta;
+    LineChange() : First(0), Last(0), Count(0) {}
+  };
+
+  std::vector<LineChange> changes(n_lines);
+  LineImageType *lines = target->GetBuffer();
+  const long max_count = std::numeric_limits<CounterType>::max();
+
+  // Each line is updated by a single thread, run by run
+  itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
+  mt->ParallelizeArray(0, n_lines, [&](itk::SizeValueType k)
+    {
+    const Span *sp = spans.data() + line_start[k];
+    const Span *sp_end = spans.data() + line_start[k+1];
+
+    LineImageType::IndexType idx;
+    idx[0] = sp->y;
+    idx[1] = sp->z;
+    RLLine &line = lines->GetPixel(idx);
+    LineChange &lc = changes[k];
+
+    // Append a run to the new line, merging it with the last run if possible
+    RLLine out;
+    out.reserve(line.size() + 2 * (sp_end - sp));
+    auto append = [&out, max_count](long count, LabelType value)
+      {
+      if(out.size() && out.back().second == value && out.back().first + count <= max_count)
+        {
+        out.back().first += count;
+        return;
+        }
+      while(count > max_count)
+        {
+        out.push_back(RLSegment((CounterType) max_count, value));
+        count -= max_count;
+        }
+      out.push_back(RLSegment((CounterType) count, value));
+      };
+
+    long x = rx0;
+    for(const RLSegment &seg : line)
+      {
+      long p = x, end = x + seg.first;
+      while(p < end)
+        {
+        // Skip the spans that end before this voxel
+        while(sp < sp_end && sp->x1 <= p)
+          ++sp;
+
+        if(sp < sp_end && sp->x0 <= p)
+          {
+          // Paint the part of the run covered by the span
+          long q = std::min(end, sp->x1);
+          LabelType l = PaintLabel(seg.second);
+          append(q - p, l);
+          if(l != seg.second)
+            {
+            if(lc.Count == 0)
+              lc.First = p;
+            lc.Last = q - 1;
+            lc.Count += q - p;
+            lc.Delta.push_back(DeltaRun { p, q - p, (LabelType) (l - seg.second) });
+            }
+          p = q;
+          }
+        else
+          {
+          // Keep the part of the run before the next span
+          long q = sp < sp_end ? std::min(end, sp->x0) : end;
+          append(q - p, seg.second);
+          p = q;
+          }
+        }
+      x = end;
+      }
+
+    if(lc.Count)
+      line.swap(out);
+    }, nullptr);
+
+  // Find the bounding box of the changes
+  long bmin[3] = { rx1, region.GetUpperIndex()[1] + 1, region.GetUpperIndex()[2] + 1 };
+  long bmax[3] = { rx0 - 1, region.GetIndex(1) - 1, region.GetIndex(2) - 1 };
+  for(size_t k = 0; k < n_lines; k++)
+    {
+    const LineChange &lc = changes[k];
+    if(lc.Count)
+      {
+      const Span &s = spans[line_start[k]];
+      m_NumberOfChangedVoxels += lc.Count;
+      bmin[0] = std::min(bmin[0], lc.First);  bmax[0] = std::max(bmax[0], lc.Last);
+      bmin[1] = std::min(bmin[1], s.y);       bmax[1] = std::max(bmax[1], s.y);
+      bmin[2] = std::min(bmin[2], s.z);       bmax[2] = std::max(bmax[2], s.z);
+      }
+    }
+
+  if(m_NumberOfChangedVoxels == 0)
+    return NULL;
+
+  for(unsigned int d = 0; d < 3; d++)
+    {
+    m_ChangedRegion.SetIndex(d, bmin[d]);
+    m_ChangedRegion.SetSize(d, bmax[d] - bmin[d] + 1);
+    }
+
+  // Encode the undo delta over the bounding box, in image order. The lines
+  // with changes are in the same order as the spans.
+  DeltaType *delta = new DeltaType();
+  delta->SetRegion(m_ChangedRegion);
+  size_t bnx = m_ChangedRegion.GetSize(0), k = 0;
+  for(long z = bmin[2]; z <= bmax[2]; z++)
+    {
+    for(long y = bmin[1]; y <= bmax[1]; y++)
+      {
+      while(k < n_lines && (spans[line_start[k]].z < z
+                            || (spans[line_start[k]].z == z && spans[line_start[k]].y < y)))
+        k++;
+
+      if(k == n_lines || spans[line_start[k]].z != z || spans[line_start[k]].y != y
+         || changes[k].Count == 0)
+        {
+        delta->EncodeRun(0, bnx);
+        continue;
+        }
+
+      long x = bmin[0];
+      for(const DeltaRun &run : changes[k].Delta)
+        {
+        delta->EncodeRun(0, run.x - x);
+        delta->EncodeRun(run.value, run.n);
+        x = run.x + run.n;
+        }
+      delta->EncodeRun(0, bmax[0] + 1 - x);
+      }
+    }
+  delta->FinishEncoding();
+
+  target->Modified();
+  return delta;
+}
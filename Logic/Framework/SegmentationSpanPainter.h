@@ -0,0 +1,88 @@
+#ifndef SEGMENTATIONSPANPAINTER_H
+#define SEGMENTATIONSPANPAINTER_H
+
+#include "SNAPCommon.h"
+#include "UndoDataManager.h"
+#include "RLEImage.h"
+#include <itkImageRegion.h>
+#include <vector>
+
+/**
+ * Paints a set of spans, i.e., runs of voxels along the x axis, into a
+ * run-length encoded segmentation image. Spans are produced by the scan
+ * conversion of polygons and of voxelized triangles. The painting rules are
+ * those of SegmentationUpdateIterator: in foreground mode, the active label
+ * is applied subject to the draw-over filter, and in background mode, voxels
+ * with the active label are cleared.
+ *
+ * The spans are applied to the runs of each line directly, without decoding
+ * the line into voxels, and the undo delta is encoded a run at a time over
+ * the bounding box of the voxels that actually changed.
+ */
+class SegmentationSpanPainter
+{
+public:
+  typedef RLEImage<LabelType> LabelImageType;
+  typedef UndoDelta<LabelType> DeltaType;
+  typedef itk::ImageRegion<3> RegionType;
+
+  /** A run of voxels x0 <= x < x1 on the line (y, z) */
+  struct Span
+  {
+    long x0, x1, y, z;
+    Span() : x0(0), x1(0), y(0), z(0) {}
+    Span(long sx0, long sx1, long sy, long sz) : x0(sx0), x1(sx1), y(sy), z(sz) {}
+  };
+
+  typedef std::vector<Span> SpanList;
+
+  SegmentationSpanPainter(LabelType active_label, DrawOverFilter draw_over, bool background = false);
+
+  /** Sort the spans by line and merge the ones that overlap or touch */
+  static void Normalize(SpanList &spans);
+
+  /**
+   * Compute the complement of a set of spans within a region, i.e., the
+   * voxels of the region not covered by any span (for inverted drawing)
+   */
+  static SpanList Complement(const SpanList &spans, const RegionType &region);
+
+  /**
+   * Paint the spans into the target. Spans are clipped to the buffered region
+   * of the target. Returns the undo delta for the changes, which the caller is
+   * responsible for deleting, or NULL if no voxels were changed.
+   */
+  DeltaType *Paint(LabelImageType *target, SpanList spans);
+
+  /** The bounding box of the voxels changed by the last call to Paint() */
+  irisGetMacro(ChangedRegion, const RegionType &)
+
+  /** The number of voxels changed by the last call to Paint() */
+  irisGetMacro(NumberOfChangedVoxels, unsigned long)
+
+protected:
+
+  // Compute the new label of a voxel in a span
+  LabelType PaintLabel(LabelType old_label) const
+  {
+    if(m_Background)
+      return (m_ActiveLabel != 0 && old_label == m_ActiveLabel) ? 0 : old_label;
+
+    if(old_label != m_ActiveLabel &&
+       (m_DrawOver.CoverageMode == PAINT_OVER_ALL ||
+        (m_DrawOver.CoverageMode == PAINT_OVER_ONE && old_label == m_DrawOver.DrawOverLabel) ||
+        (m_DrawOver.CoverageMode == PAINT_OVER_VISIBLE && old_label != 0)))
+      return m_ActiveLabel;
+
+    return old_label;
+  }
+
+  LabelType m_ActiveLabel;
+  DrawOverFilter m_DrawOver;
+  bool m_Background;
+
+  RegionType m_ChangedRegion;
+  unsigned long m_NumberOfChangedVoxels;
+};
+
+#endif // SEGMENTATIONSPANPAINTER_H
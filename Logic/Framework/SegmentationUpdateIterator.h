@@ -131,6 +131,16 @@ public:
   }
 
 
+  /**
+   * Paint with a specified label - respecting the draw-over mask - but only
+   * over voxels that have the clear label
+   */
+  void PaintLabelOverClear(LabelType new_label)
+  {
+    if(m_Iterator.Get() == 0)
+      this->PaintLabel(new_label);
+  }
+
   /**
    * Default painting mode - applies active label using the current draw over mask
    */
@@ -235,7 +245,7 @@ public:
     m_Delta->FinishEncoding();
     if(m_ChangedVoxels > 0)
       {
-      m_Wrapper->PixelsModified();
+      m_Wrapper->PixelsModifiedInRegion(m_Region);
       if(undo_string)
         m_Wrapper->StoreUndoPoint(undo_string, RelinquishDelta());
       return true;
@@ -0,0 +1,183 @@
+#include "DicomHeaderIndex.h"
+#include "itksys/MD5.h"
+#include "itksys/SystemTools.hxx"
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <stdint.h>
+
+// Identifies the file format of the index files
+static const char *DICOM_INDEX_MAGIC = "ITK-SNAP DICOM header index 1";
+
+static void WriteString(std::ostream &os, const std::string &s)
+{
+  uint32_t n = s.size();
+  os.write((const char *) &n, sizeof(n));
+  os.write(s.data(), n);
+}
+
+static bool ReadString(std::istream &is, std::string &s)
+{
+  uint32_t n;
+  if(!is.read((char *) &n, sizeof(n)))
+    return false;
+  s.resize(n);
+  return n == 0 || (bool) is.read(&s[0], n);
+}
+
+template <class T> static void WriteValue(std::ostream &os, T value)
+{
+  os.write((const char *) &value, sizeof(T));
+}
+
+template <class T> static bool ReadValue(std::istream &is, T &value)
+{
+  return (bool) is.read((char *) &value, sizeof(T));
+}
+
+void
+DicomHeaderIndex
+::Load(const std::string &index_dir, const std::string &dicom_dir,
+       const std::string &signature)
+{
+  m_Entries.clear();
+  m_Modified = false;
+  m_Signature = signature;
+  m_Directory = dicom_dir;
+
+  // The index file is named after the MD5 of the directory path
+  char hex_code[33];
+  hex_code[32] = 0;
+  itksysMD5 *md5 = itksysMD5_New();
+  itksysMD5_Initialize(md5);
+  itksysMD5_Append(md5, (unsigned char *) dicom_dir.c_str(), dicom_dir.size());
+  itksysMD5_FinalizeHex(md5, hex_code);
+  itksysMD5_Delete(md5);
+  m_IndexFile = index_dir + "/" + hex_code + ".idx";
+
+  std::ifstream is(m_IndexFile.c_str(), std::ios::binary);
+  if(!is.good())
+    return;
+
+  // Check the header, in case of a collision or a change in the fields
+  std::string magic, sig, dir;
+  if(!ReadString(is, magic) || magic != DICOM_INDEX_MAGIC
+     || !ReadString(is, sig) || sig != signature
+     || !ReadString(is, dir) || dir != dicom_dir)
+    return;
+
+  uint64_t n_entries;
+  if(!ReadValue(is, n_entries))
+    return;
+
+  // Read the entries, discarding everything if the file is truncated
+  EntryMap entries;
+  for(uint64_t i = 0; i < n_entries; i++)
+    {
+    std::string fn;
+    Entry e;
+    int64_t mtime;
+    uint64_t size;
+    uint8_t is_dicom;
+    uint32_t n_values;
+    if(!ReadString(is, fn) || !ReadValue(is, mtime) || !ReadValue(is, size)
+       || !ReadValue(is, is_dicom) || !ReadValue(is, n_values))
+      return;
+
+    e.MTime = (long) mtime;
+    e.Size = (unsigned long) size;
+    e.IsDicom = is_dicom != 0;
+    e.Values.resize(n_values);
+    for(uint32_t j = 0; j < n_values; j++)
+      if(!ReadString(is, e.Values[j]))
+        return;
+
+    entries[fn] = e;
+    }
+
+  m_Entries.swap(entries);
+}
+
+void
+DicomHeaderIndex
+::Save()
+{
+  if(!m_Modified || m_IndexFile.empty())
+    return;
+
+  // Write to a temporary file first, so that a concurrent ITK-SNAP session
+  // never reads a partially written index
+  std::ostringstream fn_tmp;
+  fn_tmp << m_IndexFile << "." << itksys::SystemTools::GetCurrentDateTime("%H%M%S")
+         << "_" << this << ".tmp";
+
+    {
+    std::ofstream os(fn_tmp.str().c_str(), std::ios::binary);
+    WriteString(os, DICOM_INDEX_MAGIC);
+    WriteString(os, m_Signature);
+
+    // The directory is stored to detect hash collisions
+    WriteString(os, m_Directory);
+    WriteValue(os, (uint64_t) m_Entries.size());
+    for(EntryMap::const_iterator it = m_Entries.begin(); it != m_Entries.end(); ++it)
+      {
+      const Entry &e = it->second;
+      WriteString(os, it->first);
+      WriteValue(os, (int64_t) e.MTime);
+      WriteValue(os, (uint64_t) e.Size);
+      WriteValue(os, (uint8_t) (e.IsDicom ? 1 : 0));
+      WriteValue(os, (uint32_t) e.Values.size());
+      for(size_t j = 0; j < e.Values.size(); j++)
+        WriteString(os, e.Values[j]);
+      }
+
+    if(!os.good())
+      {
+      os.close();
+      itksys::SystemTools::RemoveFile(fn_tmp.str());
+      return;
+      }
+    }
+
+  itksys::SystemTools::RenameFile(fn_tmp.str(), m_IndexFile);
+  m_Modified = false;
+}
+
+bool
+DicomHeaderIndex
+::Find(const std::string &filename, long mtime, unsigned long size, Entry &entry) const
+{
+  EntryMap::const_iterator it = m_Entries.find(filename);
+  if(it == m_Entries.end() || it->second.MTime != mtime || it->second.Size != size)
+    return false;
+
+  entry = it->second;
+  return true;
+}
+
+void
+DicomHeaderIndex
+::Insert(const std::string &filename, const Entry &entry)
+{
+  m_Entries[filename] = entry;
+  m_Modified = true;
+}
+
+void
+DicomHeaderIndex
+::Prune(const std::vector<std::string> &filenames)
+{
+  std::set<std::string> keep(filenames.begin(), filenames.end());
+  for(EntryMap::iterator it = m_Entries.begin(); it != m_Entries.end(); )
+    {
+    if(keep.count(it->first))
+      {
+      ++it;
+      }
+    else
+      {
+      m_Entries.erase(it++);
+      m_Modified = true;
+      }
+    }
+}
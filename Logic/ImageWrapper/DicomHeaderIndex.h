@@ -0,0 +1,69 @@
+#ifndef DICOMHEADERINDEX_H
+#define DICOMHEADERINDEX_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+/**
+ * A persistent index of the DICOM header fields read from the files in a
+ * directory, used by GuidedNativeImageIO::ParseDicomDirectory so that a
+ * directory that is browsed again only needs the headers of new or modified
+ * files to be read. Each entry is keyed by the name of the file and is valid
+ * as long as the modification time and the size of the file are unchanged.
+ *
+ * The index of each directory is stored in its own file in an index folder,
+ * named after the MD5 of the directory path. The signature passed to Load()
+ * describes the fields stored for each file (e.g., the list of DICOM tags),
+ * and an index written with a different signature is ignored.
+ */
+class DicomHeaderIndex
+{
+public:
+
+  struct Entry
+  {
+    long MTime;
+    unsigned long Size;
+
+    // Whether the file could be read as DICOM
+    bool IsDicom;
+
+    // The values of the fields, in the order given by the signature
+    std::vector<std::string> Values;
+  };
+
+  DicomHeaderIndex() : m_Modified(false) {}
+
+  /**
+   * Load the index of a directory from the index folder. Missing, unreadable
+   * or out-of-date index files result in an empty index.
+   */
+  void Load(const std::string &index_dir, const std::string &dicom_dir,
+            const std::string &signature);
+
+  /** Save the index, if it has been modified since it was loaded */
+  void Save();
+
+  /** Look up a file, returns false if there is no valid entry for it */
+  bool Find(const std::string &filename, long mtime, unsigned long size, Entry &entry) const;
+
+  /** Add or replace the entry for a file */
+  void Insert(const std::string &filename, const Entry &entry);
+
+  /** Remove the entries for all files not in the given list */
+  void Prune(const std::vector<std::string> &filenames);
+
+  /** Number of entries */
+  size_t GetSize() const { return m_Entries.size(); }
+
+protected:
+
+  typedef std::map<std::string, Entry> EntryMap;
+  EntryMap m_Entries;
+
+  std::string m_IndexFile, m_Directory, m_Signature;
+  bool m_Modified;
+};
+
+#endif // DICOMHEADERINDEX_H
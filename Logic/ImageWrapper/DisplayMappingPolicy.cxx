@@ -170,7 +170,7 @@ CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
   m_LookupTableFilter->SetImageMaxInput(m_Wrapper->GetImageMaxObject());
 
   for(unsigned int i=0; i<3; i++)
-    m_IntensityFilter[i]->SetInput(m_Wrapper->GetSlice(i));
+    m_IntensityFilter[i]->SetSliceInput(0, m_Wrapper->GetSlice(i));
 }
 
 template<class TWrapperTraits>
@@ -595,7 +595,7 @@ MultiChannelDisplayMappingPolicy<TWrapperTraits>
       for(unsigned int j=0; j<3; j++)
         {
         ComponentWrapperType *comp = m_Wrapper->GetComponentWrapper(j);
-        m_RGBMapper[i]->SetInput(j, comp->GetSlice(i));
+        m_RGBMapper[i]->SetSliceInput(j, comp->GetSlice(i));
         }
 
       // Add this filter as the input to the selector
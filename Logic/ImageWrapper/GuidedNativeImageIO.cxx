@@ -36,6 +36,7 @@
 #include "IRISException.h"
 #include "SNAPCommon.h"
 #include "SNAPRegistryIO.h"
+#include "SNAPTrace.h"
 #include "ImageCoordinateGeometry.h"
 
 #include "itkImage.h"
@@ -74,11 +75,17 @@
 #include "MultiFrameDicomSeriesSorter.h"
 #include "itkStringTools.h"
 #include "AllPurposeProgressAccumulator.h"
+#include "NativeImageCastKernels.h"
 
 #include <itk_zlib.h>
 #include "itkImportImageFilter.h"
 #include <algorithm>
 #include "itksys/Base64.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
 
 
 using namespace std;
@@ -458,6 +465,8 @@ void
 GuidedNativeImageIO
 ::ReadNativeImageHeader(const char *FileName, Registry &folder, itk::Command *progressCmd)
 {
+  SNAP_TRACE_SCOPE("io", "GuidedNativeImageIO::ReadNativeImageHeader");
+
 	/* Progress Command Usage:
 	 * We only add progressCmd as observers to each conditional branch, which
 	 * means we don't have shared progress in the header reading method. Assuming
@@ -705,6 +714,11 @@ void
 GuidedNativeImageIO
 ::ReadNativeImageData(itk::Command *progressCmd)
 {
+  SNAP_TRACE_SCOPE("io", "GuidedNativeImageIO::ReadNativeImageData");
+
+  // Any earlier cast refers to the previous image
+  m_CastImage = NULL;
+
   // Based on the component type, read image in native mode
   DispatchBase *dispatch = this->CreateDispatch(m_IOBase->GetComponentType());
 	dispatch->ReadNative(this, m_NativeFileName.c_str(), m_Hints, progressCmd);
@@ -972,6 +986,220 @@ GuidedNativeImageIO
 }
 
 
+/**
+ * Decodes the slices of a DICOM series, one slice per file, on a pool of
+ * threads. Each thread has its own instance of the image IO and decodes the
+ * pixel data of its files directly into the preallocated volume, at the
+ * offset of the slice. The calling thread waits for the slices in order, so
+ * that progress is only reported from the calling thread. A file whose pixel
+ * type or size does not match the volume is not decoded, so that the caller
+ * can fall back on itk::ImageSeriesReader, which converts such files.
+ */
+class DicomSliceDecoder
+{
+public:
+
+  DicomSliceDecoder(const std::vector<std::string> &files, itk::ImageIOBase *io,
+                    itk::IOComponentEnum component_type, size_t slice_bytes,
+                    char *buffer, unsigned int n_threads)
+    : m_Files(files), m_ComponentType(component_type), m_SliceBytes(slice_bytes),
+      m_Buffer(buffer), m_Status(files.size(), PENDING), m_Errors(files.size()),
+      m_NextFile(0), m_Stop(false)
+    {
+    // The IO objects keep the state of the file being read, so each thread
+    // needs its own. They are created here because the factory is not
+    // guaranteed to be thread-safe.
+    for(unsigned int k = 0; k < n_threads; k++)
+      {
+      itk::LightObject::Pointer another = io->CreateAnother();
+      itk::ImageIOBase::Pointer thread_io = dynamic_cast<itk::ImageIOBase *>(another.GetPointer());
+      m_Threads.push_back(std::thread(&DicomSliceDecoder::ThreadMain, this, thread_io));
+      }
+    }
+
+  ~DicomSliceDecoder()
+    {
+    m_Stop = true;
+    for(auto &t : m_Threads)
+      t.join();
+    }
+
+  /**
+   * Wait for slice i. Returns false if the file does not match the volume.
+   * Errors reading the file are rethrown on the calling thread.
+   */
+  bool WaitForSlice(size_t i)
+    {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this, i]() { return m_Status[i] != PENDING; });
+    if(m_Status[i] == FAILED)
+      std::rethrow_exception(m_Errors[i]);
+    return m_Status[i] == DECODED;
+    }
+
+  /** The metadata of the first file, valid once the first slice is decoded */
+  const itk::MetaDataDictionary &GetFirstDictionary() const
+    { return m_FirstDictionary; }
+
+protected:
+
+  enum Status { PENDING, DECODED, MISMATCH, FAILED };
+
+  void ThreadMain(itk::ImageIOBase::Pointer io)
+    {
+    while(!m_Stop)
+      {
+      // Files are taken in order, so when the calling thread gives up on a
+      // slice, all the slices before it have been taken and will complete
+      size_t i = m_NextFile++;
+      if(i >= m_Files.size())
+        return;
+
+      Status status = MISMATCH;
+      std::exception_ptr error;
+      try
+        {
+        if(io)
+          {
+          io->SetFileName(m_Files[i]);
+          io->ReadImageInformation();
+          if(io->GetComponentType() == m_ComponentType
+             && io->GetNumberOfComponents() == 1
+             && io->GetImageSizeInBytes() == m_SliceBytes)
+            {
+            itk::ImageIORegion region(io->GetNumberOfDimensions());
+            for(unsigned int d = 0; d < io->GetNumberOfDimensions(); d++)
+              region.SetSize(d, io->GetDimensions(d));
+            io->SetIORegion(region);
+            io->Read(m_Buffer + i * m_SliceBytes);
+
+            if(i == 0)
+              m_FirstDictionary = io->GetMetaDataDictionary();
+            status = DECODED;
+            }
+          }
+        }
+      catch(...)
+        {
+        error = std::current_exception();
+        status = FAILED;
+        }
+
+        {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Status[i] = status;
+        m_Errors[i] = error;
+        }
+      m_Condition.notify_all();
+
+      // The remaining slices are of no use once one slice fails
+      if(status != DECODED)
+        m_Stop = true;
+      }
+    }
+
+  const std::vector<std::string> &m_Files;
+  itk::IOComponentEnum m_ComponentType;
+  size_t m_SliceBytes;
+  char *m_Buffer;
+
+  std::vector<Status> m_Status;
+  std::vector<std::exception_ptr> m_Errors;
+  itk::MetaDataDictionary m_FirstDictionary;
+
+  std::vector<std::thread> m_Threads;
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::atomic<size_t> m_NextFile;
+  std::atomic<bool> m_Stop;
+};
+
+/**
+ * Decode a list of single-slice DICOM files into consecutive slices of a
+ * buffer, adding the given weight to the progress source. Returns the number
+ * of slices decoded, which is less than the number of files if a file does
+ * not match the buffer, in which case the caller must read the files in
+ * some other way.
+ */
+template <class TScalar>
+static size_t
+DecodeDicomSlices(const std::vector<std::string> &files, itk::ImageIOBase *io,
+                  TScalar *buffer, size_t slice_pixels, itk::MetaDataDictionary &dict,
+                  TrivalProgressSource *progress, double weight)
+{
+  SNAP_TRACE_SCOPE("io", "DecodeDicomSlices");
+
+  // Decoding compressed slices is CPU-bound, so use all cores
+  unsigned int n_threads = std::max(1u, std::thread::hardware_concurrency());
+  n_threads = (unsigned int) std::min((size_t) n_threads, files.size());
+
+  DicomSliceDecoder decoder(files, io, itk::ImageIOBase::MapPixelType<TScalar>::CType,
+                            slice_pixels * sizeof(TScalar),
+                            reinterpret_cast<char *>(buffer), n_threads);
+
+  for(size_t i = 0; i < files.size(); i++)
+    {
+    if(!decoder.WaitForSlice(i))
+      return i;
+    progress->AddProgress(weight / files.size());
+    }
+
+  dict = decoder.GetFirstDictionary();
+  return files.size();
+}
+
+/**
+ * Read a volume from a list of single-slice DICOM files. The geometry of the
+ * volume comes from itk::ImageSeriesReader, which only reads the headers of
+ * the first and last files for it, and the slices are then decoded in
+ * parallel. The series reader is only used to read the pixel data if the
+ * files do not all have the pixel type and size of the volume.
+ */
+template <class TScalar>
+static typename itk::Image<TScalar, 3>::Pointer
+ReadDicomSeriesVolume(const std::vector<std::string> &files, itk::ImageIOBase *io,
+                      itk::MetaDataDictionary &dict,
+                      TrivalProgressSource *progress, double weight)
+{
+  typedef itk::Image<TScalar, 3> GreyImageType;
+  typedef itk::ImageSeriesReader<GreyImageType> SeriesReaderType;
+
+  typename SeriesReaderType::Pointer reader = SeriesReaderType::New();
+  reader->SetFileNames(files);
+  reader->SetImageIO(io);
+  reader->UpdateOutputInformation();
+
+  GreyImageType *info = reader->GetOutput();
+  typename GreyImageType::RegionType region = info->GetLargestPossibleRegion();
+  size_t n_decoded = 0;
+  if(region.GetSize(2) == files.size())
+    {
+    typename GreyImageType::Pointer volume = GreyImageType::New();
+    volume->CopyInformation(info);
+    volume->SetRegions(region);
+    volume->Allocate();
+
+    n_decoded = DecodeDicomSlices<TScalar>(
+          files, io, volume->GetBufferPointer(), region.GetSize(0) * region.GetSize(1),
+          dict, progress, weight);
+    if(n_decoded == files.size())
+      return volume;
+    }
+
+  // Let the series reader handle files that differ in type or size
+  reader->Update();
+  typename GreyImageType::Pointer volume = reader->GetOutput();
+  volume->DisconnectPipeline();
+
+  const typename SeriesReaderType::DictionaryArrayType *darr =
+      reader->GetMetaDataDictionaryArray();
+  if(darr->size() > 0)
+    dict = *((*darr)[0]);
+
+  progress->AddProgress(weight * (files.size() - n_decoded) / files.size());
+  return volume;
+}
+
 template<class TScalar>
 void
 GuidedNativeImageIO
@@ -999,22 +1227,14 @@ GuidedNativeImageIO
 
     if(this->m_DICOMImagesPerIPP == 1)
       {
-      // When there is a single volume
-			typename SeriesReaderType::Pointer reader = SeriesReaderType::New();
-			reader->AddObserver(itk::ProgressEvent(), progressCmd);
-
-      // Set the filenames and read
-      reader->SetFileNames(m_DICOMFiles);
-
-      // Set the IO
-      // typename GDCMImageIO::Pointer dicomio = GDCMImageIO::New();
-      // dicomio->SetMaxSizeLoadEntry(0xffff);
-      // m_IOBase = dicomio;
-      reader->SetImageIO(m_IOBase);
+      // When there is a single volume, the slices are decoded in parallel
+      itk::MetaDataDictionary dict;
+      typename GreyImageType::Pointer volume = ReadDicomSeriesVolume<TScalar>(
+            m_DICOMFiles, m_IOBase, dict, dcmSeriesProgSrc, 1.0);
 
       // Present this scalar as a 4D image
       typename UpDimFilter::Pointer updim = UpDimFilter::New();
-      updim->SetInput(reader->GetOutput());
+      updim->SetInput(volume);
       updim->Update();
       GreyImage4DType *scalar = updim->GetOutput();
 
@@ -1026,12 +1246,7 @@ GuidedNativeImageIO
 			ConvertToVectorImage<TScalar>(vector, scalar);
 
       // Copy the metadata from the first scan in the series
-			const typename SeriesReaderType::DictionaryArrayType *darr =
-        reader->GetMetaDataDictionaryArray();
-      if(darr->size() > 0)
-        m_NativeImage->SetMetaDataDictionary(*((*darr)[0]));
-
-			dcmSeriesProgSrc->AddProgress(1.0);
+      m_NativeImage->SetMetaDataDictionary(dict);
       }
     else
       {
@@ -1043,9 +1258,9 @@ GuidedNativeImageIO
       typedef itk::StreamingImageFilter<NativeImageType,NativeImageType> StreamingFilter;
       typename StreamingFilter::Pointer streamer = StreamingFilter::New();
 
-      // Create separate volume readers
+      // Read the volumes one after the other, decoding the slices of each in parallel
       int n_slices = m_DICOMFiles.size() / m_DICOMImagesPerIPP;
-			std::vector<typename SeriesReaderType::Pointer> readers(m_DICOMImagesPerIPP);
+      std::vector<typename GreyImageType::Pointer> volumes(m_DICOMImagesPerIPP);
       std::vector<typename UpDimFilter::Pointer> updims(m_DICOMImagesPerIPP);
       for(int i = 0; i < this->m_DICOMImagesPerIPP; i++)
         {
@@ -1055,12 +1270,12 @@ GuidedNativeImageIO
           myFiles.push_back(m_DICOMFiles[s * m_DICOMImagesPerIPP + i]);
 
         // Read the current volume
-				readers[i] = SeriesReaderType::New();
-        readers[i]->SetFileNames(myFiles);
-        readers[i]->SetImageIO(m_IOBase);
+        itk::MetaDataDictionary dict;
+        volumes[i] = ReadDicomSeriesVolume<TScalar>(
+              myFiles, m_IOBase, dict, dcmSeriesProgSrc, 1.0 / m_DICOMImagesPerIPP);
 
         updims[i] = UpDimFilter::New();
-        updims[i]->SetInput(readers[i]->GetOutput());
+        updims[i]->SetInput(volumes[i]);
 
         // Input to the composer
         composer->SetInput(i, updims[i]->GetOutput());
@@ -1079,9 +1294,9 @@ GuidedNativeImageIO
 
       // Set the number of components
       m_NativeComponents = m_DICOMImagesPerIPP;
-
-			dcmSeriesProgSrc->AddProgress(1.0);
       }
+
+    dcmSeriesProgSrc->EndProgress();
     } 
 	else if (m_FileFormat == FORMAT_DICOM_DIR_4DCTA)
 		{
@@ -1094,26 +1309,23 @@ GuidedNativeImageIO
 
 		const float weightReading = 0.7, weightLoading = 0.25, weightMisc = 0.05;
 		float readingDelta = weightReading/m_DicomFilesToFrameMap.size();
+		float loadingDelta = weightLoading/m_DicomFilesToFrameMap.size();
 
-		std::map<unsigned int, typename GreyImageType::Pointer> frameContainer;
-
-		// read image frame by frame
+		// file names of each frame, in the order of the frames
+		std::vector<MFDS::FilenamesList> frameFiles;
 		for (auto &kv : m_DicomFilesToFrameMap)
 			{
 			MFDS::FilenamesList fnlist;
 			for (auto &df : kv.second)
 				fnlist.push_back(df.m_Filename);
-
-			reader->SetFileNames(fnlist);
-			reader->Update();
-
-			typename GreyImageType::Pointer crntImg = GreyImageType::New();
-			DeepCopyImage<GreyImageType>(crntImg, reader->GetOutput());
-			frameContainer[kv.first] = crntImg;
-
-			progSrc->AddProgress(readingDelta);
+			frameFiles.push_back(fnlist);
 			}
 
+		// the geometry of the first frame only requires reading two headers
+		reader->SetFileNames(frameFiles.front());
+		reader->UpdateOutputInformation();
+		GreyImageType *first3dImg = reader->GetOutput();
+
 		// assemble 3d images into the 4d native image
 		// -- set first 3 dimensions
 		typename GreyImage4DType::PointType origin4d;
@@ -1121,8 +1333,6 @@ GuidedNativeImageIO
 		typename GreyImage4DType::SpacingType spacing4d;
 		typename GreyImage4DType::RegionType region4d;
 
-		auto first3dImg = frameContainer[1];
-
 		for (int i = 0; i < 3; ++i)
 			{
 			origin4d[i] = first3dImg->GetOrigin()[i];
@@ -1148,7 +1358,7 @@ GuidedNativeImageIO
 
 		// region Corner Index: [x, x, x, 0], Size: [x, x, x, nt]
 		region4d.SetIndex(3, 0);
-		region4d.SetSize(3, frameContainer.size()); // number of time points
+		region4d.SetSize(3, frameFiles.size()); // number of time points
 
 		typename GreyImage4DType::Pointer image4D = GreyImage4DType::New();
 		image4D->SetOrigin(origin4d);
@@ -1158,23 +1368,62 @@ GuidedNativeImageIO
 		image4D->SetNumberOfComponentsPerPixel(first3dImg->GetNumberOfComponentsPerPixel());
 		image4D->Allocate();
 
-		itk::ImageRegionIterator<GreyImage4DType> it4d(image4D, image4D->GetLargestPossibleRegion());
+		// when every frame has one file per slice, the slices of all the frames
+		// are decoded in parallel, straight into their place in the 4d image
+		MFDS::FilenamesList allFiles;
+		for (auto &fnlist : frameFiles)
+			{
+			if (fnlist.size() != region4d.GetSize(2))
+				{
+				allFiles.clear();
+				break;
+				}
+			allFiles.insert(allFiles.end(), fnlist.begin(), fnlist.end());
+			}
 
-		float loadingDelta = weightLoading/frameContainer.size();
+		itk::MetaDataDictionary dict;
+		size_t nDecoded = 0;
+		if (allFiles.size())
+			{
+			nDecoded = DecodeDicomSlices<TScalar>(
+						allFiles, m_IOBase, image4D->GetBufferPointer(),
+						region4d.GetSize(0) * region4d.GetSize(1), dict,
+						progSrc, weightReading + weightLoading);
+			}
 
-		for (size_t i = 0; i < frameContainer.size(); ++i)
+		if (allFiles.empty() || nDecoded < allFiles.size())
 			{
-			auto crntTP = i + 1;
-			auto crntImg = frameContainer[crntTP];
+			// otherwise, read image frame by frame
+			if (nDecoded)
+				{
+				float remaining = 1.0f - (float) nDecoded / allFiles.size();
+				readingDelta *= remaining;
+				loadingDelta *= remaining;
+				}
 
-			itk::ImageRegionConstIterator<GreyImageType> it3d(crntImg, crntImg->GetLargestPossibleRegion());
-			while (!it3d.IsAtEnd())
+			itk::ImageRegionIterator<GreyImage4DType> it4d(image4D, image4D->GetLargestPossibleRegion());
+			for (auto &fnlist : frameFiles)
 				{
-				it4d.Set(it3d.Get());
-				++it3d;
-				++it4d;
+				reader->SetFileNames(fnlist);
+				reader->Update();
+				progSrc->AddProgress(readingDelta);
+
+				GreyImageType *crntImg = reader->GetOutput();
+				itk::ImageRegionConstIterator<GreyImageType> it3d(crntImg, crntImg->GetLargestPossibleRegion());
+				while (!it3d.IsAtEnd())
+					{
+					it4d.Set(it3d.Get());
+					++it3d;
+					++it4d;
+					}
+				progSrc->AddProgress(loadingDelta);
 				}
-			progSrc->AddProgress(loadingDelta);
+
+			// Copy the metadata from the first scan in the series
+			const typename SeriesReaderType::DictionaryArrayType *darr =
+				reader->GetMetaDataDictionaryArray();
+			if(darr->size() > 0)
+				dict = *((*darr)[0]);
 			}
 
 		// Convert the image into VectorImage format. Do this in-place to avoid
@@ -1183,12 +1432,7 @@ GuidedNativeImageIO
 		m_NativeImage = vector;
 
 		ConvertToVectorImage<TScalar>(vector, image4D);
-
-		// Copy the metadata from the first scan in the series
-		const typename SeriesReaderType::DictionaryArrayType *darr =
-			reader->GetMetaDataDictionaryArray();
-		if(darr->size() > 0)
-			m_NativeImage->SetMetaDataDictionary(*((*darr)[0]));
+		m_NativeImage->SetMetaDataDictionary(dict);
 
 		progSrc->AddProgress(weightMisc);
 		progSrc->EndProgress();
@@ -1572,6 +1816,16 @@ typename RescaleNativeImageToIntegralType<TOutputImage>::OutputImageType *
 RescaleNativeImageToIntegralType<TOutputImage>::operator()(
     GuidedNativeImageIO *nativeIO)
 {
+  // The image may have been cast to this type already
+  OutputImageType *cast = dynamic_cast<OutputImageType *>(nativeIO->GetCastImage());
+  if(cast)
+    {
+    m_Output = cast;
+    m_NativeScale = nativeIO->GetCastNativeScale();
+    m_NativeShift = nativeIO->GetCastNativeShift();
+    return m_Output;
+    }
+
   // Get the native image pointer
   auto *native = nativeIO->GetNativeImage();
 
@@ -1713,17 +1967,10 @@ RescaleNativeImageToIntegralType<TOutputImage>
     // Scan over all the image components. Avoid using iterators here because of
     // unnecessary overhead for vector images.
     TNative *ib_begin = input->GetBufferPointer();
-    TNative *ib_end = ib_begin + input->GetPixelContainer()->Size();
+    size_t nval = input->GetPixelContainer()->Size();
 
-    TNative imin_nat = *ib_begin, imax_nat = *ib_begin;
-
-    // Iterate over all the components in the input image
-    for(TNative *buffer = ib_begin + 1; buffer < ib_end; ++buffer)
-      {
-      TNative val = *buffer;
-      if(val < imin_nat) imin_nat = val;
-      if(val > imax_nat) imax_nat = val;
-      }
+    TNative imin_nat, imax_nat;
+    NativeImageCastKernels::ComputeRange(ib_begin, nval, imin_nat, imax_nat);
 
     // Cast the values to double
     double imin = static_cast<double>(imin_nat), imax = static_cast<double>(imax_nat);
@@ -1737,16 +1984,9 @@ RescaleNativeImageToIntegralType<TOutputImage>
       bool isint = false;
       if(1.0 * omin <= imin && 1.0 * omax >= imax && ncomp == 1)
         {
-        isint = true;
-
         // Another pass through the image? Why is this necessary?
-        for(TNative *buffer = ib_begin; buffer < ib_end; ++buffer)
-          {
-          TNative vin = *buffer;
-          TNative vcmp = static_cast<TNative>(static_cast<OutputComponentType>(vin + 0.5));
-          if(vin != vcmp)
-            { isint = false; break; }
-          }
+        isint = NativeImageCastKernels::IsIntegerValued<TNative, OutputComponentType>(
+              ib_begin, nval);
         }
 
       // If underlying data is really integer, no scale or shift is necessary
@@ -1930,22 +2170,10 @@ CastNativeImage<TOutputImage,TCastFunctor>
   // same than the target image, we want to proceed in ascending order, since each
   // input element will be replaced by one or more output elements. But if the
   // native image is smaller, we want to proceed from the end of the memory
-  // block in a descending order, so that the native data is not overridden
+  // block in a descending order, so that the native data is not overridden.
+  // CastInPlace does this in parallel chunks, see NativeImageCastKernels.h
   unsigned long nval =  nvoxels * ncomp;
-  if(szTarget > szNative)
-    {
-    TNative *pn = ib + nval - 1;
-    OutputComponentType *pt = ob + nval - 1;
-    for(; pt >= ob; pt--, pn--)
-      m_Functor(pn, pt);
-    }
-  else
-    {
-    TNative *pn = ib;
-    OutputComponentType *pt = ob;
-    for(; pt < ob + nval; pt++, pn++)
-      m_Functor(pn, pt);
-    }
+  NativeImageCastKernels::CastInPlace<TNative, OutputComponentType>(ib, nval, m_Functor);
 
   // If needed, squeeze the memory
   if(nbTarget < nbNative)
@@ -2067,11 +2295,130 @@ const gdcm::Tag GuidedNativeImageIO::m_tagSliceThickness(0x0018, 0x0050);
 
 #include "gdcmDirectory.h"
 #include "gdcmImageReader.h"
+#include "DicomHeaderIndex.h"
+
+std::string GuidedNativeImageIO::m_DicomIndexDirectory;
+
+void
+GuidedNativeImageIO
+::SetDicomIndexDirectory(const std::string &dir)
+{
+  m_DicomIndexDirectory = dir;
+}
+
+/**
+ * Reads selected tags from the headers of a list of files on a pool of
+ * threads. Files that have an up-to-date entry in the index are not read.
+ * The calling thread waits for the files in order, so that the parse results
+ * do not depend on the order in which the threads finish.
+ */
+class DicomHeaderScanner
+{
+public:
+
+  typedef DicomHeaderIndex::Entry Entry;
+
+  DicomHeaderScanner(const std::vector<std::string> &files,
+                     const std::vector<gdcm::Tag> &tags,
+                     const DicomHeaderIndex &index,
+                     unsigned int n_threads)
+    : m_Files(files), m_Tags(tags), m_Index(index),
+      m_Entries(files.size()), m_Done(files.size(), false), m_Indexed(files.size(), false),
+      m_NextFile(0), m_Stop(false)
+    {
+    m_TagSet.insert(tags.begin(), tags.end());
+    for(unsigned int k = 0; k < n_threads; k++)
+      m_Threads.push_back(std::thread(&DicomHeaderScanner::ThreadMain, this));
+    }
+
+  ~DicomHeaderScanner()
+    {
+    m_Stop = true;
+    for(auto &t : m_Threads)
+      t.join();
+    }
+
+  /** Wait for the header of file i. Sets indexed if it came from the index */
+  const Entry &WaitForFile(size_t i, bool &indexed)
+    {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this, i]() { return (bool) m_Done[i]; });
+    indexed = m_Indexed[i];
+    return m_Entries[i];
+    }
+
+protected:
+
+  void ThreadMain()
+    {
+    while(!m_Stop)
+      {
+      size_t i = m_NextFile++;
+      if(i >= m_Files.size())
+        return;
+
+      const std::string &fn = m_Files[i];
+      Entry entry;
+      entry.MTime = itksys::SystemTools::ModifiedTime(fn);
+      entry.Size = itksys::SystemTools::FileLength(fn);
+
+      // Use the index entry if the file has not changed since it was made
+      Entry cached;
+      bool indexed = m_Index.Find(fn, entry.MTime, entry.Size, cached)
+          && (!cached.IsDicom || cached.Values.size() == m_Tags.size());
+      if(indexed)
+        {
+        entry = cached;
+        }
+      else
+        {
+        // Try reading this file. Fail quietly.
+        gdcm::Reader reader;
+        reader.SetFileName(fn.c_str());
+        entry.IsDicom = false;
+        try { entry.IsDicom = reader.ReadSelectedTags(m_TagSet, true); }
+        catch(...) {}
+
+        if(entry.IsDicom)
+          {
+          gdcm::StringFilter sf;
+          sf.SetFile(reader.GetFile());
+          for(size_t j = 0; j < m_Tags.size(); j++)
+            entry.Values.push_back(sf.ToString(m_Tags[j]));
+          }
+        }
+
+        {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Entries[i] = entry;
+        m_Indexed[i] = indexed;
+        m_Done[i] = true;
+        }
+      m_Condition.notify_all();
+      }
+    }
+
+  const std::vector<std::string> &m_Files;
+  const std::vector<gdcm::Tag> &m_Tags;
+  std::set<gdcm::Tag> m_TagSet;
+  const DicomHeaderIndex &m_Index;
+
+  std::vector<Entry> m_Entries;
+  std::vector<bool> m_Done, m_Indexed;
+
+  std::vector<std::thread> m_Threads;
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::atomic<size_t> m_NextFile;
+  std::atomic<bool> m_Stop;
+};
 
 void
 GuidedNativeImageIO
 ::ParseDicomDirectory(const std::string &dir, itk::Command *progressCommand)
 {
+  SNAP_TRACE_SCOPE("io", "GuidedNativeImageIO::ParseDicomDirectory");
+
   // We will parse the DICOM directory manually to avoid extra time opening
   // files and also to allow progress reporting
 
@@ -2090,15 +2437,17 @@ GuidedNativeImageIO
   tags_refine.push_back(m_tagRows);
   tags_refine.push_back(m_tagCols);
 
-  // List of tags that we want to parse - everything else may be ignored
-  std::set<gdcm::Tag> tags_all;
-  tags_all.insert(tags_refine.begin(), tags_refine.end());
-  tags_all.insert(m_tagDesc);
-  tags_all.insert(m_tagSeriesInstanceUID);
+  // List of tags that we want to parse - everything else may be ignored. The
+  // values are stored in the index in this order
+  std::vector<gdcm::Tag> tags_all;
+  tags_all.push_back(m_tagSeriesInstanceUID);
+  tags_all.push_back(m_tagDesc);
+  tags_all.insert(tags_all.end(), tags_refine.begin(), tags_refine.end());
 
-  //--Dev: Add to read list
-  std::set<std::string> sliceLocSet;
-  std::map<std::string, std::set<std::string>> sliceMap;
+  // The signature of the index describes the tags that it stores
+  std::ostringstream sig;
+  for(size_t j = 0; j < tags_all.size(); j++)
+    sig << std::hex << tags_all[j].GetGroup() << "," << tags_all[j].GetElement() << ";";
 
   // Clear the information about the last parse
   m_LastDicomParseResult.Reset();
@@ -2110,96 +2459,121 @@ GuidedNativeImageIO
   // Load the directory - this should be quick
   dirList.Load(dir, false);
   gdcm::Directory::FilenamesType const &filenames = dirList.GetFilenames();
-  for(gdcm::Directory::FilenamesType::const_iterator it = filenames.begin();
-    it != filenames.end(); ++it)
-    {
-    // Process each filename in the directory
-    gdcm::Reader reader;
-    reader.SetFileName(it->c_str());
-
-    // Try reading this file. Fail quietly.
-    bool read = false;
-    try { read = reader.ReadSelectedTags(tags_all, true); }
-    catch(...) {}
 
-    // If nothing read, keep going
-    if(!read)
-      continue;
+  // Load the index of headers read in previous scans of this directory
+  DicomHeaderIndex index;
+  if(m_DicomIndexDirectory.size())
+    index.Load(m_DicomIndexDirectory, dir, sig.str());
 
-    // Create a string filter to get tags
-    gdcm::StringFilter sf;
-    sf.SetFile(reader.GetFile());
+  // Reading headers is dominated by file system latency, especially on network
+  // drives, so we use more threads than there are cores
+  unsigned int n_threads = (unsigned int) std::min(
+        filenames.size(), (size_t) std::min(8u, std::max(2u, 2 * std::thread::hardware_concurrency())));
 
-    // Start with the ID being the UID
-    std::string uid = sf.ToString(m_tagSeriesInstanceUID);
-    std::string full_id = uid;
+  // Headers that were read in this scan, to be added to the index
+  std::vector<std::pair<std::string, DicomHeaderIndex::Entry> > new_entries;
 
-    // Iterate over the tags in the refine list
-		for(size_t iTag = 0u; iTag < tags_refine.size(); iTag++)
+    {
+    DicomHeaderScanner scanner(filenames, tags_all, index, n_threads);
+    for(size_t iFile = 0; iFile < filenames.size(); iFile++)
       {
-      // Read the tag value
-      std::string s = sf.ToString(tags_refine[iTag]);
+      const std::string &fn = filenames[iFile];
+      bool indexed;
+      const DicomHeaderIndex::Entry &entry = scanner.WaitForFile(iFile, indexed);
+      if(!indexed)
+        new_entries.push_back(std::make_pair(fn, entry));
+
+      // If nothing read, keep going
+      if(!entry.IsDicom)
+        continue;
+
+      // Look up a tag value
+      auto tag_value = [&](const gdcm::Tag &tag) -> const std::string &
+        {
+        return entry.Values[std::find(tags_all.begin(), tags_all.end(), tag) - tags_all.begin()];
+        };
 
-      // This code is from gdcmSerieHelper
-      if( full_id == uid && !s.empty() )
+      // Start with the ID being the UID
+      std::string uid = tag_value(m_tagSeriesInstanceUID);
+      std::string full_id = uid;
+
+      // Iterate over the tags in the refine list
+      for(size_t iTag = 0u; iTag < tags_refine.size(); iTag++)
         {
-        full_id += "."; // add separator
+        // Read the tag value
+        std::string s = tag_value(tags_refine[iTag]);
+
+        // This code is from gdcmSerieHelper
+        if( full_id == uid && !s.empty() )
+          {
+          full_id += "."; // add separator
+          }
+        full_id += s;
         }
-      full_id += s;
-      }
 
-    // Eliminate non-alnum characters, including whitespace...
-    //   that may have been introduced by concats.
-    for(size_t i=0; i<full_id.size(); i++)
-      {
-      while(i<full_id.size()
-        && !( full_id[i] == '.'
-          || (full_id[i] >= 'a' && full_id[i] <= 'z')
-          || (full_id[i] >= '0' && full_id[i] <= '9')
-          || (full_id[i] >= 'A' && full_id[i] <= 'Z')))
+      // Eliminate non-alnum characters, including whitespace...
+      //   that may have been introduced by concats.
+      for(size_t i=0; i<full_id.size(); i++)
         {
-        full_id.erase(i, 1);
+        while(i<full_id.size()
+          && !( full_id[i] == '.'
+            || (full_id[i] >= 'a' && full_id[i] <= 'z')
+            || (full_id[i] >= '0' && full_id[i] <= '9')
+            || (full_id[i] >= 'A' && full_id[i] <= 'Z')))
+          {
+          full_id.erase(i, 1);
+          }
         }
-      }
 
-    // The info for the current series
-    DicomDirectoryParseResult::DicomSeriesInfo &series_info
-        = m_LastDicomParseResult.SeriesMap[full_id];
+      // The info for the current series
+      DicomDirectoryParseResult::DicomSeriesInfo &series_info
+          = m_LastDicomParseResult.SeriesMap[full_id];
 
-    // The registry for the current series
-    Registry &r = series_info.MetaData;
+      // The registry for the current series
+      Registry &r = series_info.MetaData;
 
-    // Have we found this ID before?
-    if(r.IsEmpty())
-      {
-      r["SeriesId"] << full_id;
+      // Have we found this ID before?
+      if(r.IsEmpty())
+        {
+        r["SeriesId"] << full_id;
 
-      // Read series description
-      r["SeriesDescription"] << sf.ToString(m_tagDesc);
-      r["SeriesNumber"] << sf.ToString(m_tagSeriesNumber);
+        // Read series description
+        r["SeriesDescription"] << tag_value(m_tagDesc);
+        r["SeriesNumber"] << tag_value(m_tagSeriesNumber);
 
-      // Read the dimensions
-      r["Rows"] << std::atoi(sf.ToString(m_tagRows).c_str());
-      r["Columns"] << std::atoi(sf.ToString(m_tagCols).c_str());
-      r["NumberOfImages"] << 1;
-      }
-    else
-      {
-      // Increement the number of images
-      r["NumberOfImages"] << r["NumberOfImages"][0] + 1;
-      }
+        // Read the dimensions
+        r["Rows"] << std::atoi(tag_value(m_tagRows).c_str());
+        r["Columns"] << std::atoi(tag_value(m_tagCols).c_str());
+        r["NumberOfImages"] << 1;
+        }
+      else
+        {
+        // Increement the number of images
+        r["NumberOfImages"] << r["NumberOfImages"][0] + 1;
+        }
 
-    // Update the dimensions string
-    ostringstream oss;
-    oss << r["Rows"][0] << " x " << r["Columns"][0] << " x " << r["NumberOfImages"][0];
-    r["Dimensions"] << oss.str();
+      // Update the dimensions string
+      ostringstream oss;
+      oss << r["Rows"][0] << " x " << r["Columns"][0] << " x " << r["NumberOfImages"][0];
+      r["Dimensions"] << oss.str();
 
-    // Update the filelist
-    series_info.FileList.push_back(*it);
+      // Update the filelist
+      series_info.FileList.push_back(fn);
 
-    // Indicate some progress
-    if(progressCommand)
-      progressCommand->Execute(this, itk::ProgressEvent());
+      // Indicate some progress
+      if(progressCommand)
+        progressCommand->Execute(this, itk::ProgressEvent());
+      }
+    }
+
+  // Update the index with the headers that were read, and forget the files
+  // that are no longer in the directory
+  if(m_DicomIndexDirectory.size())
+    {
+    for(size_t i = 0; i < new_entries.size(); i++)
+      index.Insert(new_entries[i].first, new_entries[i].second);
+    index.Prune(filenames);
+    index.Save();
     }
 
   // Complain if no series have been found
@@ -198,6 +198,27 @@ public:
   bool IsNativeImageLoaded() const
     { return m_NativeImage.IsNotNull(); }
 
+  /**
+   * Store the result of casting the native image to an internal image type,
+   * along with the scale and shift that map it back to native intensities.
+   * This allows the cast to be performed ahead of time, e.g., on the thread
+   * that read the image. RescaleNativeImageToIntegralType returns this image
+   * instead of casting again if the output type matches.
+   */
+  void SetCastImage(itk::DataObject *image, double native_scale, double native_shift)
+    {
+    m_CastImage = image;
+    m_CastNativeScale = native_scale;
+    m_CastNativeShift = native_shift;
+    }
+
+  /** Get the image stored by SetCastImage(), or NULL */
+  itk::DataObject *GetCastImage() const
+    { return m_CastImage; }
+
+  irisGetMacro(CastNativeScale, double)
+  irisGetMacro(CastNativeShift, double)
+
   /** 
    * Save the native image it its native format (to a different location and
    * filename, presumably). This function is not meant as part of the normal
@@ -281,6 +302,15 @@ public:
    */
   itkGetConstReferenceMacro(LastDicomParseResult, DicomDirectoryParseResult)
 
+  /**
+   * Set the directory where ParseDicomDirectory() keeps an index of the
+   * headers of the files in each directory it has parsed, so that parsing a
+   * directory again only reads the headers of new or modified files. The
+   * setting applies to all instances. If the directory is empty (default),
+   * no index is kept.
+   */
+  static void SetDicomIndexDirectory(const std::string &dir);
+
   /**
    * Create an ImageIO object using a registry folder. Second parameter is
    * true for reading the file, false for writing the file
@@ -394,12 +424,19 @@ protected:
    */
   ImageBasePointer m_NativeImage;
 
+  // The native image cast to an internal type ahead of time, if any
+  SmartPtr<itk::DataObject> m_CastImage;
+  double m_CastNativeScale = 1.0, m_CastNativeShift = 0.0;
+
   // The IO base used to read the files
   IOBasePointer m_IOBase;
 
   // DICOM directory last processed by ParseDicomSeries
   DicomDirectoryParseResult m_LastDicomParseResult;
 
+  // Directory of the DICOM header indices, shared by all instances
+  static std::string m_DicomIndexDirectory;
+
   // This information is copied from IOBase in order to delete IOBase at the 
   // earliest possible point, so as to conserve memory
   itk::IOComponentEnum m_NativeType;
@@ -45,6 +45,7 @@
 #include "ImageWrapperTraits.h"
 #include "AdaptiveSlicingPipeline.h"
 #include "itkRegionOfInterestImageFilter.h"
+#include "itkImportImageContainer.h"
 #include "SNAPSegmentationROISettings.h"
 #include "itkCommand.h"
 #include "ImageCoordinateGeometry.h"
@@ -69,6 +70,7 @@
 #include "MetaDataAccess.h"
 #include "itkCastImageFilter.h"
 #include "RLEImageRegionConstIterator.h"
+#include "RLEImageStreamWriter.h"
 #include "TDigestImageFilter.h"
 #include "AllPurposeProgressAccumulator.h"
 
@@ -118,6 +120,37 @@ void CopyInformationFrom4DToTimePoint(Image4DType *image_4d, ImageType *image_tp
 }
 
 
+/**
+ * A pixel container that references a block of memory owned by another
+ * container, such as the buffer of a region of interest within a larger image.
+ * The container holding the memory is kept alive as long as the view exists.
+ */
+template <class TElement>
+class RegionViewPixelContainer : public itk::ImportImageContainer<itk::SizeValueType, TElement>
+{
+public:
+  typedef RegionViewPixelContainer Self;
+  typedef itk::ImportImageContainer<itk::SizeValueType, TElement> Superclass;
+  typedef itk::SmartPointer<Self> Pointer;
+  typedef itk::SmartPointer<const Self> ConstPointer;
+
+  itkNewMacro(Self)
+  itkTypeMacro(RegionViewPixelContainer, ImportImageContainer)
+
+  /** Reference the memory of another container, starting at an offset */
+  void SetView(Superclass *owner, itk::SizeValueType offset, itk::SizeValueType size)
+  {
+    m_Owner = owner;
+    this->SetImportPointer(owner->GetImportPointer() + offset, size, false);
+  }
+
+protected:
+  RegionViewPixelContainer() {}
+
+  typename Superclass::Pointer m_Owner;
+};
+
+
 /* ================================================================================
  * IMAGE-LEVEL PARTIAL SPECIALIZATION CODE
  * ================================================================================ */
@@ -211,6 +244,15 @@ public:
     return NULL;
   }
 
+  // Region views are optional, so there is no exception here: the caller
+  // falls back to copying the region
+  static SmartPtr<ImageType> CreateRegionView(ImageType *itkNotUsed(image),
+                                              Image4DType *itkNotUsed(image_4d),
+                                              const itk::ImageRegion<3> &itkNotUsed(roi))
+  {
+    return NULL;
+  }
+
   static void ConfigureTimePointImageFromImage4D(Image4DType *image_4d,
                                                  ImageType *itkNotUsed(image_tp),
                                                  unsigned int itkNotUsed(tp))
@@ -386,6 +428,57 @@ public:
       }
   }
 
+  /**
+   * Create an image that references the voxels of a region of a time point
+   * image in place, without copying them. This is only possible when the
+   * region occupies a contiguous block of the buffer, i.e., it spans the whole
+   * image along all but the last of the dimensions in which it is more than
+   * one voxel thick. Otherwise NULL is returned. The resulting image has the
+   * same geometry as the output of DeepCopyImageRegion without resampling.
+   */
+  static SmartPtr<ImageType> CreateRegionView(ImageType *image,
+                                              Image4DType *image_4d,
+                                              const itk::ImageRegion<3> &roi)
+  {
+    typedef typename ImageType::RegionType RegionType;
+    const RegionType &buffered = image->GetBufferedRegion();
+    if(!buffered.IsInside(roi))
+      return NULL;
+
+    bool partial = false;
+    for(unsigned int d = 0; d < 3; d++)
+      {
+      if(partial && roi.GetSize(d) > 1)
+        return NULL;
+      if(roi.GetSize(d) < buffered.GetSize(d))
+        partial = true;
+      }
+
+    // The offset of the region in the buffer of the 4D image, which owns the
+    // memory of all the time points
+    itk::SizeValueType ncomp = ImagePartialSpecialization<ImageType>::GetNumberOfComponents(image);
+    itk::SizeValueType offset =
+        (image->GetBufferPointer() - image_4d->GetBufferPointer())
+        + image->ComputeOffset(roi.GetIndex()) * ncomp;
+
+    typedef RegionViewPixelContainer<InternalPixelType> ViewContainer;
+    typename ViewContainer::Pointer container = ViewContainer::New();
+    container->SetView(image_4d->GetPixelContainer(), offset, roi.GetNumberOfPixels() * ncomp);
+
+    // Same geometry as RegionOfInterestImageFilter: zero index, shifted origin
+    typename ImageType::PointType origin;
+    image->TransformIndexToPhysicalPoint(roi.GetIndex(), origin);
+
+    SmartPtr<ImageType> view = ImageType::New();
+    view->SetRegions(RegionType(roi.GetSize()));
+    view->SetSpacing(image->GetSpacing());
+    view->SetOrigin(origin);
+    view->SetDirection(image->GetDirection());
+    view->SetNumberOfComponentsPerPixel(image->GetNumberOfComponentsPerPixel());
+    view->SetPixelContainer(container);
+    return view;
+  }
+
   static void ConfigureTimePointImageFromImage4D(Image4DType *image_4d,
                                                  ImageType *image_tp,
                                                  unsigned int tp)
@@ -651,6 +744,22 @@ public:
 
   template <class TSavedImage> static void Write(TSavedImage *image, const char *fname, Registry &hints)
   {
+    SmartPtr<GuidedNativeImageIO> io = GuidedNativeImageIO::New();
+    io->CreateImageIO(fname, hints, false);
+    itk::ImageIOBase *base = io->GetIOBase();
+
+    // NIfTI and MetaImage files are written directly from the run-length
+    // lines, without decompressing the whole image first
+    RLEImageStreamWriter<TSavedImage> streamer;
+    streamer.SetInput(image);
+    streamer.SetFileName(fname);
+    streamer.SetImageIO(base);
+    if(streamer.CanStreamWrite())
+      {
+      streamer.Update();
+      return;
+      }
+
     //use specialized RoI filter to convert to itk::Image
     typedef itk::Image<TPixel, TSavedImage::ImageDimension> UncompressedType;
     typedef itk::RegionOfInterestImageFilter<TSavedImage, UncompressedType> outConverterType;
@@ -660,10 +769,6 @@ public:
     outConv->Update();
     typename UncompressedType::Pointer imgUncompressed = outConv->GetOutput();
 
-    SmartPtr<GuidedNativeImageIO> io = GuidedNativeImageIO::New();
-    io->CreateImageIO(fname, hints, false);
-    itk::ImageIOBase *base = io->GetIOBase();
-
     typedef itk::ImageFileWriter<UncompressedType> WriterType;
     typename WriterType::Pointer writer = WriterType::New();
     writer->SetFileName(fname);
@@ -1900,6 +2005,14 @@ ImageWrapper<TTraits>
     m_Slicers[i]->SetSliceIndex(cursor);
 }
 
+template<class TTraits>
+void
+ImageWrapper<TTraits>
+::PrefetchSlices(unsigned int display_slice, int direction, unsigned int n)
+{
+  m_Slicers[display_slice]->PrefetchSlices(direction, n);
+}
+
 template<class TTraits>
 void
 ImageWrapper<TTraits>
@@ -2695,8 +2808,18 @@ ImageWrapper<TTraits>
 ::ExtractROI(const SNAPSegmentationROISettings &roi,
              itk::Command *progressCommand) const
 {
-  // Get the ITK image for the ROI (it will be a single time point image)
-  ImagePointer newImage = this->DeepCopyRegion(roi, progressCommand);
+  typedef ImageWrapperPartialSpecializationTraits<ImageType, Image4DType> Specialization;
+
+  // Get the ITK image for the ROI (it will be a single time point image). If
+  // the ROI is taken from the image grid as is, the ROI image can reference
+  // the voxels of this image rather than copying them. This is safe because
+  // the layers are read-only while the ROI is being segmented.
+  ImagePointer newImage;
+  if(!roi.IsResampling() && this->IsSlicingOrthogonal())
+    newImage = Specialization::CreateRegionView(m_Image, m_Image4D, roi.GetROI());
+
+  if(!newImage)
+    newImage = this->DeepCopyRegion(roi, progressCommand);
 
   // Dress this image up as a 4D image.
   Image4DPointer newImage4D = Image4DType::New();
@@ -2727,7 +2850,6 @@ ImageWrapper<TTraits>
   newImage4D->SetNumberOfComponentsPerPixel(newImage->GetNumberOfComponentsPerPixel());
 
   // Take the 3D image's container into the 4D image
-  typedef ImageWrapperPartialSpecializationTraits<ImageType, Image4DType> Specialization;
   Specialization::AssignPixelContainerFromTimePointTo4D(newImage4D, newImage);
 
   // Initialize the new wrapper
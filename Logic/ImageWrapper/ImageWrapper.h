@@ -440,6 +440,9 @@ public:
    */
   virtual void SetSliceIndex(const IndexType &cursor) ITK_OVERRIDE;
 
+  /** Generate upcoming slices in the background */
+  virtual void PrefetchSlices(unsigned int display_slice, int direction, unsigned int n) ITK_OVERRIDE;
+
   /** Set the current time index */
   virtual void SetTimePointIndex(unsigned int index) ITK_OVERRIDE;
 
@@ -191,6 +191,13 @@ public:
    */
   virtual void SetSliceIndex(const IndexType &) = 0;
 
+  /**
+   * Generate the next n slices of a display slice in the background, moving
+   * from the current slice index in the given direction (+1 or -1). This is
+   * used to anticipate scrolling through the image.
+   */
+  virtual void PrefetchSlices(unsigned int display_slice, int direction, unsigned int n) = 0;
+
   /** Get the number of time points (how many 3D images in 4D array) */
   irisVirtualGetMacro(NumberOfTimePoints, unsigned int)
 
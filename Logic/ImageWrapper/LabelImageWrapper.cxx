@@ -43,6 +43,29 @@
 #include "LabelImageWrapper.h"
 #include "UndoDataManager.h"
 #include "Rebroadcaster.h"
+#include <itkImageRegionIterator.h>
+#include <algorithm>
+
+// Smallest region containing both regions, either of which may be empty
+static LabelImageWrapper::RegionType UnionOfRegions(
+    const LabelImageWrapper::RegionType &r1, const LabelImageWrapper::RegionType &r2)
+{
+  if(r1.GetNumberOfPixels() == 0)
+    return r2;
+  if(r2.GetNumberOfPixels() == 0)
+    return r1;
+
+  LabelImageWrapper::RegionType result;
+  for(unsigned int d = 0; d < 3; d++)
+    {
+    itk::IndexValueType lo = std::min(r1.GetIndex(d), r2.GetIndex(d));
+    itk::IndexValueType hi = std::max(r1.GetIndex(d) + (itk::IndexValueType) r1.GetSize(d),
+                                      r2.GetIndex(d) + (itk::IndexValueType) r2.GetSize(d));
+    result.SetIndex(d, lo);
+    result.SetSize(d, hi - lo);
+    }
+  return result;
+}
 
 LabelImageWrapper::LabelImageWrapper()
 {
@@ -70,6 +93,15 @@ void LabelImageWrapper::UpdateWrappedImages(
   for(auto &p : m_TimePointUndoManagers)
     p = new UndoManagerType(4, 200000);
 
+  // Start tracking modifications from the current state
+  m_TrackedModifications.resize(this->GetNumberOfTimePoints());
+  for(unsigned int tp = 0; tp < m_TrackedModifications.size(); tp++)
+    {
+    m_TrackedModifications[tp].Region = RegionType();
+    m_TrackedModifications[tp].Complete = true;
+    m_TrackedModifications[tp].MTime = m_ImageTimePoints[tp]->GetMTime();
+    }
+
   // Modified event on the image is rebroadcast as the WrapperImageChangeEvent
   Rebroadcaster::Rebroadcast(image_4d, itk::ModifiedEvent(), this, WrapperImageChangeEvent());
 
@@ -124,12 +156,16 @@ void LabelImageWrapper::Undo()
   // The label image that will undergo undo
   typedef itk::ImageRegionIterator<ImageType> IteratorType;
 
+  // Region affected by the undo
+  RegionType region;
+
   // Iterate over all the deltas in reverse order
   UndoManagerType::DList::const_reverse_iterator dit = commit.GetDeltas().rbegin();
   for(; dit != commit.GetDeltas().rend(); ++dit)
     {
     // Apply the changes in the current delta
     UndoManagerType::Delta *delta = *dit;
+    region = UnionOfRegions(region, delta->GetRegion());
 
     // Iterator for the relevant region in the label image
     IteratorType lit(m_Image, delta->GetRegion());
@@ -149,7 +185,7 @@ void LabelImageWrapper::Undo()
     }
 
   // Set modified flags
-  this->PixelsModified();
+  this->PixelsModifiedInRegion(region);
 }
 
 bool LabelImageWrapper::IsRedoPossible()
@@ -168,12 +204,16 @@ void LabelImageWrapper::Redo()
   // The label image that will undergo redo
   typedef itk::ImageRegionIterator<ImageType> IteratorType;
 
+  // Region affected by the redo
+  RegionType region;
+
   // Iterate over all the deltas in reverse order
   UndoManagerType::DList::const_iterator dit = commit.GetDeltas().begin();
   for(; dit != commit.GetDeltas().end(); ++dit)
     {
     // Apply the changes in the current delta
     UndoManagerType::Delta *delta = *dit;
+    region = UnionOfRegions(region, delta->GetRegion());
 
     // Iterator for the relevant region in the label image
     IteratorType lit(m_Image, delta->GetRegion());
@@ -193,7 +233,7 @@ void LabelImageWrapper::Redo()
     }
 
   // Set modified flags
-  this->PixelsModified();
+  this->PixelsModifiedInRegion(region);
 }
 
 const
@@ -216,3 +256,59 @@ LabelImageWrapper::CompressImage() const
   new_cumulative->FinishEncoding();
   return new_cumulative;
 }
+
+void LabelImageWrapper::PixelsModifiedInRegion(const RegionType &region)
+{
+  TrackedModifications &tm = m_TrackedModifications[m_TimePointIndex];
+  ImageType *img = m_ImageTimePoints[m_TimePointIndex];
+
+  // If the image has been modified since the last tracked modification, the
+  // extent of the modifications is no longer known
+  if(img->GetMTime() > tm.MTime)
+    tm.Complete = false;
+
+  this->PixelsModified();
+
+  tm.Region = UnionOfRegions(tm.Region, region);
+  tm.MTime = img->GetMTime();
+}
+
+bool LabelImageWrapper::PopModifiedRegion(unsigned int tp, RegionType &region)
+{
+  TrackedModifications &tm = m_TrackedModifications[tp];
+  ImageType *img = m_ImageTimePoints[tp];
+
+  bool complete = tm.Complete && img->GetMTime() <= tm.MTime;
+  region = tm.Region;
+
+  tm.Region = RegionType();
+  tm.Complete = true;
+  tm.MTime = img->GetMTime();
+  return complete;
+}
+
+void LabelImageWrapper::CopyRLELines(
+    unsigned int tp, const LineRegionType &lines, std::vector<RLLine> &out) const
+{
+  typedef itk::ImageRegionConstIterator<ImageType::BufferType> LineIterator;
+  out.clear();
+  out.reserve(lines.GetNumberOfPixels());
+  for(LineIterator it(m_ImageTimePoints[tp]->GetBuffer(), lines); !it.IsAtEnd(); ++it)
+    out.push_back(it.Get());
+}
+
+void LabelImageWrapper::ReplaceRLELines(
+    unsigned int tp, const LineRegionType &lines, const std::vector<RLLine> &in)
+{
+  typedef itk::ImageRegionIterator<ImageType::BufferType> LineIterator;
+  itkAssertOrThrowMacro(in.size() == lines.GetNumberOfPixels(),
+                        "Wrong number of lines in LabelImageWrapper::ReplaceRLELines");
+
+  size_t k = 0;
+  for(LineIterator it(m_ImageTimePoints[tp]->GetBuffer(), lines); !it.IsAtEnd(); ++it)
+    it.Set(in[k++]);
+
+  // Same as PixelsModified, but for any time point
+  m_Image4D->Modified();
+  m_ImageTimePoints[tp]->Modified();
+}
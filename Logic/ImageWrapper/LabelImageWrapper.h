@@ -26,6 +26,11 @@ public:
   typedef Superclass::ImagePointer                                ImagePointer;
   typedef Superclass::PixelType                                      PixelType;
   typedef Superclass::ITKTransformType                        ITKTransformType;
+  typedef ImageType::RegionType                                     RegionType;
+
+  // Run-length encoded lines of the image, indexed by (y,z)
+  typedef ImageType::RLLine                                             RLLine;
+  typedef ImageType::BufferType::RegionType                     LineRegionType;
 
   // Undo manager typedefs
   typedef UndoDataManager<PixelType> UndoManagerType;
@@ -83,6 +88,30 @@ public:
    * array created in this call. */
   UndoManagerDelta *CompressImage() const;
 
+  /**
+   * Same as PixelsModified(), but records that the modifications to the
+   * current time point were limited to the given region. This is called by
+   * the SegmentationUpdateIterator and by undo/redo.
+   */
+  void PixelsModifiedInRegion(const RegionType &region);
+
+  /**
+   * Get the bounding region of the modifications made to time point tp
+   * since the last call to this method, and start tracking afresh. Returns
+   * false if the pixels were (also) modified by other means, in which case
+   * the extent of the modifications is unknown. This is used by the autosave
+   * journal to copy only the lines that have changed.
+   */
+  bool PopModifiedRegion(unsigned int tp, RegionType &region);
+
+  /** Copy the run-length encoded lines of time point tp in a (y,z) region */
+  void CopyRLELines(unsigned int tp, const LineRegionType &lines,
+                    std::vector<RLLine> &out) const;
+
+  /** Replace the run-length encoded lines of time point tp in a (y,z) region */
+  void ReplaceRLELines(unsigned int tp, const LineRegionType &lines,
+                       const std::vector<RLLine> &in);
+
 protected:
 
   LabelImageWrapper();
@@ -93,6 +122,18 @@ protected:
   // undo steps with little cost in performance or memory. We currently associate each time
   // point with its own undo manager
   std::vector<UndoManagerType *> m_TimePointUndoManagers;
+
+  // Extent of the modifications to each time point since the last call to
+  // PopModifiedRegion. The modification time of the time point image after the
+  // last tracked modification reveals changes made without region information
+  struct TrackedModifications
+  {
+    RegionType Region;
+    bool Complete;
+    itk::ModifiedTimeType MTime;
+  };
+
+  std::vector<TrackedModifications> m_TrackedModifications;
 };
 
 #endif // LABELIMAGEWRAPPER_H
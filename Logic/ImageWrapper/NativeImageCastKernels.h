@@ -0,0 +1,178 @@
+#ifndef NATIVEIMAGECASTKERNELS_H
+#define NATIVEIMAGECASTKERNELS_H
+
+#include <itkMultiThreaderBase.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+/**
+ * Multi-threaded kernels used to convert the buffer of a native image (as
+ * read from disk) to the internal component type of ITK-SNAP. The buffers
+ * are split into fixed-size chunks, each processed by a tight loop over raw
+ * pointers that the compiler can vectorize. The kernels are templated over
+ * the native and the internal component type, so that each pair gets its own
+ * specialized loop.
+ */
+namespace NativeImageCastKernels
+{
+
+/** Number of components processed by a single work unit */
+const size_t CHUNK_SIZE = 1 << 18;
+
+inline size_t GetNumberOfChunks(size_t n)
+{
+  return (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+}
+
+/** Run f(k, first, last) for each chunk k of the range [0, n) */
+template <class TFunction>
+void ParallelizeChunks(size_t n, TFunction f)
+{
+  size_t nchunks = GetNumberOfChunks(n);
+  if(nchunks <= 1)
+    {
+    f(0, 0, n);
+    return;
+    }
+
+  itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
+  mt->ParallelizeArray(0, nchunks, [&](itk::SizeValueType k)
+    {
+    f(k, k * CHUNK_SIZE, std::min(n, (k + 1) * CHUNK_SIZE));
+    }, nullptr);
+}
+
+/**
+ * Compute the minimum and maximum of a buffer. The result is the same as that
+ * of a serial scan that starts with the first value and updates the extrema
+ * with each subsequent value using the < and > operators. This means that
+ * NaNs are skipped, unless the first value is NaN, in which case both of the
+ * extrema are NaN.
+ */
+template <class TNative>
+void ComputeRange(const TNative *data, size_t n, TNative &vmin, TNative &vmax)
+{
+  // Each chunk starts from the first value rather than from its own first
+  // value, so that a NaN at the start of a chunk is handled as in the serial
+  // scan
+  const TNative x0 = data[0];
+  std::vector<TNative> cmin(GetNumberOfChunks(n), x0), cmax(GetNumberOfChunks(n), x0);
+
+  ParallelizeChunks(n, [&](size_t k, size_t first, size_t last)
+    {
+    TNative lo = x0, hi = x0;
+    for(const TNative *p = data + first, *p_end = data + last; p < p_end; ++p)
+      {
+      TNative val = *p;
+      lo = (val < lo) ? val : lo;
+      hi = (val > hi) ? val : hi;
+      }
+    cmin[k] = lo; cmax[k] = hi;
+    });
+
+  vmin = x0; vmax = x0;
+  for(size_t k = 0; k < cmin.size(); k++)
+    {
+    if(cmin[k] < vmin) vmin = cmin[k];
+    if(cmax[k] > vmax) vmax = cmax[k];
+    }
+}
+
+/**
+ * Check whether all the values in a floating point buffer are integers that
+ * are representable in the output type, i.e., whether the image is really an
+ * integer image stored as floating point.
+ */
+template <class TNative, class TOutput>
+bool IsIntegerValued(const TNative *data, size_t n)
+{
+  std::atomic<bool> isint(true);
+  ParallelizeChunks(n, [&](size_t, size_t first, size_t last)
+    {
+    if(!isint.load(std::memory_order_relaxed))
+      return;
+
+    for(const TNative *p = data + first, *p_end = data + last; p < p_end; ++p)
+      {
+      TNative vin = *p;
+      TNative vcmp = static_cast<TNative>(static_cast<TOutput>(vin + 0.5));
+      if(vin != vcmp)
+        {
+        isint.store(false, std::memory_order_relaxed);
+        return;
+        }
+      }
+    });
+
+  return isint.load();
+}
+
+/**
+ * Apply a cast functor to each of the n components of a buffer, in place.
+ * The input buffer and the output buffer start at the same address, and
+ * the memory must be large enough to hold n values of the larger of the two
+ * types.
+ *
+ * When the two types have the same size, the chunks are independent. When
+ * they differ, each chunk is cast within its own block of memory, and the
+ * blocks are then moved into place in an order that never overwrites data
+ * that has not been moved yet. For an output type that is smaller than the
+ * native type, the chunks are cast first and then moved down; for a larger
+ * output type, the native chunks are first moved up to the start of their
+ * output blocks and then cast in descending order.
+ */
+template <class TNative, class TOutput, class TFunctor>
+void CastInPlace(TNative *ib, size_t n, TFunctor functor)
+{
+  char *base = reinterpret_cast<char *>(ib);
+  const size_t szNative = sizeof(TNative), szTarget = sizeof(TOutput);
+  size_t nchunks = GetNumberOfChunks(n);
+
+  if(szTarget <= szNative)
+    {
+    // Cast each chunk to the start of its own native block, in ascending
+    // order so that the native values are read before being overwritten
+    ParallelizeChunks(n, [&](size_t, size_t first, size_t last)
+      {
+      TNative *pn = ib + first, *pn_end = ib + last;
+      TOutput *pt = reinterpret_cast<TOutput *>(pn);
+      for(; pn < pn_end; ++pn, ++pt)
+        functor(pn, pt);
+      });
+
+    // Move the cast chunks down to their final positions
+    if(szTarget < szNative)
+      {
+      for(size_t k = 1; k < nchunks; k++)
+        {
+        size_t first = k * CHUNK_SIZE, last = std::min(n, first + CHUNK_SIZE);
+        memmove(base + first * szTarget, base + first * szNative, (last - first) * szTarget);
+        }
+      }
+    }
+  else
+    {
+    // Move the native chunks up to the start of their output blocks
+    for(size_t k = nchunks; k-- > 1; )
+      {
+      size_t first = k * CHUNK_SIZE, last = std::min(n, first + CHUNK_SIZE);
+      memmove(base + first * szTarget, base + first * szNative, (last - first) * szNative);
+      }
+
+    // Cast each chunk in descending order, so that each output value only
+    // overwrites native values that have already been read
+    ParallelizeChunks(n, [&](size_t, size_t first, size_t last)
+      {
+      TNative *pn = reinterpret_cast<TNative *>(base + first * szTarget);
+      TOutput *pt = reinterpret_cast<TOutput *>(base + first * szTarget);
+      for(size_t i = last - first; i-- > 0; )
+        functor(pn + i, pt + i);
+      });
+    }
+}
+
+} // namespace NativeImageCastKernels
+
+#endif // NATIVEIMAGECASTKERNELS_H
@@ -44,6 +44,7 @@
 //#endif
 
 #include "SNAPLevelSetDriver.h"
+#include "SNAPTrace.h"
 
 #include "itkCommand.h"
 #include "itkNarrowBandLevelSetImageFilter.h"
@@ -282,6 +283,8 @@ void
 SNAPLevelSetDriver<VDimension>
 ::Run(unsigned int nIterations)
 {
+  SNAP_TRACE_SCOPE("levelset", "SNAPLevelSetDriver::Run");
+
   // Increment the number of iterations 
   unsigned int nElapsed = m_LevelSetFilter->GetElapsedIterations();
   m_LevelSetFilter->SetNumberOfIterations(nElapsed + nIterations);
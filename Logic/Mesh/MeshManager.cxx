@@ -52,6 +52,8 @@
 #include "SNAPImageData.h"
 #include "AllPurposeProgressAccumulator.h"
 #include "MeshOptions.h"
+#include "DefaultBehaviorSettings.h"
+#include "SystemInterface.h"
 
 // ITK includes
 #include "itkRegionOfInterestImageFilter.h"
@@ -187,6 +189,13 @@ MeshManager
       // Pass the options to the pipeline
     pipeline->SetMeshOptions(m_GlobalState->GetMeshOptions());
 
+    // Enable the persistent mesh cache if requested by the user
+    if(m_GlobalState->GetDefaultBehaviorSettings()->GetPersistentMeshCache())
+      pipeline->SetDiskCacheDirectory(
+            m_Driver->GetSystemInterface()->GetUserCacheDirectory("Meshes"));
+    else
+      pipeline->SetDiskCacheDirectory(std::string());
+
     // Update the meshes
     pipeline->UpdateMeshes(command);
     }
@@ -44,10 +44,18 @@
 #include "IRISVectorTypesToITKConversion.h"
 #include "VTKMeshPipeline.h"
 #include "MeshOptions.h"
+#include "SNAPTrace.h"
+#include "Registry.h"
+#include "vtkNew.h"
 #include "vtkUnsignedShortArray.h"
+#include "vtkXMLPolyDataReader.h"
+#include "vtkXMLPolyDataWriter.h"
 
 // ITK includes
 #include "itkBinaryThresholdImageFilter.h"
+#include "itksys/SystemTools.hxx"
+#include "itksys/Directory.hxx"
+#include <algorithm>
 
 using namespace std;
 
@@ -73,6 +81,9 @@ MultiLabelMeshPipeline
   // Set the initial mesh options
   m_MeshOptions = MeshOptions::New();
   m_VTKPipeline->SetMeshOptions(m_MeshOptions);
+
+  // Default size limit of the disk cache
+  m_DiskCacheMaximumSize = 256ull * 1024 * 1024;
 }
 
 MultiLabelMeshPipeline
@@ -99,6 +110,194 @@ MultiLabelMeshPipeline
     }
 }
 
+void
+MultiLabelMeshPipeline
+::SetDiskCacheDirectory(const std::string &dir)
+{
+  if(m_DiskCacheDirectory != dir)
+    {
+    m_DiskCacheDirectory = dir;
+    if(dir.length() && !itksys::SystemTools::MakeDirectory(dir.c_str()))
+      m_DiskCacheDirectory.clear();
+    }
+}
+
+std::string
+MultiLabelMeshPipeline
+::GetDiskCacheFilename(LabelType label, const MeshInfo &info) const
+{
+  // Describe everything that affects the output mesh in a string
+  std::ostringstream oss;
+  oss << "label " << label << " digest " << info.Digest << " count " << info.Count << std::endl;
+
+  // Image geometry: meshes are generated in physical coordinates
+  oss << "region " << m_InputImage->GetLargestPossibleRegion().GetIndex()
+      << " " << m_InputImage->GetLargestPossibleRegion().GetSize() << std::endl;
+  oss << "origin " << m_InputImage->GetOrigin() << std::endl;
+  oss << "spacing " << m_InputImage->GetSpacing() << std::endl;
+  oss << "direction " << m_InputImage->GetDirection().GetVnlMatrix() << std::endl;
+
+  // Mesh options, serialized through the registry
+  Registry reg_options;
+  m_MeshOptions->WriteToRegistry(reg_options);
+  reg_options.Print(oss);
+
+  // Use the MD5 of the description as the filename
+  std::string key = oss.str();
+  char hex_code[33];
+  hex_code[32] = 0;
+  itksysMD5 *md5 = itksysMD5_New();
+  itksysMD5_Initialize(md5);
+  itksysMD5_Append(md5, (unsigned char *) key.c_str(), key.size());
+  itksysMD5_FinalizeHex(md5, hex_code);
+  itksysMD5_Delete(md5);
+
+  return m_DiskCacheDirectory + "/" + hex_code + ".vtp";
+}
+
+bool
+MultiLabelMeshPipeline
+::ReadMeshFromDiskCache(LabelType label, MeshInfo &info)
+{
+  if(m_DiskCacheDirectory.empty())
+    return false;
+
+  std::string fn = GetDiskCacheFilename(label, info);
+  if(!itksys::SystemTools::FileExists(fn.c_str(), true))
+    return false;
+
+  vtkNew<vtkXMLPolyDataReader> reader;
+  reader->SetFileName(fn.c_str());
+  reader->Update();
+
+  // A truncated or otherwise unreadable entry is treated as a cache miss
+  if(reader->GetErrorCode() || !reader->GetOutput()
+     || reader->GetOutput()->GetNumberOfPoints() == 0)
+    return false;
+
+  info.Mesh = vtkSmartPointer<vtkPolyData>::New();
+  info.Mesh->ShallowCopy(reader->GetOutput());
+
+  // Mark the entry as recently used
+  itksys::SystemTools::Touch(fn, false);
+  return true;
+}
+
+void
+MultiLabelMeshPipeline
+::WriteMeshToDiskCache(LabelType label, const MeshInfo &info)
+{
+  if(m_DiskCacheDirectory.empty() || !info.Mesh || info.Mesh->GetNumberOfPoints() == 0)
+    return;
+
+  // Write to a temporary file first, so that a crash or a concurrent
+  // ITK-SNAP session never sees a partially written entry
+  std::string fn = GetDiskCacheFilename(label, info);
+  std::ostringstream fn_tmp;
+  fn_tmp << fn << "." << itksys::SystemTools::GetCurrentDateTime("%H%M%S")
+         << "_" << this << ".tmp";
+
+  vtkNew<vtkXMLPolyDataWriter> writer;
+  writer->SetFileName(fn_tmp.str().c_str());
+  writer->SetInputData(info.Mesh);
+  writer->SetDataModeToAppended();
+  writer->EncodeAppendedDataOff();
+  writer->SetCompressorTypeToZLib();
+  if(writer->Write())
+    itksys::SystemTools::RenameFile(fn_tmp.str(), fn);
+  else
+    itksys::SystemTools::RemoveFile(fn_tmp.str());
+}
+
+void
+MultiLabelMeshPipeline
+::TrimDiskCache()
+{
+  if(m_DiskCacheDirectory.empty())
+    return;
+
+  itksys::Directory dir;
+  if(!dir.Load(m_DiskCacheDirectory))
+    return;
+
+  // List the entries, most recently used first
+  struct Entry
+  {
+    std::string Filename;
+    long MTime;
+    unsigned long long Size;
+    bool operator < (const Entry &other) const { return MTime > other.MTime; }
+  };
+
+  std::vector<Entry> entries;
+  for(unsigned long i = 0; i < dir.GetNumberOfFiles(); i++)
+    {
+    std::string fn = m_DiskCacheDirectory + "/" + dir.GetFile(i);
+    if(itksys::SystemTools::GetFilenameLastExtension(fn) != ".vtp")
+      continue;
+
+    Entry e;
+    e.Filename = fn;
+    e.MTime = itksys::SystemTools::ModifiedTime(fn);
+    e.Size = itksys::SystemTools::FileLength(fn);
+    entries.push_back(e);
+    }
+
+  std::sort(entries.begin(), entries.end());
+
+  // Keep the most recent entries that fit in the cache
+  unsigned long long total = 0;
+  for(const Entry &e : entries)
+    {
+    total += e.Size;
+    if(total > m_DiskCacheMaximumSize)
+      itksys::SystemTools::RemoveFile(e.Filename);
+    }
+}
+
+void
+MultiLabelMeshPipeline
+::ComputeLabelDigests(MeshInfoMap &meshmap, const std::set<LabelType> &labels)
+{
+  std::map<LabelType, itksysMD5 *> digests;
+  for(LabelType label : labels)
+    {
+    digests[label] = itksysMD5_New();
+    itksysMD5_Initialize(digests[label]);
+    }
+
+  // Hash the runs of the labels, line by line
+  typedef itk::ImageRegionConstIteratorWithIndex<InputImageType> InputIterator;
+  InputIterator it(m_InputImage, m_InputImage->GetLargestPossibleRegion());
+  while( !it.IsAtEnd() )
+    {
+    itk::Index<3> idx = it.GetIndex();
+    const InputIterator::RLLine &line=*(it.rlLine);
+    long t = 0;
+    for (size_t x = 0; x < line.size(); x++)
+      {
+      auto d = digests.find(line[x].second);
+      if(d != digests.end())
+        {
+        long long run[4] = { t, (long long) line[x].first, idx[1], idx[2] };
+        itksysMD5_Append(d->second, (unsigned char *) run, sizeof(run));
+        }
+      t += line[x].first;
+      }
+    ++(it.bi);
+    it.rlLine = &it.bi.Value();
+    }
+
+  for(auto &d : digests)
+    {
+    char hex_code[33];
+    hex_code[32] = 0;
+    itksysMD5_FinalizeHex(d.second, hex_code);
+    itksysMD5_Delete(d.second);
+    meshmap[d.first].Digest = hex_code;
+    }
+}
+
 unsigned long
 MultiLabelMeshPipeline
 ::GetVoxelsInBoundingBox(LabelType label) const
@@ -120,6 +319,8 @@ bool
 MultiLabelMeshPipeline
 ::ComputeMesh(LabelType label, vtkPolyData *outMesh)
 {
+  SNAP_TRACE_SCOPE("mesh", "MultiLabelMeshPipeline::ComputeMesh");
+
   // The label must be present in the image
   if(m_Histogram[label] == 0)
     return false;
@@ -203,6 +404,8 @@ void MultiLabelMeshPipeline::UpdateMeshInfoHelper(
 
 void MultiLabelMeshPipeline::UpdateMeshes(itk::Command *progressCommand)
 {
+  SNAP_TRACE_SCOPE("mesh", "MultiLabelMeshPipeline::UpdateMeshes");
+
   // Create a temporary table of mesh info
   MeshInfoMap meshmap;
 
@@ -262,8 +465,25 @@ void MultiLabelMeshPipeline::UpdateMeshes(itk::Command *progressCommand)
   SmartPtr<AllPurposeProgressAccumulator> progress = AllPurposeProgressAccumulator::New();
   progress->AddObserver(itk::ProgressEvent(), progressCommand);
 
+  // The disk cache is keyed by a strong hash of the labels that changed, since
+  // the checksum is too weak to identify a label across sessions
+  if(m_DiskCacheDirectory.size())
+    {
+    std::set<LabelType> changed;
+    for(MeshInfoMap::const_iterator it = meshmap.begin(); it != meshmap.end(); ++it)
+      {
+      MeshInfoMap::const_iterator itOld = m_MeshInfo.find(it->first);
+      if(itOld == m_MeshInfo.end() || itOld->second.Count != it->second.Count
+         || itOld->second.CheckSum != it->second.CheckSum)
+        changed.insert(it->first);
+      }
+    if(changed.size())
+      ComputeLabelDigests(meshmap, changed);
+    }
+
   // Next we check which meshes are new or updated and mark them as needing to
   // be recomputed
+  bool cache_written = false;
   for(MeshInfoMap::const_iterator it = meshmap.begin(); it != meshmap.end(); ++it)
     {
     // Get the cached mesh info for this label
@@ -275,10 +495,15 @@ void MultiLabelMeshPipeline::UpdateMeshes(itk::Command *progressCommand)
       // Cache the current information
       info.CheckSum = it->second.CheckSum;
       info.Count = it->second.Count;
+      info.Digest = it->second.Digest;
       info.BoundingBox[0] = it->second.BoundingBox[0];
       info.BoundingBox[1] = it->second.BoundingBox[1];
       info.Mesh = NULL;
 
+      // Try the persistent cache before scheduling the mesh for computation
+      if(ReadMeshFromDiskCache(it->first, info))
+        continue;
+
       //auto src = m_VTKPipeline->GetProgressAccumulator();
 
       // Capture progress from this mesh
@@ -321,6 +546,10 @@ void MultiLabelMeshPipeline::UpdateMeshes(itk::Command *progressCommand)
       m_VTKPipeline->SetImage(m_ThrehsoldFilter->GetOutput());
       m_VTKPipeline->ComputeMesh(it->second.Mesh);
 
+      // Store the mesh for future sessions
+      WriteMeshToDiskCache(it->first, mi);
+      cache_written = true;
+
       // Update progress
       progress->StartNextRun(m_VTKPipeline->GetProgressAccumulator());
       }
@@ -329,6 +558,10 @@ void MultiLabelMeshPipeline::UpdateMeshes(itk::Command *progressCommand)
   // Clean up the progress
   progress->UnregisterAllSources();
 
+  // Keep the disk cache within its size limit
+  if(cache_written)
+    TrimDiskCache();
+
   // Set the modified flag, so we can use the pipeline's MTime
   this->Modified();
 }
@@ -40,6 +40,7 @@
 #include "itkSmartPointer.h"
 #include "vtkSmartPointer.h"
 #include "itksys/MD5.h"
+#include <set>
 #include "itkObjectFactory.h"
 #include "ImageWrapperTraits.h"
 #include "RLERegionOfInterestImageFilter.h"
@@ -90,6 +91,9 @@ public:
     // The number of voxels
     unsigned long Count;
 
+    // MD5 of the runs of the label, only computed for the disk cache
+    std::string Digest;
+
     MeshInfo();
     ~MeshInfo();
   };
@@ -139,6 +143,22 @@ public:
   /** Get the progress accumulator from the VTK mesh pipeline */
   AllPurposeProgressAccumulator *GetProgressAccumulator();
 
+  /**
+   * Set the directory used to persist computed meshes between sessions. When
+   * set, UpdateMeshes() looks up each out-of-date label in the directory
+   * before running the VTK pipeline, and stores newly computed meshes there.
+   * Cache entries are keyed by the MD5 of the runs of the label, the mesh
+   * options and the image geometry, so stale entries are never hit. When the
+   * cache grows beyond its maximum size, the least recently used entries are
+   * removed. An empty string (default) disables the disk cache.
+   */
+  void SetDiskCacheDirectory(const std::string &dir);
+  irisGetMacro(DiskCacheDirectory, std::string)
+
+  /** Maximum size of the disk cache in bytes (default 256MB) */
+  irisSetMacro(DiskCacheMaximumSize, unsigned long long)
+  irisGetMacro(DiskCacheMaximumSize, unsigned long long)
+
 protected:
 
   /** Constructor, which builds the pipeline */
@@ -184,6 +204,27 @@ private:
   // The VTK pipeline
   VTKMeshPipeline *           m_VTKPipeline;
 
+  // Directory for the persistent mesh cache (empty if disabled)
+  std::string                 m_DiskCacheDirectory;
+
+  // Size limit of the persistent mesh cache
+  unsigned long long          m_DiskCacheMaximumSize;
+
+  // Compute the MD5 of the runs of each of the given labels
+  void ComputeLabelDigests(MeshInfoMap &meshmap, const std::set<LabelType> &labels);
+
+  // Remove the least recently used entries until the cache fits its size limit
+  void TrimDiskCache();
+
+  // Compute the filename of the disk cache entry for a label
+  std::string GetDiskCacheFilename(LabelType label, const MeshInfo &info) const;
+
+  // Load a mesh from the disk cache, returns false if there is no valid entry
+  bool ReadMeshFromDiskCache(LabelType label, MeshInfo &info);
+
+  // Store a mesh in the disk cache, failures are silently ignored
+  void WriteMeshToDiskCache(LabelType label, const MeshInfo &info);
+
   // Helper routine for the update command
   void UpdateMeshInfoHelper(
       MeshInfo *current_meshinfo,
@@ -37,6 +37,7 @@
 #include "ImageWrapper.h"
 #include "MeshOptions.h"
 #include "SNAPExportITKToVTK.h"
+#include "SNAPTrace.h"
 #include <map>
 
 using namespace std;
@@ -226,6 +227,8 @@ void
 VTKMeshPipeline
 ::ComputeMesh(vtkPolyData *outMesh, std::mutex *mutex)
 {
+  SNAP_TRACE_SCOPE("mesh", "VTKMeshPipeline::ComputeMesh");
+
   // Reset the progress meter
   m_Progress->ResetProgress();
 
@@ -106,6 +106,19 @@ private:
  * 
  * This functor implements a Gaussian blur, followed by a gradient magnitude
  * operator, followed by a 'contrast enhancement' intensity remapping filter.
+ *
+ * For large blur scales, the discrete Gaussian kernel becomes expensive, and
+ * the blur is computed with a recursive filter (RecursiveGaussianFilterKernel)
+ * whose cost does not depend on the scale. In that case, the gradient
+ * magnitude and the remapping are computed together in a single pass, and
+ * only a slab around the requested output region, padded by a few blur scales,
+ * is requested from the input. This makes slice previews much cheaper.
+ *
+ * The discrete kernel is truncated for speed, so the two blurs do not quite
+ * agree. To keep the edge map from jumping when the scale crosses
+ * RecursiveGaussianFilterKernel::GetMinimumSigma(), the edge maps computed
+ * with both blurs are blended over GetRecursiveGaussianBlendWidth() above it,
+ * with the weight of the recursive one going from zero to one.
  */
 template <typename TInputImage,typename TOutputImage>
 class EdgePreprocessingImageFilter: 
@@ -163,6 +176,10 @@ public:
   /** Get the parameters pointer */
   EdgePreprocessingSettings *GetParameters();
 
+  /** Range of blur scales above RecursiveGaussianFilterKernel::GetMinimumSigma()
+    over which the discrete and the recursive Gaussian are blended */
+  static double GetRecursiveGaussianBlendWidth() { return 0.5; }
+
 protected:
 
   EdgePreprocessingImageFilter();
@@ -178,6 +195,15 @@ protected:
    */
   void GenerateInputRequestedRegion() ITK_OVERRIDE;
 
+  /** Weight of the recursive Gaussian for the current blur scale: zero below
+    the switch, one above the blending range, and linear in between */
+  double GetRecursiveGaussianWeight();
+
+  /** Compute the edge map over the buffered region of the given image with
+    the recursive Gaussian and a fused gradient magnitude and remapping pass */
+  void GenerateDataRecursive(EdgePreprocessingSettings *settings,
+                             OutputImageType *outputImage);
+
 private:
 
   double m_InputImageMaximumGradientMagnitude;
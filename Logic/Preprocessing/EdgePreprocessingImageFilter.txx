@@ -40,7 +40,13 @@
 #include <itkDiscreteGaussianImageFilter.h>
 #include <itkGradientMagnitudeImageFilter.h>
 #include <itkUnaryFunctorImageFilter.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkMultiThreaderBase.h>
 #include <IRISException.h>
+#include "RecursiveGaussianFilterKernel.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 template<typename TInputImage,typename TOutputImage>
 EdgePreprocessingImageFilter<TInputImage,TOutputImage>
@@ -109,6 +115,15 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
   if(!settings)
     throw IRISException("Parameters not set in EdgePreprocessingImageFilter");
 
+  // Large blur scales are handled by the recursive Gaussian
+  double w_rec = this->GetRecursiveGaussianWeight();
+  if(w_rec >= 1.0)
+    {
+    this->AllocateOutputs();
+    this->GenerateDataRecursive(settings, outputImage);
+    return;
+    }
+
   itk::ProgressAccumulator::Pointer pac = itk::ProgressAccumulator::New();
   pac->SetMiniPipelineFilter(this);
 
@@ -148,6 +163,143 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
   m_RemapFilter->GraftOutput(outputImage);
   m_RemapFilter->Update();
   this->GraftOutput(m_RemapFilter->GetOutput());
+
+  // Just above the switch, the edge map is blended with that computed with
+  // the recursive Gaussian, so that it does not jump at the switch
+  if(w_rec > 0.0)
+    {
+    outputImage = this->GetOutput();
+    typename OutputImageType::Pointer recursive = OutputImageType::New();
+    recursive->CopyInformation(outputImage);
+    recursive->SetRegions(outputImage->GetBufferedRegion());
+    recursive->Allocate();
+    this->GenerateDataRecursive(settings, recursive);
+
+    typedef typename OutputImageType::PixelType OutputPixelType;
+    OutputPixelType *pOut = outputImage->GetBufferPointer();
+    const OutputPixelType *pRec = recursive->GetBufferPointer();
+    size_t nPixels = outputImage->GetBufferedRegion().GetNumberOfPixels();
+    for(size_t i = 0; i < nPixels; i++)
+      pOut[i] = static_cast<OutputPixelType>(
+            std::floor((1.0 - w_rec) * pOut[i] + w_rec * pRec[i] + 0.5));
+    }
+}
+
+template<typename TInputImage,typename TOutputImage>
+void
+EdgePreprocessingImageFilter<TInputImage,TOutputImage>
+::GenerateDataRecursive(EdgePreprocessingSettings *settings,
+                        OutputImageType *outputImage)
+{
+  const InputImageType *inputImage = this->GetInput();
+  this->UpdateProgress(0.0);
+
+  typedef typename InputImageType::RegionType InputRegionType;
+  typedef typename InputImageType::IndexType InputIndexType;
+  const unsigned int D = ImageDimension;
+  InputRegionType inRegion = inputImage->GetRequestedRegion();
+  OutputImageRegionType outRegion = outputImage->GetBufferedRegion();
+  if(outRegion.GetNumberOfPixels() == 0)
+    return;
+
+  // Copy the padded input region into a contiguous buffer
+  size_t size[ImageDimension], stride[ImageDimension];
+  for(unsigned int d = 0; d < D; d++)
+    {
+    size[d] = inRegion.GetSize(d);
+    stride[d] = d == 0 ? 1 : stride[d-1] * size[d-1];
+    }
+
+  std::vector<RealType> buffer(inRegion.GetNumberOfPixels());
+  RealType *pBuffer = buffer.data();
+  for(itk::ImageRegionConstIterator<InputImageType> it(inputImage, inRegion);
+      !it.IsAtEnd(); ++it)
+    *pBuffer++ = static_cast<RealType>(it.Get());
+  this->UpdateProgress(0.1);
+
+  // Blur the buffer in place, along each dimension in turn
+  RecursiveGaussianFilterKernel kernel(settings->GetGaussianBlurScale());
+  kernel.FilterImage(buffer.data(), size, D);
+  this->UpdateProgress(0.8);
+
+  // Gradient magnitude is computed by central differences in physical units,
+  // with the neighbors clamped to the buffer like the zero-flux boundary
+  // condition of itk::GradientMagnitudeImageFilter
+  double scale[ImageDimension];
+  for(unsigned int d = 0; d < D; d++)
+    scale[d] = 0.5 / inputImage->GetSpacing()[d];
+
+  FunctorType functor;
+  functor.SetParameters(0.0, m_InputImageMaximumGradientMagnitude,
+                        settings->GetRemappingExponent(),
+                        settings->GetRemappingSteepness());
+
+  // Each task computes one line of the output region along the x axis
+  size_t nx = outRegion.GetSize(0);
+  size_t nLines = outRegion.GetNumberOfPixels() / nx;
+  itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
+  mt->ParallelizeArray(0, nLines, [&](itk::SizeValueType line)
+    {
+    FunctorType f = functor;
+
+    // Find the start of the line in the output and in the buffer
+    InputIndexType idx = outRegion.GetIndex();
+    size_t pos[ImageDimension], offset = 0;
+    for(unsigned int d = 1; d < D; d++)
+      {
+      idx[d] += line % outRegion.GetSize(d);
+      line /= outRegion.GetSize(d);
+      }
+    for(unsigned int d = 0; d < D; d++)
+      {
+      pos[d] = idx[d] - inRegion.GetIndex(d);
+      offset += pos[d] * stride[d];
+      }
+
+    // Offsets of the neighbors along the slow dimensions are fixed on the line
+    long lo[ImageDimension], hi[ImageDimension];
+    for(unsigned int d = 1; d < D; d++)
+      {
+      lo[d] = pos[d] > 0 ? -(long) stride[d] : 0;
+      hi[d] = pos[d] + 1 < size[d] ? (long) stride[d] : 0;
+      }
+
+    typename OutputImageType::PixelType *out =
+        outputImage->GetBufferPointer() + outputImage->ComputeOffset(idx);
+    const RealType *p = buffer.data() + offset;
+    for(size_t i = 0, x = pos[0]; i < nx; i++, x++, p++)
+      {
+      lo[0] = x > 0 ? -1 : 0;
+      hi[0] = x + 1 < size[0] ? 1 : 0;
+
+      double gmsq = 0.0;
+      for(unsigned int d = 0; d < D; d++)
+        {
+        double g = (p[hi[d]] - p[lo[d]]) * scale[d];
+        gmsq += g * g;
+        }
+
+      out[i] = static_cast<typename OutputImageType::PixelType>(
+            f(static_cast<RealType>(std::sqrt(gmsq))));
+      }
+    }, nullptr);
+
+  this->UpdateProgress(1.0);
+}
+
+template<typename TInputImage,typename TOutputImage>
+double
+EdgePreprocessingImageFilter<TInputImage,TOutputImage>
+::GetRecursiveGaussianWeight()
+{
+  EdgePreprocessingSettings *settings = this->GetParameters();
+  if(!settings)
+    return 0.0;
+
+  double t = (settings->GetGaussianBlurScale()
+              - RecursiveGaussianFilterKernel::GetMinimumSigma())
+      / GetRecursiveGaussianBlendWidth();
+  return std::max(0.0, std::min(1.0, t));
 }
 
 template<typename TInputImage,typename TOutputImage>
@@ -196,8 +348,22 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
     const_cast< TInputImage * >( this->GetInput() );
   OutputImagePointer outputPtr = this->GetOutput();
 
-  // Use the largest possible region (hack)
-  inputPtr->SetRequestedRegion(
-        inputPtr->GetLargestPossibleRegion());
+  if(this->GetRecursiveGaussianWeight() >= 1.0)
+    {
+    // The response of the recursive Gaussian is negligible beyond a few
+    // blur scales, so only a padded slab around the output is needed
+    long radius = RecursiveGaussianFilterKernel::GetSupportRadius(
+          this->GetParameters()->GetGaussianBlurScale());
+    typename InputImageType::RegionType region = outputPtr->GetRequestedRegion();
+    region.PadByRadius(radius);
+    region.Crop(inputPtr->GetLargestPossibleRegion());
+    inputPtr->SetRequestedRegion(region);
+    }
+  else
+    {
+    // Use the largest possible region (hack)
+    inputPtr->SetRequestedRegion(
+          inputPtr->GetLargestPossibleRegion());
+    }
 }
 
@@ -0,0 +1,216 @@
+#include "GMMPosteriorEvaluator.h"
+#include <vnl/vnl_math.h>
+#include <limits>
+#include <cmath>
+#include <cstring>
+
+void GMMPosteriorEvaluator::Initialize(GaussianMixtureModel *gmm)
+{
+  int K = m_NumberOfGaussians = gmm->GetNumberOfGaussians();
+  int d = m_Dimension = gmm->GetNumberOfComponents();
+
+  m_Mean.resize(K * d);
+  m_Vt.resize(K * d * d);
+  m_Lambda.resize(K * d);
+  m_NormFac.resize(K * d);
+  m_Weight.resize(K);
+  m_LogWeight.resize(K);
+  m_Factor.resize(K);
+
+  for(int k = 0; k < K; k++)
+    {
+    Gaussian *g = gmm->GetGaussian(k);
+    const Gaussian::MatrixType &vt = g->GetEigenvectorsTransposed();
+    for(int i = 0; i < d; i++)
+      {
+      m_Mean[k * d + i] = g->GetMean()[i];
+      m_Lambda[k * d + i] = g->GetEigenvalues()[i];
+      m_NormFac[k * d + i] = log(2 * vnl_math::pi * m_Lambda[k * d + i]);
+      for(int j = 0; j < d; j++)
+        m_Vt[(k * d + i) * d + j] = vt(i, j);
+      }
+
+    m_Weight[k] = gmm->GetWeight(k);
+    m_LogWeight[k] = log(m_Weight[k]);
+    m_Factor[k] = gmm->IsForeground(k) ? 1.0 : -1.0;
+    }
+}
+
+void GMMPosteriorEvaluator
+::Evaluate(const double *x, int n, double *pdiff, std::vector<double> &scratch) const
+{
+  int K = m_NumberOfGaussians, d = m_Dimension;
+
+  // Scratch space: the log-pdf of each Gaussian for each sample, followed by
+  // the mean-subtracted samples and the projections on one eigenvector
+  scratch.resize((K + d + 1) * n);
+  double *log_pdf = scratch.data();
+  double *xs = log_pdf + K * n;
+  double *z = xs + d * n;
+
+  for(int k = 0; k < K; k++)
+    {
+    const double *mean = &m_Mean[k * d];
+    double *lp = log_pdf + k * n;
+
+    // Subtract the mean, storing the samples one component at a time
+    for(int j = 0; j < d; j++)
+      for(int s = 0; s < n; s++)
+        xs[j * n + s] = x[s * d + j] - mean[j];
+
+    for(int s = 0; s < n; s++)
+      lp[s] = 0.0;
+
+    for(int i = 0; i < d; i++)
+      {
+      // Project the samples on the i-th eigenvector of the covariance matrix
+      const double *vt = &m_Vt[(k * d + i) * d];
+      for(int s = 0; s < n; s++)
+        z[s] = 0.0;
+      for(int j = 0; j < d; j++)
+        for(int s = 0; s < n; s++)
+          z[s] += vt[j] * xs[j * n + s];
+
+      double lambda = m_Lambda[k * d + i], fac = m_NormFac[k * d + i];
+      if(lambda == 0)
+        {
+        // Zero variance: p(x) = 0 unless the projection is zero
+        for(int s = 0; s < n; s++)
+          if(z[s] != 0)
+            lp[s] = -std::numeric_limits<double>::infinity();
+        }
+      else
+        {
+        for(int s = 0; s < n; s++)
+          lp[s] -= fac + (z[s] * z[s] / lambda);
+        }
+      }
+
+    for(int s = 0; s < n; s++)
+      lp[s] *= 0.5;
+    }
+
+  // Combine the log-pdfs into posteriors, as in ComputePosterior
+  for(int s = 0; s < n; s++)
+    {
+    double diff = 0;
+    for(int j = 0; j < K; j++)
+      {
+      if(m_Weight[j] == 0)
+        continue;
+
+      double denom = 1.0;
+      double exp_j = m_LogWeight[j] + log_pdf[j * n + s];
+      for(int k = 0; k < K; k++)
+        {
+        if(j != k && m_Weight[k] > 0)
+          {
+          double exponent = (m_LogWeight[k] + log_pdf[k * n + s]) - exp_j;
+          if(exponent < -20)
+            {
+            continue;
+            }
+          else if(exponent > 20)
+            {
+            denom = vnl_huge_val(1.0);
+            break;
+            }
+          else
+            {
+            denom += exp(exponent);
+            }
+          }
+        }
+
+      diff += (1.0 / denom) * m_Factor[j];
+      }
+    pdiff[s] = diff;
+    }
+}
+
+uint64_t GMMPosteriorEvaluator::Cache::GetKey(const double *x, int dim)
+{
+  // One channel is keyed by the bits of the double, two channels are packed
+  // as floats, which is only exact if the input is no more precise than that
+  uint64_t key;
+  if(dim == 1)
+    {
+    memcpy(&key, x, sizeof(double));
+    }
+  else
+    {
+    float xf[2] = { (float) x[0], (float) x[1] };
+    memcpy(&key, xf, sizeof(key));
+    }
+  return key;
+}
+
+void GMMPosteriorEvaluator::Cache::GetSample(uint64_t key, int dim, double *x)
+{
+  if(dim == 1)
+    {
+    memcpy(x, &key, sizeof(double));
+    }
+  else
+    {
+    float xf[2];
+    memcpy(xf, &key, sizeof(key));
+    x[0] = xf[0];
+    x[1] = xf[1];
+    }
+}
+
+GMMPosteriorEvaluator::Cache::Cache(size_t max_entries)
+  : m_Size(0), m_MaxEntries(max_entries)
+{
+  Resize(10);
+}
+
+void GMMPosteriorEvaluator::Cache::Resize(unsigned int log_capacity)
+{
+  std::vector<uint64_t> keys;
+  std::vector<double> values;
+  std::vector<unsigned char> used;
+  keys.swap(m_Keys);
+  values.swap(m_Values);
+  used.swap(m_Used);
+
+  size_t capacity = ((size_t) 1) << log_capacity;
+  m_Keys.resize(capacity);
+  m_Values.resize(capacity);
+  m_Used.assign(capacity, 0);
+  m_Mask = capacity - 1;
+  m_Shift = 64 - log_capacity;
+
+  for(size_t i = 0; i < used.size(); i++)
+    {
+    if(used[i])
+      {
+      size_t j = Hash(keys[i]);
+      while(m_Used[j])
+        j = (j + 1) & m_Mask;
+      m_Keys[j] = keys[i];
+      m_Values[j] = values[i];
+      m_Used[j] = 1;
+      }
+    }
+}
+
+bool GMMPosteriorEvaluator::Cache::Insert(uint64_t key, double value)
+{
+  if(m_Size >= m_MaxEntries)
+    return false;
+
+  // Keep the table at most half full
+  if(2 * (m_Size + 1) > m_Used.size())
+    Resize(64 - m_Shift + 1);
+
+  size_t i = Hash(key);
+  while(m_Used[i])
+    i = (i + 1) & m_Mask;
+  m_Keys[i] = key;
+  m_Values[i] = value;
+  m_Used[i] = 1;
+  m_Size++;
+  return true;
+}
@@ -0,0 +1,94 @@
+#ifndef GMM_POSTERIOR_EVALUATOR_H
+#define GMM_POSTERIOR_EVALUATOR_H
+
+#include "GaussianMixtureModel.h"
+#include <vector>
+#include <stdint.h>
+#include <cstddef>
+
+/**
+ * A flattened copy of a GaussianMixtureModel for computing, for many samples,
+ * the difference between the posterior probabilities of the foreground and
+ * of the background clusters, which is what GMMClassifyImageFilter outputs.
+ * The arithmetic is that of Gaussian::EvaluateLogPDF and
+ * EMGaussianMixtures::ComputePosterior, with the operations in the same
+ * order, but the log-pdfs are computed for a batch of samples at a time, with
+ * the loops over the samples innermost so that the compiler can vectorize
+ * them.
+ */
+class GMMPosteriorEvaluator
+{
+public:
+
+  GMMPosteriorEvaluator() : m_NumberOfGaussians(0), m_Dimension(0) {}
+
+  /** Copy the parameters of the mixture model */
+  void Initialize(GaussianMixtureModel *gmm);
+
+  int GetDimension() const { return m_Dimension; }
+
+  /**
+   * Evaluate the posterior difference for n samples, stored one after the
+   * other in x (n * dimension values). The scratch vector is resized as
+   * needed and can be reused between calls.
+   */
+  void Evaluate(const double *x, int n, double *pdiff, std::vector<double> &scratch) const;
+
+  /**
+   * A hash table for memoizing the posterior difference of samples with one
+   * or two components. Such samples usually come from integer images and
+   * only take a small number of distinct values. The table grows as needed,
+   * up to a maximum number of entries, after which Insert() returns false
+   * and the caller should stop using it. Find() may be called from several
+   * threads at once, as long as nothing is inserted.
+   */
+  class Cache
+  {
+  public:
+    Cache(size_t max_entries);
+
+    /** The key of a sample with one or two components */
+    static uint64_t GetKey(const double *x, int dim);
+
+    /** The sample for a key, as used to evaluate the posterior */
+    static void GetSample(uint64_t key, int dim, double *x);
+
+    size_t GetSize() const { return m_Size; }
+    size_t GetMaxEntries() const { return m_MaxEntries; }
+
+    bool Find(uint64_t key, double &value) const
+      {
+      for(size_t i = Hash(key); m_Used[i]; i = (i + 1) & m_Mask)
+        if(m_Keys[i] == key)
+          { value = m_Values[i]; return true; }
+      return false;
+      }
+
+    bool Insert(uint64_t key, double value);
+
+  protected:
+    size_t Hash(uint64_t key) const
+      { return (size_t) ((key * 0x9E3779B97F4A7C15ull) >> m_Shift); }
+
+    void Resize(unsigned int log_capacity);
+
+    std::vector<uint64_t> m_Keys;
+    std::vector<double> m_Values;
+    std::vector<unsigned char> m_Used;
+    size_t m_Size, m_Mask, m_MaxEntries;
+    unsigned int m_Shift;
+  };
+
+protected:
+
+  int m_NumberOfGaussians, m_Dimension;
+
+  // Per Gaussian: mean (d), transposed eigenvectors (d x d), eigenvalues (d)
+  // and the log normalization factors of the 1D Gaussians (d)
+  std::vector<double> m_Mean, m_Vt, m_Lambda, m_NormFac;
+
+  // Per Gaussian: weight, log weight and +1/-1 for foreground/background
+  std::vector<double> m_Weight, m_LogWeight, m_Factor;
+};
+
+#endif
@@ -17,6 +17,10 @@ public:
   const MatrixType &GetCovariance() const;
   double GetTotalVariance();
 
+  // Eigen-decomposition of the covariance matrix, used by EvaluateLogPDF
+  const MatrixType &GetEigenvectorsTransposed() const { return m_Vt; }
+  const vnl_diag_matrix<double> &GetEigenvalues() const { return m_Lambda; }
+
   void SetMean(const VectorType &mean);
   void SetCovariance(const MatrixType &cov);
 
@@ -3,6 +3,8 @@
 
 #include "itkImageToImageFilter.h"
 #include "GaussianMixtureModel.h"
+#include "GMMPosteriorEvaluator.h"
+#include <memory>
 
 /**
  * @brief A class that takes multiple multi-component images and uses a
@@ -61,9 +63,18 @@ protected:
 
   void PrintSelf(std::ostream& os, itk::Indent indent) const ITK_OVERRIDE;
 
+  void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
   void DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread) ITK_OVERRIDE;
 
   GaussianMixtureModel *m_MixtureModel;
+
+  // Copy of the mixture model used by the threads
+  GMMPosteriorEvaluator m_Evaluator;
+
+  // Posteriors of the distinct intensities in the requested region, when
+  // there are few enough of them. Built before the threads are started
+  std::unique_ptr<GMMPosteriorEvaluator::Cache> m_Cache;
 };
 
 #ifndef ITK_MANUAL_INSTANTIATION
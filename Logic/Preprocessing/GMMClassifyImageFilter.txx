@@ -5,6 +5,11 @@
 #include "itkImageRegionConstIterator.h"
 #include "EMGaussianMixtures.h"
 #include "ImageCollectionConstIteratorWithIndex.h"
+#include "itkMultiThreaderBase.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
 
 template <class TInputImage, class TInputVectorImage, class TOutputImage>
 GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
@@ -81,6 +86,96 @@ GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
   os << indent << "GMMClassifyImageFilter" << std::endl;
 }
 
+template <class TInputImage, class TInputVectorImage, class TOutputImage>
+void
+GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
+::BeforeThreadedGenerateData()
+{
+  assert(m_MixtureModel);
+  m_Evaluator.Initialize(m_MixtureModel);
+  m_Cache.reset();
+
+  // With one or two channels, the inputs usually come from integer images and
+  // the same intensities occur over and over. The posterior of each distinct
+  // intensity is then computed once per update, here, and the threads only
+  // look it up. Two channels are packed as floats, which is only exact if the
+  // input is no more precise than a float.
+  typedef GMMPosteriorEvaluator::Cache Cache;
+  int nComp = m_Evaluator.GetDimension();
+  bool exact_float = std::is_same<InputComponentType, float>::value
+      || (std::is_integral<InputComponentType>::value && sizeof(InputComponentType) <= 2);
+  if(nComp != 1 && !(nComp == 2 && exact_float))
+    return;
+
+  // Collect the distinct keys in the requested region, in parallel. If there
+  // are too many, the data is not quantized after all
+  typedef ImageCollectionConstIteratorWithIndex<TInputImage, TInputVectorImage> CollectionIter;
+  const size_t max_entries = 1 << 17;
+  Cache distinct(max_entries);
+  std::vector<uint64_t> keys;
+  std::atomic<bool> too_many(false);
+  std::mutex mutex;
+
+  itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
+  mt->ParallelizeImageRegion<ImageDimension>(
+        this->GetOutput()->GetRequestedRegion(),
+        [&](const OutputImageRegionType &region)
+    {
+    itk::Size<ImageDimension> radius; radius.Fill(0);
+    CollectionIter cit(radius, region);
+    for( itk::InputDataObjectIterator it( this ); !it.IsAtEnd(); it++ )
+      cit.AddImage(it.GetInput());
+
+    Cache local(max_entries);
+    std::vector<uint64_t> local_keys;
+    vnl_vector<double> x(nComp);
+    double value;
+    for(size_t i = 0; i < region.GetNumberOfPixels() && !too_many; i++, ++cit)
+      {
+      cit.GetNeighborhoodValues(x);
+      uint64_t key = Cache::GetKey(x.data_block(), nComp);
+      if(!local.Find(key, value))
+        {
+        if(!local.Insert(key, 0.0))
+          too_many = true;
+        local_keys.push_back(key);
+        }
+      }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for(size_t i = 0; i < local_keys.size() && !too_many; i++)
+      {
+      if(!distinct.Find(local_keys[i], value))
+        {
+        if(!distinct.Insert(local_keys[i], 0.0))
+          too_many = true;
+        keys.push_back(local_keys[i]);
+        }
+      }
+    }, nullptr);
+
+  if(too_many)
+    return;
+
+  // Evaluate the posteriors of the distinct samples in batches
+  size_t n = keys.size();
+  const size_t batch_size = 256;
+  std::vector<double> xb(n * nComp), pb(n);
+  for(size_t i = 0; i < n; i++)
+    Cache::GetSample(keys[i], nComp, &xb[i * nComp]);
+
+  mt->ParallelizeArray(0, (n + batch_size - 1) / batch_size, [&](itk::SizeValueType b)
+    {
+    std::vector<double> scratch;
+    size_t i0 = b * batch_size, i1 = std::min(n, i0 + batch_size);
+    m_Evaluator.Evaluate(&xb[i0 * nComp], (int) (i1 - i0), &pb[i0], scratch);
+    }, nullptr);
+
+  m_Cache.reset(new Cache(max_entries));
+  for(size_t i = 0; i < n; i++)
+    m_Cache->Insert(keys[i], pb[i]);
+}
+
 template <class TInputImage, class TInputVectorImage, class TOutputImage>
 void
 GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
@@ -96,23 +191,6 @@ GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
   typedef itk::ImageRegionIterator<TOutputImage> OutputIter;
   OutputIter it_out(outputPtr, outputRegionForThread);
 
-  vnl_vector<double> x(m_MixtureModel->GetNumberOfComponents());
-  vnl_vector<double> x_scratch(m_MixtureModel->GetNumberOfComponents());
-  vnl_vector<double> z_scratch(m_MixtureModel->GetNumberOfComponents());
-  vnl_vector<double> log_pdf(m_MixtureModel->GetNumberOfGaussians());
-  vnl_vector<double> log_w(m_MixtureModel->GetNumberOfGaussians());
-  vnl_vector<double> w(m_MixtureModel->GetNumberOfGaussians());
-  vnl_vector<double> p(m_MixtureModel->GetNumberOfGaussians());
-
-  // Create a multiplier vector (1 for foreground, -1 for background)
-  vnl_vector<double> pfactor(m_MixtureModel->GetNumberOfGaussians());
-  for(int i = 0; i < m_MixtureModel->GetNumberOfGaussians(); i++)
-    {
-    pfactor[i] = m_MixtureModel->IsForeground(i) ? 1.0 : -1.0;
-    log_w[i] = log(m_MixtureModel->GetWeight(i));
-    w[i] = m_MixtureModel->GetWeight(i);
-    }
-
   // Configure the input collection iterator
   itk::Size<ImageDimension> radius; radius.Fill(0);
   CollectionIter cit(radius, outputRegionForThread);
@@ -121,34 +199,45 @@ GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
 
   // Get the number of components
   int nComp = cit.GetTotalComponents();
+  assert(nComp == m_Evaluator.GetDimension());
 
-  // Iterate through all the voxels
-  while ( !it_out.IsAtEnd() )
-    {
-    cit.GetNeighborhoodValues(x);
+  vnl_vector<double> x(nComp);
+  std::vector<double> scratch;
 
-    // Evaluate the posterior probability robustly
-    for(int k = 0; k < m_MixtureModel->GetNumberOfGaussians(); k++)
+  // Look up the posteriors computed in BeforeThreadedGenerateData
+  if(m_Cache)
+    {
+    for(; !it_out.IsAtEnd(); ++it_out, ++cit)
       {
-      log_pdf[k] = m_MixtureModel->EvaluateLogPDF(k, x, x_scratch);
+      cit.GetNeighborhoodValues(x);
+
+      double pdiff;
+      if(!m_Cache->Find(GMMPosteriorEvaluator::Cache::GetKey(x.data_block(), nComp), pdiff))
+        m_Evaluator.Evaluate(x.data_block(), 1, &pdiff, scratch);
+
+      // Store the value
+      it_out.Set((OutputPixelType)(pdiff * 0x7fff));
       }
+    return;
+    }
 
-    // Evaluate the GMM for each of the clusters
-    double pdiff = 0;
-    for(int k = 0; k < m_MixtureModel->GetNumberOfGaussians(); k++)
+  // Otherwise, the voxels are evaluated in batches
+  const int batch_size = 256;
+  std::vector<double> xb(batch_size * nComp), pb(batch_size);
+  while ( !it_out.IsAtEnd() )
+    {
+    OutputIter it_batch = it_out;
+    int n = 0;
+    for(; n < batch_size && !it_out.IsAtEnd(); n++, ++it_out, ++cit)
       {
-      p[k] = EMGaussianMixtures::ComputePosterior(
-            m_MixtureModel->GetNumberOfGaussians(),
-            log_pdf.data_block(), w.data_block(), log_w.data_block(), k);
-
-      pdiff += p[k] * pfactor[k];
+      cit.GetNeighborhoodValues(x);
+      std::copy(x.begin(), x.end(), xb.begin() + n * nComp);
       }
 
-    // Store the value
-    it_out.Set((OutputPixelType)(pdiff * 0x7fff));
+    m_Evaluator.Evaluate(xb.data(), n, pb.data(), scratch);
 
-    ++it_out;
-    ++cit;
+    for(int i = 0; i < n; i++, ++it_batch)
+      it_batch.Set((OutputPixelType)(pb[i] * 0x7fff));
     }
 }
 
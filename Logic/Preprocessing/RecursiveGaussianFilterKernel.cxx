@@ -0,0 +1,161 @@
+#include "RecursiveGaussianFilterKernel.h"
+#include <itkMultiThreaderBase.h>
+#include <algorithm>
+#include <cmath>
+
+RecursiveGaussianFilterKernel
+::RecursiveGaussianFilterKernel(double sigma)
+{
+  // Deriche, "Recursively implementing the Gaussian and its derivatives", 1993
+  const double A1 = 1.3530, B1 = 1.8151, W1 = 0.6681, L1 = -1.3932;
+  const double A2 = -0.3531, B2 = 0.0902, W2 = 2.0787, L2 = -1.3732;
+
+  const double sin1 = std::sin(W1 / sigma), sin2 = std::sin(W2 / sigma);
+  const double cos1 = std::cos(W1 / sigma), cos2 = std::cos(W2 / sigma);
+  const double exp1 = std::exp(L1 / sigma), exp2 = std::exp(L2 / sigma);
+
+  m_N[0] = A1 + A2;
+  m_N[1] = exp2 * (B2 * sin2 - (A2 + 2 * A1) * cos2)
+      + exp1 * (B1 * sin1 - (A1 + 2 * A2) * cos1);
+  m_N[2] = 2 * exp1 * exp2 * ((A1 + A2) * cos2 * cos1 - B1 * cos2 * sin1 - B2 * cos1 * sin2)
+      + A2 * exp1 * exp1 + A1 * exp2 * exp2;
+  m_N[3] = exp2 * exp1 * exp1 * (B2 * sin2 - A2 * cos2)
+      + exp1 * exp2 * exp2 * (B1 * sin1 - A1 * cos1);
+
+  m_D[0] = -2 * (exp2 * cos2 + exp1 * cos1);
+  m_D[1] = 4 * cos2 * cos1 * exp1 * exp2 + exp1 * exp1 + exp2 * exp2;
+  m_D[2] = -2 * cos1 * exp1 * exp2 * exp2 - 2 * cos2 * exp2 * exp1 * exp1;
+  m_D[3] = exp1 * exp1 * exp2 * exp2;
+
+  // The anti-causal pass mirrors the causal one, so that the filter is
+  // symmetric. Both are scaled so that the filter preserves a constant.
+  m_M[0] = m_N[1] - m_D[0] * m_N[0];
+  m_M[1] = m_N[2] - m_D[1] * m_N[0];
+  m_M[2] = m_N[3] - m_D[2] * m_N[0];
+  m_M[3] = -m_D[3] * m_N[0];
+
+  double sd = 1.0 + m_D[0] + m_D[1] + m_D[2] + m_D[3];
+  double sn = m_N[0] + m_N[1] + m_N[2] + m_N[3];
+  double sm = m_M[0] + m_M[1] + m_M[2] + m_M[3];
+  double alpha = (sn + sm) / sd;
+  for(int i = 0; i < 4; i++)
+    {
+    m_N[i] /= alpha;
+    m_M[i] /= alpha;
+    }
+
+  m_CausalGain = sn / (alpha * sd);
+  m_AntiCausalGain = sm / (alpha * sd);
+}
+
+long
+RecursiveGaussianFilterKernel
+::GetSupportRadius(double sigma)
+{
+  // The response decays like exp(-1.37 n / sigma), with lobes of both signs
+  return (long) std::ceil(6.0 * sigma) + 1;
+}
+
+void
+RecursiveGaussianFilterKernel
+::FilterLines(float *data, size_t A, size_t L, size_t B, size_t b0, size_t b1,
+              std::vector<double> &scratch) const
+{
+  const double n0 = m_N[0], n1 = m_N[1], n2 = m_N[2], n3 = m_N[3];
+  const double m1 = m_M[0], m2 = m_M[1], m3 = m_M[2], m4 = m_M[3];
+  const double d1 = m_D[0], d2 = m_D[1], d3 = m_D[2], d4 = m_D[3];
+  size_t nb = b1 - b0;
+  if(L < 2 || nb == 0)
+    return;
+
+  // The causal pass, with four rows of history in front, followed by four
+  // rows that hold the recent history of the anti-causal pass
+  scratch.resize((L + 8) * nb);
+  double *w = scratch.data() + 4 * nb;
+  double *v = w + L * nb;
+
+  for(size_t a = 0; a < A; a++)
+    {
+    float *line = data + a * L * B + b0;
+
+    // The input before the first sample replicates it, which puts the causal
+    // pass in a steady state
+    for(size_t b = 0; b < nb; b++)
+      for(size_t k = 0; k < 4; k++)
+        scratch[k * nb + b] = m_CausalGain * line[b];
+
+    for(size_t l = 0; l < L; l++)
+      {
+      const float *x0 = line + l * B;
+      const float *x1 = line + (l > 0 ? l - 1 : 0) * B;
+      const float *x2 = line + (l > 1 ? l - 2 : 0) * B;
+      const float *x3 = line + (l > 2 ? l - 3 : 0) * B;
+      double *wl = w + l * nb;
+      const double *w1 = wl - nb, *w2 = w1 - nb, *w3 = w2 - nb, *w4 = w3 - nb;
+      for(size_t b = 0; b < nb; b++)
+        wl[b] = n0 * x0[b] + n1 * x1[b] + n2 * x2[b] + n3 * x3[b]
+            - d1 * w1[b] - d2 * w2[b] - d3 * w3[b] - d4 * w4[b];
+      }
+
+    // The anti-causal pass runs backwards from the steady state of the last
+    // sample. Its output for sample l is kept in row l % 4 of v, and added to
+    // the causal output. The input is left alone until both passes are done.
+    const float *xlast = line + (L - 1) * B;
+    for(size_t b = 0; b < nb; b++)
+      for(size_t k = 0; k < 4; k++)
+        v[k * nb + b] = m_AntiCausalGain * xlast[b];
+
+    for(size_t l = L; l-- > 0; )
+      {
+      const float *x1 = line + std::min(l + 1, L - 1) * B;
+      const float *x2 = line + std::min(l + 2, L - 1) * B;
+      const float *x3 = line + std::min(l + 3, L - 1) * B;
+      const float *x4 = line + std::min(l + 4, L - 1) * B;
+      double *v1 = v + ((l + 1) & 3) * nb, *v2 = v + ((l + 2) & 3) * nb;
+      double *v3 = v + ((l + 3) & 3) * nb, *v0 = v + (l & 3) * nb;
+      double *wl = w + l * nb;
+      for(size_t b = 0; b < nb; b++)
+        {
+        // Row l % 4 holds the output for l + 4 until it is overwritten here
+        double y = m1 * x1[b] + m2 * x2[b] + m3 * x3[b] + m4 * x4[b]
+            - d1 * v1[b] - d2 * v2[b] - d3 * v3[b] - d4 * v0[b];
+        v0[b] = y;
+        wl[b] += y;
+        }
+      }
+
+    for(size_t l = 0; l < L; l++)
+      {
+      float *xl = line + l * B;
+      const double *wl = w + l * nb;
+      for(size_t b = 0; b < nb; b++)
+        xl[b] = (float) wl[b];
+      }
+    }
+}
+
+void
+RecursiveGaussianFilterKernel
+::FilterImage(float *data, const size_t *size, unsigned int ndim) const
+{
+  itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
+  for(unsigned int d = 0; d < ndim; d++)
+    {
+    size_t A = 1, B = 1, L = size[d];
+    for(unsigned int e = d + 1; e < ndim; e++)
+      A *= size[e];
+    for(unsigned int e = 0; e < d; e++)
+      B *= size[e];
+
+    // Each task filters the lines for a range of b within one a, so that
+    // there is enough work to go around even when A is 1
+    const size_t chunk = 256;
+    size_t n_chunks = (B + chunk - 1) / chunk;
+    mt->ParallelizeArray(0, A * n_chunks, [&](itk::SizeValueType task)
+      {
+      std::vector<double> scratch;
+      size_t a = task / n_chunks, b0 = (task % n_chunks) * chunk;
+      FilterLines(data + a * L * B, 1, L, B, b0, std::min(B, b0 + chunk), scratch);
+      }, nullptr);
+    }
+}
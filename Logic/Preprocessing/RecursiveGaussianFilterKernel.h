@@ -0,0 +1,61 @@
+#ifndef RECURSIVEGAUSSIANFILTERKERNEL_H
+#define RECURSIVEGAUSSIANFILTERKERNEL_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * A fourth-order recursive (IIR) approximation of Gaussian smoothing, after
+ * Deriche (1993), with the coefficients used by itk::RecursiveGaussianImageFilter.
+ * The output is the sum of a causal and an anti-causal pass over the input,
+ * and each pass starts from the steady state of the first or last sample, which
+ * is equivalent to replicating these samples indefinitely. The cost per sample
+ * does not depend on sigma, unlike that of a discrete convolution kernel.
+ *
+ * The approximation is not accurate for small sigmas, for which a discrete
+ * kernel is cheap anyway; see GetMinimumSigma(). Above it, the smoothed image
+ * is within about 1% of the intensity range of itk::DiscreteGaussianImageFilter
+ * with a maximum error of 0.01 (see RecursiveGaussianTest).
+ */
+class RecursiveGaussianFilterKernel
+{
+public:
+
+  /** Set up the filter coefficients for a sigma given in samples */
+  RecursiveGaussianFilterKernel(double sigma);
+
+  /** The smallest sigma for which the recursion approximates a Gaussian well */
+  static double GetMinimumSigma() { return 2.0; }
+
+  /**
+   * The number of samples beyond which the response of the filter to an
+   * impulse is negligible (below 3e-4 of the total), for the given sigma.
+   */
+  static long GetSupportRadius(double sigma);
+
+  /**
+   * Smooth the lines along the middle dimension of an array with shape
+   * (A, L, B) in place, restricted to the elements b0 <= b < b1 along the
+   * last dimension. The loops over b are innermost, so that lines along
+   * slow dimensions are filtered together.
+   */
+  void FilterLines(float *data, size_t A, size_t L, size_t B, size_t b0, size_t b1,
+                   std::vector<double> &scratch) const;
+
+  /**
+   * Smooth an image with the given dimensions in place along every
+   * dimension, using multiple threads.
+   */
+  void FilterImage(float *data, const size_t *size, unsigned int ndim) const;
+
+protected:
+
+  // Feed-forward coefficients of the causal and anti-causal passes, and the
+  // feedback coefficients shared by both
+  double m_N[4], m_M[4], m_D[4];
+
+  // Responses of the two passes to a constant input of one
+  double m_CausalGain, m_AntiCausalGain;
+};
+
+#endif // RECURSIVEGAUSSIANFILTERKERNEL_H
@@ -3,6 +3,10 @@
 #include "itkVectorImage.h"
 #include "itkImageRegionIteratorWithIndex.h"
 #include "itkNeighborhoodIterator.h"
+#include <vnl/vnl_matrix.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
@@ -11,70 +15,254 @@ const int MAX_VAL=100000;
 
 namespace bilwaj {
 
+// Sum over a sliding window of width w along the middle dimension of an array
+// of shape (A, L, B), giving an array of shape (A, L - w + 1, B). The inner
+// loops run over B, so that they can be vectorized.
+template <class T>
+static void BoxSum(const T *in, T *out, size_t A, size_t L, size_t B, size_t w)
+{
+  size_t L_out = L - w + 1;
+  for(size_t a = 0; a < A; a++)
+    {
+    const T *pin = in + a * L * B;
+    T *pout = out + a * L_out * B;
+
+    for(size_t b = 0; b < B; b++)
+      pout[b] = pin[b];
+    for(size_t t = 1; t < w; t++)
+      for(size_t b = 0; b < B; b++)
+        pout[b] += pin[t * B + b];
+
+    for(size_t l = 1; l < L_out; l++)
+      {
+      const T *add = pin + (l + w - 1) * B, *sub = pin + (l - 1) * B;
+      T *prev = pout + (l - 1) * B, *curr = pout + l * B;
+      for(size_t b = 0; b < B; b++)
+        curr[b] = prev[b] + add[b] - sub[b];
+      }
+    }
+}
+
+// Minimum or maximum over a sliding window, with the same layout as BoxSum,
+// computed with the van Herk / Gil-Werman algorithm, which takes three
+// comparisons per element regardless of the width of the window
+template <class T, class TCompare>
+static void BoxExtremum(const T *in, T *out, size_t A, size_t L, size_t B, size_t w,
+                        TCompare better, std::vector<T> &scratch)
+{
+  size_t L_out = L - w + 1;
+  scratch.resize(2 * L * B);
+  T *g = scratch.data(), *h = g + L * B;
+  for(size_t a = 0; a < A; a++)
+    {
+    const T *pin = in + a * L * B;
+    T *pout = out + a * L_out * B;
+
+    // Extremum from the start of each block of w elements, and to its end
+    for(size_t l = 0; l < L; l++)
+      for(size_t b = 0; b < B; b++)
+        g[l * B + b] = (l % w == 0) ? pin[l * B + b]
+                                    : std::min(g[(l - 1) * B + b], pin[l * B + b], better);
+    for(size_t l = L; l-- > 0; )
+      for(size_t b = 0; b < B; b++)
+        h[l * B + b] = (l % w == w - 1 || l == L - 1) ? pin[l * B + b]
+                                                      : std::min(h[(l + 1) * B + b], pin[l * B + b], better);
+
+    for(size_t l = 0; l < L_out; l++)
+      for(size_t b = 0; b < B; b++)
+        pout[l * B + b] = std::min(h[l * B + b], g[(l + w - 1) * B + b], better);
+    }
+}
+
+/**
+ * The moments are computed from sums of powers of the intensities over the
+ * neighborhood, which are separable box filters. The output region is split
+ * into tiles; each tile is padded by the radius, with the boundary of the
+ * input replicated as by the neighborhood iterator's default boundary
+ * condition, and the box filters are applied to the padded tile one
+ * dimension at a time with running sums. The intensity range comes from
+ * running minima and maxima. The cost per voxel thus depends on the degree
+ * but not on the radius. The intensities are centered on the mean of the
+ * tile before taking the powers, to preserve precision.
+ */
 template <class TInputImage, class TOutputImage>
 void
 MomentTextureFilter<TInputImage, TOutputImage>
 ::DynamicThreadedGenerateData(const RegionType & outputRegionForThread)
 {
+  const unsigned int VDim = ImageDimension;
+  const unsigned int nd = m_HighestDegree;
+
+  const InputImageType *input = this->GetInput();
+  const RegionType &inRegion = input->GetBufferedRegion();
+  const InputPixelType *inBuffer = input->GetBufferPointer();
+  const typename InputImageType::OffsetValueType *inOffsets = input->GetOffsetTable();
+
   // Iterator for the output region
   typedef itk::ImageRegionIteratorWithIndex<OutputImageType> OutputIteratorType;
-  OutputIteratorType TexIt(this->GetOutput(), outputRegionForThread);
-
-  // Neighborhood iterator for the input region
-  typedef itk::ConstNeighborhoodIterator<InputImageType> NeighborhoodIterator;
-  NeighborhoodIterator InpIt(m_Radius,this->GetInput(), outputRegionForThread);
+  OutputPixelType out_pix(nd);
 
-  // Accumulator array
-  vnl_vector<float> accumX(m_HighestDegree);
-  OutputPixelType out_pix(m_HighestDegree);
+  // Size of the neighborhood and of the tiles
+  double n_window = 1.0;
+  SizeType tile_size;
+  for(unsigned int d = 0; d < VDim; d++)
+    {
+    n_window *= 2 * m_Radius[d] + 1;
+    tile_size[d] = d < 2 ? 64 : 16;
+    }
 
-  for( TexIt.GoToBegin(); !TexIt.IsAtEnd(); ++TexIt, ++InpIt)
+  // Binomial coefficients for computing central moments from power sums
+  vnl_matrix<double> binom(nd + 1, nd + 1, 0.0);
+  for(unsigned int k = 0; k <= nd; k++)
     {
-    // On the first pass through the neighborhood compute the mean intensity and
-    // the intensity range in the neighborhood
-    float accum=0.0;
-    float min=0; //Store minimum voxel intensity value
-    float max=0; //Store maximum voxel intensity value
+    binom(k, 0) = 1.0;
+    for(unsigned int i = 1; i <= k; i++)
+      binom(k, i) = binom(k - 1, i - 1) + (i < k ? binom(k - 1, i) : 0.0);
+    }
 
-    for(int j=0;j<InpIt.Size();j++)
+  std::vector<float> values;
+  std::vector<double> buf_a, buf_b, scratch;
+
+  // Box-filtered quantities for the tile: minimum, maximum, power sums 1..nd
+  std::vector<std::vector<double> > boxed(nd + 2);
+  std::vector<double> m(nd + 1), mc_pow(nd + 1);
+
+  // Iterate over the tiles
+  typename RegionType::IndexType tile_start = outputRegionForThread.GetIndex();
+  typename RegionType::IndexType region_end = outputRegionForThread.GetUpperIndex();
+  while(true)
+    {
+    // The tile, and the tile padded by the radius
+    RegionType tile;
+    SizeType pad_size;
+    size_t n_pad = 1;
+    for(unsigned int d = 0; d < VDim; d++)
       {
-      InputPixelType pix = InpIt.GetPixel(j);
-      accum += pix;
-      min=MIN(min, pix);
-      max=MAX(max, pix);
+      tile.SetIndex(d, tile_start[d]);
+      tile.SetSize(d, std::min((itk::IndexValueType) tile_size[d],
+                               region_end[d] - tile_start[d] + 1));
+      pad_size[d] = tile.GetSize(d) + 2 * m_Radius[d];
+      n_pad *= pad_size[d];
       }
 
-    float range = max-min;
-    float mean = accum / InpIt.Size();
-
-    // On the second pass, compute the moments
-    accumX.fill(0.0f);
-    for(int j=0;j<InpIt.Size();j++)
+    // Read the padded tile, clamping to the buffered region of the input
+    values.resize(n_pad);
+    double center = 0.0;
+    typename RegionType::IndexType pos;
+    for(unsigned int d = 0; d < VDim; d++)
+      pos[d] = tile_start[d] - m_Radius[d];
+    for(size_t j = 0; j < n_pad; j++)
       {
-      InputPixelType pix = InpIt.GetPixel(j);
-      float norm_val = ((pix - mean) / range), norm_val_k = norm_val;
-      accumX[0] += norm_val;
-      for(int k = 1; k < m_HighestDegree; k++)
+      typename InputImageType::OffsetValueType offset = 0;
+      for(unsigned int d = 0; d < VDim; d++)
         {
-        norm_val_k *= norm_val;
-        accumX[k] += norm_val_k;
+        itk::IndexValueType c = std::max(inRegion.GetIndex(d),
+              std::min(pos[d], (itk::IndexValueType) (inRegion.GetIndex(d) + inRegion.GetSize(d) - 1)));
+        offset += (c - inRegion.GetIndex(d)) * inOffsets[d];
+        }
+      values[j] = inBuffer[offset];
+      center += values[j];
+
+      for(unsigned int d = 0; d < VDim; d++)
+        {
+        if(++pos[d] < (itk::IndexValueType) (tile_start[d] - m_Radius[d] + pad_size[d]))
+          break;
+        pos[d] = tile_start[d] - m_Radius[d];
         }
       }
+    center /= n_pad;
+
+    // Box-filter each of the quantities
+    for(unsigned int q = 0; q < nd + 2; q++)
+      {
+      buf_a.resize(n_pad);
+      buf_b.resize(n_pad);
+      for(size_t j = 0; j < n_pad; j++)
+        {
+        if(q < 2)
+          {
+          buf_a[j] = values[j];
+          }
+        else
+          {
+          double v = values[j] - center, vk = v;
+          for(unsigned int k = 1; k < q - 1; k++)
+            vk *= v;
+          buf_a[j] = vk;
+          }
+        }
+
+      SizeType shape = pad_size;
+      for(unsigned int d = 0; d < VDim; d++)
+        {
+        size_t A = 1, B = 1;
+        for(unsigned int e = d + 1; e < VDim; e++)
+          A *= shape[e];
+        for(unsigned int e = 0; e < d; e++)
+          B *= shape[e];
+
+        size_t w = 2 * m_Radius[d] + 1;
+        if(q == 0)
+          BoxExtremum(buf_a.data(), buf_b.data(), A, shape[d], B, w, std::less<double>(), scratch);
+        else if(q == 1)
+          BoxExtremum(buf_a.data(), buf_b.data(), A, shape[d], B, w, std::greater<double>(), scratch);
+        else
+          BoxSum(buf_a.data(), buf_b.data(), A, shape[d], B, w);
 
-    // Scale the moments by neighborhood size
-    accumX /= InpIt.Size();
+        shape[d] -= 2 * m_Radius[d];
+        buf_a.swap(buf_b);
+        }
 
-    // The first moment should just be the mean
-    accumX[0] = mean / range;
+      boxed[q].assign(buf_a.begin(), buf_a.begin() + tile.GetNumberOfPixels());
+      }
 
-    // Assign to the output voxel
-    for(int k = 0; k < m_HighestDegree; k++)
+    // Compute the moments for each voxel in the tile
+    size_t j = 0;
+    for(OutputIteratorType TexIt(this->GetOutput(), tile); !TexIt.IsAtEnd(); ++TexIt, ++j)
       {
-      out_pix[k] = static_cast<OutputComponentType>(1000 * accumX[k]);
+      // As before, the intensity range always includes zero
+      double min = std::min(0.0, boxed[0][j]);
+      double max = std::max(0.0, boxed[1][j]);
+      double range = max - min;
+
+      // Raw moments about the center, and the mean relative to the center
+      m[0] = 1.0;
+      for(unsigned int i = 1; i <= nd; i++)
+        m[i] = boxed[i + 1][j] / n_window;
+      double mc = m[1];
+
+      // The first moment is just the mean
+      out_pix[0] = static_cast<OutputComponentType>(1000 * (mc + center) / range);
+
+      // Central moments from the raw moments
+      mc_pow[0] = 1.0;
+      for(unsigned int i = 1; i <= nd; i++)
+        mc_pow[i] = mc_pow[i - 1] * (-mc);
+
+      double range_k = range;
+      for(unsigned int k = 2; k <= nd; k++)
+        {
+        double mu = 0.0;
+        for(unsigned int i = 0; i <= k; i++)
+          mu += binom(k, i) * m[i] * mc_pow[k - i];
+        range_k *= range;
+        out_pix[k - 1] = static_cast<OutputComponentType>(1000 * mu / range_k);
+        }
+
+      TexIt.Set(out_pix);
       }
 
-    // Assign to the output voxel
-    TexIt.Set(out_pix);
+    // Advance to the next tile
+    unsigned int d = 0;
+    for(; d < VDim; d++)
+      {
+      tile_start[d] += tile_size[d];
+      if(tile_start[d] <= region_end[d])
+        break;
+      tile_start[d] = outputRegionForThread.GetIndex(d);
+      }
+    if(d == VDim)
+      break;
     }
 }
 
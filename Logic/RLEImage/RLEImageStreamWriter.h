@@ -0,0 +1,83 @@
+#ifndef RLEIMAGESTREAMWRITER_H
+#define RLEIMAGESTREAMWRITER_H
+
+#include "RLEImage.h"
+#include <itkImageIOBase.h>
+#include <string>
+#include <vector>
+
+/**
+ * Writes an RLEImage to a NIfTI (.nii, .nii.gz) or MetaImage (.mha) file
+ * without first converting it to an uncompressed itk::Image.
+ *
+ * The header is produced by the regular ITK image IO, by writing a tiny image
+ * with the same geometry, pixel type and metadata as the input to the
+ * temporary directory, and patching the image dimensions. The voxel data is
+ * then generated a block of run-length lines at a time. For .nii.gz files, the blocks are expanded and
+ * compressed in parallel, each block becoming a separate gzip member. The
+ * concatenation of gzip members is a valid gzip stream, and is read by zlib
+ * (and therefore by the NIfTI reader) as a single file.
+ *
+ * Call CanStreamWrite() first: for other formats and options, the caller
+ * should fall back to itk::ImageFileWriter.
+ */
+template <class TImage>
+class RLEImageStreamWriter
+{
+public:
+
+  typedef TImage ImageType;
+  typedef typename ImageType::PixelType PixelType;
+  typedef typename ImageType::RLLine RLLine;
+  typedef typename ImageType::BufferType BufferType;
+  itkStaticConstMacro(ImageDimension, unsigned int, TImage::ImageDimension);
+
+  RLEImageStreamWriter();
+
+  /** Set the image to write */
+  void SetInput(const ImageType *image) { m_Image = image; }
+
+  /** Set the filename to write to */
+  void SetFileName(const std::string &fn) { m_FileName = fn; }
+
+  /** Set the IO that would be used to write the image (determines format) */
+  void SetImageIO(itk::ImageIOBase *io) { m_ImageIO = io; }
+
+  /** Approximate size of the blocks of voxel data compressed together */
+  void SetBlockSize(size_t bytes) { m_BlockSize = bytes; }
+
+  /** Check whether the image, file name and IO can be handled by this writer */
+  bool CanStreamWrite() const;
+
+  /** Write the image. Throws an IRISException on error */
+  void Update();
+
+protected:
+
+  enum Format { NIFTI, NIFTI_GZ, MHA, UNSUPPORTED };
+
+  Format GetFormat() const;
+
+  // A unique file name in the temporary directory for the header proxy image
+  static std::string GetTemporaryHeaderFileName(const char *extension);
+
+  // Generate the header bytes for the image using the ITK IO
+  void GenerateHeader(Format format, std::vector<char> &header) const;
+
+  // Expand lines [l0, l1) of the run-length buffer into raw voxel data
+  void ExpandLines(size_t l0, size_t l1, char *out) const;
+
+  // Compress a block of data into a single gzip member
+  static bool CompressGzipMember(const char *data, size_t size, std::vector<char> &out);
+
+  const ImageType *m_Image;
+  std::string m_FileName;
+  itk::ImageIOBase::Pointer m_ImageIO;
+  size_t m_BlockSize;
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "RLEImageStreamWriter.txx"
+#endif
+
+#endif // RLEIMAGESTREAMWRITER_H
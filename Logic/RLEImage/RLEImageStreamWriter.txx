@@ -0,0 +1,332 @@
+#ifndef RLEIMAGESTREAMWRITER_TXX
+#define RLEIMAGESTREAMWRITER_TXX
+
+#include "RLEImageStreamWriter.h"
+#include "IRISException.h"
+#include <itkImage.h>
+#include <itkImageFileWriter.h>
+#include <itkMultiThreaderBase.h>
+#include <itksys/SystemTools.hxx>
+#include "itk_zlib.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+template <class TImage>
+RLEImageStreamWriter<TImage>
+::RLEImageStreamWriter()
+{
+  m_Image = NULL;
+  m_BlockSize = 1 << 20;
+}
+
+template <class TImage>
+typename RLEImageStreamWriter<TImage>::Format
+RLEImageStreamWriter<TImage>
+::GetFormat() const
+{
+  if(!m_Image || !m_ImageIO)
+    return UNSUPPORTED;
+
+  std::string io_class = m_ImageIO->GetNameOfClass();
+  std::string fn = itksys::SystemTools::LowerCase(m_FileName);
+  if(io_class == "NiftiImageIO")
+    {
+    // Analyze files (.hdr/.img) are also written by the NIfTI IO
+    if(itksys::SystemTools::StringEndsWith(fn, ".nii.gz"))
+      return NIFTI_GZ;
+    if(itksys::SystemTools::StringEndsWith(fn, ".nii"))
+      return NIFTI;
+    }
+  else if(io_class == "MetaImageIO")
+    {
+    // Data of .mhd files goes into a separate file
+    if(itksys::SystemTools::StringEndsWith(fn, ".mha"))
+      return MHA;
+    }
+
+  return UNSUPPORTED;
+}
+
+template <class TImage>
+bool
+RLEImageStreamWriter<TImage>
+::CanStreamWrite() const
+{
+  Format format = GetFormat();
+  if(format == UNSUPPORTED)
+    return false;
+
+  // The whole image must be in memory, starting at the zero index
+  typename ImageType::RegionType region = m_Image->GetLargestPossibleRegion();
+  if(m_Image->GetBufferedRegion() != region)
+    return false;
+
+  for(unsigned int d = 0; d < ImageDimension; d++)
+    {
+    if(region.GetIndex(d) != 0 || region.GetSize(d) == 0)
+      return false;
+
+    // NIfTI-1 stores the dimensions as shorts
+    if(format != MHA && region.GetSize(d) > 32767)
+      return false;
+    }
+
+  return true;
+}
+
+template <class TImage>
+std::string
+RLEImageStreamWriter<TImage>
+::GetTemporaryHeaderFileName(const char *extension)
+{
+  // Unique across threads by the counter, and across processes by the time
+  // and the thread id
+  static std::atomic<unsigned long> counter(0);
+  std::ostringstream oss;
+  oss << "itksnap_header_"
+      << std::chrono::steady_clock::now().time_since_epoch().count() << "_"
+      << std::hash<std::thread::id>()(std::this_thread::get_id()) << "_"
+      << counter++ << extension;
+
+  std::error_code ec;
+  std::filesystem::path dir = std::filesystem::temp_directory_path(ec);
+  if(ec)
+    throw IRISException("Unable to find a temporary directory: %s", ec.message().c_str());
+
+  return (dir / oss.str()).string();
+}
+
+template <class TImage>
+void
+RLEImageStreamWriter<TImage>
+::GenerateHeader(Format format, std::vector<char> &header) const
+{
+  // Create a small image with the same geometry and metadata as the input.
+  // Each dimension has size 2 so that no dimension is dropped by the IO.
+  typedef itk::Image<PixelType, ImageDimension> ProxyImageType;
+  typename ProxyImageType::Pointer proxy = ProxyImageType::New();
+  typename ProxyImageType::SizeType proxy_size;
+  proxy_size.Fill(2);
+  proxy->SetRegions(proxy_size);
+  proxy->SetSpacing(m_Image->GetSpacing());
+  proxy->SetOrigin(m_Image->GetOrigin());
+  proxy->SetDirection(m_Image->GetDirection());
+  proxy->SetMetaDataDictionary(m_Image->GetMetaDataDictionary());
+  proxy->Allocate();
+  proxy->FillBuffer(PixelType());
+
+  // Write it uncompressed, using a new IO of the same kind. The file goes to
+  // the temporary directory, so that nothing is left next to the target file
+  std::string fn_proxy = GetTemporaryHeaderFileName(format == MHA ? ".mha" : ".nii");
+  itk::ImageIOBase::Pointer io =
+      dynamic_cast<itk::ImageIOBase *>(m_ImageIO->CreateAnother().GetPointer());
+
+  typedef itk::ImageFileWriter<ProxyImageType> WriterType;
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName(fn_proxy);
+  writer->SetImageIO(io);
+  writer->SetUseCompression(false);
+  writer->SetInput(proxy);
+  try
+    {
+    writer->Update();
+    }
+  catch(itk::ExceptionObject &exc)
+    {
+    itksys::SystemTools::RemoveFile(fn_proxy);
+    throw IRISException("Error writing image header for %s: %s",
+                        m_FileName.c_str(), exc.GetDescription());
+    }
+
+  // Read the proxy file back
+  std::ifstream ifs(fn_proxy.c_str(), std::ios::binary);
+  std::vector<char> data((std::istreambuf_iterator<char>(ifs)),
+                         std::istreambuf_iterator<char>());
+  ifs.close();
+  itksys::SystemTools::RemoveFile(fn_proxy);
+
+  typename ImageType::SizeType size = m_Image->GetLargestPossibleRegion().GetSize();
+  if(format == MHA)
+    {
+    // The header is text, ending with the line that says that data follows
+    std::string text(data.begin(), data.end());
+    size_t p_data = text.find("ElementDataFile = LOCAL");
+    size_t p_dim = text.find("DimSize = ");
+    if(p_data == std::string::npos || p_dim == std::string::npos
+       || text.find("CompressedData = True") != std::string::npos)
+      throw IRISException("Unexpected MetaImage header for %s", m_FileName.c_str());
+
+    size_t p_end = text.find('\n', p_data) + 1;
+    size_t p_dim_end = text.find('\n', p_dim);
+
+    std::ostringstream oss;
+    oss << "DimSize =";
+    for(unsigned int d = 0; d < ImageDimension; d++)
+      oss << " " << size[d];
+
+    text = text.substr(0, p_dim) + oss.str() + text.substr(p_dim_end, p_end - p_dim_end);
+    header.assign(text.begin(), text.end());
+    }
+  else
+    {
+    // Check that the header is a NIfTI-1 header in native byte order
+    int sizeof_hdr = 0;
+    float vox_offset = 0;
+    short dim0 = 0;
+    if(data.size() >= 348)
+      {
+      memcpy(&sizeof_hdr, &data[0], 4);
+      memcpy(&dim0, &data[40], 2);
+      memcpy(&vox_offset, &data[108], 4);
+      }
+
+    size_t n_header = (size_t) vox_offset;
+    if(sizeof_hdr != 348 || dim0 != (short) ImageDimension
+       || n_header < 348 || n_header > data.size())
+      throw IRISException("Unexpected NIfTI header for %s", m_FileName.c_str());
+
+    // Patch the dimensions, dim[1..n], and keep everything before the data
+    for(unsigned int d = 0; d < ImageDimension; d++)
+      {
+      short dim = (short) size[d];
+      memcpy(&data[42 + 2 * d], &dim, 2);
+      }
+
+    header.assign(data.begin(), data.begin() + n_header);
+    }
+}
+
+template <class TImage>
+void
+RLEImageStreamWriter<TImage>
+::ExpandLines(size_t l0, size_t l1, char *out) const
+{
+  const RLLine *lines = m_Image->GetBuffer()->GetBufferPointer();
+  size_t nx = m_Image->GetLargestPossibleRegion().GetSize(0);
+
+  PixelType *p = reinterpret_cast<PixelType *>(out);
+  for(size_t l = l0; l < l1; l++)
+    {
+    const RLLine &line = lines[l];
+    size_t remaining = nx;
+    for(size_t s = 0; s < line.size() && remaining > 0; s++)
+      {
+      size_t n = std::min((size_t) line[s].first, remaining);
+      std::fill_n(p, n, line[s].second);
+      p += n;
+      remaining -= n;
+      }
+
+    // Guard against incomplete lines
+    std::fill_n(p, remaining, PixelType());
+    p += remaining;
+    }
+}
+
+template <class TImage>
+bool
+RLEImageStreamWriter<TImage>
+::CompressGzipMember(const char *data, size_t size, std::vector<char> &out)
+{
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+
+  // Window bits of 15 + 16 produce a gzip header and trailer
+  if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return false;
+
+  out.resize(deflateBound(&zs, (uLong) size));
+  zs.next_in = (Bytef *) data;
+  zs.avail_in = (uInt) size;
+  zs.next_out = (Bytef *) out.data();
+  zs.avail_out = (uInt) out.size();
+
+  int rc = deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+
+  return rc == Z_STREAM_END;
+}
+
+template <class TImage>
+void
+RLEImageStreamWriter<TImage>
+::Update()
+{
+  if(!this->CanStreamWrite())
+    throw IRISException("Image can not be streamed to file %s", m_FileName.c_str());
+
+  Format format = GetFormat();
+  bool compress = (format == NIFTI_GZ);
+
+  std::vector<char> header, packed_header;
+  this->GenerateHeader(format, header);
+
+  std::ofstream ofs(m_FileName.c_str(), std::ios::binary | std::ios::trunc);
+  if(!ofs.good())
+    throw IRISException("Unable to open file %s for writing", m_FileName.c_str());
+
+  if(compress)
+    {
+    if(!CompressGzipMember(header.data(), header.size(), packed_header))
+      throw IRISException("Compression error writing %s", m_FileName.c_str());
+    ofs.write(packed_header.data(), packed_header.size());
+    }
+  else
+    {
+    ofs.write(header.data(), header.size());
+    }
+
+  // Divide the run-length lines into blocks of roughly the requested size
+  size_t nx = m_Image->GetLargestPossibleRegion().GetSize(0);
+  size_t line_bytes = nx * sizeof(PixelType);
+  size_t n_lines = m_Image->GetBuffer()->GetBufferedRegion().GetNumberOfPixels();
+  size_t lines_per_block = std::max((size_t) 1, m_BlockSize / line_bytes);
+  size_t n_blocks = (n_lines + lines_per_block - 1) / lines_per_block;
+
+  // Blocks are processed in batches that keep all threads busy, and each
+  // batch is written out in order before the next one is started
+  itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
+  size_t batch = std::max((size_t) 1, (size_t) (2 * mt->GetNumberOfWorkUnits()));
+  std::vector<std::vector<char> > raw(batch), packed(batch);
+  std::vector<char> status(batch);
+
+  for(size_t b0 = 0; b0 < n_blocks; b0 += batch)
+    {
+    size_t b1 = std::min(b0 + batch, n_blocks);
+    mt->ParallelizeArray(b0, b1, [&](itk::SizeValueType b)
+      {
+      size_t k = b - b0;
+      size_t l0 = b * lines_per_block, l1 = std::min(l0 + lines_per_block, n_lines);
+      raw[k].resize((l1 - l0) * line_bytes);
+      this->ExpandLines(l0, l1, raw[k].data());
+      status[k] = compress ? CompressGzipMember(raw[k].data(), raw[k].size(), packed[k]) : 1;
+      }, nullptr);
+
+    for(size_t k = 0; k < b1 - b0; k++)
+      {
+      if(!status[k])
+        throw IRISException("Compression error writing %s", m_FileName.c_str());
+
+      const std::vector<char> &block = compress ? packed[k] : raw[k];
+      ofs.write(block.data(), block.size());
+      }
+
+    if(!ofs.good())
+      throw IRISException("Error writing to file %s", m_FileName.c_str());
+    }
+
+  ofs.close();
+  if(ofs.fail())
+    throw IRISException("Error writing to file %s", m_FileName.c_str());
+}
+
+#endif // RLEIMAGESTREAMWRITER_TXX
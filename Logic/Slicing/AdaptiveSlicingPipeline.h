@@ -48,6 +48,7 @@
 #include "itkDataObjectDecorator.h"
 #include "IRISSlicer.h"
 #include "NonOrthogonalSlicer.h"
+#include "SliceLineReader.h"
 #include "SNAPCommon.h"
 
 class ImageCoordinateTransform;
@@ -65,11 +66,16 @@ template<typename TParametersValueType,
 /**
  * This filter encapsulates the ITK-SNAP slicing pipeline. It includes both
  * the straight (orthogonal) slicer and the oblique slicer. The input to this
- * pipeline is a 3D image, and it will generate slices for selected time points
+ * pipeline is a 3D image, and it will generate slices for selected time points.
+ *
+ * With orthogonal slicing and no preview image, the pipeline can also hand
+ * lines of the current slice to the display filters without generating the
+ * slice (see SliceLineReader).
  */
 template <typename TInputImage, typename TOutputImage, typename TPreviewImage>
 class AdaptiveSlicingPipeline
-    : public itk::ImageToImageFilter<TInputImage, TOutputImage>
+    : public itk::ImageToImageFilter<TInputImage, TOutputImage>,
+      public SliceLineReader<TOutputImage>
 {
 public:
   /** Standard class typedefs. */
@@ -151,6 +157,23 @@ public:
   void SetUseNearestNeighbor(bool flag);
   bool GetUseNearestNeighbor() const;
 
+  /**
+   * Generate the next n slices in the given direction (+1 or -1) relative to
+   * the current slice index in the background. This only has an effect with
+   * orthogonal slicing (see IRISSlicer::PrefetchSlices)
+   */
+  void PrefetchSlices(int direction, unsigned int n);
+
+  /** Whether lines of the slice can be read from the input directly */
+  virtual bool CanReadSliceLines() const ITK_OVERRIDE;
+
+  /** Copy n pixels of the current slice, starting at idx, from the input */
+  virtual void ReadSliceLine(const typename OutputImageType::IndexType &idx, size_t n,
+                             OutputPixelType *buffer) const ITK_OVERRIDE;
+
+  /** The current slice, if the orthogonal slicer generated it in advance */
+  virtual typename OutputImageType::ConstPointer GetPrefetchedSlice() ITK_OVERRIDE;
+
 protected:
 
   AdaptiveSlicingPipeline();
@@ -110,6 +110,61 @@ AdaptiveSlicingPipeline<TInputImage, TOutputImage, TPreviewImage>
     }
 }
 
+template<typename TInputImage, typename TOutputImage, typename TPreviewImage>
+void
+AdaptiveSlicingPipeline<TInputImage, TOutputImage, TPreviewImage>
+::PrefetchSlices(int direction, unsigned int n)
+{
+  if(!m_UseOrthogonalSlicing || !this->GetInput() || direction == 0)
+    return;
+
+  // Make sure the slicer is looking in the current direction
+  this->MapInputsToSlicers();
+
+  unsigned int axis = m_OrthogonalSlicer->GetSliceDirectionImageAxis();
+  long size = this->GetInput()->GetLargestPossibleRegion().GetSize(axis);
+
+  std::vector<unsigned int> slices;
+  for(unsigned int k = 1; k <= n; k++)
+    {
+    long index = m_SliceIndex[axis] + (direction > 0 ? 1 : -1) * (long) k;
+    if(index < 0 || index >= size)
+      break;
+    slices.push_back(static_cast<unsigned int>(index));
+    }
+
+  m_OrthogonalSlicer->PrefetchSlices(slices);
+}
+
+template<typename TInputImage, typename TOutputImage, typename TPreviewImage>
+bool
+AdaptiveSlicingPipeline<TInputImage, TOutputImage, TPreviewImage>
+::CanReadSliceLines() const
+{
+  // The slicers are configured when the output information is generated,
+  // which is why the input of the orthogonal slicer must match ours
+  return m_UseOrthogonalSlicing && this->GetInput() && !this->GetPreviewImage()
+      && m_OrthogonalSlicer->GetInput() == this->GetInput()
+      && m_OrthogonalSlicer->CanReadSliceLines();
+}
+
+template<typename TInputImage, typename TOutputImage, typename TPreviewImage>
+void
+AdaptiveSlicingPipeline<TInputImage, TOutputImage, TPreviewImage>
+::ReadSliceLine(const typename OutputImageType::IndexType &idx, size_t n,
+                OutputPixelType *buffer) const
+{
+  m_OrthogonalSlicer->ReadSliceLine(idx, n, buffer);
+}
+
+template<typename TInputImage, typename TOutputImage, typename TPreviewImage>
+typename TOutputImage::ConstPointer
+AdaptiveSlicingPipeline<TInputImage, TOutputImage, TPreviewImage>
+::GetPrefetchedSlice()
+{
+  return m_OrthogonalSlicer->GetPrefetchedSlice();
+}
+
 template<typename TInputImage, typename TOutputImage, typename TPreviewImage>
 void
 AdaptiveSlicingPipeline<TInputImage, TOutputImage, TPreviewImage>
@@ -42,6 +42,9 @@
 #include <itkImageSliceConstIteratorWithIndex.h>
 #include <itkImageRegionIteratorWithIndex.h>
 #include <itkImageLinearIteratorWithIndex.h>
+#include <list>
+#include <mutex>
+#include <vector>
 
 /**
  * \class IRISSlicer
@@ -138,6 +141,42 @@ public:
   itkGetMacro(BypassMainInput, bool)
   itkSetMacro(BypassMainInput, bool)
 
+  /**
+   * Generate the given slices (along the current slice direction) on the
+   * background threads of the SlicePrefetchQueue and keep them in a small
+   * cache, so that a subsequent update to one of these slice indices is a
+   * copy rather than a traversal of the input. Pending requests from earlier
+   * calls are cancelled. Nothing is done when the preview input is set,
+   * since the preview is generated lazily by its own pipeline.
+   */
+  void PrefetchSlices(const std::vector<unsigned int> &slices);
+
+  /** Maximum number of slices kept in the cache (0 disables prefetching) */
+  itkSetMacro(SliceCacheSize, unsigned int)
+  itkGetMacro(SliceCacheSize, unsigned int)
+
+  /**
+   * Whether ReadSliceLine() can be used, i.e., the whole main input is
+   * buffered. The preview input is not considered by ReadSliceLine().
+   */
+  bool CanReadSliceLines() const;
+
+  /**
+   * Copy n pixels of the current slice, starting at the given slice index,
+   * straight from the main input into a buffer, without generating the slice.
+   * The output information must be up to date. This does not modify the
+   * filter, so it can be called from several threads at once.
+   */
+  void ReadSliceLine(const typename OutputImageType::IndexType &idx, size_t n,
+                     OutputPixelType *buffer) const;
+
+  /**
+   * The current slice, if it has been generated by PrefetchSlices() for the
+   * current version of the main input, or NULL. The output information must
+   * be up to date. The slice is marked as the most recently used.
+   */
+  typename OutputImageType::ConstPointer GetPrefetchedSlice();
+
 protected:
   IRISSlicer();
   virtual ~IRISSlicer() {};
@@ -168,12 +207,80 @@ protected:
    */
   virtual void GenerateData() ITK_OVERRIDE;
 
-  template <class TSourceImage> void DoGenerateData(const TSourceImage *source);
+  // The parameters that determine which slice is extracted and how
+  struct SliceConfig
+  {
+    unsigned int SliceAxis, LineAxis, PixelAxis, SliceIndex;
+    bool LineForward, PixelForward;
+
+    bool operator == (const SliceConfig &o) const
+      {
+      return SliceAxis == o.SliceAxis && LineAxis == o.LineAxis
+          && PixelAxis == o.PixelAxis && SliceIndex == o.SliceIndex
+          && LineForward == o.LineForward && PixelForward == o.PixelForward;
+      }
+  };
+
+  SliceConfig GetSliceConfig(unsigned int slice_index) const;
+
+  // Offset in the input buffer of the first pixel of a slice, and the steps
+  // in the buffer between subsequent pixels and subsequent lines
+  struct SliceStrides
+  {
+    size_t Start;
+    long Pixel, Line;
+  };
+
+  template <class TSourceImage>
+  static SliceStrides ComputeSliceStrides(const TSourceImage *source,
+                                          const SliceConfig &config);
+
+  // Extract a slice from the source into an allocated output. This does not
+  // use the state of the filter, so it can be called from any thread
+  template <class TSourceImage>
+  static void DoGenerateData(const TSourceImage *source,
+                             OutputImageType *output,
+                             const SliceConfig &config);
+
+  // A slice generated ahead of time. The slice pointer is NULL until the
+  // slice has been generated by a worker thread
+  struct CachedSlice
+  {
+    const InputImageType *Input;
+    itk::ModifiedTimeType InputMTime;
+    SliceConfig Config;
+    OutputImagePointer Slice;
+    bool InProgress;
+  };
+
+  typedef typename std::list<CachedSlice>::iterator CachedSliceIterator;
+
+  // Find the cache entry for a slice, whether pending or not. The cache
+  // mutex must be held by the caller
+  CachedSliceIterator FindCachedSlice(const InputImageType *input,
+                                      itk::ModifiedTimeType input_mtime,
+                                      const SliceConfig &config);
+
+  // Fill the output from the cache, if it holds the requested slice
+  bool CopyFromCache(OutputImageType *output);
+
+  // Called on a worker thread to fill a pending cache entry
+  void GenerateCachedSlice(InputImagePointer input,
+                           itk::ModifiedTimeType input_mtime,
+                           SliceConfig config,
+                           OutputImageRegionType region,
+                           unsigned int ncomp);
 
 private:
   IRISSlicer(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
 
+  // Most recently used slices come first. Guarded by the mutex, since the
+  // entries are filled in by the worker threads
+  std::list<CachedSlice> m_SliceCache;
+  std::mutex m_SliceCacheMutex;
+  unsigned int m_SliceCacheSize;
+
   // Current slice in each of the dimensions
   unsigned int m_SliceIndex;
 
@@ -285,6 +392,26 @@ public:
   itkGetMacro(BypassMainInput, bool)
   itkSetMacro(BypassMainInput, bool)
 
+  /**
+   * Slices of run-length encoded images are cheap to extract and the images
+   * are edited in place, so they are not generated ahead of time
+   */
+  void PrefetchSlices(const std::vector<unsigned int> &) {}
+
+  /**
+   * Slices of run-length encoded images are expanded a run at a time, so
+   * single lines are not read from the input (see the generic IRISSlicer)
+   */
+  bool CanReadSliceLines() const { return false; }
+
+  void ReadSliceLine(const typename OutputImageType::IndexType &, size_t,
+                     OutputPixelType *) const
+  {
+    itkExceptionMacro(<< "Reading slice lines is not supported for RLE images");
+  }
+
+  typename OutputImageType::ConstPointer GetPrefetchedSlice() { return NULL; }
+
 protected:
 
   IRISSlicer();
@@ -38,6 +38,9 @@
 #include "itkImage.h"
 #include "itkVectorImage.h"
 #include "itkVectorImageToImageAdaptor.h"
+#include "SNAPTrace.h"
+#include "SlicePrefetchQueue.h"
+#include <algorithm>
 
 template <class TImage>
 class IRISSlicerComponentHelper
@@ -83,6 +86,24 @@ IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
   m_SliceIndex = 0;
 
   m_BypassMainInput = false;
+
+  // Enough slices to scroll ahead of the user in either direction
+  m_SliceCacheSize = 8;
+}
+
+template <class TInputImage, class TOutputImage, class TPreviewImage>
+typename IRISSlicer<TInputImage, TOutputImage, TPreviewImage>::SliceConfig
+IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
+::GetSliceConfig(unsigned int slice_index) const
+{
+  SliceConfig config;
+  config.SliceAxis = m_SliceDirectionImageAxis;
+  config.LineAxis = m_LineDirectionImageAxis;
+  config.PixelAxis = m_PixelDirectionImageAxis;
+  config.SliceIndex = slice_index;
+  config.LineForward = m_LineTraverseForward;
+  config.PixelForward = m_PixelTraverseForward;
+  return config;
 }
 
 template <class TInputImage, class TOutputImage, class TPreviewImage>
@@ -226,25 +247,12 @@ IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
 #include "itkImageConstIterator.h"
 #include "itkImageFileWriter.h"
 
-// This method is templated to allow preview input and actual input to be different
-// types
 template <class TInputImage, class TOutputImage, class TPreviewImage>
 template <class TSourceImage>
-void
+typename IRISSlicer<TInputImage, TOutputImage, TPreviewImage>::SliceStrides
 IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
-::DoGenerateData(const TSourceImage *inputPtr)
+::ComputeSliceStrides(const TSourceImage *inputPtr, const SliceConfig &config)
 {
-  typedef typename TSourceImage::AccessorFunctorType AccessorFunctorType;
-  typedef typename TSourceImage::AccessorType AccessorType;
-  typedef typename TSourceImage::OffsetValueType OffsetType;
-  typedef typename TSourceImage::InternalPixelType ComponentType;
-
-  // The output image
-  OutputImageType *outputPtr = this->GetOutput();
-
-  // Allocate (why is this necessary?)
-  this->AllocateOutputs();
-
   // Get the image dimensions
   typename InputImageType::SizeType szVol = inputPtr->GetBufferedRegion().GetSize();
 
@@ -260,32 +268,97 @@ IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
   stride_image *= ncomp;
 
   // Determine the strides for the pixel step and line step
-  int sPixel = (m_PixelTraverseForward ? 1 : -1) *
-    stride_image[m_PixelDirectionImageAxis];
-  int sLine = (m_LineTraverseForward ? 1 : -1) *
-    stride_image[m_LineDirectionImageAxis];
-
-  // We never take full line-strides, because as we iterate, we
-  // take n pixel-strides before needing to worry about changing
-  // the line. Therefore, we compute the step needed to go to the
-  // start of next line after taking n pixel-strides
-  int sRowOfPixels = sPixel * szVol[m_PixelDirectionImageAxis];
-  int sLineDelta = sLine - sRowOfPixels;
+  SliceStrides strides;
+  strides.Pixel = (config.PixelForward ? 1 : -1) *
+    static_cast<long>(stride_image[config.PixelAxis]);
+  strides.Line = (config.LineForward ? 1 : -1) *
+    static_cast<long>(stride_image[config.LineAxis]);
 
   // Determine the first voxel that we will traverse
   Vector3i xStartVoxel;
-  xStartVoxel[m_PixelDirectionImageAxis] =
-    m_PixelTraverseForward ? 0 : szVol[m_PixelDirectionImageAxis] - 1;
-  xStartVoxel[m_LineDirectionImageAxis] =
-    m_LineTraverseForward ? 0 : szVol[m_LineDirectionImageAxis] - 1;
-  xStartVoxel[m_SliceDirectionImageAxis] =
-    szVol[m_SliceDirectionImageAxis] == 1 ? 0 : m_SliceIndex;
+  xStartVoxel[config.PixelAxis] =
+    config.PixelForward ? 0 : szVol[config.PixelAxis] - 1;
+  xStartVoxel[config.LineAxis] =
+    config.LineForward ? 0 : szVol[config.LineAxis] - 1;
+  xStartVoxel[config.SliceAxis] =
+    szVol[config.SliceAxis] == 1 ? 0 : config.SliceIndex;
 
   // Get the offset of the first voxel. As pointed out by Roman Grothausmann, the VNL
   // dot product causes overflow so we compute directly.
-  size_t iStart = 0;
+  strides.Start = 0;
   for(int i = 0; i < 3; i++)
-    iStart += static_cast<long>(stride_image[i]) * static_cast<long>(xStartVoxel[i]);
+    strides.Start += static_cast<long>(stride_image[i]) * static_cast<long>(xStartVoxel[i]);
+
+  return strides;
+}
+
+template <class TInputImage, class TOutputImage, class TPreviewImage>
+bool
+IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
+::CanReadSliceLines() const
+{
+  const InputImageType *input = this->GetInput();
+  return input && input->GetBufferPointer()
+      && input->GetBufferedRegion() == input->GetLargestPossibleRegion();
+}
+
+template <class TInputImage, class TOutputImage, class TPreviewImage>
+void
+IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
+::ReadSliceLine(const typename OutputImageType::IndexType &idx, size_t n,
+                OutputPixelType *buffer) const
+{
+  typedef typename InputImageType::AccessorFunctorType AccessorFunctorType;
+  typedef typename InputImageType::AccessorType AccessorType;
+
+  const InputImageType *inputPtr = this->GetInput();
+  SliceStrides strides = ComputeSliceStrides(inputPtr, this->GetSliceConfig(m_SliceIndex));
+
+  // The first pixel of the slice is the first pixel of the output region
+  typename OutputImageType::IndexType origin =
+      this->GetOutput()->GetLargestPossibleRegion().GetIndex();
+  const InputComponentType *pSource = inputPtr->GetBufferPointer() + strides.Start
+      + (idx[0] - origin[0]) * strides.Pixel + (idx[1] - origin[1]) * strides.Line;
+
+  // Use the accessor, as in DoGenerateData
+  AccessorType accessor = inputPtr->GetPixelAccessor();
+  AccessorFunctorType accessor_functor;
+  accessor_functor.SetPixelAccessor(accessor);
+
+  for(size_t i = 0; i < n; i++, pSource += strides.Pixel)
+    {
+    accessor_functor.SetBegin(pSource);
+    buffer[i] = accessor_functor.Get(*pSource);
+    }
+}
+
+// This method is templated to allow preview input and actual input to be different
+// types
+template <class TInputImage, class TOutputImage, class TPreviewImage>
+template <class TSourceImage>
+void
+IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
+::DoGenerateData(const TSourceImage *inputPtr, OutputImageType *outputPtr,
+                 const SliceConfig &config)
+{
+  typedef typename TSourceImage::AccessorFunctorType AccessorFunctorType;
+  typedef typename TSourceImage::AccessorType AccessorType;
+  typedef typename TSourceImage::InternalPixelType ComponentType;
+
+  // Get the image dimensions
+  typename InputImageType::SizeType szVol = inputPtr->GetBufferedRegion().GetSize();
+
+  // Get the position of the first voxel and the strides
+  SliceStrides strides = ComputeSliceStrides(inputPtr, config);
+  long sPixel = strides.Pixel;
+
+  // We never take full line-strides, because as we iterate, we
+  // take n pixel-strides before needing to worry about changing
+  // the line. Therefore, we compute the step needed to go to the
+  // start of next line after taking n pixel-strides
+  long sRowOfPixels = sPixel * szVol[config.PixelAxis];
+  long sLineDelta = strides.Line - sRowOfPixels;
+  size_t iStart = strides.Start;
 
   // Get pointers to input and output data
   const ComponentType *pSource = inputPtr->GetBufferPointer();
@@ -329,24 +402,207 @@ void
 IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
 ::GenerateData()
 {
+  SNAP_TRACE_SCOPE("slicing", "IRISSlicer::GenerateData");
+
   // Here's the input and output
   const InputImageType *inputPtr = this->GetInput();
+  OutputImageType *outputPtr = this->GetOutput();
+
+  // Allocate (why is this necessary?)
+  this->AllocateOutputs();
 
   // Decide if we want to use the preview input instead
   const PreviewImageType *preview =
       (PreviewImageType *) this->GetInputs()[1].GetPointer();
 
+  SliceConfig config = this->GetSliceConfig(m_SliceIndex);
+
   if(preview &&
      (m_BypassMainInput || preview->GetMTime() > inputPtr->GetMTime()))
     {
-    this->DoGenerateData(preview);
+    DoGenerateData(preview, outputPtr, config);
     }
-  else
+  else if(!this->CopyFromCache(outputPtr))
     {
-    this->DoGenerateData(inputPtr);
+    DoGenerateData(inputPtr, outputPtr, config);
     }
 }
 
+template <class TInputImage, class TOutputImage, class TPreviewImage>
+typename IRISSlicer<TInputImage, TOutputImage, TPreviewImage>::CachedSliceIterator
+IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
+::FindCachedSlice(const InputImageType *input,
+                  itk::ModifiedTimeType input_mtime,
+                  const SliceConfig &config)
+{
+  for(CachedSliceIterator it = m_SliceCache.begin(); it != m_SliceCache.end(); ++it)
+    {
+    if(it->Input == input && it->InputMTime == input_mtime && it->Config == config)
+      return it;
+    }
+  return m_SliceCache.end();
+}
+
+template <class TInputImage, class TOutputImage, class TPreviewImage>
+bool
+IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
+::CopyFromCache(OutputImageType *output)
+{
+  typename OutputImageType::ConstPointer slice = this->GetPrefetchedSlice();
+  if(!slice || slice->GetBufferedRegion() != output->GetBufferedRegion()
+     || slice->GetPixelContainer()->Size() != output->GetPixelContainer()->Size())
+    return false;
+
+  const OutputComponentType *src = slice->GetBufferPointer();
+  std::copy(src, src + slice->GetPixelContainer()->Size(),
+            output->GetBufferPointer());
+  return true;
+}
+
+template <class TInputImage, class TOutputImage, class TPreviewImage>
+typename TOutputImage::ConstPointer
+IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
+::GetPrefetchedSlice()
+{
+  const InputImageType *input = this->GetInput();
+  if(m_SliceCacheSize == 0 || !input)
+    return NULL;
+
+  std::lock_guard<std::mutex> lock(m_SliceCacheMutex);
+  CachedSliceIterator it = this->FindCachedSlice(
+        input, input->GetMTime(), this->GetSliceConfig(m_SliceIndex));
+
+  if(it == m_SliceCache.end() || !it->Slice
+     || it->Slice->GetBufferedRegion() != this->GetOutput()->GetLargestPossibleRegion())
+    return NULL;
+
+  // Mark as most recently used
+  m_SliceCache.splice(m_SliceCache.begin(), m_SliceCache, it);
+  return it->Slice.GetPointer();
+}
+
+template <class TInputImage, class TOutputImage, class TPreviewImage>
+void
+IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
+::GenerateCachedSlice(InputImagePointer input,
+                      itk::ModifiedTimeType input_mtime,
+                      SliceConfig config,
+                      OutputImageRegionType region,
+                      unsigned int ncomp)
+{
+  SNAP_TRACE_SCOPE("slicing", "IRISSlicer::GenerateCachedSlice");
+
+  // The request may have been withdrawn, or another worker may be on it
+    {
+    std::lock_guard<std::mutex> lock(m_SliceCacheMutex);
+    CachedSliceIterator it = this->FindCachedSlice(input, input_mtime, config);
+    if(it == m_SliceCache.end() || it->Slice || it->InProgress)
+      return;
+    it->InProgress = true;
+    }
+
+  OutputImagePointer slice = OutputImageType::New();
+  slice->SetRegions(region);
+  IRISSlicerComponentHelper<OutputImageType>::SetImageComponents(slice, ncomp);
+  slice->Allocate();
+  DoGenerateData(input.GetPointer(), slice.GetPointer(), config);
+
+  // Discard the slice if the input changed while we were working
+  if(input->GetMTime() != input_mtime)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_SliceCacheMutex);
+  CachedSliceIterator it = this->FindCachedSlice(input, input_mtime, config);
+  if(it != m_SliceCache.end() && !it->Slice)
+    {
+    it->Slice = slice;
+    it->InProgress = false;
+    }
+}
+
+template <class TInputImage, class TOutputImage, class TPreviewImage>
+void
+IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
+::PrefetchSlices(const std::vector<unsigned int> &slices)
+{
+  if(m_SliceCacheSize == 0 || this->GetPreviewInput())
+    return;
+
+  // Only fully buffered inputs can be sliced outside of the pipeline
+  InputImagePointer input = this->GetInput();
+  if(!input || input->GetBufferedRegion() != input->GetLargestPossibleRegion())
+    return;
+
+  this->UpdateOutputInformation();
+  OutputImageRegionType region = this->GetOutput()->GetLargestPossibleRegion();
+  unsigned int ncomp = this->GetOutput()->GetNumberOfComponentsPerPixel();
+  itk::ModifiedTimeType mtime = input->GetMTime();
+
+  // Requests from earlier calls that have not started are no longer needed
+  SlicePrefetchQueue *queue = SlicePrefetchQueue::GetInstance();
+  queue->Cancel(this);
+
+  std::vector<SliceConfig> requested;
+  unsigned int szSlice = input->GetLargestPossibleRegion().GetSize(m_SliceDirectionImageAxis);
+  for(unsigned int i = 0; i < slices.size() && requested.size() < m_SliceCacheSize; i++)
+    if(slices[i] < szSlice)
+      requested.push_back(this->GetSliceConfig(slices[i]));
+
+  std::lock_guard<std::mutex> lock(m_SliceCacheMutex);
+
+  // Drop slices of older versions of the input, and pending slices that are
+  // no longer requested
+  for(CachedSliceIterator it = m_SliceCache.begin(); it != m_SliceCache.end(); )
+    {
+    if(it->Input != input.GetPointer() || it->InputMTime != mtime
+       || (!it->Slice && std::find(requested.begin(), requested.end(), it->Config)
+           == requested.end()))
+      it = m_SliceCache.erase(it);
+    else
+      ++it;
+    }
+
+  // Move the requested slices to the front of the cache in reverse order, so
+  // that the nearest slice ends up first
+  for(typename std::vector<SliceConfig>::reverse_iterator rit = requested.rbegin();
+      rit != requested.rend(); ++rit)
+    {
+    CachedSliceIterator it = this->FindCachedSlice(input, mtime, *rit);
+    if(it != m_SliceCache.end())
+      {
+      m_SliceCache.splice(m_SliceCache.begin(), m_SliceCache, it);
+      }
+    else
+      {
+      CachedSlice entry;
+      entry.Input = input.GetPointer();
+      entry.InputMTime = mtime;
+      entry.Config = *rit;
+      entry.InProgress = false;
+      m_SliceCache.push_front(entry);
+      }
+    }
+
+  // Queue the slices that are not yet generated, nearest first
+  Pointer self = this;
+  CachedSliceIterator it = m_SliceCache.begin();
+  for(unsigned int i = 0; i < requested.size() && it != m_SliceCache.end(); i++, ++it)
+    {
+    if(it->Slice || it->InProgress)
+      continue;
+
+    SliceConfig config = it->Config;
+    queue->Submit(this, [self, input, mtime, config, region, ncomp]()
+      {
+      self->GenerateCachedSlice(input, mtime, config, region, ncomp);
+      });
+    }
+
+  // Forget the least recently used slices
+  while(m_SliceCache.size() > m_SliceCacheSize)
+    m_SliceCache.pop_back();
+}
+
 template <class TInputImage, class TOutputImage, class TPreviewImage>
 void
 IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
@@ -360,6 +616,7 @@ IRISSlicer<TInputImage, TOutputImage, TPreviewImage>
   os << indent << "Lines Traversed Forward: " << m_LineTraverseForward << std::endl;
   os << indent << "Pixel Image Axis: " << m_PixelDirectionImageAxis << std::endl;
   os << indent << "Pixels Traversed Forward: " << m_PixelTraverseForward << std::endl;
+  os << indent << "Slice Cache Size: " << m_SliceCacheSize << std::endl;
 }
 
 template <class TInputImage, class TOutputImage, class TPreviewImage>
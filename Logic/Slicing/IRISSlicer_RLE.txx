@@ -38,6 +38,7 @@
 #include "itkImage.h"
 #include "itkVectorImage.h"
 #include "itkVectorImageToImageAdaptor.h"
+#include "SNAPTrace.h"
 
 //now goes version specialized for RLEImage
 template< typename TPixel, typename CounterType, class TOutputImage, class TPreviewImage>
@@ -202,6 +203,8 @@ template< typename TPixel, typename CounterType, class TOutputImage, class TPrev
 void IRISSlicer<RLEImage<TPixel, 3, CounterType>, TOutputImage, TPreviewImage>
 ::GenerateData()
 {
+  SNAP_TRACE_SCOPE("slicing", "IRISSlicer<RLEImage>::GenerateData");
+
   // Here's the input and output
   const InputImageType *inputPtr = this->GetInput();
   OutputImageType *outputPtr = this->GetOutput();
@@ -2,32 +2,44 @@
 #include "RLEImageRegionIterator.h"
 #include <itkRGBAPixel.h>
 #include "ColorLookupTable.h"
+#include <vector>
 
 template<class TInputImage, class TOutputImage>
 LookupTableIntensityMappingFilter<TInputImage, TOutputImage>
 ::LookupTableIntensityMappingFilter()
 {
-  // The image and the LUT are inputs
-  this->SetNumberOfIndexedInputs(1);
+  // The LUT is the input, the slice is set with SetSliceInput()
   this->AddRequiredInputName("LookupTable");
 }
 
+template<class TInputImage, class TOutputImage>
+template<bool VZeroOutOfRange>
+void
+LookupTableIntensityMappingFilter<TInputImage, TOutputImage>
+::MapLine(const InputPixelType *in, OutputPixelType *out, size_t n,
+          const LookupTableType *lut)
+{
+  for(const InputPixelType *in_end = in + n; in < in_end; ++in, ++out)
+    {
+    // Special case: intensity is actually outside of the min/max range
+    if(VZeroOutOfRange && *in == 0)
+      out->Fill(0);
+    else
+      *out = lut->MapIntensityToDisplay(*in);
+    }
+}
+
 template<class TInputImage, class TOutputImage>
 void
 LookupTableIntensityMappingFilter<TInputImage, TOutputImage>
 ::DynamicThreadedGenerateData(const OutputRegionType &region)
 {
-  // Get the input and output images
-  const InputImageType *input = this->GetInput();
+  // Get the output image
   OutputImageType *output = this->GetOutput(0);
 
   // Get the range of intensities mapped that the LUT handles
   const LookupTableType *lut = this->GetLookupTable();
 
-  // Define the iterators
-  itk::ImageRegionConstIterator<TInputImage> inputIt(input, region);
-  itk::ImageRegionIterator<TOutputImage> outputIt(output, region);
-
   // Does zero map out of the LUT's range? We may get inputs of zero from
   // the non-orthogonal slicer (data outside of image range) that would fall
   // outside of the colormap. This is really a poor way to handle this but
@@ -35,27 +47,22 @@ LookupTableIntensityMappingFilter<TInputImage, TOutputImage>
   // TODO: fix this.
   bool zero_out_of_range = !lut->CheckRange(0);
 
-  // Perform the intensity mapping using the LUT (no bounds checking!)
-  while( !inputIt.IsAtEnd() )
-    {
-    // Get the input intensity
-    InputPixelType xin = inputIt.Get();
-    OutputPixelType xout;
+  // Go line by line: each line of the slice is read from the 3D image into
+  // a small buffer, mapped, and written as RGBA pixels straight into the
+  // output buffer that is shared with the VTK texture
+  size_t n = region.GetSize(0);
+  std::vector<InputPixelType> line(n);
+  OutputPixelType *out_buffer = output->GetBufferPointer();
 
-    if(zero_out_of_range && xin == 0)
-      {
-      // Special case: intensity is actually outside of the min/max range
-      xout.Fill(0);
-      }
+  typename OutputRegionType::IndexType idx = region.GetIndex();
+  for(unsigned int j = 0; j < region.GetSize(1); j++, idx[1]++)
+    {
+    const InputPixelType *in = this->GetSliceLine(0, idx, n, line.data());
+    OutputPixelType *out = out_buffer + output->ComputeOffset(idx);
+    if(zero_out_of_range)
+      MapLine<true>(in, out, n, lut);
     else
-      {
-      xout = lut->MapIntensityToDisplay(xin);
-      }
-
-    outputIt.Set(xout);
-
-    ++inputIt;
-    ++outputIt;
+      MapLine<false>(in, out, n, lut);
     }
 }
 
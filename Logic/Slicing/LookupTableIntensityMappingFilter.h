@@ -2,7 +2,7 @@
 #define LOOKUPTABLEINTENSITYMAPPINGFILTER_H
 
 #include "SNAPCommon.h"
-#include <itkImageToImageFilter.h>
+#include "SlicingImageSource.h"
 #include <itkSimpleDataObjectDecorator.h>
 #include <itkVectorImage.h>
 
@@ -10,17 +10,19 @@ template <class TInputPixel, class TDisplayPixel> class ColorLookupTable;
 
 
 /**
-  This ITK filter uses a lookup table to map image intensities. The input
-  image should be of an integral type.
+  This ITK filter uses a lookup table to map the intensities of a slice. The
+  input image should be of an integral type. The slice is set with
+  SetSliceInput() and is usually read straight from the 3D image, so that
+  slicing and mapping happen in one pass (see SlicingImageSource).
   */
 template<class TInputImage, class TOutputImage>
 class LookupTableIntensityMappingFilter :
-    public itk::ImageToImageFilter<TInputImage, TOutputImage>
+    public SlicingImageSource<TInputImage, TOutputImage>
 {
 public:
 
   typedef LookupTableIntensityMappingFilter<TInputImage, TOutputImage>   Self;
-  typedef itk::ImageToImageFilter<TInputImage, TOutputImage>       Superclass;
+  typedef SlicingImageSource<TInputImage, TOutputImage>            Superclass;
   typedef itk::SmartPointer<Self>                                     Pointer;
   typedef itk::SmartPointer<const Self>                          ConstPointer;
 
@@ -41,7 +43,7 @@ public:
   // This is necessary to use itkGet/SetInputMacros to avoid gcc compiling error
   using ProcessObject = itk::ProcessObject;
 
-  itkTypeMacro(LookupTableIntensityMappingFilter, ImageToImageFilter)
+  itkTypeMacro(LookupTableIntensityMappingFilter, SlicingImageSource)
   itkNewMacro(Self)
 
   /** Set the intensity remapping curve - for contrast adjustment */
@@ -60,6 +62,11 @@ protected:
 
   LookupTableIntensityMappingFilter();
   virtual ~LookupTableIntensityMappingFilter() {}
+
+  // Map a contiguous run of pixels
+  template <bool VZeroOutOfRange>
+  static void MapLine(const InputPixelType *in, OutputPixelType *out, size_t n,
+                      const LookupTableType *lut);
 };
 
 
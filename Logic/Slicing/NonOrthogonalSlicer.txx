@@ -46,6 +46,7 @@
 #include "NonOrthogonalSlicer.h"
 #include "FastLinearInterpolator.h"
 #include "ImageRegionConstIteratorWithIndexOverride.h"
+#include "SNAPTrace.h"
 
 template <typename TInputImage, typename TOutputImage, typename TWorkerTraits>
 NonOrthogonalSlicer<TInputImage, TOutputImage, TWorkerTraits>
@@ -110,6 +111,8 @@ void
 NonOrthogonalSlicer<TInputImage, TOutputImage, TWorkerTraits>
 ::DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread)
 {
+  SNAP_TRACE_SCOPE("slicing", "NonOrthogonalSlicer::DynamicThreadedGenerateData");
+
   // The input 4D image volume
   InputImageType *input = const_cast<InputImageType *>(this->GetInput());
 
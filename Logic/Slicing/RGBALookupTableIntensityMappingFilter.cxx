@@ -1,13 +1,13 @@
 #include "RGBALookupTableIntensityMappingFilter.h"
 #include "RLEImageRegionIterator.h"
 #include "ColorLookupTable.h"
+#include <vector>
 
 template<class TInputImage>
 RGBALookupTableIntensityMappingFilter<TInputImage>
 ::RGBALookupTableIntensityMappingFilter()
 {
-  // Multiple images are indexed inputs
-  this->SetNumberOfRequiredInputs(3);
+  // The LUT is the input, the three slices are set with SetSliceInput()
   this->AddRequiredInputName("LookupTable");
 }
 
@@ -16,11 +16,6 @@ void
 RGBALookupTableIntensityMappingFilter<TInputImage>
 ::DynamicThreadedGenerateData(const OutputImageRegionType &region)
 {
-  // Get all the inputs
-  std::vector<const InputImageType *> inputs(3);
-  for(int d = 0; d < 3; d++)
-    inputs[d] = this->GetInput(d);
-
   // Get the output
   OutputImageType *output = this->GetOutput(0);
 
@@ -34,41 +29,36 @@ RGBALookupTableIntensityMappingFilter<TInputImage>
   // TODO: fix this.
   bool zero_out_of_range = !lut->CheckRange(0);
 
-  // Define the iterators
-  typedef itk::ImageRegionConstIterator<InputImageType> InputIteratorType;
-  InputIteratorType it0(inputs[0], region);
-  InputIteratorType it1(inputs[1], region);
-  InputIteratorType it2(inputs[2], region);
-
-  itk::ImageRegionIterator<OutputImageType> outputIt(output, region);
-
-  // Perform the intensity mapping using the LUT (no bounds checking!)
-  while( !outputIt.IsAtEnd() )
+  // Go line by line: the lines of the three channels are read from the 3D
+  // image into small buffers, and the RGBA pixels are written straight into
+  // the output buffer that is shared with the VTK texture
+  size_t n = region.GetSize(0);
+  std::vector<InputPixelType> line(3 * n);
+  typename OutputImageRegionType::IndexType idx = region.GetIndex();
+  for(unsigned int j = 0; j < region.GetSize(1); j++, idx[1]++)
     {
-    OutputPixelType xout;
-
-    InputPixelType xin0 = it0.Get();
-    InputPixelType xin1 = it1.Get();
-    InputPixelType xin2 = it2.Get();
+    const InputPixelType *in0 = this->GetSliceLine(0, idx, n, line.data());
+    const InputPixelType *in1 = this->GetSliceLine(1, idx, n, line.data() + n);
+    const InputPixelType *in2 = this->GetSliceLine(2, idx, n, line.data() + 2 * n);
+    OutputPixelType *out = output->GetBufferPointer() + output->ComputeOffset(idx);
 
-    // TODO: we need to handle out of bounds voxels in non-orthogonal slicing
-    // better than this, i.e., via a special value reserved for such voxels.
-    // Right now, defaulting to zero is a DISASTER!
-    if(zero_out_of_range && xin0 == 0 && xin1 == 0 && xin2 == 0)
+    for(size_t i = 0; i < n; i++, ++out)
       {
-      xout.Fill(0);
+      // TODO: we need to handle out of bounds voxels in non-orthogonal slicing
+      // better than this, i.e., via a special value reserved for such voxels.
+      // Right now, defaulting to zero is a DISASTER!
+      if(zero_out_of_range && in0[i] == 0 && in1[i] == 0 && in2[i] == 0)
+        {
+        out->Fill(0);
+        }
+      else
+        {
+        (*out)[0] = lut->MapIntensityToDisplay(in0[i]);
+        (*out)[1] = lut->MapIntensityToDisplay(in1[i]);
+        (*out)[2] = lut->MapIntensityToDisplay(in2[i]);
+        (*out)[3] = 255; // alpha = 1
+        }
       }
-    else
-      {
-      xout[0] = lut->MapIntensityToDisplay(xin0);
-      xout[1] = lut->MapIntensityToDisplay(xin1);
-      xout[2] = lut->MapIntensityToDisplay(xin2);
-      xout[3] = 255; // alpha = 1
-      }
-
-    outputIt.Set(xout);
-    ++it0; ++it1; ++it2;
-    ++outputIt;
     }
 }
 
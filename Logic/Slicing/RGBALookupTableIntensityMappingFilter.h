@@ -2,8 +2,8 @@
 #define MULTICHANNELLUTINTENSITYMAPPINGFILTER_H
 
 #include "SNAPCommon.h"
+#include "SlicingImageSource.h"
 #include "itkRGBAPixel.h"
-#include <itkImageToImageFilter.h>
 
 template <class TInputPixel, class TDisplayPixel> class ColorLookupTable;
 
@@ -11,11 +11,13 @@ template <class TInputPixel, class TDisplayPixel> class ColorLookupTable;
 /**
  * This filter takes multiple input channels and a common lookup table, and
  * generates an image of pixels of a certain vector type, e.g., RGBAPixel.
+ * The channels are the slices 0, 1 and 2 set with SetSliceInput(), which are
+ * usually read straight from the 3D images (see SlicingImageSource).
  */
 template<class TInputImage>
 class RGBALookupTableIntensityMappingFilter :
-    public itk::ImageToImageFilter<TInputImage,
-                                   itk::Image<itk::RGBAPixel<unsigned char>, 2> >
+    public SlicingImageSource<TInputImage,
+                              itk::Image<itk::RGBAPixel<unsigned char>, 2> >
 {
 public:
 
@@ -23,7 +25,7 @@ public:
   typedef itk::Image<OutputPixelType, 2>                      OutputImageType;
 
   typedef RGBALookupTableIntensityMappingFilter<TInputImage>             Self;
-  typedef itk::ImageToImageFilter<TInputImage, OutputImageType>    Superclass;
+  typedef SlicingImageSource<TInputImage, OutputImageType>         Superclass;
   typedef itk::SmartPointer<Self>                                     Pointer;
   typedef itk::SmartPointer<const Self>                          ConstPointer;
 
@@ -38,7 +40,7 @@ public:
   // This is necessary to use itkGet/SetInputMacros to avoid gcc compiling error
   using ProcessObject = itk::ProcessObject;
 
-  itkTypeMacro(RGBALookupTableIntensityMappingFilter, ImageToImageFilter)
+  itkTypeMacro(RGBALookupTableIntensityMappingFilter, SlicingImageSource)
   itkNewMacro(Self)
 
   /** Set the intensity remapping curve - for contrast adjustment */
@@ -0,0 +1,40 @@
+#ifndef SLICELINEREADER_H
+#define SLICELINEREADER_H
+
+#include <cstddef>
+
+/**
+ * Interface of the slicing pipelines that can copy lines of the current
+ * slice straight from the 3D image, without generating the slice. The
+ * display filters use it to extract the slice and apply the lookup table in
+ * a single pass (see SlicingImageSource).
+ */
+template <class TSliceImage>
+class SliceLineReader
+{
+public:
+  typedef typename TSliceImage::IndexType                      SliceIndexType;
+  typedef typename TSliceImage::PixelType                      SlicePixelType;
+  typedef typename TSliceImage::ConstPointer                 SliceConstPointer;
+
+  virtual ~SliceLineReader() {}
+
+  /**
+   * Whether the lines can be read directly. This depends on the state of the
+   * pipeline, and is valid after its output information has been updated
+   */
+  virtual bool CanReadSliceLines() const = 0;
+
+  /** Copy n pixels of the slice, starting at the given index, into a buffer */
+  virtual void ReadSliceLine(const SliceIndexType &idx, size_t n,
+                             SlicePixelType *buffer) const = 0;
+
+  /**
+   * The current slice if it has already been generated in the background,
+   * or NULL. When there is one, the lines should be read from its buffer
+   * rather than from the 3D image.
+   */
+  virtual SliceConstPointer GetPrefetchedSlice() = 0;
+};
+
+#endif // SLICELINEREADER_H
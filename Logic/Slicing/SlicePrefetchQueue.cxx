@@ -0,0 +1,101 @@
+#include "SlicePrefetchQueue.h"
+#include <algorithm>
+
+SlicePrefetchQueue *
+SlicePrefetchQueue
+::GetInstance()
+{
+  static SlicePrefetchQueue instance;
+  return &instance;
+}
+
+SlicePrefetchQueue
+::SlicePrefetchQueue()
+{
+  m_Stop = false;
+}
+
+SlicePrefetchQueue
+::~SlicePrefetchQueue()
+{
+  std::deque<Entry> discarded;
+    {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stop = true;
+    discarded.swap(m_Queue);
+    }
+  m_Condition.notify_all();
+
+  for(auto &worker : m_Workers)
+    worker.join();
+}
+
+void
+SlicePrefetchQueue
+::Submit(const void *owner, Task task)
+{
+    {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if(m_Stop)
+      return;
+
+    // Prefetching should not compete with the interactive thread, so we use
+    // at most two workers, and only one on dual-core machines
+    if(m_Workers.empty())
+      {
+      unsigned int n = std::max(2u, std::thread::hardware_concurrency()) - 1;
+      for(unsigned int i = 0; i < std::min(n, 2u); i++)
+        m_Workers.emplace_back(&SlicePrefetchQueue::WorkerThread, this);
+      }
+
+    Entry entry;
+    entry.Owner = owner;
+    entry.Work = std::move(task);
+    m_Queue.push_back(std::move(entry));
+    }
+  m_Condition.notify_one();
+}
+
+void
+SlicePrefetchQueue
+::Cancel(const void *owner)
+{
+  // The removed tasks hold references to the owner and its inputs, so they
+  // must be destroyed after the mutex is released
+  std::deque<Entry> removed;
+    {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::deque<Entry> kept;
+    for(auto &entry : m_Queue)
+      {
+      if(entry.Owner == owner)
+        removed.push_back(std::move(entry));
+      else
+        kept.push_back(std::move(entry));
+      }
+    m_Queue.swap(kept);
+    }
+}
+
+void
+SlicePrefetchQueue
+::WorkerThread()
+{
+  while(true)
+    {
+    Task task;
+      {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_Condition.wait(lock, [this] { return m_Stop || !m_Queue.empty(); });
+      if(m_Stop)
+        return;
+
+      task = std::move(m_Queue.front().Work);
+      m_Queue.pop_front();
+      }
+
+    // Run the task and release whatever it holds outside of the lock
+    task();
+    task = nullptr;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef SLICEPREFETCHQUEUE_H
+#define SLICEPREFETCHQUEUE_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+/**
+ * A small pool of low-priority worker threads shared by all the slicers that
+ * generate slices ahead of time (see IRISSlicer::PrefetchSlices). Tasks are
+ * tagged with the object that submitted them, so that a slicer can withdraw
+ * its pending tasks when the user changes scroll direction or jumps to a
+ * different part of the image. The workers are started on first use.
+ */
+class SlicePrefetchQueue
+{
+public:
+
+  typedef std::function<void()> Task;
+
+  /** The queue shared by all slicers */
+  static SlicePrefetchQueue *GetInstance();
+
+  /** Add a task to the end of the queue */
+  void Submit(const void *owner, Task task);
+
+  /** Remove the tasks of the owner that have not started yet */
+  void Cancel(const void *owner);
+
+  ~SlicePrefetchQueue();
+
+protected:
+
+  SlicePrefetchQueue();
+
+  void WorkerThread();
+
+  struct Entry
+  {
+    const void *Owner;
+    Task Work;
+  };
+
+  std::vector<std::thread> m_Workers;
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::deque<Entry> m_Queue;
+  bool m_Stop;
+};
+
+#endif // SLICEPREFETCHQUEUE_H
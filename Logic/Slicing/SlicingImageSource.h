@@ -0,0 +1,86 @@
+#ifndef SLICINGIMAGESOURCE_H
+#define SLICINGIMAGESOURCE_H
+
+#include "SNAPCommon.h"
+#include "SliceLineReader.h"
+#include <itkImageSource.h>
+#include <vector>
+
+/**
+ * Base class for the filters that turn the slices of the image wrappers
+ * into display slices. The slices, which are outputs of the slicing
+ * pipelines, are not inputs of this filter in the ITK sense, so updating
+ * this filter does not generate them.
+ *
+ * When all slicing pipelines can read lines of their slice straight from the
+ * 3D image (see SliceLineReader), the subclass reads each line it needs in
+ * its threaded pass, so that slicing, intensity mapping and packing of the
+ * display pixels are done in one pass over a line-sized buffer. A slice that
+ * the pipeline already generated in the background is read from instead of
+ * the 3D image (see IRISSlicer::PrefetchSlices). Otherwise,
+ * e.g., for oblique slices or previews, the slices are updated before the
+ * threaded pass and the lines are read from their buffers.
+ */
+template <class TInputImage, class TOutputImage>
+class SlicingImageSource : public itk::ImageSource<TOutputImage>
+{
+public:
+
+  typedef SlicingImageSource<TInputImage, TOutputImage>                  Self;
+  typedef itk::ImageSource<TOutputImage>                           Superclass;
+  typedef itk::SmartPointer<Self>                                     Pointer;
+  typedef itk::SmartPointer<const Self>                          ConstPointer;
+
+  typedef TInputImage                                          InputImageType;
+  typedef typename InputImageType::PixelType                   InputPixelType;
+  typedef typename InputImageType::IndexType                   InputIndexType;
+  typedef TOutputImage                                        OutputImageType;
+  typedef typename OutputImageType::RegionType          OutputImageRegionType;
+  typedef SliceLineReader<InputImageType>                  SliceLineReaderType;
+
+  itkTypeMacro(SlicingImageSource, ImageSource)
+
+  /** Set the i-th slice, which should be the output of a slicing pipeline */
+  void SetSliceInput(unsigned int i, InputImageType *slice);
+
+  /** Get the i-th slice */
+  InputImageType *GetSliceInput(unsigned int i) const;
+
+  /** Bring the slicing pipelines up to date before our own information */
+  virtual void UpdateOutputInformation() ITK_OVERRIDE;
+
+  /** The modified time includes the pipeline modified time of the slices */
+  virtual itk::ModifiedTimeType GetMTime() const ITK_OVERRIDE;
+
+protected:
+
+  SlicingImageSource();
+  virtual ~SlicingImageSource() {}
+
+  /** The output has the geometry of the first slice */
+  virtual void GenerateOutputInformation() ITK_OVERRIDE;
+
+  /** Decide whether to read the slices directly or to update them */
+  virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  /** Let go of the prefetched slices */
+  virtual void AfterThreadedGenerateData() ITK_OVERRIDE;
+
+  /**
+   * Get n pixels of the i-th slice starting at idx. When reading from the 3D
+   * image, they are copied into the buffer, which must hold n pixels.
+   */
+  const InputPixelType *GetSliceLine(unsigned int i, const InputIndexType &idx,
+                                     size_t n, InputPixelType *buffer) const;
+
+  std::vector<SmartPtr<InputImageType> > m_Slices;
+  std::vector<SliceLineReaderType *> m_Readers;
+  std::vector<typename InputImageType::ConstPointer> m_PrefetchedSlices;
+  bool m_ReadSliceLines;
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "SlicingImageSource.txx"
+#endif
+
+#endif // SLICINGIMAGESOURCE_H
@@ -0,0 +1,141 @@
+#ifndef SLICINGIMAGESOURCE_TXX
+#define SLICINGIMAGESOURCE_TXX
+
+#include "SlicingImageSource.h"
+#include <algorithm>
+
+template <class TInputImage, class TOutputImage>
+SlicingImageSource<TInputImage, TOutputImage>
+::SlicingImageSource()
+{
+  m_ReadSliceLines = false;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SlicingImageSource<TInputImage, TOutputImage>
+::SetSliceInput(unsigned int i, InputImageType *slice)
+{
+  if(m_Slices.size() <= i)
+    m_Slices.resize(i + 1);
+
+  if(m_Slices[i] != slice)
+    {
+    m_Slices[i] = slice;
+    this->Modified();
+    }
+}
+
+template <class TInputImage, class TOutputImage>
+typename SlicingImageSource<TInputImage, TOutputImage>::InputImageType *
+SlicingImageSource<TInputImage, TOutputImage>
+::GetSliceInput(unsigned int i) const
+{
+  return i < m_Slices.size() ? m_Slices[i].GetPointer() : NULL;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SlicingImageSource<TInputImage, TOutputImage>
+::UpdateOutputInformation()
+{
+  // This configures the slicers for the current slice and computes the
+  // pipeline modified time of the slices, which GetMTime() depends on
+  for(auto &slice : m_Slices)
+    if(slice)
+      slice->UpdateOutputInformation();
+
+  Superclass::UpdateOutputInformation();
+}
+
+template <class TInputImage, class TOutputImage>
+itk::ModifiedTimeType
+SlicingImageSource<TInputImage, TOutputImage>
+::GetMTime() const
+{
+  itk::ModifiedTimeType mtime = Superclass::GetMTime();
+  for(auto &slice : m_Slices)
+    {
+    if(slice)
+      {
+      mtime = std::max(mtime, slice->GetPipelineMTime());
+      mtime = std::max(mtime, slice->GetMTime());
+      }
+    }
+  return mtime;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SlicingImageSource<TInputImage, TOutputImage>
+::GenerateOutputInformation()
+{
+  OutputImageType *output = this->GetOutput();
+  if(output && m_Slices.size() && m_Slices[0])
+    output->CopyInformation(m_Slices[0]);
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SlicingImageSource<TInputImage, TOutputImage>
+::BeforeThreadedGenerateData()
+{
+  // Read lines from the 3D images only if this works for every slice
+  m_Readers.assign(m_Slices.size(), NULL);
+  m_ReadSliceLines = true;
+  for(unsigned int i = 0; i < m_Slices.size(); i++)
+    {
+    if(m_Slices[i])
+      m_Readers[i] = dynamic_cast<SliceLineReaderType *>(
+            m_Slices[i]->GetSource().GetPointer());
+
+    if(!m_Readers[i] || !m_Readers[i]->CanReadSliceLines())
+      m_ReadSliceLines = false;
+    }
+
+  // Slices generated in the background are cheaper to read than the 3D image
+  m_PrefetchedSlices.assign(m_Slices.size(), NULL);
+  if(m_ReadSliceLines)
+    {
+    for(unsigned int i = 0; i < m_Slices.size(); i++)
+      m_PrefetchedSlices[i] = m_Readers[i]->GetPrefetchedSlice();
+    }
+
+  // Otherwise, generate the slices
+  else
+    {
+    for(auto &slice : m_Slices)
+      if(slice)
+        slice->Update();
+    }
+}
+
+template <class TInputImage, class TOutputImage>
+void
+SlicingImageSource<TInputImage, TOutputImage>
+::AfterThreadedGenerateData()
+{
+  m_PrefetchedSlices.clear();
+}
+
+template <class TInputImage, class TOutputImage>
+const typename SlicingImageSource<TInputImage, TOutputImage>::InputPixelType *
+SlicingImageSource<TInputImage, TOutputImage>
+::GetSliceLine(unsigned int i, const InputIndexType &idx,
+               size_t n, InputPixelType *buffer) const
+{
+  const InputImageType *slice = m_Slices[i];
+  if(m_ReadSliceLines)
+    {
+    slice = m_PrefetchedSlices[i];
+    if(!slice)
+      {
+      m_Readers[i]->ReadSliceLine(idx, n, buffer);
+      return buffer;
+      }
+    }
+
+  return slice->GetBufferPointer() + slice->ComputeOffset(idx);
+}
+
+#endif // SLICINGIMAGESOURCE_TXX
@@ -30,10 +30,22 @@ int progress_callback(void *clientp,
 
   typedef std::pair<void *, RESTClient::ProgressCallbackFunction> CallbackInfo;
   CallbackInfo *cbi = static_cast<CallbackInfo *>(clientp);
+  if(!cbi->second)
+    return 0;
   cbi->second(cbi->first, bytes_done * 1.0 / bytes_total);
   return 0;
 }
 
+// Destination of a download, which only receives the body of a successful
+// response
+struct DownloadedFile
+{
+  FILE *file;
+  CURL *curl;
+  bool checked;
+  std::string *output;
+};
+
 } // namespace
 
 using namespace std;
@@ -358,6 +370,10 @@ bool RESTClient::UploadFile(
   /* free slist */
   curl_slist_free_all(headerlist);
 
+  /* the handle may be reused, so it must not keep pointers to freed data */
+  curl_easy_setopt(m_Curl, CURLOPT_HTTPHEADER, NULL);
+  curl_easy_setopt(m_Curl, CURLOPT_HTTPPOST, NULL);
+
   // Capture the response code
   m_HTTPCode = 0L;
   curl_easy_getinfo(m_Curl, CURLINFO_RESPONSE_CODE, &m_HTTPCode);
@@ -366,6 +382,59 @@ bool RESTClient::UploadFile(
   return m_HTTPCode == 200L;
 }
 
+bool RESTClient::DownloadFile(const char *rel_url, const char *filename)
+{
+  // The URL to get
+  string url = this->GetServerURL() + "/" + rel_url;
+  curl_easy_setopt(m_Curl, CURLOPT_URL, url.c_str());
+
+  // The cookie JAR
+  string cookie_jar = this->GetCookieFile();
+  curl_easy_setopt(m_Curl, CURLOPT_COOKIEFILE, cookie_jar.c_str());
+  curl_easy_setopt(m_Curl, CURLOPT_HTTPGET, 1L);
+
+  // Open the file for writing
+  RESTClient_internal::DownloadedFile df;
+  df.file = fopen(filename, "wb");
+  if(!df.file)
+    throw IRISException("Unable to open file %s for writing", filename);
+  df.curl = m_Curl;
+  df.checked = false;
+  df.output = &m_Output;
+
+  // Capture output
+  m_Output.clear();
+  curl_easy_setopt(m_Curl, CURLOPT_WRITEFUNCTION, RESTClient::WriteToDownloadedFileCallback);
+  curl_easy_setopt(m_Curl, CURLOPT_WRITEDATA, &df);
+
+  // Set the callback functions
+  this->SetupProgressCallback();
+
+  // Make request
+  CURLcode res = curl_easy_perform(m_Curl);
+  if(df.file)
+    fclose(df.file);
+
+  if(res != CURLE_OK)
+    throw IRISException("CURL library error: %s\n%s", curl_easy_strerror(res), m_ErrorBuffer);
+
+  // Capture the response code
+  m_HTTPCode = 0L;
+  curl_easy_getinfo(m_Curl, CURLINFO_RESPONSE_CODE, &m_HTTPCode);
+
+  return m_HTTPCode == 200L;
+}
+
+void RESTClient::SetupProgressCallback()
+{
+  if(m_CallbackInfo.first)
+    {
+    curl_easy_setopt(m_Curl, CURLOPT_PROGRESSFUNCTION, RESTClient_internal::progress_callback);
+    curl_easy_setopt(m_Curl, CURLOPT_PROGRESSDATA, &m_CallbackInfo);
+    curl_easy_setopt(m_Curl, CURLOPT_NOPROGRESS, 0);
+    }
+}
+
 const char *RESTClient::GetOutput()
 {
   return m_Output.c_str();
@@ -462,6 +531,33 @@ size_t RESTClient::WriteToFileCallback(void *contents, size_t size, size_t nmemb
   return fwrite(contents, size, nmemb, file);
 }
 
+size_t RESTClient::WriteToDownloadedFileCallback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+  RESTClient_internal::DownloadedFile *df = static_cast<RESTClient_internal::DownloadedFile *>(userp);
+
+  // Once the headers are in, decide where the body goes. Error messages must
+  // not end up in the file
+  if(!df->checked)
+    {
+    df->checked = true;
+    long code = 0L;
+    curl_easy_getinfo(df->curl, CURLINFO_RESPONSE_CODE, &code);
+    if(code != 200L)
+      {
+      fclose(df->file);
+      df->file = NULL;
+      }
+    }
+
+  if(!df->file)
+    {
+    df->output->append((char *) contents, size * nmemb);
+    return size * nmemb;
+    }
+
+  return fwrite(contents, size, nmemb, df->file);
+}
+
 
 
 static void REST_DebugDump(const char *text,
@@ -76,6 +76,13 @@ public:
   bool UploadFile(const char *rel_url, const char *filename,
     std::map<std::string,std::string> extra_fields, ...);
 
+  /**
+   * Download from a URL into a file with a GET request. The body of an error
+   * response is kept as the output instead of being written to the file. The
+   * URL is not a printf-like expression.
+   */
+  bool DownloadFile(const char *rel_url, const char *filename);
+
   const char *GetOutput();
 
   std::string GetFormattedCSVOutput(bool header);
@@ -127,6 +134,10 @@ protected:
 
   static size_t WriteToFileCallback(void *contents, size_t size, size_t nmemb, void *userp);
 
+  static size_t WriteToDownloadedFileCallback(void *contents, size_t size, size_t nmemb, void *userp);
+
+  void SetupProgressCallback();
+
 
 
 };
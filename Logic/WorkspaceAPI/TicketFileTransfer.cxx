@@ -0,0 +1,270 @@
+#include "TicketFileTransfer.h"
+#include "RESTClient.h"
+#include "IRISException.h"
+#include "AllPurposeProgressAccumulator.h"
+#include "itksys/MD5.h"
+#include "itksys/SystemTools.hxx"
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <map>
+
+using namespace std;
+using itksys::SystemTools;
+
+TicketFileTransfer::TicketFileTransfer()
+{
+  m_NumberOfThreads = 4;
+  m_MaximumRetries = 3;
+  m_NextTransfer = 0;
+  m_FinishedThreads = 0;
+  m_Failed = false;
+}
+
+TicketFileTransfer::~TicketFileTransfer()
+{
+}
+
+void TicketFileTransfer::AddUpload(const string &local_file, const string &url)
+{
+  Transfer t;
+  t.Upload = true;
+  t.URL = url;
+  t.LocalFile = local_file;
+  t.Size = (long long) SystemTools::FileLength(local_file);
+  t.Progress = 0.0;
+  m_Transfers.push_back(t);
+}
+
+void TicketFileTransfer::AddDownload(const string &url, const string &local_file)
+{
+  Transfer t;
+  t.Upload = false;
+  t.URL = url;
+  t.LocalFile = local_file;
+  t.Size = -1;
+  t.Progress = 0.0;
+  m_Transfers.push_back(t);
+}
+
+string TicketFileTransfer::ComputeFileMD5(const string &filename)
+{
+  ifstream ifs(filename.c_str(), ios::binary);
+  if(!ifs.good())
+    throw IRISException("Unable to open file %s for reading", filename.c_str());
+
+  char hex_code[33];
+  hex_code[32] = 0;
+  itksysMD5 *md5 = itksysMD5_New();
+  itksysMD5_Initialize(md5);
+
+  vector<char> buffer(1 << 20);
+  while(ifs)
+    {
+    ifs.read(&buffer[0], buffer.size());
+    if(ifs.gcount() > 0)
+      itksysMD5_Append(md5, (unsigned char *) &buffer[0], (int) ifs.gcount());
+    }
+
+  itksysMD5_FinalizeHex(md5, hex_code);
+  itksysMD5_Delete(md5);
+  return hex_code;
+}
+
+void TicketFileTransfer::ProgressCallback(void *data, double progress)
+{
+  ProgressContext *pc = static_cast<ProgressContext *>(data);
+  pc->Self->SetProgress(pc->Index, pc->Base + pc->Scale * progress);
+}
+
+void TicketFileTransfer::SetProgress(unsigned int index, double progress)
+{
+  lock_guard<mutex> guard(m_Mutex);
+  m_Transfers[index].Progress = std::min(progress, 1.0);
+}
+
+void TicketFileTransfer::PerformUpload(RESTClient *rc, unsigned int index)
+{
+  Transfer &t = m_Transfers[index];
+  ProgressContext pc = { this, index, 0.0, 1.0 };
+  rc->SetProgressCallback(&pc, &TicketFileTransfer::ProgressCallback);
+
+  for(int attempt = 0; ; attempt++)
+    {
+    try
+      {
+      std::map<string, string> empty_map;
+      if(!rc->UploadFile("%s", t.LocalFile.c_str(), empty_map, t.URL.c_str()))
+        throw IRISException("Failed to upload file %s (%s)",
+                            t.LocalFile.c_str(), rc->GetResponseText());
+
+      t.Status = rc->GetUploadStatistics();
+      break;
+      }
+    catch(IRISException &exc)
+      {
+      if(attempt >= m_MaximumRetries)
+        throw;
+      this_thread::sleep_for(chrono::seconds(attempt + 1));
+      }
+    }
+
+  rc->SetProgressCallback(NULL, NULL);
+  SetProgress(index, 1.0);
+}
+
+void TicketFileTransfer::PerformDownload(RESTClient *rc, unsigned int index)
+{
+  Transfer &t = m_Transfers[index];
+
+  // Data is downloaded into a temporary file that is renamed when complete
+  string fn_part = t.LocalFile + ".part";
+
+  ProgressContext pc = { this, index, 0.0, 1.0 };
+  rc->SetProgressCallback(&pc, &TicketFileTransfer::ProgressCallback);
+
+  for(int attempt = 0; ; attempt++)
+    {
+    try
+      {
+      if(!rc->DownloadFile(t.URL.c_str(), fn_part.c_str()))
+        throw IRISException("Failed to download file %s (%s)",
+                            t.LocalFile.c_str(), rc->GetResponseText());
+
+      if(!SystemTools::RenameFile(fn_part, t.LocalFile))
+        throw IRISException("Unable to rename %s to %s", fn_part.c_str(), t.LocalFile.c_str());
+
+      t.Status = "downloaded";
+      break;
+      }
+    catch(IRISException &exc)
+      {
+      if(attempt >= m_MaximumRetries)
+        throw;
+      this_thread::sleep_for(chrono::seconds(attempt + 1));
+      }
+    }
+
+  rc->SetProgressCallback(NULL, NULL);
+  SetProgress(index, 1.0);
+}
+
+void TicketFileTransfer::WorkerThread(RESTClient *rc)
+{
+  while(true)
+    {
+    // Take the next transfer from the queue
+    unsigned int index;
+      {
+      lock_guard<mutex> guard(m_Mutex);
+      if(m_Failed || m_NextTransfer >= m_Transfers.size())
+        break;
+      index = m_Order[m_NextTransfer++];
+      }
+
+    try
+      {
+      if(m_Transfers[index].Upload)
+        PerformUpload(rc, index);
+      else
+        PerformDownload(rc, index);
+      }
+    catch(std::exception &exc)
+      {
+      lock_guard<mutex> guard(m_Mutex);
+      if(!m_Failed)
+        {
+        m_Failed = true;
+        m_ErrorMessage = exc.what();
+        }
+      }
+    }
+
+  lock_guard<mutex> guard(m_Mutex);
+  m_FinishedThreads++;
+  m_Condition.notify_all();
+}
+
+void TicketFileTransfer::Run(AllPurposeProgressAccumulator *accum)
+{
+  unsigned int n = m_Transfers.size();
+  if(n == 0)
+    return;
+
+  // Start the largest files first so that the workers finish at about the same time
+  m_Order.resize(n);
+  for(unsigned int i = 0; i < n; i++)
+    m_Order[i] = i;
+  std::stable_sort(m_Order.begin(), m_Order.end(),
+                   [this](unsigned int a, unsigned int b)
+                   { return m_Transfers[a].Size > m_Transfers[b].Size; });
+
+  // Weigh the progress of each file by its size, if all sizes are known
+  bool sizes_known = true;
+  for(unsigned int i = 0; i < n; i++)
+    {
+    m_Transfers[i].Progress = 0.0;
+    m_Transfers[i].Status.clear();
+    if(m_Transfers[i].Size < 0)
+      sizes_known = false;
+    }
+
+  vector<void *> sources(n, NULL);
+  if(accum)
+    {
+    for(unsigned int i = 0; i < n; i++)
+      {
+      float weight = sizes_known ? std::max(m_Transfers[i].Size, 1LL) : 1.0f;
+      sources[i] = accum->RegisterGenericSource(1, weight);
+      }
+    }
+
+  // The clients are created on this thread because CURL initialization is
+  // not thread-safe
+  int n_threads = std::max(1, std::min(m_NumberOfThreads, (int) n));
+  vector<RESTClient *> clients;
+  for(int k = 0; k < n_threads; k++)
+    clients.push_back(new RESTClient());
+
+  m_NextTransfer = 0;
+  m_FinishedThreads = 0;
+  m_Failed = false;
+  m_ErrorMessage.clear();
+
+  vector<thread> workers;
+  for(int k = 0; k < n_threads; k++)
+    workers.push_back(thread(&TicketFileTransfer::WorkerThread, this, clients[k]));
+
+  // Progress is passed on from this thread, since the observers of the
+  // accumulator (e.g., progress dialogs) are not thread-safe
+  vector<double> reported(n, 0.0), progress(n, 0.0);
+  unique_lock<mutex> lock(m_Mutex);
+  while(m_FinishedThreads < n_threads)
+    {
+    m_Condition.wait_for(lock, chrono::milliseconds(100));
+    for(unsigned int i = 0; i < n; i++)
+      progress[i] = m_Transfers[i].Progress;
+
+    lock.unlock();
+    for(unsigned int i = 0; accum && i < n; i++)
+      {
+      if(progress[i] != reported[i])
+        {
+        AllPurposeProgressAccumulator::GenericProgressCallback(sources[i], progress[i]);
+        reported[i] = progress[i];
+        }
+      }
+    lock.lock();
+    }
+  lock.unlock();
+
+  for(int k = 0; k < n_threads; k++)
+    {
+    workers[k].join();
+    delete clients[k];
+    }
+
+  if(m_Failed)
+    throw IRISException("%s", m_ErrorMessage.c_str());
+}
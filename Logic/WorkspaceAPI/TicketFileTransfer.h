@@ -0,0 +1,107 @@
+#ifndef TICKETFILETRANSFER_H
+#define TICKETFILETRANSFER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+class RESTClient;
+class AllPurposeProgressAccumulator;
+
+/**
+ * This class moves the files of a distributed segmentation ticket between the
+ * local disk and the server. Several files are transferred at the same time,
+ * each worker thread using its own RESTClient. Each file is sent in a single
+ * multi-part POST and fetched with a single GET, which is what the server
+ * implements. Failed transfers are retried from the start, and downloads are
+ * written to a temporary file that is moved into place once complete.
+ */
+class TicketFileTransfer
+{
+public:
+
+  TicketFileTransfer();
+
+  ~TicketFileTransfer();
+
+  /** Set the number of files that are transferred concurrently */
+  void SetNumberOfThreads(int n) { m_NumberOfThreads = n; }
+
+  /** Set the number of times a failed transfer is retried */
+  void SetMaximumRetries(int n) { m_MaximumRetries = n; }
+
+  /** Schedule the upload of a local file to a URL (not a printf expression) */
+  void AddUpload(const std::string &local_file, const std::string &url);
+
+  /** Schedule the download of a URL to a local file (not a printf expression) */
+  void AddDownload(const std::string &url, const std::string &local_file);
+
+  /**
+   * Perform all the scheduled transfers. If an accumulator is provided, a
+   * generic source is registered with it for every file, weighted by the size
+   * of the uploaded files, and progress is reported on the calling thread. The sources are
+   * freed by the accumulator's UnregisterAllSources(). An IRISException is
+   * thrown if any of the transfers fails.
+   */
+  void Run(AllPurposeProgressAccumulator *accum = NULL);
+
+  /** Number of scheduled transfers */
+  unsigned int GetNumberOfFiles() const { return m_Transfers.size(); }
+
+  /** Local file of the i-th transfer */
+  const std::string &GetLocalFile(unsigned int i) const
+    { return m_Transfers[i].LocalFile; }
+
+  /** Description of the outcome of the i-th transfer, after Run() */
+  const std::string &GetStatus(unsigned int i) const
+    { return m_Transfers[i].Status; }
+
+  /** Compute the md5 checksum of a file, as a hex string */
+  static std::string ComputeFileMD5(const std::string &filename);
+
+protected:
+
+  struct Transfer
+  {
+    bool Upload;
+    std::string URL, LocalFile, Status;
+    long long Size;
+    double Progress;
+  };
+
+  // Data passed to the progress callback of the REST client
+  struct ProgressContext
+  {
+    TicketFileTransfer *Self;
+    unsigned int Index;
+    double Base, Scale;
+  };
+
+  static void ProgressCallback(void *data, double progress);
+
+  void SetProgress(unsigned int index, double progress);
+
+  void WorkerThread(RESTClient *rc);
+
+  void PerformUpload(RESTClient *rc, unsigned int index);
+
+  void PerformDownload(RESTClient *rc, unsigned int index);
+
+  std::vector<Transfer> m_Transfers;
+
+  // Order in which the transfers are started
+  std::vector<unsigned int> m_Order;
+
+  int m_NumberOfThreads, m_MaximumRetries;
+
+  // State shared between the worker threads, guarded by the mutex
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  unsigned int m_NextTransfer;
+  int m_FinishedThreads;
+  bool m_Failed;
+  std::string m_ErrorMessage;
+};
+
+#endif // TICKETFILETRANSFER_H
@@ -9,8 +9,12 @@
 #include "ColorLabelTable.h"
 #include "MultiChannelDisplayMode.h"
 #include "RESTClient.h"
+#include "TicketFileTransfer.h"
 #include "itkCommand.h"
 #include "GuidedMeshIO.h"
+#include "itkMultiThreaderBase.h"
+#include <random>
+#include <fstream>
 
 using namespace std;
 using itksys::SystemTools;
@@ -1183,6 +1187,233 @@ void WorkspaceAPI::ExportWorkspace(const char *new_workspace,
   progress->EndProgress();
 }
 
+// Whether the text header of a MetaImage or NRRD file refers to a separate
+// data file (MetaImage 'ElementDataFile' other than LOCAL, NRRD 'data file')
+static bool HasDetachedDataReference(const string &filename, bool nrrd)
+{
+  ifstream ifs(filename.c_str(), ios::binary);
+  string line;
+  for(int i = 0; i < 1000 && getline(ifs, line); i++)
+    {
+    // Strip the trailing carriage return of DOS files
+    if(line.size() && line[line.size()-1] == '\r')
+      line.resize(line.size()-1);
+
+    if(nrrd)
+      {
+      // The NRRD header ends with an empty line
+      if(line.empty())
+        return false;
+      if(SystemTools::StringStartsWith(line, "data file:")
+         || SystemTools::StringStartsWith(line, "datafile:"))
+        return true;
+      }
+    else
+      {
+      // In MetaImage files, ElementDataFile is the last field of the header
+      if(SystemTools::StringStartsWith(line, "ElementDataFile"))
+        {
+        size_t pos = line.find('=');
+        string value = pos == string::npos ? string() : SystemTools::TrimWhitespace(line.substr(pos + 1));
+        return value != "LOCAL" && value != "Local" && value != "local";
+        }
+      }
+    }
+
+  // Treat unreadable or incomplete headers as detached to be safe
+  return true;
+}
+
+// Whether all of the data of an image is in the layer file itself, in which
+// case the checksum of the file identifies the image
+static bool IsSelfContainedImageFile(const string &filename, Registry *io_hints)
+{
+  if(io_hints)
+    {
+    GuidedNativeImageIO::FileFormat fmt = GuidedNativeImageIO::GetFileFormat(*io_hints);
+    if(fmt != GuidedNativeImageIO::FORMAT_COUNT
+       && fmt != GuidedNativeImageIO::FORMAT_NIFTI
+       && fmt != GuidedNativeImageIO::FORMAT_MHA
+       && fmt != GuidedNativeImageIO::FORMAT_NRRD
+       && fmt != GuidedNativeImageIO::FORMAT_VTK
+       && fmt != GuidedNativeImageIO::FORMAT_GIPL)
+      return false;
+    }
+
+  string ext = SystemTools::LowerCase(SystemTools::GetFilenameExtension(filename));
+
+  // MetaImage and NRRD headers may point to the data in another file
+  if(SystemTools::StringEndsWith(ext, ".mha"))
+    return !HasDetachedDataReference(filename, false);
+  if(SystemTools::StringEndsWith(ext, ".nrrd"))
+    return !HasDetachedDataReference(filename, true);
+
+  return SystemTools::StringEndsWith(ext, ".nii")
+      || SystemTools::StringEndsWith(ext, ".nii.gz")
+      || SystemTools::StringEndsWith(ext, ".vtk")
+      || SystemTools::StringEndsWith(ext, ".gipl")
+      || SystemTools::StringEndsWith(ext, ".gipl.gz");
+}
+
+// Combine a checksum with additional text into a new checksum
+static string CombineMD5(const string &md5, const string &extra)
+{
+  if(extra.empty())
+    return md5;
+
+  string text = md5 + extra;
+  char hex_code[33];
+  hex_code[32] = 0;
+  itksysMD5 *hasher = itksysMD5_New();
+  itksysMD5_Initialize(hasher);
+  itksysMD5_Append(hasher, (unsigned char *) text.c_str(), text.size());
+  itksysMD5_FinalizeHex(hasher, hex_code);
+  itksysMD5_Delete(hasher);
+  return hex_code;
+}
+
+void WorkspaceAPI::ExportWorkspaceToStore(const char *new_workspace,
+                                          const char *store_dir,
+                                          CommandType *cmd_progress)
+{
+  // Create a progress tracker
+  SmartPtr<TrivalProgressSource> progress = TrivalProgressSource::New();
+  if(cmd_progress)
+    {
+    progress->AddObserver(itk::StartEvent(), cmd_progress);
+    progress->AddObserver(itk::ProgressEvent(), cmd_progress);
+    progress->AddObserver(itk::EndEvent(), cmd_progress);
+    }
+
+  // Create the store
+  string store = SystemTools::CollapseFullPath(store_dir);
+  if(!SystemTools::MakeDirectory(store))
+    throw IRISException("Unable to create directory %s", store.c_str());
+
+  int n_layers = this->GetNumberOfLayers();
+  progress->StartProgress(2 * n_layers);
+
+  // Find the files of all layers, and figure out which ones need to be hashed.
+  // The checksum of each file is cached in the layer folder, along with the
+  // size and modification time of the file it was computed for
+  vector<string> fn_layer(n_layers), file_md5(n_layers);
+  vector<bool> self_contained(n_layers);
+  vector<int> to_hash;
+  for(int i = 0; i < n_layers; i++)
+    {
+    Registry &f_layer = this->GetLayerFolder(i);
+    fn_layer[i] = this->GetLayerActualPath(f_layer);
+    self_contained[i] = IsSelfContainedImageFile(fn_layer[i], this->GetLayerIOHints(f_layer));
+    if(!self_contained[i])
+      continue;
+
+    Registry &f_hash = f_layer.Folder("ContentHash");
+    if(f_hash["Path"][""] == fn_layer[i]
+       && f_hash["FileSize"][""] == Registry::Key("%lu", SystemTools::FileLength(fn_layer[i]))
+       && f_hash["FileTime"][""] == Registry::Key("%ld", SystemTools::ModifiedTime(fn_layer[i])))
+      file_md5[i] = f_hash["MD5"][""];
+    else
+      to_hash.push_back(i);
+    }
+
+  // Hash the files in parallel
+  vector<string> errors(n_layers);
+  if(to_hash.size())
+    {
+    itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
+    mt->ParallelizeArray(0, to_hash.size(), [&](itk::SizeValueType k)
+      {
+      int i = to_hash[k];
+      try { file_md5[i] = TicketFileTransfer::ComputeFileMD5(fn_layer[i]); }
+      catch(std::exception &exc) { errors[i] = exc.what(); }
+      }, nullptr);
+    }
+
+  for(int i : to_hash)
+    {
+    if(errors[i].size())
+      throw IRISException("Failed to compute checksum of %s: %s", fn_layer[i].c_str(), errors[i].c_str());
+
+    Registry &f_hash = this->GetLayerFolder(i).Folder("ContentHash");
+    f_hash["Path"] << fn_layer[i];
+    f_hash["FileSize"] << Registry::Key("%lu", SystemTools::FileLength(fn_layer[i]));
+    f_hash["FileTime"] << Registry::Key("%ld", SystemTools::ModifiedTime(fn_layer[i]));
+    f_hash["MD5"] << file_md5[i];
+    }
+
+  // Duplicate the workspace data, including the updated checksums
+  WorkspaceAPI wsexp = (*this);
+
+  for(int i = 0; i < n_layers; i++)
+    {
+    Registry &f_layer = wsexp.GetLayerFolder(i);
+
+    // The IO hints for the file
+    Registry io_hints, *layer_io_hints;
+    if((layer_io_hints = wsexp.GetLayerIOHints(f_layer)))
+      io_hints.Update(*layer_io_hints);
+
+    // The IO hints affect how the file is read, so they are part of the key
+    ostringstream oss_hints;
+    if(layer_io_hints)
+      io_hints.Print(oss_hints);
+
+    // Images that are not in a single file have to be read to be identified
+    SmartPtr<GuidedNativeImageIO> io;
+    string key;
+    if(self_contained[i])
+      {
+      key = CombineMD5(file_md5[i], oss_hints.str());
+      }
+    else
+      {
+      io = GuidedNativeImageIO::New();
+      io->ReadNativeImage(fn_layer[i].c_str(), io_hints);
+      GuidedNativeImageIO::ImageBase *img = io->GetNativeImage();
+      ostringstream oss_geom;
+      oss_geom << img->GetBufferedRegion() << img->GetOrigin()
+               << img->GetSpacing() << img->GetDirection();
+      key = CombineMD5(io->GetNativeImageMD5Hash(), oss_geom.str());
+      }
+
+    progress->AddProgress(1.0);
+
+    // Write the image into the store, unless it is already there
+    string fn_store = store + "/" + key + ".nii.gz";
+    if(!SystemTools::FileExists(fn_store, true))
+      {
+      if(!io)
+        {
+        io = GuidedNativeImageIO::New();
+        io->ReadNativeImage(fn_layer[i].c_str(), io_hints);
+        }
+
+      // Other exports may be using the same store, so the file is renamed into
+      // place once it is complete
+      string fn_temp = store + "/" + key
+          + Registry::Key(".%08x.tmp.nii.gz", (unsigned int) std::random_device()());
+      Registry dummy_hints;
+      io->SaveNativeImage(fn_temp.c_str(), dummy_hints);
+      if(!SystemTools::RenameFile(fn_temp, fn_store))
+        throw IRISException("Unable to rename %s to %s", fn_temp.c_str(), fn_store.c_str());
+      }
+
+    progress->AddProgress(1.0);
+
+    // Refer to the stored image; there are no hints necessary for NIFTI
+    f_layer["AbsolutePath"] << fn_store;
+    f_layer.Folder("IOHints").Clear();
+
+    // The checksum of the stored file is unknown until it is hashed
+    f_layer.Folder("ContentHash").Clear();
+    }
+
+  // Write the updated project
+  wsexp.SaveAsXMLFile(new_workspace);
+
+  progress->EndProgress();
+}
+
 void WorkspaceAPI::UploadWorkspace(const char *url, int ticket_id,
                                    const char *wsfile_suffix,
                                    CommandType *cmd_progress) const
@@ -1223,36 +1454,22 @@ void WorkspaceAPI::UploadWorkspace(const char *url, int ticket_id,
 
   cout << "Exported workspace to " << ws_fname_buffer << endl;
 
-  // Create a source for transfer progress
-  void *transfer_progress_src = accum_upload->RegisterGenericSource(fn_to_upload.size(), 1.0);
+  // Expand the upload URL
+  char url_buffer[4096];
+  snprintf(url_buffer, 4096, url, ticket_id);
 
-  // For each of the files in the directory upload it
+  // Upload the files concurrently. Per-file progress is reported to the upload accumulator
+  TicketFileTransfer transfer;
   for(int i = 0; i < fn_to_upload.size(); i++)
-    {
-    const char *fn = fn_to_upload[i].c_str();
-
-    RESTClient rcu;
-
-    // Set progress callback
-    rcu.SetProgressCallback(transfer_progress_src,
-                            AllPurposeProgressAccumulator::GenericProgressCallback);
-
-    // TODO: this is disgraceful!
-    std::map<string, string> empty_map;
-    if(!rcu.UploadFile(url, fn, empty_map, ticket_id))
-      throw IRISException("Failed up upload file %s (%s)", fn, rcu.GetResponseText());
-
-    // Reset progress counter for next run
-    accum_upload->StartNextRun(transfer_progress_src);
+    transfer.AddUpload(fn_to_upload[i], url_buffer);
+  transfer.Run(accum_upload);
 
-    cout << "Upload " << fn << " (" << rcu.GetUploadStatistics() << ")" << endl;
-    }
+  for(unsigned int i = 0; i < transfer.GetNumberOfFiles(); i++)
+    cout << "Upload " << transfer.GetLocalFile(i) << " (" << transfer.GetStatus(i) << ")" << endl;
 
   // Finish with the progress
   accum_upload->UnregisterAllSources();
   accum->UnregisterAllSources();
-
-  // TODO: we should verify that all the files were successfully sent, via MD5
 }
 
 int WorkspaceAPI::CreateWorkspaceTicket(const string &service_desc,
@@ -1325,12 +1542,8 @@ string WorkspaceAPI::DownloadTicketFiles(
   if(!SystemTools::MakeDirectory(outdir))
     throw IRISException("Unable to create output directory %s", outdir);
 
-  // Progress source
-  void *transfer_progress_src = accum->RegisterGenericSource(ft.Rows(), 1.0);
-  rc.SetProgressCallback(transfer_progress_src,
-                         AllPurposeProgressAccumulator::GenericProgressCallback);
-
-  // Iterate over the dictionary
+  // Schedule the download of each file
+  TicketFileTransfer transfer;
   for(int iFile = 0; iFile < ft.Rows(); iFile++)
     {
     // Where we will write this file to
@@ -1348,23 +1561,18 @@ string WorkspaceAPI::DownloadTicketFiles(
     // Make it into a full path
     string file_path = SystemTools::CollapseFullPath(file_name.c_str(), outdir);
 
-    // Create a file handle
-    FILE *fout = fopen(file_path.c_str(), "wb");
-    rc.SetOutputFile(fout);
+    // The URL of the file
+    char url_buffer[4096];
+    snprintf(url_buffer, 4096, "%s/tickets/%d/files/%s/%d", url_base, ticket_id, area, file_index);
 
-    if(!rc.Get("%s/tickets/%d/files/%s/%d", url_base, ticket_id, area, file_index))
-      throw IRISException("Failed to download file %s for ticket %d (%s)",
-        file_name.c_str(), ticket_id, rc.GetResponseText());
-
-    rc.SetOutputFile(NULL);
-    fclose(fout);
-
-    // Start next run of uploading
-    accum->StartNextRun(transfer_progress_src);
+    transfer.AddDownload(url_buffer, file_path);
 
     oss << file_path << endl;
     }
 
+  // Download the files concurrently
+  transfer.Run(accum);
+
   accum->UnregisterAllSources();
 
   return oss.str();
@@ -254,6 +254,17 @@ public:
   /** Export the workspace */
   void ExportWorkspace(const char *new_workspace, CommandType *cmd_progress = NULL, bool scramble_filenames = true) const;
 
+  /**
+   * Export the workspace, storing each distinct layer image only once in a
+   * content-addressed store directory that can be shared between exports.
+   * Self-contained image files are identified by their md5 checksum, which is
+   * computed in parallel and cached in the layer folders of this workspace
+   * (hence the method is not const), so that unchanged files are skipped on
+   * later exports. Other images (e.g., DICOM) are identified by their data.
+   */
+  void ExportWorkspaceToStore(const char *new_workspace, const char *store_dir,
+                              CommandType *cmd_progress = NULL);
+
   /** Upload the workspace */
   void UploadWorkspace(const char *url, int ticket_id, const char *wsfile_suffix,
                        CommandType *cmd_progress = NULL) const;
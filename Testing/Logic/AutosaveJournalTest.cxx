@@ -0,0 +1,137 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "IRISApplication.h"
+#include "IRISImageData.h"
+#include "GlobalState.h"
+#include "LabelImageWrapper.h"
+#include "AutosaveJournal.h"
+#include "SegmentationUpdateIterator.h"
+#include "IRISException.h"
+#include "TestSystemInfoDelegate.h"
+#include "TestSegmentation.h"
+#include "itksys/SystemTools.hxx"
+
+/**
+ * Test of the autosave journal. Two edits to a segmentation that has been
+ * loaded from a file are journaled, the segmentation is loaded again and the
+ * journal is replayed, which must restore the edited segmentation exactly.
+ * Then the segmentation file is overwritten, as another program would do,
+ * and replaying the journal must leave the new file contents alone.
+ *
+ * Usage: AutosaveJournalTest TempDirectory
+ */
+
+// Paint a box with a label, as a drawing tool would
+void PaintBox(LabelImageWrapper *seg, const itk::ImageRegion<3> &region, LabelType label)
+{
+  DrawOverFilter drawover;
+  drawover.CoverageMode = PAINT_OVER_ALL;
+  drawover.DrawOverLabel = 0;
+
+  SegmentationUpdateIterator it_update(seg, region, label, drawover);
+  for(; !it_update.IsAtEnd(); ++it_update)
+    it_update.PaintAsForeground();
+
+  if(it_update.Finalize())
+    seg->StoreIntermediateUndoDelta(it_update.RelinquishDelta());
+  seg->StoreUndoPoint("Test drawing");
+}
+
+itk::ImageRegion<3> MakeRegion(int x, int y, int z, int sx, int sy, int sz)
+{
+  itk::ImageRegion<3> region;
+  region.SetIndex({{x, y, z}});
+  region.SetSize({{(itk::SizeValueType) sx, (itk::SizeValueType) sy, (itk::SizeValueType) sz}});
+  return region;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2)
+    {
+    cerr << "Usage:\n" << argv[0] << " TempDirectory" << endl;
+    return 1;
+    }
+
+  string tmpdir = itksys::SystemTools::CollapseFullPath(argv[1]);
+  itksys::SystemTools::MakeDirectory(tmpdir);
+  string fn_main = tmpdir + "/journal_main.nii.gz";
+  string fn_seg = tmpdir + "/journal_seg.nii.gz";
+  string fn_journal = tmpdir + "/journal_test.journal";
+  const int n = 32;
+
+  DummySystemInfoDelegate sidel(argv[0]);
+  SystemInterface::SetSystemInfoDelegate(&sidel);
+
+  IRISApplication::Pointer app = IRISApplication::New();
+
+  int rc = 0;
+  try
+    {
+    // The main image is just needed to hold the segmentation
+    itk::ImageRegion<3> empty = MakeRegion(0, 0, 0, 0, 0, 0);
+    WriteSegmentation(fn_main, n, MakeRegion(8, 8, 8, 16, 16, 16), 100);
+    WriteSegmentation(fn_seg, n, empty, 0);
+    itksys::SystemTools::RemoveFile(fn_journal);
+
+    IRISWarningList wl;
+    app->OpenImage(fn_main.c_str(), MAIN_ROLE, wl);
+    app->OpenImage(fn_seg.c_str(), LABEL_ROLE, wl);
+
+    // Journal two edits, the second overlapping the first
+    AutosaveJournal::Pointer journal = AutosaveJournal::New();
+    journal->Open(fn_journal);
+    journal->Update(app->GetCurrentImageData());
+
+    LabelImageWrapper *seg = app->GetSelectedSegmentationLayer();
+    PaintBox(seg, MakeRegion(4, 4, 4, 10, 6, 3), 3);
+    journal->Update(app->GetCurrentImageData());
+    PaintBox(seg, MakeRegion(10, 2, 5, 8, 20, 12), 5);
+    journal->Update(app->GetCurrentImageData());
+
+    vector<LabelType> expected = GetVoxels(seg);
+    journal->Close(false);
+
+    // Load the segmentation from the file again and replay the journal
+    app->OpenImage(fn_seg.c_str(), LABEL_ROLE, wl);
+    unsigned int n_replayed = AutosaveJournal::Replay(fn_journal, app->GetCurrentImageData());
+    vector<LabelType> replayed = GetVoxels(app->GetSelectedSegmentationLayer());
+    if(n_replayed != 1 || replayed != expected)
+      {
+      cerr << "Replay did not restore the edits (" << n_replayed << " layers replayed)" << endl;
+      rc = 1;
+      }
+
+    // Another program writes the segmentation file. The journal was made for
+    // the old file and must not be applied to the new one.
+    WriteSegmentation(fn_seg, n, MakeRegion(0, 0, 0, 4, 4, 4), 7);
+    app->OpenImage(fn_seg.c_str(), LABEL_ROLE, wl);
+    vector<LabelType> on_disk = GetVoxels(app->GetSelectedSegmentationLayer());
+    n_replayed = AutosaveJournal::Replay(fn_journal, app->GetCurrentImageData());
+    vector<LabelType> after = GetVoxels(app->GetSelectedSegmentationLayer());
+    if(n_replayed != 0 || after != on_disk)
+      {
+      cerr << "Journal was replayed over a different segmentation file" << endl;
+      rc = 1;
+      }
+
+    app->UnloadMainImage();
+    }
+  catch(std::exception &exc)
+    {
+    cerr << "Autosave journal test failed: " << exc.what() << endl;
+    rc = -1;
+    }
+
+  itksys::SystemTools::RemoveFile(fn_main);
+  itksys::SystemTools::RemoveFile(fn_seg);
+  itksys::SystemTools::RemoveFile(fn_journal);
+
+  if(rc == 0)
+    cout << "Autosave journal write and replay OK" << endl;
+  return rc;
+}
@@ -0,0 +1,177 @@
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+
+using namespace std;
+
+#include "BrushWatershedPipeline.h"
+#include <itkImage.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkGradientAnisotropicDiffusionImageFilter.h>
+#include <itkGradientMagnitudeImageFilter.h>
+#include <itkWatershedImageFilter.h>
+
+/**
+ * Test of the watershed hierarchy used by the adaptive paintbrush. The basic
+ * segments are merged with a union-find over the merges of the hierarchy, and
+ * the segments must partition the image in the same way as the output of
+ * itk::WatershedImageFilter, with the same smoothing, after the level is set
+ * on a filter that has computed the complete hierarchy. This is checked for
+ * several levels. Then the reuse of the window is checked: a window computed
+ * for a 3D brush must not be reused for a 2D brush, which needs a window that
+ * is flat in the slice of the brush.
+ *
+ * Usage: BrushWatershedTest
+ */
+
+typedef BrushWatershedPipeline::FloatImageType ImageType;
+typedef BrushWatershedPipeline::WatershedImageType WatershedImageType;
+typedef BrushWatershedPipeline::RegionType RegionType;
+
+const int n = 24;
+const size_t smoothing_iter = 2;
+
+// Overlapping blobs of different heights, with a deterministic texture
+ImageType::Pointer MakeImage()
+{
+  ImageType::Pointer img = ImageType::New();
+  img->SetRegions(ImageType::SizeType({{n, n, n}}));
+  img->Allocate();
+
+  double centers[][3] = { { 6, 7, 8 }, { 16, 8, 14 }, { 10, 17, 6 }, { 17, 17, 17 }, { 5, 15, 18 } };
+  for(itk::ImageRegionIteratorWithIndex<ImageType> it(img, img->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    {
+    ImageType::IndexType idx = it.GetIndex();
+    double value = 10.0 * sin(0.9 * idx[0] + 1.7 * idx[1] + 2.3 * idx[2]);
+    for(int k = 0; k < 5; k++)
+      {
+      double dx = idx[0] - centers[k][0], dy = idx[1] - centers[k][1], dz = idx[2] - centers[k][2];
+      value += (100.0 + 40.0 * k) * exp(-(dx * dx + dy * dy + dz * dz) / (2 * 3.0 * 3.0));
+      }
+    it.Set((float) value);
+    }
+  return img;
+}
+
+// Count the voxels at which the segments of the brush and the labels of the
+// filter do not correspond one to one
+int CountMismatches(BrushWatershedPipeline *pipeline, WatershedImageType *ref)
+{
+  unordered_map<long, itk::IdentifierType> to_ref;
+  unordered_map<itk::IdentifierType, long> from_ref;
+  int n_diff = 0;
+  for(itk::ImageRegionConstIteratorWithIndex<WatershedImageType> it(ref, ref->GetBufferedRegion());
+      !it.IsAtEnd(); ++it)
+    {
+    long segment = pipeline->GetSegmentAt(it.GetIndex());
+    auto a = to_ref.insert(make_pair(segment, it.Get())).first;
+    auto b = from_ref.insert(make_pair(it.Get(), segment)).first;
+    if(a->second != it.Get() || b->second != segment)
+      n_diff++;
+    }
+  return n_diff;
+}
+
+int TestLevels(ImageType *img)
+{
+  BrushWatershedPipeline pipeline;
+  pipeline.PrecomputeWatersheds(img, img, img->GetLargestPossibleRegion(), smoothing_iter);
+
+  // The reference filter computes the complete hierarchy, and then only
+  // relabels the basic segments when the level is lowered
+  typedef itk::GradientAnisotropicDiffusionImageFilter<ImageType, ImageType> ADFType;
+  typedef itk::GradientMagnitudeImageFilter<ImageType, ImageType> GMFType;
+  typedef itk::WatershedImageFilter<ImageType> WFType;
+  ADFType::Pointer adf = ADFType::New();
+  adf->SetInput(img);
+  adf->SetConductanceParameter(0.5);
+  adf->SetNumberOfIterations(smoothing_iter);
+  GMFType::Pointer gmf = GMFType::New();
+  gmf->SetInput(adf->GetOutput());
+  WFType::Pointer wf = WFType::New();
+  wf->SetInput(gmf->GetOutput());
+  wf->SetLevel(1.0);
+  wf->Update();
+
+  int rc = 0;
+  double levels[] = { 0.0, 0.05, 0.2, 0.5, 1.0 };
+  for(double level : levels)
+    {
+    pipeline.RecomputeWatersheds(level);
+    wf->SetLevel(level);
+    wf->Update();
+
+    int n_diff = CountMismatches(&pipeline, wf->GetOutput());
+    cout << "level " << level << ": " << n_diff << " voxels differ from itk::WatershedImageFilter" << endl;
+    if(n_diff)
+      {
+      cerr << "Segments at level " << level << " differ from itk::WatershedImageFilter" << endl;
+      rc = 1;
+      }
+    }
+  return rc;
+}
+
+RegionType MakeRegion(long x0, long y0, long z0, long sx, long sy, long sz)
+{
+  RegionType region;
+  region.SetIndex({{ x0, y0, z0 }});
+  region.SetSize({{ (unsigned long) sx, (unsigned long) sy, (unsigned long) sz }});
+  return region;
+}
+
+int TestWindow(ImageType *img)
+{
+  BrushWatershedPipeline pipeline;
+  int rc = 0;
+
+  // A 3D brush, and a 2D brush inside its window
+  RegionType r3d = MakeRegion(9, 9, 9, 5, 5, 5);
+  RegionType r2d = MakeRegion(9, 9, 11, 5, 5, 1);
+  pipeline.PrecomputeWatersheds(img, img, r3d, smoothing_iter);
+  if(!pipeline.IsWindowValid(img, r3d, smoothing_iter))
+    {
+    cerr << "Window is not valid for the brush it was computed for" << endl;
+    rc = 1;
+    }
+  if(pipeline.IsWindowValid(img, r2d, smoothing_iter))
+    {
+    cerr << "Window of a 3D brush is reused for a 2D brush" << endl;
+    rc = 1;
+    }
+
+  // The window of the 2D brush is flat, and only valid in the same slice
+  pipeline.PrecomputeWatersheds(img, img, r2d, smoothing_iter);
+  cout << "window of the 2D brush: " << pipeline.GetWindow() << endl;
+  if(pipeline.GetWindow().GetSize(2) != 1 || !pipeline.IsWindowValid(img, r2d, smoothing_iter))
+    {
+    cerr << "Window of a 2D brush is not flat in the slice of the brush" << endl;
+    rc = 1;
+    }
+  if(pipeline.IsWindowValid(img, MakeRegion(9, 9, 12, 5, 5, 1), smoothing_iter)
+     || pipeline.IsWindowValid(img, MakeRegion(11, 9, 9, 1, 5, 5), smoothing_iter))
+    {
+    cerr << "Window of a 2D brush is reused for another slice" << endl;
+    rc = 1;
+    }
+  return rc;
+}
+
+int main(int argc, char *argv[])
+{
+  int rc = 0;
+  try
+    {
+    ImageType::Pointer img = MakeImage();
+    rc |= TestLevels(img);
+    rc |= TestWindow(img);
+    }
+  catch(std::exception &exc)
+    {
+    cerr << "Brush watershed test failed: " << exc.what() << endl;
+    rc = -1;
+    }
+
+  return rc;
+}
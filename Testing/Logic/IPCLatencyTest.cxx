@@ -0,0 +1,197 @@
+#include "IPCHandler.h"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined(WIN32)
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/**
+ * Measures the round trip latency of IPC messages between two local processes.
+ * The parent process sends a 'ping' message through IPCHandler, the child waits
+ * for it using IPCHandler::WaitForMessage and replies with a 'pong'. The time
+ * between sending the ping and receiving the pong is recorded. Then both
+ * processes broadcast at the same time, and every message read back is checked
+ * for being a mix of two messages.
+ *
+ * Usage: IPCLatencyTest [n_messages] [payload_bytes]
+ */
+
+// A variable-size message: a header followed by an opaque payload
+struct PingMessage
+{
+  long counter;
+  int is_reply;
+  char payload[4096];
+};
+
+// A version that does not collide with the version used by ITK-SNAP sessions
+static const short TEST_IPC_VERSION = 0x7e57;
+
+// Timeout for a single message, after which the test is considered failed
+static const int TEST_TIMEOUT_MS = 5000;
+
+// Check that a message read back is not a mix of two messages
+static bool IsConsistent(const PingMessage &msg, size_t payload)
+{
+  for(size_t i = 0; i < payload; i++)
+    if(msg.payload[i] != (char) (msg.counter & 0x7f))
+      return false;
+  return true;
+}
+
+// Broadcast and read messages as fast as possible, returning the number of
+// torn messages read. Both processes do this at the same time
+static long Contend(IPCHandler &ipc, long n_messages, size_t payload, size_t msg_size, int sender)
+{
+  PingMessage msg, in;
+  long torn = 0;
+  for(long i = 0; i < n_messages; i++)
+    {
+    msg.counter = i * 2 + sender;
+    msg.is_reply = sender;
+    memset(msg.payload, (int) (msg.counter & 0x7f), payload);
+    ipc.Broadcast(&msg, msg_size);
+    if(ipc.Read(&in) && !IsConsistent(in, payload))
+      torn++;
+    }
+  return torn;
+}
+
+static bool WaitAndRead(IPCHandler &ipc, PingMessage &msg, long counter, int is_reply)
+{
+  auto t_start = chrono::steady_clock::now();
+  while(true)
+    {
+    if(ipc.WaitForMessage(100) && ipc.ReadIfNew(&msg)
+       && msg.counter == counter && msg.is_reply == is_reply)
+      return true;
+
+    auto elapsed = chrono::steady_clock::now() - t_start;
+    if(chrono::duration_cast<chrono::milliseconds>(elapsed).count() > TEST_TIMEOUT_MS)
+      return false;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+#if defined(WIN32)
+  cout << "IPCLatencyTest is not supported on this platform" << endl;
+  return 0;
+#else
+  long n_messages = argc > 1 ? atol(argv[1]) : 1000;
+  size_t payload = argc > 2 ? (size_t) atol(argv[2]) : 64;
+  payload = std::min(payload, sizeof(PingMessage::payload));
+  size_t msg_size = offsetof(PingMessage, payload) + payload;
+
+  cout << "IPC notification: "
+       << (IPCHandler::IsNotificationSupported() ? "futex" : "polling") << endl;
+
+  pid_t child = fork();
+  if(child < 0)
+    {
+    cerr << "fork() failed" << endl;
+    return -1;
+    }
+
+  // The handler must be created after the fork so that it records the pid
+  IPCHandler ipc;
+  ipc.Attach(argv[0], TEST_IPC_VERSION, sizeof(PingMessage));
+  if(!ipc.IsAttached())
+    {
+    cerr << "Failed to attach to shared memory" << endl;
+    return -1;
+    }
+
+  PingMessage msg;
+  memset(&msg, 0, sizeof(msg));
+
+  if(child == 0)
+    {
+    // Child: echo every ping back to the parent
+    for(long i = 0; i < n_messages; i++)
+      {
+      if(!WaitAndRead(ipc, msg, i, 0))
+        _exit(1);
+      msg.is_reply = 1;
+      ipc.Broadcast(&msg, msg_size);
+      }
+
+    // Closing marks our last message as stale, so wait until the parent has
+    // read it and says goodbye
+    if(!WaitAndRead(ipc, msg, n_messages, 0))
+      _exit(1);
+
+    // Both processes now broadcast at the same time
+    long torn = Contend(ipc, n_messages * 10, payload, msg_size, 1);
+    ipc.Close();
+    _exit(torn == 0 ? 0 : 2);
+    }
+
+  // Parent: give the child time to attach, then send pings
+  usleep(100000);
+  vector<double> latency;
+  int rc = 0;
+  for(long i = 0; i < n_messages; i++)
+    {
+    msg.counter = i;
+    msg.is_reply = 0;
+    auto t0 = chrono::steady_clock::now();
+    ipc.Broadcast(&msg, msg_size);
+    if(!WaitAndRead(ipc, msg, i, 1))
+      {
+      cerr << "Timed out waiting for reply to message " << i << endl;
+      rc = -1;
+      break;
+      }
+    auto t1 = chrono::steady_clock::now();
+    latency.push_back(chrono::duration<double, micro>(t1 - t0).count());
+    }
+
+  // Start the contention phase in the child
+  msg.counter = n_messages;
+  msg.is_reply = 0;
+  ipc.Broadcast(&msg, msg_size);
+  usleep(100000);
+
+  long torn = rc == 0 ? Contend(ipc, n_messages * 10, payload, msg_size, 0) : 0;
+
+  int status = 0;
+  if(rc != 0)
+    kill(child, SIGTERM);
+  waitpid(child, &status, 0);
+  ipc.Close();
+
+  if(rc != 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || torn != 0)
+    {
+    cerr << "Torn messages read with concurrent broadcasts: " << torn
+         << (WIFEXITED(status) && WEXITSTATUS(status) == 2 ? " (and in child)" : "") << endl;
+    return -1;
+    }
+
+  // Report round trip statistics in microseconds
+  sort(latency.begin(), latency.end());
+  double sum = 0.0;
+  for(double l : latency)
+    sum += l;
+
+  cout << "Messages:     " << latency.size() << " x " << msg_size << " bytes" << endl;
+  cout << "Mean RTT:     " << sum / latency.size() << " us" << endl;
+  cout << "Median RTT:   " << latency[latency.size() / 2] << " us" << endl;
+  cout << "95% RTT:      " << latency[(latency.size() * 95) / 100] << " us" << endl;
+  cout << "Max RTT:      " << latency.back() << " us" << endl;
+
+  return 0;
+#endif
+}
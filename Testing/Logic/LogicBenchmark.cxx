@@ -0,0 +1,483 @@
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "IRISApplication.h"
+#include "IRISImageData.h"
+#include "SNAPImageData.h"
+#include "GlobalState.h"
+#include "ImageIODelegates.h"
+#include "ImageWrapperBase.h"
+#include "LabelImageWrapper.h"
+#include "LayerIterator.h"
+#include "SegmentationUpdateIterator.h"
+#include "SegmentationStatistics.h"
+#include "SNAPSegmentationROISettings.h"
+#include "MeshManager.h"
+#include "RFClassificationEngine.h"
+#include "UIReporterDelegates.h"
+#include "TestSystemInfoDelegate.h"
+#include "TestTiming.h"
+#include "IRISException.h"
+#include "itksys/SystemTools.hxx"
+#include <itkImage.h>
+#include <itkVectorImage.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkMatrixOffsetTransformBase.h>
+#include <itkMultiThreaderBase.h>
+#include <vnl/vnl_math.h>
+
+/**
+ * Benchmark of the hot paths of the logic layer, driven through
+ * IRISApplication without a GUI. The suite is run on the tensor project in
+ * the test data directory (grey and vector layers, opened with OpenProject)
+ * and on synthetic grey and RGB volumes of a given size. For each dataset it
+ * times slicing along the three display axes for every layer, paintbrush
+ * strokes, undo and redo, mesh updates, segmentation statistics, random
+ * forest training, level set iterations and oblique reslicing. Opening the
+ * project is also broken down into the per-layer stages of OpenProject.
+ *
+ * The results are written to standard output as JSON, one entry per
+ * measurement, so that they can be compared across versions.
+ *
+ * Usage: LogicBenchmark TestDataDirectory TempDirectory [SyntheticSize]
+ */
+
+// Collects the measurements and writes them out as JSON
+class BenchmarkReport
+{
+public:
+
+  void Add(const string &dataset, const string &test, const string &layer,
+           unsigned int count, double total_ms)
+    {
+    Entry e = { dataset, test, layer, count, total_ms };
+    m_Entries.push_back(e);
+
+    // Progress goes to the error stream to keep the output parseable
+    cerr << dataset << " " << test << " " << layer << ": "
+         << total_ms << " ms / " << count << endl;
+    }
+
+  void Write(ostream &os, int synthetic_size) const
+    {
+    os << "{" << endl;
+    os << "  \"benchmark\": \"LogicBenchmark\"," << endl;
+    os << "  \"threads\": " << itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads() << "," << endl;
+    os << "  \"synthetic_size\": " << synthetic_size << "," << endl;
+    os << "  \"results\": [" << endl;
+    for(size_t i = 0; i < m_Entries.size(); i++)
+      {
+      const Entry &e = m_Entries[i];
+      os << "    { \"dataset\": \"" << e.Dataset << "\""
+         << ", \"test\": \"" << e.Test << "\""
+         << ", \"layer\": \"" << e.Layer << "\""
+         << ", \"count\": " << e.Count
+         << ", \"total_ms\": " << e.TotalMs
+         << ", \"mean_ms\": " << (e.Count ? e.TotalMs / e.Count : 0.0)
+         << " }" << (i + 1 < m_Entries.size() ? "," : "") << endl;
+      }
+    os << "  ]" << endl;
+    os << "}" << endl;
+    }
+
+protected:
+
+  struct Entry
+  {
+    string Dataset, Test, Layer;
+    unsigned int Count;
+    double TotalMs;
+  };
+
+  vector<Entry> m_Entries;
+};
+
+// Create a grey volume with a bright sphere and some noise, and an RGB volume
+// with smooth gradients, of the given size
+void MakeSyntheticImages(const string &fn_grey, const string &fn_rgb, int n)
+{
+  typedef itk::Image<short, 3> GreyImageType;
+  typedef itk::VectorImage<unsigned char, 3> RGBImageType;
+
+  GreyImageType::Pointer grey = GreyImageType::New();
+  grey->SetRegions(GreyImageType::SizeType({{(itk::SizeValueType) n, (itk::SizeValueType) n, (itk::SizeValueType) n}}));
+  grey->Allocate();
+
+  double r2 = (n / 4.0) * (n / 4.0), c = (n - 1) / 2.0;
+  for(itk::ImageRegionIteratorWithIndex<GreyImageType> it(grey, grey->GetBufferedRegion());
+      !it.IsAtEnd(); ++it)
+    {
+    const GreyImageType::IndexType &idx = it.GetIndex();
+    double dx = idx[0] - c, dy = idx[1] - c, dz = idx[2] - c;
+    unsigned int hash = (idx[0] * 73856093u) ^ (idx[1] * 19349663u) ^ (idx[2] * 83492791u);
+    short value = (dx * dx + dy * dy + dz * dz < r2) ? 800 : 200;
+    it.Set(value + (short) (hash % 100));
+    }
+
+  RGBImageType::Pointer rgb = RGBImageType::New();
+  rgb->SetRegions(grey->GetBufferedRegion());
+  rgb->SetNumberOfComponentsPerPixel(3);
+  rgb->Allocate();
+
+  for(itk::ImageRegionIteratorWithIndex<RGBImageType> it(rgb, rgb->GetBufferedRegion());
+      !it.IsAtEnd(); ++it)
+    {
+    RGBImageType::PixelType pix(3);
+    for(unsigned int d = 0; d < 3; d++)
+      pix[d] = (unsigned char) ((it.GetIndex()[d] * 255) / n);
+    it.Set(pix);
+    }
+
+  typedef itk::ImageFileWriter<GreyImageType> GreyWriter;
+  GreyWriter::Pointer wg = GreyWriter::New();
+  wg->SetInput(grey);
+  wg->SetFileName(fn_grey);
+  wg->Update();
+
+  typedef itk::ImageFileWriter<RGBImageType> RGBWriter;
+  RGBWriter::Pointer wr = RGBWriter::New();
+  wr->SetInput(rgb);
+  wr->SetFileName(fn_rgb);
+  wr->Update();
+}
+
+// A short name for a layer, such as main0, overlay1 or label0
+string GetLayerName(LayerIterator &it)
+{
+  ostringstream oss;
+  if(it.GetRole() == LABEL_ROLE)
+    oss << "label";
+  else if(it.GetRole() == MAIN_ROLE)
+    oss << "main";
+  else
+    oss << "overlay";
+  oss << it.GetPositionInRole();
+  if(it.GetRole() != LABEL_ROLE)
+    oss << (it.GetLayer()->IsScalar() ? "_grey" : "_vector");
+  return oss.str();
+}
+
+// Generate every display slice of every layer along each of the display axes
+void BenchmarkSlicing(IRISApplication *app, BenchmarkReport &report,
+                      const string &dataset, const string &test)
+{
+  GenericImageData *gid = app->GetCurrentImageData();
+  ImageWrapperBase *main = gid->GetMain();
+  Vector3ui cursor_start = app->GetCursorPosition();
+  Vector3ui size = main->GetSize();
+
+  for(LayerIterator it = gid->GetLayers(MAIN_ROLE | OVERLAY_ROLE | LABEL_ROLE);
+      !it.IsAtEnd(); ++it)
+    {
+    ImageWrapperBase *layer = it.GetLayer();
+    for(unsigned int d = 0; d < 3; d++)
+      {
+      unsigned int axis = main->GetDisplaySliceImageAxis(d);
+      ostringstream name;
+      name << test << "_axis" << d;
+
+      double t = TimeIt([&]()
+        {
+        Vector3ui cursor = cursor_start;
+        for(unsigned int k = 0; k < size[axis]; k++)
+          {
+          cursor[axis] = k;
+          app->SetCursorPosition(cursor);
+          layer->GetDisplaySlice(d)->Update();
+          }
+        });
+
+      report.Add(dataset, name.str(), GetLayerName(it), size[axis], t);
+      }
+    }
+
+  app->SetCursorPosition(cursor_start, true);
+}
+
+// Paint a stroke of spherical dabs along a line in the middle of the image,
+// in the way that the paintbrush does, with a single undo point at the end
+unsigned int PaintStroke(LabelImageWrapper *seg, LabelType label, int offset)
+{
+  Vector3ui size = seg->GetSize();
+  int radius = std::max(2, (int) size[0] / 32);
+
+  DrawOverFilter drawover;
+  drawover.CoverageMode = PAINT_OVER_ALL;
+  drawover.DrawOverLabel = 0;
+
+  unsigned int n_dabs = 0;
+  for(int x = radius; x < (int) size[0] - radius; x += std::max(1, radius / 2), n_dabs++)
+    {
+    itk::Index<3> center = {{ x, (int) size[1] / 2 + offset, (int) size[2] / 2 }};
+    itk::ImageRegion<3> region;
+    for(unsigned int d = 0; d < 3; d++)
+      {
+      region.SetIndex(d, center[d] - radius);
+      region.SetSize(d, 2 * radius + 1);
+      }
+    region.Crop(seg->GetImage()->GetBufferedRegion());
+
+    SegmentationUpdateIterator it_update(seg, region, label, drawover);
+    for(; !it_update.IsAtEnd(); ++it_update)
+      {
+      SegmentationUpdateIterator::IndexType idx = it_update.GetIndex();
+      long r2 = 0;
+      for(unsigned int d = 0; d < 3; d++)
+        r2 += (idx[d] - center[d]) * (idx[d] - center[d]);
+      if(r2 <= radius * radius)
+        it_update.PaintAsForeground();
+      }
+
+    if(it_update.Finalize())
+      seg->StoreIntermediateUndoDelta(it_update.RelinquishDelta());
+    }
+
+  seg->StoreUndoPoint("Drawing with paintbrush");
+  return n_dabs;
+}
+
+// Benchmarks that modify and analyze the segmentation in IRIS mode
+void BenchmarkSegmentation(IRISApplication *app, BenchmarkReport &report,
+                           const string &dataset)
+{
+  const unsigned int n_strokes = 8;
+  LabelImageWrapper *seg = app->GetSelectedSegmentationLayer();
+
+  unsigned int n_dabs = 0;
+  double t_paint = TimeIt([&]()
+    {
+    for(unsigned int i = 0; i < n_strokes; i++)
+      n_dabs += PaintStroke(seg, 1 + (i % 3), 4 * (int) i);
+    });
+  report.Add(dataset, "paintbrush_dab", "label0", n_dabs, t_paint);
+
+  double t_undo = TimeIt([&]()
+    {
+    for(unsigned int i = 0; i < n_strokes; i++)
+      app->Undo();
+    });
+  report.Add(dataset, "undo", "label0", n_strokes, t_undo);
+
+  double t_redo = TimeIt([&]()
+    {
+    for(unsigned int i = 0; i < n_strokes; i++)
+      app->Redo();
+    });
+  report.Add(dataset, "redo", "label0", n_strokes, t_redo);
+
+  // Meshes are built from scratch, and then again after a small edit
+  MeshManager *mm = app->GetMeshManager();
+  unsigned int tp = seg->GetTimePointIndex();
+  double t_mesh = TimeIt([&]() { mm->UpdateVTKMeshes(NULL, tp); });
+  report.Add(dataset, "mesh_update_full", "label0", 1, t_mesh);
+
+  PaintStroke(seg, 1, -4);
+  double t_mesh_edit = TimeIt([&]() { mm->UpdateVTKMeshes(NULL, tp); });
+  report.Add(dataset, "mesh_update_after_stroke", "label0", 1, t_mesh_edit);
+
+  SegmentationStatistics stats;
+  double t_stats = TimeIt([&]() { stats.Compute(app); });
+  report.Add(dataset, "segmentation_statistics", "label0", 1, t_stats);
+}
+
+// Benchmarks of the snake mode: classifier training and level set evolution
+void BenchmarkSnake(IRISApplication *app, BenchmarkReport &report,
+                    const string &dataset)
+{
+  const unsigned int n_iter = 50;
+
+  // Segment the whole image
+  SNAPSegmentationROISettings roi;
+  roi.SetROI(app->GetIRISImageData()->GetMain()->GetBufferedRegion());
+
+  double t_init = TimeIt([&]()
+    {
+    app->InitializeSNAPImageData(roi, NULL);
+    app->SetCurrentImageDataToSNAP();
+    });
+  report.Add(dataset, "snake_initialize", "main0_grey", 1, t_init);
+
+  // Paint training samples for two classes: inside and around the center
+  app->EnterPreprocessingMode(PREPROCESS_RF);
+  LabelImageWrapper *seg = app->GetSNAPImageData()->GetFirstSegmentationLayer();
+  PaintStroke(seg, 1, 0);
+  PaintStroke(seg, 2, seg->GetSize()[1] / 4);
+
+  double t_train = TimeIt([&]() { app->GetClassificationEngine()->TrainClassifier(); });
+  report.Add(dataset, "rf_train", "main0_grey", 1, t_train);
+
+  // The level set runs on a thresholded speed image
+  app->EnterPreprocessingMode(PREPROCESS_THRESHOLD);
+  double t_speed = TimeIt([&]() { app->ApplyCurrentPreprocessingModeToSpeedVolume(NULL); });
+  report.Add(dataset, "speed_threshold", "main0_grey", 1, t_speed);
+  app->EnterPreprocessingMode(PREPROCESS_NONE);
+
+  Vector3ui size = app->GetSNAPImageData()->GetMain()->GetSize();
+  Bubble bub;
+  bub.center = to_int(size / 2u);
+  bub.radius = std::max(2.0, size[0] / 16.0);
+  app->GetBubbleArray().clear();
+  app->GetBubbleArray().push_back(bub);
+
+  if(!app->InitializeActiveContourPipeline())
+    throw IRISException("Failed to initialize the active contour");
+
+  double t_snake = TimeIt([&]() { app->GetSNAPImageData()->RunSegmentation(n_iter); });
+  report.Add(dataset, "levelset_iteration", "main0_grey", n_iter, t_snake);
+
+  app->SetCurrentImageDataToIRIS();
+  app->ReleaseSNAPImageData();
+}
+
+// Place the display viewports on the slices of the main image through the
+// cursor, as the slice views do, so that oblique slicing can be performed
+void SetupDisplayViewports(IRISApplication *app)
+{
+  GenericImageData *gid = app->GetCurrentImageData();
+  ImageWrapperBase *main = gid->GetMain();
+  ImageWrapperBase::ImageBaseType *img = main->GetImageBase();
+  Vector3ui cursor = app->GetCursorPosition();
+
+  for(unsigned int i = 0; i < 3; i++)
+    {
+    unsigned int k = main->GetDisplaySliceImageAxis(i);
+    unsigned int axes[3] = { (k + 1) % 3, (k + 2) % 3, k };
+
+    ImageWrapperBase::ImageBaseType *vp = gid->GetDisplayViewportGeometry(i);
+    ImageWrapperBase::ImageBaseType::RegionType region;
+    ImageWrapperBase::ImageBaseType::SpacingType spacing;
+    ImageWrapperBase::ImageBaseType::DirectionType dir;
+    ImageWrapperBase::ImageBaseType::PointType origin = img->GetOrigin();
+    for(unsigned int j = 0; j < 3; j++)
+      {
+      region.SetSize(j, j < 2 ? img->GetLargestPossibleRegion().GetSize(axes[j]) : 1);
+      spacing[j] = img->GetSpacing()[axes[j]];
+      for(unsigned int r = 0; r < 3; r++)
+        {
+        dir(r, j) = img->GetDirection()(r, axes[j]);
+        origin[r] += (j == 2) ? dir(r, j) * spacing[j] * cursor[k] : 0.0;
+        }
+      }
+
+    vp->SetRegions(region);
+    vp->SetSpacing(spacing);
+    vp->SetOrigin(origin);
+    vp->SetDirection(dir);
+    }
+}
+
+// Rotate the overlays relative to the main image and slice them again
+void BenchmarkObliqueSlicing(IRISApplication *app, BenchmarkReport &report,
+                             const string &dataset)
+{
+  GenericImageData *gid = app->GetCurrentImageData();
+  ImageWrapperBase *main = gid->GetMain();
+  ImageWrapperBase::ImageBaseType *img = main->GetImageBase();
+
+  // Rotation by 15 degrees around the first and third axes about the center
+  typedef itk::MatrixOffsetTransformBase<double, 3, 3> TransformType;
+  TransformType::Pointer tran = TransformType::New();
+  TransformType::MatrixType rx, rz;
+  double a = 15.0 * vnl_math::pi / 180.0;
+  rx.SetIdentity(); rz.SetIdentity();
+  rx(1,1) = cos(a); rx(1,2) = -sin(a); rx(2,1) = sin(a); rx(2,2) = cos(a);
+  rz(0,0) = cos(a); rz(0,1) = -sin(a); rz(1,0) = sin(a); rz(1,1) = cos(a);
+
+  itk::ContinuousIndex<double, 3> cidx;
+  for(unsigned int d = 0; d < 3; d++)
+    cidx[d] = (img->GetLargestPossibleRegion().GetSize(d) - 1) / 2.0;
+  TransformType::InputPointType center;
+  img->TransformContinuousIndexToPhysicalPoint(cidx, center);
+
+  tran->SetCenter(center);
+  tran->SetMatrix(rx * rz);
+
+  for(LayerIterator it = gid->GetLayers(OVERLAY_ROLE); !it.IsAtEnd(); ++it)
+    it.GetLayer()->SetITKTransform(img, tran);
+
+  SetupDisplayViewports(app);
+  BenchmarkSlicing(app, report, dataset, "slice_oblique");
+}
+
+void RunBenchmarks(IRISApplication *app, BenchmarkReport &report, const string &dataset)
+{
+  // Start with the cursor in the center of the image
+  app->SetCursorPosition(app->GetCurrentImageData()->GetMain()->GetSize() / 2u, true);
+
+  BenchmarkSlicing(app, report, dataset, "slice");
+  BenchmarkSegmentation(app, report, dataset);
+  BenchmarkSnake(app, report, dataset);
+  BenchmarkObliqueSlicing(app, report, dataset);
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 3)
+    {
+    cerr << "Usage:\n" << argv[0] << " TestDataDirectory TempDirectory [SyntheticSize]" << endl;
+    return 1;
+    }
+
+  string datadir = argv[1], tmpdir = argv[2];
+  int synth_size = argc > 3 ? atoi(argv[3]) : 256;
+  itksys::SystemTools::MakeDirectory(tmpdir);
+
+  DummySystemInfoDelegate sidel(argv[0]);
+  SystemInterface::SetSystemInfoDelegate(&sidel);
+
+  IRISApplication::Pointer app = IRISApplication::New();
+  BenchmarkReport report;
+
+  try
+    {
+    // Real data: the tensor project has grey and vector layers
+    IRISWarningList wl;
+    string fn_project = datadir + "/tensor.itksnap";
+    double t_open = TimeIt([&]() { app->OpenProject(fn_project, wl); });
+    report.Add("tensor", "open_project", "all", 1, t_open);
+
+    // Time spent in each stage of loading each layer of the project
+    for(const IRISApplication::LayerLoadTiming &t : app->GetProjectLoadTimings())
+      {
+      string layer = itksys::SystemTools::GetFilenameName(t.FileName);
+      report.Add("tensor", "open_project_read", layer, 1, t.ReadTime * 1000);
+      report.Add("tensor", "open_project_cast", layer, 1, t.CastTime * 1000);
+      report.Add("tensor", "open_project_wait", layer, 1, t.WaitTime * 1000);
+      report.Add("tensor", "open_project_attach", layer, 1, t.AttachTime * 1000);
+      }
+
+    RunBenchmarks(app, report, "tensor");
+    app->UnloadMainImage();
+
+    // Synthetic data of the requested size
+    ostringstream oss;
+    oss << "synthetic" << synth_size;
+    string fn_grey = tmpdir + "/benchmark_grey.nii", fn_rgb = tmpdir + "/benchmark_rgb.nii";
+    MakeSyntheticImages(fn_grey, fn_rgb, synth_size);
+
+    double t_main = TimeIt([&]() { app->OpenImage(fn_grey.c_str(), MAIN_ROLE, wl); });
+    report.Add(oss.str(), "open_image", "main0_grey", 1, t_main);
+    double t_overlay = TimeIt([&]() { app->OpenImage(fn_rgb.c_str(), OVERLAY_ROLE, wl); });
+    report.Add(oss.str(), "open_image", "overlay0_vector", 1, t_overlay);
+    RunBenchmarks(app, report, oss.str());
+    app->UnloadMainImage();
+
+    itksys::SystemTools::RemoveFile(fn_grey);
+    itksys::SystemTools::RemoveFile(fn_rgb);
+    }
+  catch(std::exception &exc)
+    {
+    cerr << "Benchmark failed: " << exc.what() << endl;
+    return -1;
+    }
+
+  report.Write(cout, synth_size);
+  return 0;
+}
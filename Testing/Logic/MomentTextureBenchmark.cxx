@@ -0,0 +1,157 @@
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+#include "MomentTextures.h"
+#include <itkImage.h>
+#include <itkVectorImage.h>
+#include <itkImageRegionIterator.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkConstNeighborhoodIterator.h>
+#include <itkMultiThreaderBase.h>
+#include "TestTiming.h"
+
+/**
+ * Benchmark of the moment texture features used for random forest
+ * classification. MomentTextureFilter, which computes the moments from box
+ * filtered power sums, is compared to the direct evaluation over the
+ * neighborhood of each voxel, for several radii. The features must agree
+ * within floating point tolerance. The timings are written to standard
+ * output as JSON.
+ *
+ * Usage: MomentTextureBenchmark [ImageSize]
+ */
+
+typedef itk::Image<float, 3> ImageType;
+typedef itk::VectorImage<float, 3> TextureImageType;
+typedef bilwaj::MomentTextureFilter<ImageType, TextureImageType> FilterType;
+
+const unsigned int DEGREE = 3;
+
+ImageType::Pointer CreateImage(unsigned int n)
+{
+  ImageType::Pointer img = ImageType::New();
+  ImageType::RegionType region;
+  region.SetSize(0, n); region.SetSize(1, n); region.SetSize(2, n);
+  img->SetRegions(region);
+  img->Allocate();
+
+  // Smooth structure plus noise, with values on both sides of zero
+  srand(1234);
+  for(itk::ImageRegionIteratorWithIndex<ImageType> it(img, region); !it.IsAtEnd(); ++it)
+    {
+    ImageType::IndexType idx = it.GetIndex();
+    double v = 400 * sin(idx[0] * 0.1) * cos(idx[1] * 0.07) + 3 * idx[2];
+    it.Set((float) (v + rand() % 100));
+    }
+
+  return img;
+}
+
+// The features as they were computed before, by visiting the neighborhood
+TextureImageType::Pointer ReferenceTextures(ImageType *img, ImageType::SizeType radius)
+{
+  TextureImageType::Pointer out = TextureImageType::New();
+  out->CopyInformation(img);
+  out->SetRegions(img->GetBufferedRegion());
+  out->SetNumberOfComponentsPerPixel(DEGREE);
+  out->Allocate();
+
+  itk::ConstNeighborhoodIterator<ImageType> nit(radius, img, img->GetBufferedRegion());
+  itk::ImageRegionIterator<TextureImageType> it(out, out->GetBufferedRegion());
+  TextureImageType::PixelType pix(DEGREE);
+  for(; !it.IsAtEnd(); ++it, ++nit)
+    {
+    float accum = 0, min = 0, max = 0;
+    for(unsigned int j = 0; j < nit.Size(); j++)
+      {
+      float p = nit.GetPixel(j);
+      accum += p;
+      min = std::min(min, p);
+      max = std::max(max, p);
+      }
+
+    float range = max - min, mean = accum / nit.Size();
+    vector<float> m(DEGREE, 0.0f);
+    for(unsigned int j = 0; j < nit.Size(); j++)
+      {
+      float v = (nit.GetPixel(j) - mean) / range, vk = v;
+      m[0] += v;
+      for(unsigned int k = 1; k < DEGREE; k++)
+        {
+        vk *= v;
+        m[k] += vk;
+        }
+      }
+
+    for(unsigned int k = 0; k < DEGREE; k++)
+      pix[k] = 1000 * (k == 0 ? mean / range : m[k] / nit.Size());
+    it.Set(pix);
+    }
+
+  return out;
+}
+
+double MaxError(TextureImageType *a, TextureImageType *b)
+{
+  double max_err = 0;
+  itk::ImageRegionConstIterator<TextureImageType> ia(a, a->GetBufferedRegion());
+  itk::ImageRegionConstIterator<TextureImageType> ib(b, b->GetBufferedRegion());
+  for(; !ia.IsAtEnd(); ++ia, ++ib)
+    for(unsigned int k = 0; k < DEGREE; k++)
+      max_err = std::max(max_err, fabs(ia.Get()[k] - ib.Get()[k]) / (1.0 + fabs(ia.Get()[k])));
+  return max_err;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int n = argc > 1 ? atoi(argv[1]) : 128;
+  bool ok = true;
+
+  ImageType::Pointer img = CreateImage(n);
+
+  cout << "{" << endl;
+  cout << "  \"benchmark\": \"MomentTextureBenchmark\"," << endl;
+  cout << "  \"threads\": " << itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads() << "," << endl;
+  cout << "  \"size\": " << n << "," << endl;
+  cout << "  \"degree\": " << DEGREE << "," << endl;
+  cout << "  \"results\": [" << endl;
+
+  unsigned int radii[] = { 1, 2, 4 };
+  for(unsigned int r = 0; r < 3; r++)
+    {
+    ImageType::SizeType radius;
+    radius.Fill(radii[r]);
+
+    TextureImageType::Pointer ref;
+    double t_ref = TimeIt([&]() { ref = ReferenceTextures(img, radius); });
+
+    FilterType::Pointer filter = FilterType::New();
+    filter->SetInput(img);
+    filter->SetRadius(radius);
+    filter->SetHighestDegree(DEGREE);
+    double t_filter = TimeIt([&]() { filter->Update(); });
+
+    double err = MaxError(ref, filter->GetOutput());
+    if(!(err < 1e-3))
+      {
+      cerr << "radius " << radii[r] << ": textures differ from reference, error " << err << endl;
+      ok = false;
+      }
+
+    cout << "    { \"radius\": " << radii[r]
+         << ", \"reference_ms\": " << t_ref
+         << ", \"filter_ms\": " << t_filter
+         << ", \"max_relative_error\": " << err
+         << " }" << (r < 2 ? "," : "") << endl;
+    }
+
+  cout << "  ]" << endl;
+  cout << "}" << endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "NativeImageCastKernels.h"
+#include <itkMultiThreaderBase.h>
+#include "TestTiming.h"
+
+/**
+ * Micro-benchmark of the kernels used to convert native image buffers to the
+ * internal short representation when images are loaded (range scan, integer
+ * check for floating point data, and in-place rescaling). Every native
+ * component type is covered. The results of the threaded kernels are checked
+ * against serial reference loops, including the handling of NaN values, and
+ * the timings are written to standard output as JSON.
+ *
+ * Usage: NativeCastBenchmark [NumberOfValues]
+ */
+
+typedef short OutputComponentType;
+
+// Same arithmetic as the functor used by RescaleNativeImageToIntegralType
+template <class TNative>
+class RescaleFunctor
+{
+public:
+  RescaleFunctor(double shift, double scale) : m_Shift(shift), m_Scale(scale) {}
+
+  void operator()(TNative *src, OutputComponentType *trg)
+    {
+    *trg = (OutputComponentType) ((*src + m_Shift) * m_Scale + 0.5);
+    }
+
+protected:
+  double m_Shift, m_Scale;
+};
+
+struct Result
+{
+  string Type, Test;
+  double SerialMs, ThreadedMs;
+};
+
+// Fill a buffer with a pattern that spans much of the range of the type
+template <class TNative>
+void FillBuffer(vector<TNative> &data)
+{
+  double lo = std::max(-30000.0, (double) numeric_limits<TNative>::lowest());
+  double hi = std::min(30000.0, (double) numeric_limits<TNative>::max());
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = static_cast<TNative>(lo + (hi - lo) * ((i * 7919) % 10007) / 10006.0);
+
+  // For floating point types, put NaNs at the start of some chunks, where
+  // a naive parallel reduction would lose the values that follow
+  if(!numeric_limits<TNative>::is_integer)
+    {
+    for(size_t i = NativeImageCastKernels::CHUNK_SIZE; i < data.size();
+        i += 3 * NativeImageCastKernels::CHUNK_SIZE)
+      data[i] = numeric_limits<TNative>::quiet_NaN();
+    }
+}
+
+template <class TNative>
+bool SameValue(TNative a, TNative b)
+{
+  return a == b || (a != a && b != b);
+}
+
+template <class TNative>
+bool RunType(const string &name, size_t n, vector<Result> &results)
+{
+  vector<TNative> data(n);
+  FillBuffer(data);
+  bool ok = true;
+
+  // Range scan
+  TNative smin = data[0], smax = data[0], tmin, tmax;
+  double t_serial = TimeIt([&]()
+    {
+    for(size_t i = 1; i < n; i++)
+      {
+      if(data[i] < smin) smin = data[i];
+      if(data[i] > smax) smax = data[i];
+      }
+    });
+  double t_threaded = TimeIt([&]()
+    {
+    NativeImageCastKernels::ComputeRange(data.data(), n, tmin, tmax);
+    });
+  results.push_back({ name, "range", t_serial, t_threaded });
+  if(!SameValue(smin, tmin) || !SameValue(smax, tmax))
+    {
+    cerr << name << ": range mismatch" << endl;
+    ok = false;
+    }
+
+  // The range scan must also match when the very first value is NaN
+  if(!numeric_limits<TNative>::is_integer)
+    {
+    vector<TNative> nan_first(data.begin(), data.begin() + std::min(n, (size_t) 1000));
+    nan_first[0] = numeric_limits<TNative>::quiet_NaN();
+    NativeImageCastKernels::ComputeRange(nan_first.data(), nan_first.size(), tmin, tmax);
+    if(tmin == tmin || tmax == tmax)
+      {
+      cerr << name << ": leading NaN not propagated" << endl;
+      ok = false;
+      }
+
+    // Integer check, on data without NaNs
+    vector<TNative> ints(n);
+    for(size_t i = 0; i < n; i++)
+      ints[i] = static_cast<TNative>(i % 20000);
+    bool s_isint = true, t_isint = false;
+    t_serial = TimeIt([&]()
+      {
+      for(size_t i = 0; i < n; i++)
+        {
+        TNative vcmp = static_cast<TNative>(static_cast<OutputComponentType>(ints[i] + 0.5));
+        if(ints[i] != vcmp) { s_isint = false; break; }
+        }
+      });
+    t_threaded = TimeIt([&]()
+      {
+      t_isint = NativeImageCastKernels::IsIntegerValued<TNative, OutputComponentType>(ints.data(), n);
+      });
+    results.push_back({ name, "is_integer", t_serial, t_threaded });
+    if(s_isint != t_isint)
+      {
+      cerr << name << ": integer check mismatch" << endl;
+      ok = false;
+      }
+    }
+
+  // In-place rescaling to short. The buffer is made large enough for either
+  // type, as the native image buffer is reallocated before expanding
+  double scale = 0.5, shift = 10.0;
+  size_t nbytes = n * std::max(sizeof(TNative), sizeof(OutputComponentType));
+  vector<OutputComponentType> expected(n);
+  vector<char> buffer(nbytes);
+  memcpy(buffer.data(), data.data(), n * sizeof(TNative));
+
+  RescaleFunctor<TNative> functor(shift, scale);
+  t_serial = TimeIt([&]()
+    {
+    for(size_t i = 0; i < n; i++)
+      functor(&data[i], &expected[i]);
+    });
+  t_threaded = TimeIt([&]()
+    {
+    NativeImageCastKernels::CastInPlace<TNative, OutputComponentType>(
+          reinterpret_cast<TNative *>(buffer.data()), n, functor);
+    });
+  results.push_back({ name, "cast_in_place", t_serial, t_threaded });
+
+  // NaNs convert to an unspecified value, so they are not compared
+  const OutputComponentType *out = reinterpret_cast<OutputComponentType *>(buffer.data());
+  for(size_t i = 0; i < n; i++)
+    {
+    if(data[i] == data[i] && out[i] != expected[i])
+      {
+      cerr << name << ": cast mismatch at " << i << endl;
+      ok = false;
+      break;
+      }
+    }
+
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t n = argc > 1 ? (size_t) atol(argv[1]) : 16000000;
+  vector<Result> results;
+  bool ok = true;
+
+  ok &= RunType<unsigned char>("uchar", n, results);
+  ok &= RunType<signed char>("char", n, results);
+  ok &= RunType<unsigned short>("ushort", n, results);
+  ok &= RunType<signed short>("short", n, results);
+  ok &= RunType<unsigned int>("uint", n, results);
+  ok &= RunType<signed int>("int", n, results);
+  ok &= RunType<unsigned long>("ulong", n, results);
+  ok &= RunType<signed long>("long", n, results);
+  ok &= RunType<float>("float", n, results);
+  ok &= RunType<double>("double", n, results);
+
+  cout << "{" << endl;
+  cout << "  \"benchmark\": \"NativeCastBenchmark\"," << endl;
+  cout << "  \"threads\": " << itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads() << "," << endl;
+  cout << "  \"values\": " << n << "," << endl;
+  cout << "  \"results\": [" << endl;
+  for(size_t i = 0; i < results.size(); i++)
+    {
+    const Result &r = results[i];
+    cout << "    { \"type\": \"" << r.Type << "\""
+         << ", \"test\": \"" << r.Test << "\""
+         << ", \"serial_ms\": " << r.SerialMs
+         << ", \"threaded_ms\": " << r.ThreadedMs
+         << " }" << (i + 1 < results.size() ? "," : "") << endl;
+    }
+  cout << "  ]" << endl;
+  cout << "}" << endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "RLEImage.h"
+#include "RLERegionOfInterestImageFilter.h"
+#include "RLEImageStreamWriter.h"
+#include "IRISException.h"
+#include "itksys/SystemTools.hxx"
+#include "itksys/Directory.hxx"
+#include "itk_zlib.h"
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkNiftiImageIO.h>
+#include <itkMetaImageIO.h>
+
+/**
+ * Test of the streaming RLE image writer. A label image is written with the
+ * streaming writer to .nii, .nii.gz and .mha files, and with the regular ITK
+ * writer to uncompressed reference files. The uncompressed streamed files
+ * must be byte for byte identical to the references, the decompressed .nii.gz
+ * file must be identical to the reference .nii file, and every file must read
+ * back as the original image. No temporary files may be left in the output
+ * directory.
+ *
+ * Usage: RLEStreamWriterTest TempDirectory
+ */
+
+typedef itk::Image<unsigned short, 3> ImageType;
+typedef RLEImage<unsigned short> RLEImageType;
+
+ImageType::Pointer MakeLabelImage()
+{
+  ImageType::Pointer img = ImageType::New();
+  img->SetRegions(ImageType::SizeType({{37, 29, 23}}));
+  double origin[3] = { -12.5, 4.25, 30.0 };
+  img->SetOrigin(origin);
+  ImageType::SpacingType spacing;
+  spacing[0] = 0.8; spacing[1] = 1.2; spacing[2] = 2.5;
+  img->SetSpacing(spacing);
+  img->Allocate();
+
+  // Long runs with a few short ones, as in a segmentation
+  for(itk::ImageRegionIteratorWithIndex<ImageType> it(img, img->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    {
+    ImageType::IndexType idx = it.GetIndex();
+    unsigned short label = 0;
+    if(idx[0] > 5 && idx[0] < 30 && idx[1] > 3 && idx[1] < 20)
+      label = 1 + (idx[2] % 3);
+    if((idx[0] + idx[1] + idx[2]) % 17 == 0)
+      label = 300;
+    it.Set(label);
+    }
+  return img;
+}
+
+vector<char> ReadBytes(const string &fn)
+{
+  ifstream ifs(fn.c_str(), ios::binary);
+  return vector<char>((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+}
+
+// Decompress a gzip file, which may consist of several members
+vector<char> ReadGzipBytes(const string &fn)
+{
+  vector<char> data;
+  gzFile gz = gzopen(fn.c_str(), "rb");
+  if(!gz)
+    return data;
+
+  char buffer[65536];
+  int n;
+  while((n = gzread(gz, buffer, sizeof(buffer))) > 0)
+    data.insert(data.end(), buffer, buffer + n);
+  gzclose(gz);
+  return data;
+}
+
+bool SameImage(ImageType *a, const string &fn)
+{
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(fn);
+  reader->Update();
+  ImageType *b = reader->GetOutput();
+
+  if(a->GetLargestPossibleRegion() != b->GetLargestPossibleRegion())
+    return false;
+
+  for(unsigned int d = 0; d < 3; d++)
+    if(fabs(a->GetSpacing()[d] - b->GetSpacing()[d]) > 1e-5
+       || fabs(a->GetOrigin()[d] - b->GetOrigin()[d]) > 1e-5)
+      return false;
+
+  itk::ImageRegionConstIterator<ImageType> ia(a, a->GetBufferedRegion());
+  itk::ImageRegionConstIterator<ImageType> ib(b, b->GetBufferedRegion());
+  for(; !ia.IsAtEnd(); ++ia, ++ib)
+    if(ia.Get() != ib.Get())
+      return false;
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2)
+    {
+    cerr << "Usage:\n" << argv[0] << " TempDirectory" << endl;
+    return 1;
+    }
+
+  // Use a fresh directory, so that leftover files can be detected
+  string tmpdir = itksys::SystemTools::CollapseFullPath(argv[1]) + "/rle_stream_writer";
+  itksys::SystemTools::RemoveADirectory(tmpdir);
+  itksys::SystemTools::MakeDirectory(tmpdir);
+
+  int rc = 0;
+  try
+    {
+    ImageType::Pointer img = MakeLabelImage();
+
+    typedef itk::RegionOfInterestImageFilter<ImageType, RLEImageType> ConverterType;
+    ConverterType::Pointer conv = ConverterType::New();
+    conv->SetInput(img);
+    conv->SetRegionOfInterest(img->GetLargestPossibleRegion());
+    conv->Update();
+    RLEImageType *rle = conv->GetOutput();
+
+    // Reference files written by ITK
+    string fn_ref_nii = tmpdir + "/ref.nii", fn_ref_mha = tmpdir + "/ref.mha";
+    typedef itk::ImageFileWriter<ImageType> WriterType;
+    WriterType::Pointer writer = WriterType::New();
+    writer->SetInput(img);
+    writer->SetUseCompression(false);
+    writer->SetImageIO(itk::NiftiImageIO::New());
+    writer->SetFileName(fn_ref_nii);
+    writer->Update();
+    writer->SetImageIO(itk::MetaImageIO::New());
+    writer->SetFileName(fn_ref_mha);
+    writer->Update();
+
+    // Streamed files, with small blocks so that there are many gzip members
+    const char *names[] = { "stream.nii", "stream.nii.gz", "stream.mha" };
+    for(const char *name : names)
+      {
+      string fn = tmpdir + "/" + name;
+      RLEImageStreamWriter<RLEImageType> sw;
+      sw.SetInput(rle);
+      sw.SetFileName(fn);
+      if(string(name).find(".mha") != string::npos)
+        sw.SetImageIO(itk::MetaImageIO::New());
+      else
+        sw.SetImageIO(itk::NiftiImageIO::New());
+      sw.SetBlockSize(4096);
+      if(!sw.CanStreamWrite())
+        {
+        cerr << "Can not stream write " << name << endl;
+        rc = 1;
+        continue;
+        }
+      sw.Update();
+
+      if(!SameImage(img, fn))
+        {
+        cerr << "Image read from " << name << " does not match the input" << endl;
+        rc = 1;
+        }
+      }
+
+    if(ReadBytes(tmpdir + "/stream.nii") != ReadBytes(fn_ref_nii))
+      {
+      cerr << "Streamed .nii file differs from the ITK file" << endl;
+      rc = 1;
+      }
+    if(ReadGzipBytes(tmpdir + "/stream.nii.gz") != ReadBytes(fn_ref_nii))
+      {
+      cerr << "Decompressed .nii.gz file differs from the ITK .nii file" << endl;
+      rc = 1;
+      }
+    if(ReadBytes(tmpdir + "/stream.mha") != ReadBytes(fn_ref_mha))
+      {
+      cerr << "Streamed .mha file differs from the ITK file" << endl;
+      rc = 1;
+      }
+
+    // Only the files written above may be in the directory
+    itksys::Directory dir;
+    dir.Load(tmpdir);
+    for(unsigned long i = 0; i < dir.GetNumberOfFiles(); i++)
+      {
+      string file = dir.GetFile(i);
+      if(file != "." && file != ".." && file != "ref.nii" && file != "ref.mha"
+         && file != "stream.nii" && file != "stream.nii.gz" && file != "stream.mha")
+        {
+        cerr << "Unexpected file " << file << " left in the output directory" << endl;
+        rc = 1;
+        }
+      }
+    }
+  catch(std::exception &exc)
+    {
+    cerr << "RLE stream writer test failed: " << exc.what() << endl;
+    rc = -1;
+    }
+
+  itksys::SystemTools::RemoveADirectory(tmpdir);
+
+  if(rc == 0)
+    cout << "RLE stream writer round trip OK" << endl;
+  return rc;
+}
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+#include "RecursiveGaussianFilterKernel.h"
+#include "EdgePreprocessingImageFilter.h"
+#include "EdgePreprocessingSettings.h"
+#include <itkImage.h>
+#include <itkDiscreteGaussianImageFilter.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+
+/**
+ * Test of the recursive Gaussian used for large scales in edge preprocessing.
+ * For several scales, an image blurred with RecursiveGaussianFilterKernel is
+ * compared with the same image blurred by itk::DiscreteGaussianImageFilter
+ * with a tightly truncated kernel. Then the change of the edge map over small
+ * steps of the scale at the start, middle and end of the range where the
+ * discrete and the recursive Gaussian are blended is compared with the change
+ * over a larger step on the discrete side: the switch must not make the edge
+ * map jump. Last, the edge map of one slice, which is computed from a padded
+ * slab of the input, is compared with the edge map of the whole image.
+ *
+ * Usage: RecursiveGaussianTest
+ */
+
+typedef itk::Image<float, 3> ImageType;
+typedef itk::Image<short, 3> EdgeImageType;
+typedef EdgePreprocessingImageFilter<ImageType, EdgeImageType> EdgeFilterType;
+
+const int n = 48;
+
+// A sphere and a box on a background, with an intensity range of 800
+ImageType::Pointer MakeImage()
+{
+  ImageType::Pointer img = ImageType::New();
+  img->SetRegions(ImageType::SizeType({{n, n, n}}));
+  img->Allocate();
+
+  for(itk::ImageRegionIteratorWithIndex<ImageType> it(img, img->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    {
+    ImageType::IndexType idx = it.GetIndex();
+    double dx = idx[0] - 20.0, dy = idx[1] - 24.0, dz = idx[2] - 22.0;
+    float value = 200.0f;
+    if(dx * dx + dy * dy + dz * dz < 14.0 * 14.0)
+      value = 1000.0f;
+    if(idx[0] >= 30 && idx[0] < 44 && idx[1] >= 6 && idx[1] < 20 && idx[2] >= 6 && idx[2] < 40)
+      value = 600.0f;
+    it.Set(value);
+    }
+  return img;
+}
+
+double MaxDifference(ImageType *a, ImageType *b)
+{
+  double max_diff = 0.0;
+  itk::ImageRegionConstIterator<ImageType> ia(a, a->GetBufferedRegion());
+  itk::ImageRegionConstIterator<ImageType> ib(b, b->GetBufferedRegion());
+  for(; !ia.IsAtEnd(); ++ia, ++ib)
+    max_diff = std::max(max_diff, (double) fabs(ia.Get() - ib.Get()));
+  return max_diff;
+}
+
+// Compute the edge map of the whole image, or of the given region
+EdgeImageType::Pointer ComputeEdges(ImageType *img, double scale, const itk::ImageRegion<3> *region = nullptr)
+{
+  SmartPtr<EdgePreprocessingSettings> settings = EdgePreprocessingSettings::New();
+  settings->SetGaussianBlurScale(scale);
+
+  EdgeFilterType::Pointer filter = EdgeFilterType::New();
+  filter->SetInput(img);
+  filter->SetParameters(settings);
+
+  // The steepest gradient of the unblurred image, in central differences
+  filter->SetInputImageMaximumGradientMagnitude(400.0);
+
+  if(region)
+    {
+    filter->UpdateOutputInformation();
+    filter->GetOutput()->SetRequestedRegion(*region);
+    filter->GetOutput()->Update();
+    }
+  else
+    {
+    filter->Update();
+    }
+
+  EdgeImageType::Pointer result = filter->GetOutput();
+  result->DisconnectPipeline();
+  return result;
+}
+
+double MeanDifference(EdgeImageType *a, EdgeImageType *b)
+{
+  double sum = 0.0;
+  itk::ImageRegionConstIterator<EdgeImageType> ia(a, a->GetBufferedRegion());
+  itk::ImageRegionConstIterator<EdgeImageType> ib(b, b->GetBufferedRegion());
+  for(; !ia.IsAtEnd(); ++ia, ++ib)
+    sum += abs(ia.Get() - ib.Get());
+  return sum / a->GetBufferedRegion().GetNumberOfPixels();
+}
+
+int TestBlur(ImageType *img, double sigma)
+{
+  // The discrete Gaussian, truncated where it holds 99% of the Gaussian
+  typedef itk::DiscreteGaussianImageFilter<ImageType, ImageType> BlurFilterType;
+  BlurFilterType::Pointer blur = BlurFilterType::New();
+  blur->SetInput(img);
+  blur->SetUseImageSpacingOff();
+  blur->SetVariance(sigma * sigma);
+  blur->SetMaximumError(0.01);
+  blur->SetMaximumKernelWidth(128);
+  blur->Update();
+
+  ImageType::Pointer rec = ImageType::New();
+  rec->SetRegions(img->GetBufferedRegion());
+  rec->Allocate();
+  std::copy(img->GetBufferPointer(),
+            img->GetBufferPointer() + img->GetBufferedRegion().GetNumberOfPixels(),
+            rec->GetBufferPointer());
+
+  size_t size[3] = { n, n, n };
+  RecursiveGaussianFilterKernel kernel(sigma);
+  kernel.FilterImage(rec->GetBufferPointer(), size, 3);
+
+  // The two approximations of the Gaussian differ by about 1% of the range
+  double max_diff = MaxDifference(blur->GetOutput(), rec);
+  cout << "sigma " << sigma << ": largest difference from the discrete Gaussian "
+       << max_diff << endl;
+  if(max_diff > 0.02 * 800.0)
+    {
+    cerr << "Recursive Gaussian with sigma " << sigma << " differs from the discrete Gaussian" << endl;
+    return 1;
+    }
+  return 0;
+}
+
+int TestSwitch(ImageType *img)
+{
+  // Both below the threshold, using the discrete Gaussian
+  double s_min = RecursiveGaussianFilterKernel::GetMinimumSigma();
+  double s_max = s_min + EdgeFilterType::GetRecursiveGaussianBlendWidth();
+  double d_step = MeanDifference(ComputeEdges(img, s_min - 0.1),
+                                 ComputeEdges(img, s_min - 0.01));
+  cout << "mean change of the edge map: " << d_step << " from scale " << s_min - 0.1
+       << " to " << s_min - 0.01 << endl;
+
+  // Into, across and out of the blending range
+  int rc = 0;
+  double s_test[] = { s_min - 0.01, 0.5 * (s_min + s_max), s_max - 0.01 };
+  for(double s : s_test)
+    {
+    double d = MeanDifference(ComputeEdges(img, s), ComputeEdges(img, s + 0.01));
+    cout << "mean change of the edge map: " << d << " from scale " << s
+         << " to " << s + 0.01 << endl;
+    if(d >= d_step)
+      {
+      cerr << "Edge map jumps between scales " << s << " and " << s + 0.01 << endl;
+      rc = 1;
+      }
+    }
+  return rc;
+}
+
+int TestSlab(ImageType *img, double sigma)
+{
+  itk::ImageRegion<3> slice = img->GetLargestPossibleRegion();
+  slice.SetIndex(2, n / 2);
+  slice.SetSize(2, 1);
+
+  EdgeImageType::Pointer e_full = ComputeEdges(img, sigma);
+  EdgeImageType::Pointer e_slice = ComputeEdges(img, sigma, &slice);
+
+  // The input beyond the padding has a negligible effect
+  int max_diff = 0;
+  for(itk::ImageRegionConstIteratorWithIndex<EdgeImageType> it(e_slice, slice); !it.IsAtEnd(); ++it)
+    max_diff = std::max(max_diff, abs(it.Get() - e_full->GetPixel(it.GetIndex())));
+
+  cout << "sigma " << sigma << ": largest difference of a slice from the whole image "
+       << max_diff << endl;
+  if(max_diff > 0x7fff / 200)
+    {
+    cerr << "Edge map of a slice with sigma " << sigma << " differs from that of the image" << endl;
+    return 1;
+    }
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int rc = 0;
+  try
+    {
+    ImageType::Pointer img = MakeImage();
+
+    double sigmas[] = { 2.0, 3.0, 5.0, 8.0 };
+    for(double sigma : sigmas)
+      rc |= TestBlur(img, sigma);
+
+    rc |= TestSwitch(img);
+    rc |= TestSlab(img, 2.25);
+    rc |= TestSlab(img, 3.0);
+    }
+  catch(std::exception &exc)
+    {
+    cerr << "Recursive Gaussian test failed: " << exc.what() << endl;
+    rc = -1;
+    }
+
+  return rc;
+}
@@ -0,0 +1,260 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+#include "GlobalUIModel.h"
+#include "RegistrationModel.h"
+#include "IRISApplication.h"
+#include "GenericImageData.h"
+#include "ImageWrapperBase.h"
+#include "IRISException.h"
+#include "TestSystemInfoDelegate.h"
+#include "itksys/SystemTools.hxx"
+#include <itkCommand.h>
+#include <itkImage.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkMatrixOffsetTransformBase.h>
+
+/**
+ * Test of the multi-resolution automatic registration in RegistrationModel.
+ * An overlay that is a shifted copy of the main image is registered over two
+ * resolution levels. The metric log must have an entry for each level, and
+ * the registration must recover the shift. Then the registration is run again
+ * from the identity and cancelled from the iteration command after the first
+ * iteration: it must stop, leave the moving transform at the identity, which
+ * is the result of the last completed level, and leave the log of the finer
+ * level empty.
+ *
+ * Usage: RegistrationModelTest TempDirectory
+ */
+
+typedef itk::Image<short, 3> FileImageType;
+typedef itk::MatrixOffsetTransformBase<double, 3, 3> TransformBase;
+
+const int n = 64;
+
+// A smooth blob on a background, shifted along x
+void WriteImage(const string &fn, double shift)
+{
+  FileImageType::Pointer img = FileImageType::New();
+  img->SetRegions(FileImageType::SizeType({{n, n, n}}));
+  img->Allocate();
+
+  for(itk::ImageRegionIteratorWithIndex<FileImageType> it(img, img->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    {
+    FileImageType::IndexType idx = it.GetIndex();
+    double dx = idx[0] - 30.0 - shift, dy = (idx[1] - 32.0) * 1.3, dz = idx[2] - 34.0;
+    it.Set((short) (100.0 + 800.0 * exp(-(dx * dx + dy * dy + dz * dz) / (2 * 10.0 * 10.0))));
+    }
+
+  typedef itk::ImageFileWriter<FileImageType> WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetInput(img);
+  writer->SetFileName(fn);
+  writer->Update();
+}
+
+// Counts the iterations, and cancels the registration after a given number
+class CancelAfterCommand : public itk::Command
+{
+public:
+  typedef CancelAfterCommand Self;
+  typedef itk::SmartPointer<Self> Pointer;
+
+  itkTypeMacro(CancelAfterCommand, itk::Command)
+  itkNewMacro(Self)
+
+  RegistrationModel *Model = nullptr;
+  int CancelAfter = 0, Iterations = 0;
+
+  virtual void Execute(itk::Object *caller, const itk::EventObject &event) ITK_OVERRIDE
+  {
+    Execute((const itk::Object *) caller, event);
+  }
+
+  virtual void Execute(const itk::Object *, const itk::EventObject &) ITK_OVERRIDE
+  {
+    if(++Iterations == CancelAfter)
+      Model->CancelAutoRegistration();
+  }
+};
+
+double GetTranslation(ImageWrapperBase *layer, bool &is_identity)
+{
+  const TransformBase *tb = dynamic_cast<const TransformBase *>(layer->GetITKTransform());
+  is_identity = true;
+  if(!tb)
+    return 0.0;
+
+  TransformBase::MatrixType matrix = tb->GetMatrix();
+  TransformBase::OutputVectorType offset = tb->GetOffset();
+  for(int i = 0; i < 3; i++)
+    for(int j = 0; j < 3; j++)
+      if(fabs(matrix(i, j) - (i == j ? 1.0 : 0.0)) > 1e-6 || fabs(offset[i]) > 1e-6)
+        is_identity = false;
+  return offset.GetNorm();
+}
+
+int TestFullRun(RegistrationModel *reg, CancelAfterCommand *cmd, int n_levels)
+{
+  cmd->Iterations = 0;
+  cmd->CancelAfter = -1;
+  reg->RunAutoRegistration();
+
+  // One non-empty log for each level
+  const RegistrationModel::MetricLog &log = reg->GetRegistrationMetricLog();
+  cout << "full run: " << cmd->Iterations << " iterations, log sizes";
+  for(const auto &level_log : log)
+    cout << " " << level_log.size();
+  cout << endl;
+
+  int rc = 0;
+  if(log.size() != (size_t) n_levels)
+    {
+    cerr << "Metric log has " << log.size() << " levels instead of " << n_levels << endl;
+    rc = 1;
+    }
+  for(const auto &level_log : log)
+    {
+    if(level_log.empty())
+      {
+      cerr << "Metric log of a level is empty after a full run" << endl;
+      rc = 1;
+      }
+    }
+
+  // The overlay is shifted by 3 voxels of 1mm
+  bool is_identity;
+  double t = GetTranslation(reg->GetMovingLayerWrapper(), is_identity);
+  cout << "full run: recovered translation " << t << endl;
+  if(fabs(t - 3.0) > 1.0)
+    {
+    cerr << "Registration did not recover the shift of the overlay" << endl;
+    rc = 1;
+    }
+
+  if(reg->IsAutoRegistrationRunning())
+    {
+    cerr << "Registration is still flagged as running" << endl;
+    rc = 1;
+    }
+  return rc;
+}
+
+int TestCancel(RegistrationModel *reg, CancelAfterCommand *cmd, int n_levels)
+{
+  reg->ResetTransformToIdentity();
+  cmd->Iterations = 0;
+  cmd->CancelAfter = 1;
+  reg->RunAutoRegistration();
+
+  const RegistrationModel::MetricLog &log = reg->GetRegistrationMetricLog();
+  cout << "cancelled run: " << cmd->Iterations << " iterations" << endl;
+
+  int rc = 0;
+  if(cmd->Iterations != 1)
+    {
+    cerr << "Registration continued for " << cmd->Iterations << " iterations after cancellation" << endl;
+    rc = 1;
+    }
+
+  // The coarsest level has the iteration before the cancellation, the finer
+  // levels were never started
+  if(log.size() != (size_t) n_levels || log[0].empty())
+    {
+    cerr << "Metric log of the cancelled level is missing" << endl;
+    rc = 1;
+    }
+  for(size_t i = 1; i < log.size(); i++)
+    {
+    if(!log[i].empty())
+      {
+      cerr << "Metric log of level " << i << " is not empty after cancellation" << endl;
+      rc = 1;
+      }
+    }
+
+  // No level was completed, so the transform is back where it started
+  bool is_identity;
+  GetTranslation(reg->GetMovingLayerWrapper(), is_identity);
+  if(!is_identity)
+    {
+    cerr << "Cancelled registration did not restore the last completed transform" << endl;
+    rc = 1;
+    }
+
+  if(reg->IsAutoRegistrationRunning())
+    {
+    cerr << "Registration is still flagged as running after cancellation" << endl;
+    rc = 1;
+    }
+  return rc;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2)
+    {
+    cerr << "Usage:\n" << argv[0] << " TempDirectory" << endl;
+    return 1;
+    }
+
+  string tmpdir = itksys::SystemTools::CollapseFullPath(argv[1]);
+  itksys::SystemTools::MakeDirectory(tmpdir);
+  string fn_fixed = tmpdir + "/registration_fixed.nii.gz";
+  string fn_moving = tmpdir + "/registration_moving.nii.gz";
+
+  DummySystemInfoDelegate sidel(argv[0]);
+  SystemInterface::SetSystemInfoDelegate(&sidel);
+
+  SmartPtr<GlobalUIModel> gui = GlobalUIModel::New();
+  IRISApplication *app = gui->GetDriver();
+  RegistrationModel *reg = gui->GetRegistrationModel();
+
+  int rc = 0;
+  try
+    {
+    WriteImage(fn_fixed, 0.0);
+    WriteImage(fn_moving, 3.0);
+
+    IRISWarningList wl;
+    app->OpenImage(fn_fixed.c_str(), MAIN_ROLE, wl);
+    app->OpenImage(fn_moving.c_str(), OVERLAY_ROLE, wl);
+
+    // Pick up the new images and select the overlay as the moving image
+    reg->Update();
+    reg->GetMovingLayerModel()->SetValue(app->GetCurrentImageData()->GetLastOverlay()->GetUniqueId());
+
+    // Two levels, at 2x and at full resolution
+    reg->SetCoarsestResolutionLevel(1);
+    reg->SetFinestResolutionLevel(0);
+    reg->SetSimilarityMetric(RegistrationModel::SSD);
+    reg->SetTransformation(RegistrationModel::RIGID);
+
+    CancelAfterCommand::Pointer cmd = CancelAfterCommand::New();
+    cmd->Model = reg;
+    reg->SetIterationCommand(cmd);
+
+    rc |= TestFullRun(reg, cmd, 2);
+    rc |= TestCancel(reg, cmd, 2);
+
+    reg->OnDialogClosed();
+    app->UnloadMainImage();
+    }
+  catch(std::exception &exc)
+    {
+    cerr << "Registration model test failed: " << exc.what() << endl;
+    rc = -1;
+    }
+
+  itksys::SystemTools::RemoveFile(fn_fixed);
+  itksys::SystemTools::RemoveFile(fn_moving);
+
+  if(rc == 0)
+    cout << "Registration levels and cancellation behave as expected" << endl;
+  return rc;
+}
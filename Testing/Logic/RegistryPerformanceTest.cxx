@@ -0,0 +1,121 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+using namespace std;
+
+#include "Registry.h"
+#include "itksys/SystemTools.hxx"
+#include "TestTiming.h"
+
+/**
+ * Builds synthetic workspace-like registries of increasing size, writes them
+ * to disk in XML and in the plain text format, reads them back and checks that
+ * the round trip is lossless. Reports the time taken by each operation.
+ *
+ * Usage: RegistryPerformanceTest TempDirectory [MaxAnnotations]
+ */
+
+// Fill a registry with the kind of content found in large workspaces
+void MakeSyntheticWorkspace(Registry &reg, int n_layers, int n_annot, int n_labels)
+{
+  reg["SaveLocation"] << "/data/study/subject001";
+  reg["Version"] << "20240101";
+
+  for(int i = 0; i < n_layers; i++)
+    {
+    Registry &layer = reg.Folder(Registry::Key("Layers.Layer[%03d]", i));
+    layer["AbsolutePath"] << Registry::Key("/data/study/subject001/layer_%03d.nii.gz", i);
+    layer["Role"] << (i == 0 ? "MainRole" : "OverlayRole");
+    layer["Tags"] << "T1,contrast,\"quoted\" <tag> & more";
+
+    // Per-layer metadata, similar to DICOM headers
+    Registry &meta = layer.Folder("ImageMetaData");
+    for(int j = 0; j < 200; j++)
+      meta[Registry::Key("0008|%04x", j)] << Registry::Key("Value %d of layer %d with spaces", j, i);
+
+    // Per-layer history
+    Registry &hist = layer.Folder("LayerMetaData.IOHistory");
+    std::vector<std::string> history;
+    for(int j = 0; j < 20; j++)
+      history.push_back(Registry::Key("/previous/location_%d/file with space.nii.gz", j));
+    hist.PutArray(history);
+    }
+
+  // Annotations
+  Registry &annot = reg.Folder("Annotations");
+  annot["Format"] << "ITK-SNAP Annotation File";
+  for(int k = 0; k < n_annot; k++)
+    {
+    Registry &a = annot.Folder(Registry::Key("Annotations.Element[%d]", k));
+    a["Type"] << "LineSegment";
+    a["Plane"] << (k % 3);
+    a["Point1"] << Vector3d(k * 0.5, k * 0.25, k * 0.125);
+    a["Point2"] << Vector3d(k * 1.5, k * 1.25, k * 1.125);
+    a["Text"] << Registry::Key("Annotation #%d: width < height & depth > 0", k);
+    a["Color"] << Vector3d(1.0, 0.5, 0.25);
+    }
+
+  // Label descriptions
+  Registry &labels = reg.Folder("IRIS.LabelTable");
+  labels["NumberOfElements"] << n_labels;
+  for(int l = 0; l < n_labels; l++)
+    {
+    Registry &lab = labels.Folder(Registry::Key("Element[%d]", l));
+    lab["Index"] << l;
+    lab["Label"] << Registry::Key("Label %d (left/right)", l);
+    lab["Color"] << Vector3i(l % 256, (l * 7) % 256, (l * 13) % 256);
+    lab["Alpha"] << 255;
+    lab["Flags"] << Vector2i(1, 1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2)
+    {
+    cout << "Usage:\n" << argv[0] << " TempDirectory [MaxAnnotations]" << endl;
+    return 1;
+    }
+
+  string tmpdir = argv[1];
+  int max_annot = argc > 2 ? atoi(argv[2]) : 100000;
+  itksys::SystemTools::MakeDirectory(tmpdir);
+
+  cout << "annotations,layers,labels,xml_bytes,write_xml_ms,read_xml_ms,write_txt_ms,read_txt_ms" << endl;
+  for(int n_annot = 100; n_annot <= max_annot; n_annot *= 10)
+    {
+    int n_layers = 4 + n_annot / 1000;
+    int n_labels = n_annot / 10;
+
+    Registry reg;
+    MakeSyntheticWorkspace(reg, n_layers, n_annot, n_labels);
+
+    string fn_xml = tmpdir + "/synthetic_workspace.itksnap";
+    string fn_txt = tmpdir + "/synthetic_workspace.txt";
+
+    Registry reg_xml, reg_txt;
+    double t_wx = TimeIt([&]() { reg.WriteToXMLFile(fn_xml.c_str(), "Synthetic workspace"); });
+    double t_rx = TimeIt([&]() { reg_xml.ReadFromXMLFile(fn_xml.c_str()); });
+    double t_wt = TimeIt([&]() { reg.WriteToFile(fn_txt.c_str(), "# Synthetic workspace"); });
+    double t_rt = TimeIt([&]() { reg_txt.ReadFromFile(fn_txt.c_str()); });
+
+    cout << n_annot << "," << n_layers << "," << n_labels << ","
+         << itksys::SystemTools::FileLength(fn_xml) << ","
+         << t_wx << "," << t_rx << "," << t_wt << "," << t_rt << endl;
+
+    // The files must read back to exactly the same registry
+    if(reg_xml != reg)
+      {
+      cerr << "XML round trip failed for " << n_annot << " annotations" << endl;
+      return -1;
+      }
+    if(reg_txt != reg)
+      {
+      cerr << "Text round trip failed for " << n_annot << " annotations" << endl;
+      return -1;
+      }
+    }
+
+  return 0;
+}
@@ -0,0 +1,160 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+#include "AdaptiveSlicingPipeline.h"
+#include "LookupTableIntensityMappingFilter.h"
+#include "ColorLookupTable.h"
+#include "ImageCoordinateTransform.h"
+#include <itkImage.h>
+#include <itkRGBAPixel.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+
+/**
+ * Test that slices prefetched by the slicing pipeline are used when display
+ * slices are mapped through the lookup table in one pass. Slices ahead of the
+ * current one are prefetched, and the voxels of one of them are then changed
+ * in the 3D image without marking the image as modified. The display slice
+ * must show the prefetched values, which means that it was read from the
+ * cache and not from the 3D image. Once the image is marked as modified, the
+ * display slice must show the new values.
+ *
+ * Usage: SlicePrefetchTest
+ */
+
+typedef itk::Image<short, 3> ImageType;
+typedef itk::Image<short, 2> SliceType;
+typedef itk::Image<itk::RGBAPixel<unsigned char>, 2> DisplaySliceType;
+typedef AdaptiveSlicingPipeline<ImageType, SliceType, ImageType> SlicerType;
+typedef LookupTableIntensityMappingFilter<SliceType, DisplaySliceType> MappingFilterType;
+typedef ColorLookupTable<short, itk::RGBAPixel<unsigned char> > LookupTableType;
+
+const int n = 40;
+
+ImageType::Pointer MakeImage()
+{
+  ImageType::Pointer img = ImageType::New();
+  img->SetRegions(ImageType::SizeType({{n, n, n}}));
+  img->Allocate();
+
+  for(itk::ImageRegionIteratorWithIndex<ImageType> it(img, img->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    {
+    ImageType::IndexType idx = it.GetIndex();
+    it.Set((idx[0] + 3 * idx[1] + 7 * idx[2]) % 200);
+    }
+  return img;
+}
+
+// The LUT maps each intensity to the grey level of the same value
+LookupTableType::Pointer MakeLookupTable()
+{
+  LookupTableType::Pointer lut = LookupTableType::New();
+  lut->Initialize(0, 255, 0.0, 1.0);
+  for(unsigned int i = 0; i < lut->GetSize(); i++)
+    {
+    itk::RGBAPixel<unsigned char> rgba;
+    rgba.Set(i, i, i, 255);
+    lut->SetLUTValue(i, rgba);
+    }
+  return lut;
+}
+
+// Count the display pixels that do not show the given slice of the image
+int CountMismatches(DisplaySliceType *display, const ImageType *img, long z)
+{
+  int n_diff = 0;
+  for(itk::ImageRegionConstIteratorWithIndex<DisplaySliceType> it(display, display->GetBufferedRegion());
+      !it.IsAtEnd(); ++it)
+    {
+    ImageType::IndexType idx = {{ it.GetIndex()[0], it.GetIndex()[1], z }};
+    if(it.Get()[0] != img->GetPixel(idx))
+      n_diff++;
+    }
+  return n_diff;
+}
+
+void SetSlice(SlicerType *slicer, long z)
+{
+  SlicerType::IndexType idx = {{ 0, 0, z }};
+  slicer->SetSliceIndex(idx);
+}
+
+int main(int argc, char *argv[])
+{
+  int rc = 0;
+  try
+    {
+    ImageType::Pointer img = MakeImage();
+
+    // Slice along z, lines along y and pixels along x
+    SlicerType::Pointer slicer = SlicerType::New();
+    slicer->SetInput(img);
+    slicer->SetOrthogonalTransform(ImageCoordinateTransform::New());
+    SetSlice(slicer, 10);
+
+    MappingFilterType::Pointer mapper = MappingFilterType::New();
+    mapper->SetSliceInput(0, slicer->GetOutput());
+    mapper->SetLookupTable(MakeLookupTable());
+    mapper->Update();
+    rc |= CountMismatches(mapper->GetOutput(), img, 10) ? 1 : 0;
+
+    // Scroll forward and wait for the next slice to be generated
+    slicer->PrefetchSlices(1, 4);
+    SetSlice(slicer, 11);
+    mapper->UpdateOutputInformation();
+    if(!slicer->CanReadSliceLines())
+      {
+      cerr << "Display slices are not read in one pass from the 3D image" << endl;
+      return 1;
+      }
+
+    bool prefetched = false;
+    for(int i = 0; i < 1000 && !prefetched; i++)
+      {
+      prefetched = slicer->GetPrefetchedSlice().IsNotNull();
+      if(!prefetched)
+        this_thread::sleep_for(chrono::milliseconds(10));
+      }
+    if(!prefetched)
+      {
+      cerr << "Slice 11 was not prefetched" << endl;
+      return 1;
+      }
+
+    // Change slice 11 behind the back of the pipeline
+    ImageType::Pointer original = MakeImage();
+    for(long y = 0; y < n; y++)
+      for(long x = 0; x < n; x++)
+        img->GetPixel({{ x, y, 11 }}) = 250;
+
+    mapper->Update();
+    int n_stale = CountMismatches(mapper->GetOutput(), original, 11);
+    cout << "prefetched slice: " << n_stale << " pixels differ from the prefetched values" << endl;
+    if(n_stale)
+      {
+      cerr << "Display slice was not read from the prefetched slice" << endl;
+      rc = 1;
+      }
+
+    // Once the image is modified, the prefetched slice is out of date
+    img->Modified();
+    mapper->Update();
+    int n_fresh = CountMismatches(mapper->GetOutput(), img, 11);
+    cout << "modified image: " << n_fresh << " pixels differ from the image" << endl;
+    if(n_fresh)
+      {
+      cerr << "Display slice was read from an out of date prefetched slice" << endl;
+      rc = 1;
+      }
+    }
+  catch(std::exception &exc)
+    {
+    cerr << "Slice prefetch test failed: " << exc.what() << endl;
+    rc = -1;
+    }
+
+  return rc;
+}
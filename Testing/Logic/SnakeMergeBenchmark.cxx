@@ -0,0 +1,211 @@
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "LevelSetSegmentationMerger.h"
+#include "RLEImageRegionIterator.h"
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkMultiThreaderBase.h>
+#include "TestTiming.h"
+
+/**
+ * Benchmark of pasting the result of active contour segmentation back into
+ * the segmentation (IRISApplication::UpdateIRISWithSnapImageData). A large
+ * ROI is cut from a synthetic segmentation that contains a sphere with the
+ * active label and a slab with another label. The level set describes a
+ * slightly larger sphere, so that only a thin shell changes, as is typical
+ * when the snake is seeded from the existing segmentation.
+ *
+ * The voxel-by-voxel merge through RLE iterators, with an undo delta over the
+ * whole ROI, is compared to LevelSetSegmentationMerger. The results must be
+ * identical, and applying the undo delta must restore the original image.
+ * The timings are written to standard output as JSON.
+ *
+ * Usage: SnakeMergeBenchmark [ImageSize]
+ */
+
+typedef LevelSetSegmentationMerger::LabelImageType LabelImageType;
+typedef LevelSetSegmentationMerger::LevelSetImageType LevelSetImageType;
+typedef LevelSetSegmentationMerger::DeltaType DeltaType;
+typedef LevelSetSegmentationMerger::RegionType RegionType;
+typedef itk::ImageRegionIterator<LabelImageType> LabelIterator;
+
+const LabelType ACTIVE = 1, OTHER = 2;
+
+LabelImageType::Pointer CreateSegmentation(unsigned int n)
+{
+  LabelImageType::Pointer img = LabelImageType::New();
+  RegionType region;
+  region.SetSize(0, n); region.SetSize(1, n); region.SetSize(2, n);
+  img->SetRegions(region);
+  img->Allocate();
+  img->FillBuffer(0);
+
+  double c = n / 2.0, r = n / 4.0;
+  for(LabelIterator it(img, region); !it.IsAtEnd(); ++it)
+    {
+    RegionType::IndexType idx = it.GetIndex();
+    double dx = idx[0] - c, dy = idx[1] - c, dz = idx[2] - c;
+    if(sqrt(dx * dx + dy * dy + dz * dz) <= r)
+      it.Set(ACTIVE);
+    else if(idx[2] < n / 8)
+      it.Set(OTHER);
+    }
+
+  return img;
+}
+
+LevelSetImageType::Pointer CreateLevelSet(unsigned int n, const RegionType &roi)
+{
+  LevelSetImageType::Pointer img = LevelSetImageType::New();
+  img->SetRegions(RegionType(roi.GetSize()));
+  img->Allocate();
+
+  double c = n / 2.0, r = n / 4.0 + 2.0;
+  typedef itk::ImageRegionIteratorWithIndex<LevelSetImageType> Iterator;
+  for(Iterator it(img, img->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    {
+    LevelSetImageType::IndexType idx = it.GetIndex();
+    double dx = idx[0] + roi.GetIndex(0) - c;
+    double dy = idx[1] + roi.GetIndex(1) - c;
+    double dz = idx[2] + roi.GetIndex(2) - c;
+    it.Set(sqrt(dx * dx + dy * dy + dz * dz) - r);
+    }
+
+  return img;
+}
+
+// The merge as it was done before, one voxel at a time through iterators
+DeltaType *ReferenceMerge(LabelImageType *target, const RegionType &roi,
+                          LevelSetImageType *source, DrawOverFilter draw_over)
+{
+  DeltaType *delta = new DeltaType();
+  delta->SetRegion(roi);
+
+  itk::ImageRegionConstIterator<LevelSetImageType> itSource(source, source->GetBufferedRegion());
+  for(LabelIterator it(target, roi); !it.IsAtEnd(); ++it, ++itSource)
+    {
+    LabelType lOld = it.Get(), lNew = lOld;
+    if(itSource.Value() <= 0)
+      {
+      if(lOld != ACTIVE &&
+         (draw_over.CoverageMode == PAINT_OVER_ALL ||
+          (draw_over.CoverageMode == PAINT_OVER_ONE && lOld == draw_over.DrawOverLabel) ||
+          (draw_over.CoverageMode == PAINT_OVER_VISIBLE && lOld != 0)))
+        lNew = ACTIVE;
+      }
+    else if(lOld == ACTIVE)
+      {
+      lNew = 0;
+      }
+
+    if(lNew != lOld)
+      it.Set(lNew);
+    delta->Encode(lNew - lOld);
+    }
+
+  delta->FinishEncoding();
+  return delta;
+}
+
+bool SameImages(LabelImageType *a, LabelImageType *b)
+{
+  LabelIterator ia(a, a->GetBufferedRegion()), ib(b, b->GetBufferedRegion());
+  for(; !ia.IsAtEnd(); ++ia, ++ib)
+    if(ia.Get() != ib.Get())
+      return false;
+  return true;
+}
+
+void Undo(LabelImageType *img, DeltaType *delta)
+{
+  LabelIterator it(img, delta->GetRegion());
+  for(size_t i = 0; i < delta->GetNumberOfRLEs(); i++)
+    {
+    LabelType d = delta->GetRLEValue(i);
+    for(size_t j = 0; j < delta->GetRLELength(i); j++, ++it)
+      if(d != 0)
+        it.Set(it.Get() - d);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int n = argc > 1 ? atoi(argv[1]) : 256;
+  bool ok = true;
+
+  // The ROI covers most of the image, but not whole lines
+  RegionType roi;
+  for(unsigned int d = 0; d < 3; d++)
+    {
+    roi.SetIndex(d, n / 16);
+    roi.SetSize(d, n - n / 8);
+    }
+
+  LevelSetImageType::Pointer ls = CreateLevelSet(n, roi);
+
+  DrawOverFilter modes[] = {
+    DrawOverFilter(PAINT_OVER_ALL, 0),
+    DrawOverFilter(PAINT_OVER_ONE, 0),
+    DrawOverFilter(PAINT_OVER_VISIBLE, 0) };
+  const char *mode_names[] = { "all", "one", "visible" };
+
+  cout << "{" << endl;
+  cout << "  \"benchmark\": \"SnakeMergeBenchmark\"," << endl;
+  cout << "  \"threads\": " << itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads() << "," << endl;
+  cout << "  \"size\": " << n << "," << endl;
+  cout << "  \"roi_voxels\": " << roi.GetNumberOfPixels() << "," << endl;
+  cout << "  \"results\": [" << endl;
+
+  for(unsigned int m = 0; m < 3; m++)
+    {
+    LabelImageType::Pointer original = CreateSegmentation(n);
+    LabelImageType::Pointer ref = CreateSegmentation(n);
+    LabelImageType::Pointer trg = CreateSegmentation(n);
+
+    DeltaType *ref_delta = NULL, *delta = NULL;
+    double t_ref = TimeIt([&]() { ref_delta = ReferenceMerge(ref, roi, ls, modes[m]); });
+
+    LevelSetSegmentationMerger merger(ACTIVE, modes[m], false);
+    double t_merge = TimeIt([&]() { delta = merger.Merge(trg, roi, ls); });
+
+    if(!SameImages(ref, trg))
+      {
+      cerr << mode_names[m] << ": merged segmentation differs from reference" << endl;
+      ok = false;
+      }
+
+    if(delta)
+      {
+      Undo(trg, delta);
+      if(!SameImages(original, trg))
+        {
+        cerr << mode_names[m] << ": undo does not restore the segmentation" << endl;
+        ok = false;
+        }
+      }
+
+    cout << "    { \"mode\": \"" << mode_names[m] << "\""
+         << ", \"changed_voxels\": " << merger.GetNumberOfChangedVoxels()
+         << ", \"reference_ms\": " << t_ref
+         << ", \"merger_ms\": " << t_merge
+         << ", \"reference_delta_voxels\": " << ref_delta->GetRegion().GetNumberOfPixels()
+         << ", \"merger_delta_voxels\": " << (delta ? delta->GetRegion().GetNumberOfPixels() : 0)
+         << ", \"reference_delta_runs\": " << ref_delta->GetNumberOfRLEs()
+         << ", \"merger_delta_runs\": " << (delta ? delta->GetNumberOfRLEs() : 0)
+         << " }" << (m < 2 ? "," : "") << endl;
+
+    delete ref_delta;
+    delete delta;
+    }
+
+  cout << "  ]" << endl;
+  cout << "}" << endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,279 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "IRISApplication.h"
+#include "IRISImageData.h"
+#include "LabelImageWrapper.h"
+#include "SegmentationSpanPainter.h"
+#include "SegmentationUpdateIterator.h"
+#include "IRISException.h"
+#include "TestSystemInfoDelegate.h"
+#include "TestSegmentation.h"
+#include "itksys/SystemTools.hxx"
+
+/**
+ * Test of the painting of spans into the RLE segmentation. Random spans, some
+ * of them overlapping or outside of the image, are normalized, complemented
+ * and painted with each of the draw-over modes and in background mode. The
+ * segmentation and the undo delta must be the same as those produced by
+ * merging a binary mask of the spans into the segmentation voxel by voxel
+ * with SegmentationUpdateIterator, as drawing used to do.
+ *
+ * Usage: SpanPainterTest TempDirectory
+ */
+
+typedef SegmentationSpanPainter::Span Span;
+typedef SegmentationSpanPainter::SpanList SpanList;
+typedef itk::ImageRegion<3> RegionType;
+
+const int n = 24;
+
+size_t Offset(long x, long y, long z)
+{
+  return x + n * (y + n * z);
+}
+
+bool Inside(long x, long y, long z)
+{
+  return x >= 0 && x < n && y >= 0 && y < n && z >= 0 && z < n;
+}
+
+// The voxels of the image covered by a list of spans
+vector<bool> MakeMask(const SpanList &spans)
+{
+  vector<bool> mask(n * n * n, false);
+  for(const Span &s : spans)
+    for(long x = s.x0; x < s.x1; x++)
+      if(Inside(x, s.y, s.z))
+        mask[Offset(x, s.y, s.z)] = true;
+  return mask;
+}
+
+SpanList MakeRandomSpans(int count)
+{
+  SpanList spans;
+  for(int i = 0; i < count; i++)
+    {
+    long x0 = rand() % (n + 6) - 3;
+    spans.push_back(Span(x0, x0 + rand() % 12, rand() % (n + 2) - 1, rand() % (n + 2) - 1));
+    }
+  return spans;
+}
+
+// Expand an undo delta over the whole image
+vector<LabelType> ExpandDelta(SegmentationSpanPainter::DeltaType *delta)
+{
+  vector<LabelType> dense(n * n * n, 0);
+  if(!delta)
+    return dense;
+
+  RegionType region = delta->GetRegion();
+  vector<size_t> offsets;
+  for(long z = region.GetIndex(2); z <= region.GetUpperIndex()[2]; z++)
+    for(long y = region.GetIndex(1); y <= region.GetUpperIndex()[1]; y++)
+      for(long x = region.GetIndex(0); x <= region.GetUpperIndex()[0]; x++)
+        offsets.push_back(Offset(x, y, z));
+
+  size_t k = 0;
+  for(size_t i = 0; i < delta->GetNumberOfRLEs(); i++)
+    for(size_t j = 0; j < delta->GetRLELength(i) && k < offsets.size(); j++)
+      dense[offsets[k++]] = delta->GetRLEValue(i);
+  return dense;
+}
+
+struct PaintResult
+{
+  vector<LabelType> Voxels, Delta;
+  unsigned long Changed;
+};
+
+// Merge the mask voxel by voxel over the bounding box of the image, as the
+// drawing code did before spans were painted into the runs
+PaintResult PaintVoxelByVoxel(LabelImageWrapper *seg, const vector<bool> &mask,
+                              LabelType label, DrawOverFilter drawover, bool background)
+{
+  RegionType region = seg->GetBufferedRegion();
+  SegmentationUpdateIterator it(seg, region, label, drawover);
+  for(size_t i = 0; !it.IsAtEnd(); ++it, ++i)
+    {
+    if(mask[i])
+      {
+      if(background)
+        it.PaintAsBackground();
+      else
+        it.PaintAsForeground();
+      }
+    }
+
+  PaintResult result;
+  it.Finalize();
+  result.Changed = it.GetNumberOfChangedVoxels();
+  SegmentationSpanPainter::DeltaType *delta = it.RelinquishDelta();
+  result.Voxels = GetVoxels(seg);
+  result.Delta = ExpandDelta(result.Changed ? delta : nullptr);
+  delete delta;
+  return result;
+}
+
+PaintResult PaintSpans(LabelImageWrapper *seg, const SpanList &spans,
+                       LabelType label, DrawOverFilter drawover, bool background)
+{
+  SegmentationSpanPainter painter(label, drawover, background);
+  SegmentationSpanPainter::DeltaType *delta = painter.Paint(seg->GetModifiableImage(), spans);
+
+  PaintResult result;
+  result.Changed = painter.GetNumberOfChangedVoxels();
+  result.Voxels = GetVoxels(seg);
+  result.Delta = ExpandDelta(delta);
+
+  // The delta must cover exactly the bounding box of the changes
+  if(delta && delta->GetRegion() != painter.GetChangedRegion())
+    result.Changed = (unsigned long) -1;
+  delete delta;
+  return result;
+}
+
+int TestNormalize(const SpanList &spans)
+{
+  SpanList norm = spans;
+  SegmentationSpanPainter::Normalize(norm);
+
+  // Spans must be sorted by line, and must not overlap or touch
+  for(size_t i = 1; i < norm.size(); i++)
+    {
+    const Span &a = norm[i-1], &b = norm[i];
+    bool ordered = a.z < b.z || (a.z == b.z && (a.y < b.y || (a.y == b.y && a.x1 < b.x0)));
+    if(!ordered || b.x1 <= b.x0)
+      {
+      cerr << "Normalized spans are not sorted and disjoint" << endl;
+      return 1;
+      }
+    }
+
+  if(MakeMask(norm) != MakeMask(spans))
+    {
+    cerr << "Normalized spans do not cover the same voxels" << endl;
+    return 1;
+    }
+  return 0;
+}
+
+int TestComplement(const SpanList &spans, const RegionType &region)
+{
+  SpanList comp = SegmentationSpanPainter::Complement(spans, region);
+  vector<bool> mask = MakeMask(spans), mask_comp = MakeMask(comp);
+  for(long z = 0; z < n; z++)
+    for(long y = 0; y < n; y++)
+      for(long x = 0; x < n; x++)
+        {
+        itk::Index<3> idx = {{ x, y, z }};
+        size_t i = Offset(x, y, z);
+        if(mask_comp[i] != (region.IsInside(idx) && !mask[i]))
+          {
+          cerr << "Complement of the spans is wrong at " << idx << endl;
+          return 1;
+          }
+        }
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2)
+    {
+    cerr << "Usage:\n" << argv[0] << " TempDirectory" << endl;
+    return 1;
+    }
+
+  string tmpdir = itksys::SystemTools::CollapseFullPath(argv[1]);
+  itksys::SystemTools::MakeDirectory(tmpdir);
+  string fn_seg = tmpdir + "/span_painter_seg.nii.gz";
+
+  DummySystemInfoDelegate sidel(argv[0]);
+  SystemInterface::SetSystemInfoDelegate(&sidel);
+
+  IRISApplication::Pointer app = IRISApplication::New();
+
+  int rc = 0;
+  try
+    {
+    // The segmentation also serves as the main image
+    // A segmentation with runs of several labels and of clear voxels
+    WriteSegmentation(fn_seg, n, [](const LabelFileImageType::IndexType &idx)
+      {
+      return (idx[0] / 5 + idx[1] + 2 * idx[2]) % 4;
+      });
+    IRISWarningList wl;
+    app->OpenImage(fn_seg.c_str(), MAIN_ROLE, wl);
+
+    srand(1234);
+    SpanList spans = MakeRandomSpans(600);
+
+    RegionType box;
+    box.SetIndex({{ 3, 2, 5 }});
+    box.SetSize({{ 15, 17, 1 }});
+
+    rc |= TestNormalize(spans);
+    rc |= TestComplement(spans, box);
+
+    // Draw-over modes, background mode and inverted drawing
+    struct Case { const char *name; DrawOverFilter drawover; bool background, invert; };
+    Case cases[] = {
+      { "paint over all", { PAINT_OVER_ALL, 0 }, false, false },
+      { "paint over one", { PAINT_OVER_ONE, 2 }, false, false },
+      { "paint over visible", { PAINT_OVER_VISIBLE, 0 }, false, false },
+      { "background", { PAINT_OVER_ALL, 0 }, true, false },
+      { "inverted", { PAINT_OVER_ALL, 0 }, false, true }
+    };
+
+    const LabelType label = 3;
+    for(const Case &c : cases)
+      {
+      SpanList case_spans = c.invert ? SegmentationSpanPainter::Complement(spans, box) : spans;
+      vector<bool> mask = MakeMask(case_spans);
+
+      app->OpenImage(fn_seg.c_str(), LABEL_ROLE, wl);
+      vector<LabelType> before = GetVoxels(app->GetSelectedSegmentationLayer());
+      PaintResult ref = PaintVoxelByVoxel(app->GetSelectedSegmentationLayer(), mask, label, c.drawover, c.background);
+
+      app->OpenImage(fn_seg.c_str(), LABEL_ROLE, wl);
+      PaintResult res = PaintSpans(app->GetSelectedSegmentationLayer(), case_spans, label, c.drawover, c.background);
+
+      cout << c.name << ": " << ref.Changed << " voxels changed voxel by voxel, "
+           << res.Changed << " by spans" << endl;
+
+      if(res.Voxels != ref.Voxels || res.Changed != ref.Changed)
+        {
+        cerr << c.name << ": segmentation differs from the voxel by voxel merge" << endl;
+        rc = 1;
+        }
+
+      // Undo deltas are the differences between the new and the old labels
+      vector<LabelType> diff(before.size());
+      for(size_t i = 0; i < diff.size(); i++)
+        diff[i] = ref.Voxels[i] - before[i];
+      if(ref.Delta != diff || res.Delta != ref.Delta)
+        {
+        cerr << c.name << ": undo delta differs from the voxel by voxel merge" << endl;
+        rc = 1;
+        }
+      }
+
+    app->UnloadMainImage();
+    }
+  catch(std::exception &exc)
+    {
+    cerr << "Span painter test failed: " << exc.what() << endl;
+    rc = -1;
+    }
+
+  itksys::SystemTools::RemoveFile(fn_seg);
+
+  if(rc == 0)
+    cout << "Span painting matches the voxel by voxel merge" << endl;
+  return rc;
+}
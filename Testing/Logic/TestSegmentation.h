@@ -0,0 +1,57 @@
+#ifndef TESTSEGMENTATION_H
+#define TESTSEGMENTATION_H
+
+#include "LabelImageWrapper.h"
+#include <itkImage.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <string>
+#include <vector>
+
+/**
+ * Helpers for the logic tests that load segmentations from files and check
+ * the voxels of the segmentation layers.
+ */
+typedef itk::Image<unsigned short, 3> LabelFileImageType;
+
+/** Write a segmentation of n^3 voxels, labeled by a function of the index */
+template <class TFunction>
+void WriteSegmentation(const std::string &fn, int n, TFunction label_at)
+{
+  LabelFileImageType::Pointer img = LabelFileImageType::New();
+  img->SetRegions(LabelFileImageType::SizeType({{(itk::SizeValueType) n, (itk::SizeValueType) n, (itk::SizeValueType) n}}));
+  img->Allocate();
+
+  for(itk::ImageRegionIteratorWithIndex<LabelFileImageType> it(img, img->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    it.Set(static_cast<LabelFileImageType::PixelType>(label_at(it.GetIndex())));
+
+  typedef itk::ImageFileWriter<LabelFileImageType> WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetInput(img);
+  writer->SetFileName(fn);
+  writer->Update();
+}
+
+/** Write a segmentation in which the voxels of a region have a given label */
+inline void WriteSegmentation(const std::string &fn, int n, const itk::ImageRegion<3> &region, LabelType label)
+{
+  WriteSegmentation(fn, n, [&](const LabelFileImageType::IndexType &idx)
+    {
+    return region.IsInside(idx) ? label : 0;
+    });
+}
+
+/** Copy all the voxels of a segmentation, with x varying fastest */
+inline std::vector<LabelType> GetVoxels(LabelImageWrapper *seg)
+{
+  std::vector<LabelType> voxels;
+  Vector3ui size = seg->GetSize();
+  itk::Index<3> idx;
+  for(idx[2] = 0; idx[2] < size[2]; idx[2]++)
+    for(idx[1] = 0; idx[1] < size[1]; idx[1]++)
+      for(idx[0] = 0; idx[0] < size[0]; idx[0]++)
+        voxels.push_back(seg->GetVoxel(idx));
+  return voxels;
+}
+
+#endif // TESTSEGMENTATION_H
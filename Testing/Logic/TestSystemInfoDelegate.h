@@ -0,0 +1,58 @@
+#ifndef TESTSYSTEMINFODELEGATE_H
+#define TESTSYSTEMINFODELEGATE_H
+
+#include "UIReporterDelegates.h"
+#include "itksys/SystemTools.hxx"
+
+/**
+ * A system info delegate for the logic tests, which run without a GUI. The
+ * user data is kept in the .itksnap.test directory, and the resources are
+ * not loaded.
+ */
+class DummySystemInfoDelegate : public SystemInfoDelegate
+{
+public:
+
+  DummySystemInfoDelegate(const char *argv0)
+    {
+    m_ExecutableName = argv0;
+    }
+
+  virtual std::string GetApplicationDirectory()
+    {
+    return itksys::SystemTools::GetFilenamePath(m_ExecutableName);
+    }
+
+  virtual std::string GetApplicationFile()
+    {
+    return m_ExecutableName;
+    }
+
+  virtual std::string GetApplicationPermanentDataLocation()
+    {
+    return std::string(".itksnap.test");
+    }
+
+  virtual std::string GetUserDocumentsLocation()
+    {
+    return std::string(".itksnap.test");
+    }
+
+  virtual std::string EncodeServerURL(const std::string &url)
+    {
+    return url;
+    }
+
+  typedef SystemInfoDelegate::GrayscaleImage GrayscaleImage;
+  typedef SystemInfoDelegate::RGBAPixelType RGBAPixelType;
+  typedef SystemInfoDelegate::RGBAImageType RGBAImageType;
+
+  virtual void LoadResourceAsImage2D(std::string tag, GrayscaleImage *image) {}
+  virtual void LoadResourceAsRegistry(std::string tag, Registry &reg) {}
+  virtual void WriteRGBAImage2D(std::string file, RGBAImageType *image) {}
+
+protected:
+  std::string m_ExecutableName;
+};
+
+#endif // TESTSYSTEMINFODELEGATE_H
@@ -0,0 +1,20 @@
+#ifndef TESTTIMING_H
+#define TESTTIMING_H
+
+#include <itkTimeProbe.h>
+
+/**
+ * Time a single call of a function or lambda, for the benchmarks among the
+ * logic tests. Returns the elapsed time in milliseconds.
+ */
+template <class TFunction>
+double TimeIt(TFunction f)
+{
+  itk::TimeProbe tp;
+  tp.Start();
+  f();
+  tp.Stop();
+  return tp.GetMean() * 1000;
+}
+
+#endif // TESTTIMING_H
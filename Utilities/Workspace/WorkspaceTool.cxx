@@ -83,6 +83,10 @@ int usage(int rc)
   cout << "  -o <workspace>                    : Write workspace file (without touching external images)" << endl;
   cout << "  -a <dest_dir>                     : Package workspace into uploadable archive in dest_dir" << endl;
   cout << "  -A <dest_dir>                     : Package workspace preserving filenames" << endl;
+  cout << "  -as <store_dir> <workspace>       : Package workspace, writing each distinct image once" << endl;
+  cout << "                                      into a store directory shared between workspaces." << endl;
+  cout << "                                      Checksums are cached in the input workspace; save it" << endl;
+  cout << "                                      with -o to skip unchanged images on later exports" << endl;
   cout << "  -p <prefix>                       : Set the output prefix for the next command only" << endl;
   cout << "  -P                                : No printing of prefix for output commands" << endl;
   cout << "Informational commands: " << endl;
@@ -424,6 +428,13 @@ int main(int argc, char *argv[])
         ws.ExportWorkspace(cl.read_output_filename().c_str(), nullptr, false);
         }
 
+      else if(arg == "-as")
+        {
+        // Create an archive with images in a content-addressed store
+        string store_dir = cl.read_output_filename();
+        ws.ExportWorkspaceToStore(cl.read_output_filename().c_str(), store_dir.c_str());
+        }
+
       // Prefix
       else if(arg == "-p" || arg == "-prefix")
         {